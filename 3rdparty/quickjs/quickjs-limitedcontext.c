@@ -59,3 +59,43 @@ JSContext *JS_NewLimitedContext(JSRuntime *rt, const JSLimitedContextOptions* op
 //#endif
 	return ctx;
 }
+
+const void *JS_UpdateStackTop(JSRuntime *rt)
+{
+	const void *stack_top = rt->stack_top;
+	rt->stack_top = js_get_stack_pointer();
+	return stack_top;
+}
+
+void JS_RestoreStackTop(JSRuntime *rt, const void *stack_top)
+{
+	rt->stack_top = (const uint8_t *)stack_top;
+}
+
+static void *js_counting_malloc(JSMallocState *s, size_t size)
+{
+	JSAllocationCounts *counts = (JSAllocationCounts *)s->opaque;
+	counts->count++;
+	counts->size += size;
+	return js_def_malloc(s, size);
+}
+
+static void *js_counting_realloc(JSMallocState *s, void *ptr, size_t size)
+{
+	JSAllocationCounts *counts = (JSAllocationCounts *)s->opaque;
+	size_t old_size = ptr ? js_def_malloc_usable_size(ptr) : 0;
+	if (size > old_size)
+	{
+		counts->count++;
+		counts->size += size - old_size;
+	}
+	return js_def_realloc(s, ptr, size);
+}
+
+JSRuntime *JS_NewCountingRuntime(JSAllocationCounts *counts)
+{
+	JSMallocFunctions mf = def_malloc_funcs;
+	mf.js_malloc = js_counting_malloc;
+	mf.js_realloc = js_counting_realloc;
+	return JS_NewRuntime2(&mf, counts);
+}
@@ -47,6 +47,20 @@ typedef struct JSLimitedContextOptions
 // Constructs a context with a configurable subset of language intrinsics
 JSContext *JS_NewLimitedContext(JSRuntime *rt, const JSLimitedContextOptions* options);
 
+// Makes the runtime measure its stack usage from the current stack pointer, and returns the previous top of the stack,
+// to be passed to JS_RestoreStackTop once done. Needed when a runtime is used from more than one thread.
+const void *JS_UpdateStackTop(JSRuntime *rt);
+void JS_RestoreStackTop(JSRuntime *rt, const void *stack_top);
+
+typedef struct JSAllocationCounts
+{
+	uint64_t count;
+	uint64_t size;
+} JSAllocationCounts;
+
+// Constructs a runtime which adds each of its allocations to *counts (growing an allocation counts as allocating the difference)
+JSRuntime *JS_NewCountingRuntime(JSAllocationCounts *counts);
+
 #ifdef __cplusplus
 } /* extern "C" { */
 #endif
@@ -113,6 +113,25 @@ Sha256 sha256Sum(void const *data, size_t dataLen)
 	return ret;
 }
 
+Sha256Hasher::Sha256Hasher()
+{
+	static_assert(sizeof(crypto_hash_sha256_state) <= sizeof(state), "Sha256Hasher::state too small.");
+	crypto_hash_sha256_init(reinterpret_cast<crypto_hash_sha256_state *>(state));
+}
+
+void Sha256Hasher::update(void const *data, size_t dataLen)
+{
+	crypto_hash_sha256_update(reinterpret_cast<crypto_hash_sha256_state *>(state), (const unsigned char *)data, dataLen);
+}
+
+Sha256 Sha256Hasher::result() const
+{
+	crypto_hash_sha256_state stateCopy = *reinterpret_cast<crypto_hash_sha256_state const *>(state);
+	Sha256 ret;
+	crypto_hash_sha256_final(&stateCopy, ret.bytes);
+	return ret;
+}
+
 bool Sha256::operator ==(Sha256 const &b) const
 {
 	return memcmp(bytes, b.bytes, Bytes) == 0;
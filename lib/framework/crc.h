@@ -45,6 +45,18 @@ struct Sha256
 };
 Sha256 sha256Sum(void const *data, size_t dataLen);
 
+/// Calculates a Sha256 of data which arrives in pieces, giving the same result as sha256Sum of all the pieces.
+class Sha256Hasher
+{
+public:
+	Sha256Hasher();
+	void update(void const *data, size_t dataLen);
+	Sha256 result() const;  ///< Returns the hash of the data so far, more data can still be added afterwards.
+
+private:
+	alignas(uint64_t) uint8_t state[128];  ///< A crypto_hash_sha256_state, which is a plain struct, so the class can be copied.
+};
+
 class EcKey
 {
 public:
@@ -67,6 +67,8 @@ struct screeninfo
 };
 
 void wzMain(int &argc, char **argv);
+void wzSetHeadless(bool headless);	///< Run without a window, rendering or audio. Must be called before wzMainScreenSetup.
+bool wzIsHeadless();
 bool wzMainScreenSetup(const video_backend& backend, int antialiasing = 0, bool fullscreen = false, int vsync = 1, bool highDPI = true);
 video_backend wzGetDefaultGfxBackendForCurrentSystem();
 void wzGetGameToRendererScaleFactor(float *horizScaleFactor, float *vertScaleFactor);
@@ -115,6 +117,7 @@ WZ_DECL_NONNULL(1) int wzThreadJoin(WZ_THREAD *thread);
 WZ_DECL_NONNULL(1) void wzThreadDetach(WZ_THREAD *thread);
 WZ_DECL_NONNULL(1) void wzThreadStart(WZ_THREAD *thread);
 void wzYieldCurrentThread();
+unsigned wzGetLogicalCPUCount();	///< Number of logical CPU cores, at least 1
 WZ_MUTEX *wzMutexCreate();
 WZ_DECL_NONNULL(1) void wzMutexDestroy(WZ_MUTEX *mutex);
 WZ_DECL_NONNULL(1) void wzMutexLock(WZ_MUTEX *mutex);
@@ -19,9 +19,29 @@
 
 #include "gfx_api_vk.h"
 #include "gfx_api_gl.h"
+#include "gfx_api_null.h"
 
 bool uses_vulkan = false;
 bool uses_gfx_debug = false;
+static bool uses_null_backend = false;
+
+namespace
+{
+	class null_backend_Impl_Factory final : public gfx_api::backend_Impl_Factory
+	{
+	public:
+		virtual std::unique_ptr<gfx_api::backend_OpenGL_Impl> createOpenGLBackendImpl() const override
+		{
+			return nullptr;
+		}
+#if defined(WZ_VULKAN_ENABLED)
+		virtual std::unique_ptr<gfx_api::backend_Vulkan_Impl> createVulkanBackendImpl() const override
+		{
+			return nullptr;
+		}
+#endif
+	};
+}
 
 bool gfx_api::context::initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode swapMode, bool useVulkan)
 {
@@ -29,9 +49,20 @@ bool gfx_api::context::initialize(const gfx_api::backend_Impl_Factory& impl, int
 	return gfx_api::context::get()._initialize(impl, antialiasing, swapMode);
 }
 
+bool gfx_api::context::initializeNull()
+{
+	uses_null_backend = true;
+	return gfx_api::context::get()._initialize(null_backend_Impl_Factory(), 0, swap_interval_mode::immediate);
+}
+
 gfx_api::context& gfx_api::context::get()
 {
-	if (uses_vulkan)
+	if (uses_null_backend)
+	{
+		static null_context ctx;
+		return ctx;
+	}
+	else if (uses_vulkan)
 	{
 #if defined(WZ_VULKAN_ENABLED)
 		static VkRoot ctx(uses_gfx_debug);
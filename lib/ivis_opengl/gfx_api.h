@@ -285,6 +285,8 @@ namespace gfx_api
 		virtual int32_t get_context_value(const context_value property) = 0;
 		static context& get();
 		static bool initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode mode, bool useVulkan);
+		// Selects the backend which draws nothing, for running without a window.
+		static bool initializeNull();
 		virtual void flip(int clearMode) = 0;
 		virtual void debugStringMarker(const char *str) = 0;
 		virtual void debugSceneBegin(const char *descr) = 0;
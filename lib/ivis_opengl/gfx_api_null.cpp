@@ -0,0 +1,80 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "gfx_api_null.h"
+
+#include <limits>
+
+gfx_api::texture* null_context::create_texture(const size_t& mipmap_count, const size_t& width, const size_t& height, const gfx_api::pixel_format& internal_format, const std::string& filename)
+{
+	return new null_texture();
+}
+
+gfx_api::buffer* null_context::create_buffer_object(const gfx_api::buffer::usage& usage, const buffer_storage_hint& hint)
+{
+	return new null_buffer();
+}
+
+gfx_api::pipeline_state_object* null_context::build_pipeline(const gfx_api::state_description& state_desc,
+                                                             const SHADER_MODE& shader_mode,
+                                                             const gfx_api::primitive_type& primitive,
+                                                             const std::vector<gfx_api::texture_input>& texture_desc,
+                                                             const std::vector<gfx_api::vertex_buffer>& attribute_descriptions)
+{
+	return new null_pipeline_state_object();
+}
+
+int32_t null_context::get_context_value(const context_value property)
+{
+	switch (property)
+	{
+		case gfx_api::context::context_value::MAX_ELEMENTS_VERTICES:
+		case gfx_api::context::context_value::MAX_ELEMENTS_INDICES:
+			return std::numeric_limits<int32_t>::max();
+		case gfx_api::context::context_value::MAX_TEXTURE_SIZE:
+			return 16384;
+		case gfx_api::context::context_value::MAX_SAMPLES:
+			return 0;
+	}
+	return 0;
+}
+
+void null_context::flip(int clearMode)
+{
+	++frameNum;
+}
+
+std::map<std::string, std::string> null_context::getBackendGameInfo()
+{
+	std::map<std::string, std::string> backendGameInfo;
+	backendGameInfo["null_backend"] = "true";
+	return backendGameInfo;
+}
+
+const std::string& null_context::getFormattedRendererInfoString() const
+{
+	static const std::string rendererInfo = "Null renderer (headless)";
+	return rendererInfo;
+}
+
+bool null_context::_initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode mode)
+{
+	debug(LOG_3D, "Using the null renderer, nothing will be drawn");
+	return true;
+}
@@ -0,0 +1,92 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "gfx_api.h"
+
+// A backend which renders nothing, for running without a window (see --headless).
+// Textures and buffers don't keep the data uploaded to them, and draw calls are ignored.
+
+struct null_texture final : public gfx_api::texture
+{
+	virtual void bind() override {}
+	virtual void upload(const size_t& mip_level, const size_t& offset_x, const size_t& offset_y, const size_t& width, const size_t& height, const gfx_api::pixel_format& buffer_format, const void* data) override {}
+	virtual void upload_and_generate_mipmaps(const size_t& offset_x, const size_t& offset_y, const size_t& width, const size_t& height, const gfx_api::pixel_format& buffer_format, const void* data) override {}
+	virtual unsigned id() override { return 0; }
+};
+
+struct null_buffer final : public gfx_api::buffer
+{
+	virtual void upload(const size_t& size, const void* data) override {}
+	virtual void update(const size_t& start, const size_t& size, const void* data, const update_flag flag = update_flag::none) override {}
+	virtual void bind() override {}
+};
+
+struct null_pipeline_state_object final : public gfx_api::pipeline_state_object
+{
+};
+
+struct null_context final : public gfx_api::context
+{
+	virtual gfx_api::texture* create_texture(const size_t& mipmap_count, const size_t& width, const size_t& height, const gfx_api::pixel_format& internal_format, const std::string& filename) override;
+	virtual gfx_api::buffer* create_buffer_object(const gfx_api::buffer::usage& usage, const buffer_storage_hint& hint = buffer_storage_hint::static_draw) override;
+	virtual gfx_api::pipeline_state_object* build_pipeline(const gfx_api::state_description& state_desc,
+	                                                       const SHADER_MODE& shader_mode,
+	                                                       const gfx_api::primitive_type& primitive,
+	                                                       const std::vector<gfx_api::texture_input>& texture_desc,
+	                                                       const std::vector<gfx_api::vertex_buffer>& attribute_descriptions) override;
+	virtual void bind_pipeline(gfx_api::pipeline_state_object* pso, bool notextures) override {}
+	virtual void bind_index_buffer(gfx_api::buffer&, const gfx_api::index_type&) override {}
+	virtual void unbind_index_buffer(gfx_api::buffer&) override {}
+	virtual void bind_vertex_buffers(const std::size_t& first, const std::vector<std::tuple<gfx_api::buffer*, std::size_t>>& vertex_buffers_offset) override {}
+	virtual void unbind_vertex_buffers(const std::size_t& first, const std::vector<std::tuple<gfx_api::buffer*, std::size_t>>& vertex_buffers_offset) override {}
+	virtual void disable_all_vertex_buffers() override {}
+	virtual void bind_streamed_vertex_buffers(const void* data, const std::size_t size) override {}
+	virtual void bind_textures(const std::vector<gfx_api::texture_input>& texture_descriptions, const std::vector<gfx_api::texture*>& textures) override {}
+	virtual void set_constants(const void* buffer, const size_t& size) override {}
+	virtual void draw(const size_t& offset, const size_t& count, const gfx_api::primitive_type& primitive) override {}
+	virtual void draw_elements(const size_t& offset, const size_t& count, const gfx_api::primitive_type& primitive, const gfx_api::index_type& index) override {}
+	virtual void set_polygon_offset(const float& offset, const float& slope) override {}
+	virtual void set_depth_range(const float& min, const float& max) override {}
+	virtual int32_t get_context_value(const context_value property) override;
+
+	virtual void flip(int clearMode) override;
+	virtual void debugStringMarker(const char *str) override {}
+	virtual void debugSceneBegin(const char *descr) override {}
+	virtual void debugSceneEnd(const char *descr) override {}
+	virtual bool debugPerfAvailable() override { return false; }
+	virtual bool debugPerfStart(size_t sample) override { return false; }
+	virtual void debugPerfStop() override {}
+	virtual void debugPerfBegin(PERF_POINT pp, const char *descr) override {}
+	virtual void debugPerfEnd(PERF_POINT pp) override {}
+	virtual uint64_t debugGetPerfValue(PERF_POINT pp) override { return 0; }
+	virtual std::map<std::string, std::string> getBackendGameInfo() override;
+	virtual const std::string& getFormattedRendererInfoString() const override;
+	virtual bool getScreenshot(std::function<void (std::unique_ptr<iV_Image>)> callback) override { return false; }
+	virtual void handleWindowSizeChange(unsigned int oldWidth, unsigned int oldHeight, unsigned int newWidth, unsigned int newHeight) override {}
+	virtual void shutdown() override {}
+	virtual const size_t& current_FrameNum() const override { return frameNum; }
+	virtual bool setSwapInterval(gfx_api::context::swap_interval_mode mode) override { return false; }
+	virtual gfx_api::context::swap_interval_mode getSwapInterval() const override { return gfx_api::context::swap_interval_mode::immediate; }
+private:
+	virtual bool _initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode mode) override;
+
+	size_t frameNum = 0;
+};
@@ -21,10 +21,15 @@
 // Includes
 #include "lib/framework/frame.h"
 
+#include <algorithm>
 #include <time.h>
 #include <physfs.h>
 #include "lib/framework/physfs_ext.h"
 
+#include "lib/framework/wzapp.h"
+#include "lib/gamelib/gtime.h"
+#include <3rdparty/json/json.hpp>
+
 #include "netlog.h"
 #include "netplay.h"
 
@@ -38,6 +43,190 @@ static PHYSFS_file	*pFileHandle = nullptr;
 static uint32_t		packetcount[2][NUM_GAME_PACKETS];
 static uint32_t		packetsize[2][NUM_GAME_PACKETS];
 
+// ////////////////////////////////////////////////////////////////////////
+// Statistics, written as one JSON object per line to the statistics file
+// ////////////////////////////////////////////////////////////////////////
+
+#define NUM_LATENCY_BUCKETS 12
+
+/// Upper limits of the latency histogram buckets, in milliseconds. The last bucket has no limit.
+static const uint32_t latencyBucketLimits[NUM_LATENCY_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000};
+
+struct LatencyHistogram
+{
+	uint32_t buckets[NUM_LATENCY_BUCKETS];
+	uint32_t count;
+	uint64_t totalMs;
+	uint32_t maxMs;
+};
+
+struct QueueDepth
+{
+	uint32_t current;
+	uint32_t max;      ///< Since the statistics were last written.
+};
+
+static unsigned         statsInterval = 0;  ///< Seconds between writing the statistics, 0 if disabled.
+static PHYSFS_file     *pStatsFileHandle = nullptr;
+static uint32_t         statsStartTime;
+static uint32_t         statsLastWriteTime;
+static uint32_t         wirecount[NUM_GAME_PACKETS];
+static uint64_t         wiresize[NUM_GAME_PACKETS];
+static uint32_t         timecount[2][NUM_GAME_PACKETS];     ///< Index 0 is encoding, 1 is decoding.
+static uint64_t         timemicroseconds[2][NUM_GAME_PACKETS];
+static LatencyHistogram gameLatency[MAX_PLAYERS];
+static QueueDepth       gameQueueDepth[MAX_PLAYERS];
+
+static bool NETstartStatistics()
+{
+	memset(wirecount, 0, sizeof(wirecount));
+	memset(wiresize, 0, sizeof(wiresize));
+	memset(timecount, 0, sizeof(timecount));
+	memset(timemicroseconds, 0, sizeof(timemicroseconds));
+	memset(gameLatency, 0, sizeof(gameLatency));
+	memset(gameQueueDepth, 0, sizeof(gameQueueDepth));
+	statsStartTime = wzGetTicks();
+	statsLastWriteTime = statsStartTime;
+
+	if (statsInterval == 0)
+	{
+		return true;
+	}
+
+	time_t aclock;
+	time(&aclock);
+	struct tm *newtime = localtime(&aclock);
+	char filename[256];
+	snprintf(filename, sizeof(filename), "logs/netstats-%04d%02d%02d_%02d%02d%02d.jsonl", newtime->tm_year + 1900, newtime->tm_mon + 1, newtime->tm_mday, newtime->tm_hour, newtime->tm_min, newtime->tm_sec);
+	pStatsFileHandle = PHYSFS_openWrite(filename);
+	if (!pStatsFileHandle)
+	{
+		debug(LOG_ERROR, "Could not create net statistics %s: %s", filename, WZ_PHYSFS_getLastError());
+		return false;
+	}
+	debug(LOG_NET, "Writing net statistics to %s every %u seconds", filename, statsInterval);
+	return true;
+}
+
+static void NETwriteStatistics()
+{
+	uint32_t now = wzGetTicks();
+	statsLastWriteTime = now;
+
+	nlohmann::json types = nlohmann::json::object();
+	for (unsigned i = 0; i < NUM_GAME_PACKETS; ++i)
+	{
+		if (packetcount[0][i] == 0 && packetcount[1][i] == 0 && wirecount[i] == 0 && timecount[0][i] == 0 && timecount[1][i] == 0)
+		{
+			continue;
+		}
+		types[messageTypeToString(i)] = {
+			{"sent", packetcount[0][i]}, {"sentBytes", packetsize[0][i]},
+			{"received", packetcount[1][i]}, {"receivedBytes", packetsize[1][i]},
+			{"wire", wirecount[i]}, {"wireBytes", wiresize[i]},
+			{"encoded", timecount[0][i]}, {"encodeMicroseconds", timemicroseconds[0][i]},
+			{"decoded", timecount[1][i]}, {"decodeMicroseconds", timemicroseconds[1][i]},
+		};
+	}
+
+	nlohmann::json players = nlohmann::json::array();
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		LatencyHistogram const &latency = gameLatency[player];
+		nlohmann::json buckets = nlohmann::json::array();
+		for (unsigned bucket = 0; bucket < NUM_LATENCY_BUCKETS; ++bucket)
+		{
+			buckets.push_back({{"le", bucket < NUM_LATENCY_BUCKETS - 1 ? nlohmann::json(latencyBucketLimits[bucket]) : nlohmann::json("inf")}, {"count", latency.buckets[bucket]}});
+		}
+		players.push_back({
+			{"player", player},
+			{"latency", {{"count", latency.count}, {"totalMs", latency.totalMs}, {"maxMs", latency.maxMs}, {"buckets", buckets}}},
+			{"queueDepth", gameQueueDepth[player].current}, {"queueDepthMax", gameQueueDepth[player].max},
+		});
+		gameQueueDepth[player].max = gameQueueDepth[player].current;
+	}
+
+	nlohmann::json stats = {
+		{"ms", now - statsStartTime},
+		{"rawBytesSent", NETgetStatistic(NetStatisticRawBytes, true, true)}, {"rawBytesReceived", NETgetStatistic(NetStatisticRawBytes, false, true)},
+		{"uncompressedBytesSent", NETgetStatistic(NetStatisticUncompressedBytes, true, true)}, {"uncompressedBytesReceived", NETgetStatistic(NetStatisticUncompressedBytes, false, true)},
+		{"packetsSent", NETgetStatistic(NetStatisticPackets, true, true)}, {"packetsReceived", NETgetStatistic(NetStatisticPackets, false, true)},
+		{"types", types},
+		{"players", players},
+	};
+	std::string line = stats.dump() + "\n";
+	if (WZ_PHYSFS_writeBytes(pStatsFileHandle, line.data(), static_cast<PHYSFS_uint32>(line.size())) != static_cast<PHYSFS_sint64>(line.size()))
+	{
+		debug(LOG_ERROR, "Could not write net statistics, stopping: %s", WZ_PHYSFS_getLastError());
+		PHYSFS_close(pStatsFileHandle);
+		pStatsFileHandle = nullptr;
+		return;
+	}
+	PHYSFS_flush(pStatsFileHandle);
+}
+
+static void NETstopStatistics()
+{
+	if (!pStatsFileHandle)
+	{
+		return;
+	}
+	NETwriteStatistics();
+	if (!PHYSFS_close(pStatsFileHandle))
+	{
+		debug(LOG_ERROR, "Could not close net statistics: %s", WZ_PHYSFS_getLastError());
+	}
+	pStatsFileHandle = nullptr;
+}
+
+void NETsetStatisticsInterval(unsigned seconds)
+{
+	statsInterval = seconds;
+}
+
+bool NETstatisticsEnabled()
+{
+	return pStatsFileHandle != nullptr;
+}
+
+void NETlogPacketWire(uint8_t type, uint32_t size)
+{
+	wirecount[type]++;
+	wiresize[type] += size;
+}
+
+void NETlogPacketTime(uint8_t type, uint64_t microseconds, bool decoded)
+{
+	timecount[decoded][type]++;
+	timemicroseconds[decoded][type] += microseconds;
+}
+
+void NETlogGameMessageLatency(uint8_t player, uint32_t milliseconds)
+{
+	ASSERT_OR_RETURN(, player < MAX_PLAYERS, "Bad player %u", player);
+	LatencyHistogram &latency = gameLatency[player];
+	unsigned bucket = std::lower_bound(latencyBucketLimits, latencyBucketLimits + NUM_LATENCY_BUCKETS - 1, milliseconds) - latencyBucketLimits;
+	latency.buckets[bucket]++;
+	latency.count++;
+	latency.totalMs += milliseconds;
+	latency.maxMs = std::max(latency.maxMs, milliseconds);
+}
+
+void NETlogGameQueueDepth(uint8_t player, uint32_t depth)
+{
+	ASSERT_OR_RETURN(, player < MAX_PLAYERS, "Bad player %u", player);
+	gameQueueDepth[player].current = depth;
+	gameQueueDepth[player].max = std::max(gameQueueDepth[player].max, depth);
+}
+
+void NETupdateStatistics()
+{
+	if (pStatsFileHandle && wzGetTicks() - statsLastWriteTime >= statsInterval * GAME_TICKS_PER_SEC)
+	{
+		NETwriteStatistics();
+	}
+}
+
 bool NETstartLogging(void)
 {
 	time_t aclock;
@@ -67,7 +256,7 @@ bool NETstartLogging(void)
 	}
 	snprintf(buf, sizeof(buf), "NETPLAY log: %s\n", asctime(newtime));
 	WZ_PHYSFS_writeBytes(pFileHandle, buf, static_cast<PHYSFS_uint32>(strlen(buf)));
-	return true;
+	return NETstartStatistics();
 }
 
 bool NETstopLogging(void)
@@ -77,6 +266,8 @@ bool NETstopLogging(void)
 	int i;
 	UDWORD totalBytessent = 0, totalBytesrecv = 0, totalPacketsent = 0, totalPacketrecv = 0;
 
+	NETstopStatistics();
+
 	if (!pFileHandle)
 	{
 		return false;
@@ -29,4 +29,13 @@ bool NETstopLogging();
 WZ_DECL_NONNULL(1) bool NETlogEntry(const char *str, UDWORD a, UDWORD b);
 void NETlogPacket(uint8_t type, uint32_t size, bool received);
 
+// Statistics for diagnosing network load, written as JSON while logging, if enabled with NETsetStatisticsInterval.
+void NETsetStatisticsInterval(unsigned seconds);  ///< Writes the statistics every given number of seconds, 0 to disable. Call before NETinit.
+bool NETstatisticsEnabled();                       ///< True if the statistics below are being collected.
+void NETlogPacketWire(uint8_t type, uint32_t size);                   ///< A message of size bytes was written to a socket.
+void NETlogPacketTime(uint8_t type, uint64_t microseconds, bool decoded);  ///< Time spent encoding (or decoding) a message.
+void NETlogGameMessageLatency(uint8_t player, uint32_t milliseconds); ///< Time from a game message arriving from the network to it being processed.
+void NETlogGameQueueDepth(uint8_t player, uint32_t depth);            ///< Number of messages waiting in the game queue of a player.
+void NETupdateStatistics();                        ///< Writes the statistics, if it's time to. Call regularly.
+
 #endif // _netlog_h
@@ -41,10 +41,13 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <unordered_map>
 #include <sodium.h>
 
 #include "netplay.h"
 #include "netlog.h"
+#include "netreplay.h"
 #include "netsocket.h"
 
 #include <miniupnpc/miniwget.h>
@@ -130,6 +133,9 @@ struct NETSTATS  // data regarding the last one second or so.
 	Statistic       rawBytes;               // Number of actual bytes, in about 1 sec.
 	Statistic       uncompressedBytes;      // Number of bytes sent, before compression, in about 1 sec.
 	Statistic       packets;                // Number of calls to writeAll, in about 1 sec.
+	Statistic       broadcasts;             // Number of messages the host sent to all players, in about 1 sec.
+	Statistic       broadcastBytes;         // Number of bytes in those messages, counted once per message, before compression, in about 1 sec.
+	Statistic       broadcastMicroseconds;  // Time spent serialising and compressing those messages, in about 1 sec.
 };
 
 struct NET_PLAYER_DATA
@@ -182,10 +188,10 @@ static SocketSet *tmp_socket_set = nullptr;
 static int32_t          NetGameFlags[4] = { 0, 0, 0, 0 };
 char iptoconnect[PATH_MAX] = "\0"; // holds IP/hostname from command line
 
-static NETSTATS nStats              = {{0, 0}, {0, 0}, {0, 0}};
-static NETSTATS nStatsLastSec       = {{0, 0}, {0, 0}, {0, 0}};
-static NETSTATS nStatsSecondLastSec = {{0, 0}, {0, 0}, {0, 0}};
-static const NETSTATS nZeroStats    = {{0, 0}, {0, 0}, {0, 0}};
+static NETSTATS nStats              = {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}};
+static NETSTATS nStatsLastSec       = {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}};
+static NETSTATS nStatsSecondLastSec = {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}};
+static const NETSTATS nZeroStats    = {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}};
 static int nStatsLastUpdateTime = 0;
 
 unsigned NET_PlayerConnectionStatus[CONNECTIONSTATUS_NORMAL][MAX_PLAYERS];
@@ -1360,6 +1366,9 @@ size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
 	case NetStatisticRawBytes:          statsType = &NETSTATS::rawBytes;          break;
 	case NetStatisticUncompressedBytes: statsType = &NETSTATS::uncompressedBytes; break;
 	case NetStatisticPackets:           statsType = &NETSTATS::packets;           break;
+	case NetStatisticBroadcasts:        statsType = &NETSTATS::broadcasts;        break;
+	case NetStatisticBroadcastBytes:    statsType = &NETSTATS::broadcastBytes;    break;
+	case NetStatisticBroadcastMicroseconds: statsType = &NETSTATS::broadcastMicroseconds; break;
 	default: ASSERT(false, " "); return 0;
 	}
 
@@ -1413,24 +1422,37 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 
 	if (NetPlay.isHost)
 	{
-		int firstPlayer = player == NET_ALL_PLAYERS ? 0                         : player;
-		int lastPlayer  = player == NET_ALL_PLAYERS ? MAX_CONNECTED_PLAYERS - 1 : player;
+		bool isBroadcast = player == NET_ALL_PLAYERS;
+		std::chrono::steady_clock::time_point broadcastStart;
+		if (isBroadcast)
+		{
+			broadcastStart = std::chrono::steady_clock::now();
+		}
+
+		// Serialise the message once, and send the same bytes to every player. (Each socket still compresses them separately, since each has its own zlib stream.)
+		std::vector<uint8_t> rawData;
+
+		int firstPlayer = isBroadcast ? 0                         : player;
+		int lastPlayer  = isBroadcast ? MAX_CONNECTED_PLAYERS - 1 : player;
 		for (player = firstPlayer; player <= lastPlayer; ++player)
 		{
 			// We are the host, send directly to player.
 			if (sockets[player] != nullptr && player != queue.exclude)
 			{
-				uint8_t *rawData = message->rawDataDup();
-				ssize_t rawLen   = message->rawLen();
+				if (rawData.empty())
+				{
+					message->rawDataAppendToVector(rawData);
+				}
+				ssize_t rawLen   = rawData.size();
 				size_t compressedRawLen;
-				result = writeAll(sockets[player], rawData, rawLen, &compressedRawLen);
-				delete[] rawData;  // Done with the data.
+				result = writeAll(sockets[player], &rawData[0], rawLen, &compressedRawLen);
 
 				if (result == rawLen)
 				{
 					nStats.rawBytes.sent          += compressedRawLen;
 					nStats.uncompressedBytes.sent += rawLen;
 					nStats.packets.sent           += 1;
+					NETlogPacketWire(message->type, static_cast<uint32_t>(rawLen));
 				}
 				else if (result == SOCKET_ERROR)
 				{
@@ -1444,6 +1466,13 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 				}
 			}
 		}
+
+		if (isBroadcast && !rawData.empty())
+		{
+			nStats.broadcasts.sent            += 1;
+			nStats.broadcastBytes.sent        += rawData.size();
+			nStats.broadcastMicroseconds.sent += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - broadcastStart).count();
+		}
 		return true;
 	}
 	else if (player == NetPlay.hostPlayer)
@@ -1462,6 +1491,7 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 				nStats.rawBytes.sent          += compressedRawLen;
 				nStats.uncompressedBytes.sent += rawLen;
 				nStats.packets.sent           += 1;
+				NETlogPacketWire(message->type, static_cast<uint32_t>(rawLen));
 			}
 			else if (result == SOCKET_ERROR)
 			{
@@ -1587,6 +1617,7 @@ static bool NETprocessSystemMessage(NETQUEUE playerQueue, uint8_t type)
 				      || message->type == NET_COLOURREQUEST
 				      || message->type == NET_POSITIONREQUEST
 				      || message->type == NET_FILE_CANCELLED
+				      || message->type == NET_FILE_ACKNOWLEDGED
 				      || message->type == NET_JOIN
 				      || message->type == NET_PLAYER_INFO) && receiver != NET_HOST_ONLY))
 				{
@@ -1932,6 +1963,8 @@ bool NETrecvNet(NETQUEUE *queue, uint8_t *type)
 		return false;
 	}
 
+	NETupdateStatistics();
+
 	if (NetPlay.isHost)
 	{
 		NETfixPlayerCount();
@@ -2011,6 +2044,10 @@ bool NETrecvGame(NETQUEUE *queue, uint8_t *type)
 		*queue = NETgameQueue(current);
 		while (!checkPlayerGameTime(current))  // Check for any messages that are scheduled to be read now.
 		{
+			while (!NETisMessageReady(*queue) && NETreplayLoadNetMessage())
+			{
+				// Playing back a replay, keep reading it until there is a message for this player.
+			}
 			if (!NETisMessageReady(*queue))
 			{
 				return false;  // Still waiting for messages from this player, and all players should process messages in the same order. Will have to freeze the game while waiting.
@@ -2034,104 +2071,139 @@ bool NETrecvGame(NETQUEUE *queue, uint8_t *type)
 
 // ////////////////////////////////////////////////////////////////////////
 // File Transfer programs.
-/** Send file. It returns % of file sent when 100 it's complete. Call until it returns 100.
-*  @TODO: more error checking (?) different file types (?)
-*          Maybe should close file handle, and seek each time?
-*
-*  @NOTE: MAX_FILE_TRANSFER_PACKET is set to 2k per packet since 7*2 = 14K which is pretty
-*         much our limit.  Don't screw with that without having a bigger buffer!
-*         NET_BUFFER_SIZE is at 16k.  (also remember text chat, plus all the other cruff)
+/** Files are sent in chunks of MAX_FILE_TRANSFER_PACKET bytes. The receiver acknowledges each chunk once it has been
+*   written, and the sender keeps at most fileTransferWindow bytes unacknowledged, so that several chunks are always
+*   on their way, without filling the socket buffers with a whole mod, delaying any other messages to that player.
 */
-#define MAX_FILE_TRANSFER_PACKET 2048
-int NETsendFile(WZFile &file, unsigned player)
+#define MAX_FILE_TRANSFER_PACKET 16384
+#define DEFAULT_FILE_TRANSFER_WINDOW (256 * 1024)
+static uint32_t fileTransferWindow = DEFAULT_FILE_TRANSFER_WINDOW;
+
+void NETsetFileTransferWindow(uint32_t bytes)
 {
-	ASSERT_OR_RETURN(100, NetPlay.isHost, "Trying to send a file and we are not the host!");
+	fileTransferWindow = std::max<uint32_t>(bytes, MAX_FILE_TRANSFER_PACKET);
+}
 
-	uint8_t inBuff[MAX_FILE_TRANSFER_PACKET];
-	memset(inBuff, 0x0, sizeof(inBuff));
+uint32_t NETgetFileTransferWindow()
+{
+	return fileTransferWindow;
+}
+
+std::shared_ptr<std::vector<uint8_t> const> NETloadFileToSend(std::string const &filename, Sha256 const &hash, bool *openFailed)
+{
+	if (openFailed != nullptr)
+	{
+		*openFailed = false;
+	}
 
-	// read some bytes.
-	uint32_t bytesToRead = WZ_PHYSFS_readBytes(file.handle, inBuff, MAX_FILE_TRANSFER_PACKET);
-	ASSERT_OR_RETURN(100, (int32_t)bytesToRead >= 0, "Error reading file.");
+	// If the file is being sent to another player, it has already been read.
+	for (unsigned player = 0; player < MAX_CONNECTED_PLAYERS; ++player)
+	{
+		for (WZFile const &file : NetPlay.players[player].wzFiles)
+		{
+			if (file.hash == hash && file.data != nullptr)
+			{
+				return file.data;
+			}
+		}
+	}
 
+	PHYSFS_file *fileHandle = PHYSFS_openRead(filename.c_str());
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Failed to open %s for reading: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		if (openFailed != nullptr)
+		{
+			*openFailed = true;
+		}
+		return nullptr;
+	}
+	PHYSFS_sint64 fileSize = PHYSFS_fileLength(fileHandle);
+	if (fileSize < 0 || fileSize > MAX_NET_TRANSFERRABLE_FILE_SIZE)
+	{
+		debug(LOG_ERROR, "Bad file size for %s: %" PRId64, filename.c_str(), static_cast<int64_t>(fileSize));
+		PHYSFS_close(fileHandle);
+		return nullptr;
+	}
+	auto data = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(fileSize));
+	bool readOk = fileSize == 0 || WZ_PHYSFS_readBytes(fileHandle, data->data(), static_cast<PHYSFS_uint32>(fileSize)) == fileSize;
+	PHYSFS_close(fileHandle);
+	if (!readOk)
+	{
+		debug(LOG_ERROR, "Failed to read %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		return nullptr;
+	}
+	return data;
+}
+
+bool NETsendFile(WZFile &file, unsigned player)
+{
+	ASSERT_OR_RETURN(false, NetPlay.isHost, "Trying to send a file and we are not the host!");
+
+	if (file.data == nullptr || file.pos - file.acknowledged >= fileTransferWindow)
+	{
+		return false;  // Sent everything, or waiting for the receiver to catch up.
+	}
+
+	uint32_t bytesToSend = std::min<uint32_t>(file.size - file.pos, MAX_FILE_TRANSFER_PACKET);
 	NETbeginEncode(NETnetQueue(player), NET_FILE_PAYLOAD);
 	NETbin(file.hash.bytes, file.hash.Bytes);
 	NETuint32_t(&file.size);  // total bytes in this file. (we don't support 64bit yet)
 	NETuint32_t(&file.pos);  // start byte
-	NETuint32_t(&bytesToRead);  // bytes in this packet
-	NETbin(inBuff, bytesToRead);
+	NETuint32_t(&bytesToSend);  // bytes in this packet
+	NETbin(const_cast<uint8_t *>(file.data->data()) + file.pos, bytesToSend);  // NETbin only reads when encoding.
 	NETend();
 
-	file.pos += bytesToRead;  // update position!
+	file.pos += bytesToSend;  // update position!
 	if (file.pos == file.size)
 	{
-		PHYSFS_close(file.handle);
-		file.handle = nullptr;  // We are done sending to this client.
+		file.data = nullptr;  // Sent everything, the data is still shared with any other players it's being sent to.
 	}
-
-	return (uint64_t)file.pos * 100 / file.size;
+	return true;
 }
 
-bool validateReceivedFile(const WZFile& file)
+void NETrecvFileAcknowledged(NETQUEUE queue)
 {
-	PHYSFS_file *fileHandle = PHYSFS_openRead(file.filename.c_str());
-	ASSERT_OR_RETURN(false, fileHandle != nullptr, "Could not open downloaded file %s for reading: %s", file.filename.c_str(), WZ_PHYSFS_getLastError());
+	Sha256 hash;
+	hash.setZero();
+	uint32_t pos = 0;
+
+	NETbeginDecode(queue, NET_FILE_ACKNOWLEDGED);
+	NETbin(hash.bytes, hash.Bytes);
+	NETuint32_t(&pos);
+	NETend();
 
-	PHYSFS_sint64 actualFileSize64 = PHYSFS_fileLength(fileHandle);
-	if (actualFileSize64 < 0)
+	ASSERT_HOST_ONLY(return);
+	auto &files = NetPlay.players[queue.index].wzFiles;
+	auto file = std::find_if(files.begin(), files.end(), [&](WZFile const &file) { return file.hash == hash; });
+	if (file == files.end())
 	{
-		debug(LOG_ERROR, "Failed to determine file size of the downloaded file!");
-		PHYSFS_close(fileHandle);
-		return false;
+		return;  // Cancelled already.
 	}
-	if(actualFileSize64 > std::numeric_limits<int32_t>::max())
+	if (pos > file->pos)
 	{
-		debug(LOG_ERROR, "Downloaded file is too large!");
-		PHYSFS_close(fileHandle);
-		return false;
+		debug(LOG_ERROR, "Player %u acknowledged file data we didn't send.", queue.index);
+		return;
 	}
+	file->acknowledged = std::max(file->acknowledged, pos);
+}
 
-	uint32_t actualFileSize = static_cast<uint32_t>(actualFileSize64);
-	if (actualFileSize != file.size)
+static bool validateReceivedFile(const WZFile& file)
+{
+	if (file.pos != file.size)
 	{
-		debug(LOG_ERROR, "Downloaded map unexpected size! Got %" PRIu32", expected %" PRIu32"!", actualFileSize, file.size);
-		PHYSFS_close(fileHandle);
+		debug(LOG_ERROR, "Downloaded map unexpected size! Got %" PRIu32", expected %" PRIu32"!", file.pos, file.size);
 		return false;
 	}
 
-	// verify actual downloaded file hash matches expected hash
-
-	Sha256 actualFileHash;
-	crypto_hash_sha256_state state;
-	crypto_hash_sha256_init(&state);
-	size_t bufferSize = std::min<size_t>(actualFileSize, 4 * 1024 * 1024);
-	std::vector<unsigned char> fileChunkBuffer(bufferSize, '\0');
-	PHYSFS_sint64 length_read = 0;
-	do {
-		length_read = WZ_PHYSFS_readBytes(fileHandle, fileChunkBuffer.data(), static_cast<PHYSFS_uint32>(bufferSize));
-		if (length_read != bufferSize)
-		{
-			if (length_read < 0 || !PHYSFS_eof(fileHandle))
-			{
-				// did not read expected amount, but did not reach end of file - some other error reading the file occurred
-				debug(LOG_ERROR, "Failed to read downloaded file: %s", WZ_PHYSFS_getLastError());
-				PHYSFS_close(fileHandle);
-				return false;
-			}
-		}
-		crypto_hash_sha256_update(&state, fileChunkBuffer.data(), static_cast<unsigned long long>(length_read));
-	} while (length_read == bufferSize);
-	crypto_hash_sha256_final(&state, actualFileHash.bytes);
-	fileChunkBuffer.clear();
-
+	// The hash was calculated as the file was received.
+	Sha256 actualFileHash = file.receivedHash.result();
 	if (actualFileHash != file.hash)
 	{
 		debug(LOG_ERROR, "Downloaded file hash (%s) does not match requested file hash (%s)", actualFileHash.toString().c_str(), file.hash.toString().c_str());
-		PHYSFS_close(fileHandle);
 		return false;
 	}
 
-	PHYSFS_close(fileHandle);
 	return true;
 }
 
@@ -2279,11 +2351,25 @@ int NETrecvFile(NETQUEUE queue)
 	}
 
 	// Write packet to the file.
-	WZ_PHYSFS_writeBytes(file->handle, buf, bytesToRead);
+	if (WZ_PHYSFS_writeBytes(file->handle, buf, bytesToRead) != static_cast<PHYSFS_sint64>(bytesToRead))
+	{
+		debug(LOG_ERROR, "Could not write downloaded file %s: %s", file->filename.c_str(), WZ_PHYSFS_getLastError());
+		std::string filename = file->filename;
+		terminateFileDownload(file); // 'file' is now an invalidated iterator.
+		PHYSFS_delete(filename.c_str());
+		return 100;
+	}
+	file->receivedHash.update(buf, bytesToRead);
 
 	uint32_t newPos = pos + bytesToRead;
 	file->pos = newPos;
 
+	// Let the host send more.
+	NETbeginEncode(NETnetQueue(NET_HOST_ONLY), NET_FILE_ACKNOWLEDGED);
+	NETbin(hash.bytes, hash.Bytes);
+	NETuint32_t(&newPos);
+	NETend();
+
 	if (newPos >= size)  // last packet
 	{
 		int noError = PHYSFS_close(file->handle);
@@ -2293,7 +2379,7 @@ int NETrecvFile(NETQUEUE queue)
 		}
 		file->handle = nullptr;
 
-		if(!validateReceivedFile(*file))
+		if (noError == 0 || !validateReceivedFile(*file))
 		{
 			// Delete the (invalid) downloaded file
 			PHYSFS_delete(file->filename.c_str());
@@ -2326,7 +2412,8 @@ unsigned NETgetDownloadProgress(unsigned player)
 	uint32_t progress = 100;
 	for (WZFile const &file : files)
 	{
-		progress = std::min<uint32_t>(progress, (uint32_t)((uint64_t)file.pos * 100 / (uint64_t)std::max<uint32_t>(file.size, 1)));
+		uint32_t done = player == selectedPlayer ? file.pos : file.acknowledged;
+		progress = std::min<uint32_t>(progress, (uint32_t)((uint64_t)done * 100 / (uint64_t)std::max<uint32_t>(file.size, 1)));
 	}
 	return static_cast<unsigned>(progress);
 }
@@ -3757,11 +3844,167 @@ bool NETcheckPlayerConnectionStatus(CONNECTION_STATUS status, unsigned player)
 	return realTime < NET_PlayerConnectionStatus[status][player];
 }
 
+#define MAX_LEN_LOG_LINE 512  // From debug.c - no use printing something longer.
+
 struct SyncDebugEntry
 {
 	char const *function;
 };
 
+/// A syncDebug() format string, split up so that the message can be recorded as raw arguments, and only printed if there is a desynch.
+struct SyncDebugFormat
+{
+	enum ArgType {Int, Unsigned, Long, UnsignedLong, LongLong, UnsignedLongLong, Size, String};
+
+	explicit SyncDebugFormat(char const *format)
+	{
+		formatCrc = htonl(crcSum(0, format, strlen(format) + 1));
+
+		char const *segmentBegin = format;
+		for (char const *p = format; *p != '\0'; ++p)
+		{
+			if (*p != '%')
+			{
+				continue;
+			}
+			++p;
+			if (*p == '%')
+			{
+				continue;  // Literal '%', stays part of the segment.
+			}
+			p += strspn(p, "-+ #0123456789.");
+			unsigned longs = 0;
+			bool isSize = false;
+			if (*p == 'h')
+			{
+				p += p[1] == 'h' ? 2 : 1;  // Promoted to int, anyway.
+			}
+			else if (*p == 'l')
+			{
+				longs = p[1] == 'l' ? 2 : 1;
+				p += longs;
+			}
+			else if (*p == 'z')
+			{
+				isSize = true;
+				++p;
+			}
+			ArgType type;
+			switch (*p)
+			{
+			case 'd':
+			case 'i':
+				type = isSize ? Size : longs == 2 ? LongLong : longs == 1 ? Long : Int;
+				break;
+			case 'o':
+			case 'u':
+			case 'x':
+			case 'X':
+				type = isSize ? Size : longs == 2 ? UnsignedLongLong : longs == 1 ? UnsignedLong : Unsigned;
+				break;
+			case 'c':
+			case 's':
+				if (longs != 0 || isSize)
+				{
+					return;  // Wide characters, not supported.
+				}
+				type = *p == 'c' ? Int : String;
+				break;
+			default:
+				return;  // Floating point, '*' width, %p or something else which isn't supported, has to be printed straight away.
+			}
+			segments.push_back(std::string(segmentBegin, p + 1));
+			args.push_back(type);
+			segmentBegin = p + 1;
+		}
+		for (char const *p = segmentBegin; *p != '\0'; ++p)
+		{
+			trailingText.push_back(*p);
+			p += p[0] == '%' && p[1] == '%';
+		}
+		isSupported = true;
+	}
+
+	bool isSupported = false;       ///< False if the arguments can't be recorded, so the message must be printed with vssprintf.
+	uint32_t formatCrc;             ///< CRC of the format string, in network byte order.
+	std::vector<std::string> segments;  ///< Format string of each argument, along with any text before it.
+	std::vector<ArgType> args;      ///< Type of each argument.
+	std::string trailingText;       ///< Text after the last argument, with "%%" unescaped.
+};
+
+struct SyncDebugFormatted : public SyncDebugEntry
+{
+	/// Reads the arguments of the format from ap, storing them in words and chars.
+	void set(uint32_t &crc, char const *f, SyncDebugFormat const *fmt, va_list ap, std::vector<int64_t> &words, std::vector<char> &chars)
+	{
+		function = f;
+		format = fmt;
+		crc = crcSum(crc, function, strlen(function) + 1);
+		crc = crcSum(crc, &format->formatCrc, 4);
+		for (SyncDebugFormat::ArgType type : format->args)
+		{
+			int64_t word;
+			switch (type)
+			{
+			case SyncDebugFormat::Int:              word = va_arg(ap, int);                break;
+			case SyncDebugFormat::Unsigned:         word = va_arg(ap, unsigned);           break;
+			case SyncDebugFormat::Long:             word = va_arg(ap, long);               break;
+			case SyncDebugFormat::UnsignedLong:     word = va_arg(ap, unsigned long);      break;
+			case SyncDebugFormat::LongLong:         word = va_arg(ap, long long);          break;
+			case SyncDebugFormat::UnsignedLongLong: word = va_arg(ap, unsigned long long); break;
+			case SyncDebugFormat::Size:             word = va_arg(ap, size_t);             break;
+			case SyncDebugFormat::String:
+				{
+					char const *string = va_arg(ap, char const *);
+					string = string != nullptr ? string : "(null)";
+					size_t length = strlen(string) + 1;
+					crc = crcSum(crc, string, length);
+					word = chars.size();
+					chars.insert(chars.end(), string, string + length);
+					words.push_back(word);
+					continue;
+				}
+			}
+			uint32_t valueBytes[2] = {htonl(uint32_t(uint64_t(word) >> 32)), htonl(uint32_t(word))};
+			crc = crcSum(crc, valueBytes, 8);
+			words.push_back(word);
+		}
+	}
+	int snprint(char *buf, size_t bufSize, int64_t const *&words, char const *chars) const
+	{
+		int64_t const *argWords = words;
+		words += format->args.size();
+
+		// Print the message the same way as vssprintf would have, when recording it.
+		char line[MAX_LEN_LOG_LINE];
+		size_t index = 0;
+		for (size_t n = 0; n < format->args.size() && index + 1 < sizeof(line); ++n)
+		{
+			char *out = line + index;
+			size_t outSize = sizeof(line) - index;
+			char const *segment = format->segments[n].c_str();
+			int64_t word = argWords[n];
+			int ret = 0;
+			switch (format->args[n])
+			{
+			case SyncDebugFormat::Int:              ret = snprintf(out, outSize, segment, (int)word);                break;
+			case SyncDebugFormat::Unsigned:         ret = snprintf(out, outSize, segment, (unsigned)word);           break;
+			case SyncDebugFormat::Long:             ret = snprintf(out, outSize, segment, (long)word);               break;
+			case SyncDebugFormat::UnsignedLong:     ret = snprintf(out, outSize, segment, (unsigned long)word);      break;
+			case SyncDebugFormat::LongLong:         ret = snprintf(out, outSize, segment, (long long)word);          break;
+			case SyncDebugFormat::UnsignedLongLong: ret = snprintf(out, outSize, segment, (unsigned long long)word); break;
+			case SyncDebugFormat::Size:             ret = snprintf(out, outSize, segment, (size_t)word);             break;
+			case SyncDebugFormat::String:           ret = snprintf(out, outSize, segment, chars + word);             break;
+			}
+			index = std::min(index + std::max(ret, 0), sizeof(line) - 1);
+		}
+		snprintf(line + index, sizeof(line) - index, "%s", format->trailingText.c_str());
+		return snprintf(buf, bufSize, "[%s] %s\n", function, line);
+	}
+
+	SyncDebugFormat const *format;
+};
+
 struct SyncDebugString : public SyncDebugEntry
 {
 	void set(uint32_t &crc, char const *f, char const *string)
@@ -3898,8 +4141,11 @@ struct SyncDebugLog
 		strings.clear();
 		valueChanges.clear();
 		intLists.clear();
+		formatteds.clear();
 		chars.clear();
 		ints.clear();
+		words.clear();
+		argChars.clear();
 	}
 	void string(char const *f, char const *s)
 	{
@@ -3913,6 +4159,12 @@ struct SyncDebugLog
 
 		log.push_back('s');
 	}
+	void formatted(char const *f, SyncDebugFormat const *format, va_list ap)
+	{
+		formatteds.resize(formatteds.size() + 1);
+		formatteds.back().set(crc, f, format, ap, words, argChars);
+		log.push_back('f');
+	}
 	void valueChange(char const *f, char const *vn, int nv, int i)
 	{
 		valueChanges.resize(valueChanges.size() + 1);
@@ -3935,8 +4187,10 @@ struct SyncDebugLog
 		SyncDebugString const *stringPtr = strings.empty() ? nullptr : &strings[0]; // .empty() check, since &strings[0] is undefined if strings is empty(), even if it's likely to work, anyway.
 		SyncDebugValueChange const *valueChangePtr = valueChanges.empty() ? nullptr : &valueChanges[0];
 		SyncDebugIntList const *intListPtr = intLists.empty() ? nullptr : &intLists[0];
+		SyncDebugFormatted const *formattedPtr = formatteds.empty() ? nullptr : &formatteds[0];
 		char const *charPtr = chars.empty() ? nullptr : &chars[0];
 		int const *intPtr = ints.empty() ? nullptr : &ints[0];
+		int64_t const *wordPtr = words.empty() ? nullptr : &words[0];
 
 		int index = 0;
 		for (size_t n = 0; n < log.size() && (size_t)index < bufSize; ++n)
@@ -3953,6 +4207,9 @@ struct SyncDebugLog
 			case 'i':
 				index += intListPtr++->snprint(buf + index, bufSize - index, intPtr);
 				break;
+			case 'f':
+				index += formattedPtr++->snprint(buf + index, bufSize - index, wordPtr, argChars.empty() ? nullptr : &argChars[0]);
+				break;
 			default:
 				abort();
 				break;
@@ -3989,16 +4246,18 @@ private:
 	std::vector<SyncDebugString> strings;
 	std::vector<SyncDebugValueChange> valueChanges;
 	std::vector<SyncDebugIntList> intLists;
+	std::vector<SyncDebugFormatted> formatteds;
 
 	std::vector<char> chars;
 	std::vector<int> ints;
+	std::vector<int64_t> words;  ///< Arguments of formatteds. String arguments are stored in argChars, and the word is the offset.
+	std::vector<char> argChars;
 
 private:
 	SyncDebugLog(SyncDebugLog const &)/* = delete*/;
 	SyncDebugLog &operator =(SyncDebugLog const &)/* = delete*/;
 };
 
-#define MAX_LEN_LOG_LINE 512  // From debug.c - no use printing something longer.
 #define MAX_SYNC_HISTORY 12
 
 static unsigned syncDebugNext = 0;
@@ -4007,6 +4266,7 @@ static uint32_t syncDebugExtraGameTime;
 static uint32_t syncDebugExtraCrc;
 
 static uint32_t syncDebugNumDumps = 0;
+static std::unordered_map<char const *, SyncDebugFormat> syncDebugFormats;  ///< Parsed format strings, by address. The format strings are string literals.
 
 void _syncDebug(const char *function, const char *str, ...)
 {
@@ -4017,14 +4277,26 @@ void _syncDebug(const char *function, const char *str, ...)
 		}
 #endif
 
-	va_list ap;
-	char outputBuffer[MAX_LEN_LOG_LINE];
+	auto format = syncDebugFormats.find(str);
+	if (format == syncDebugFormats.end())
+	{
+		format = syncDebugFormats.emplace(str, SyncDebugFormat(str)).first;
+	}
 
+	va_list ap;
 	va_start(ap, str);
-	vssprintf(outputBuffer, str, ap);
+	if (format->second.isSupported)
+	{
+		// Just record the arguments, they only need to be printed if there is a desynch.
+		syncDebugLog[syncDebugNext].formatted(function, &format->second, ap);
+	}
+	else
+	{
+		char outputBuffer[MAX_LEN_LOG_LINE];
+		vssprintf(outputBuffer, str, ap);
+		syncDebugLog[syncDebugNext].string(function, outputBuffer);
+	}
 	va_end(ap);
-
-	syncDebugLog[syncDebugNext].string(function, outputBuffer);
 }
 
 void _syncDebugIntList(const char *function, const char *str, int *ints, size_t numInts)
@@ -4254,6 +4526,7 @@ const char *messageTypeToString(unsigned messageType_)
 	case NET_DEBUG_SYNC:                return "NET_DEBUG_SYNC";
 	case NET_VOTE:                      return "NET_VOTE";
 	case NET_VOTE_REQUEST:              return "NET_VOTE_REQUEST";
+	case NET_FILE_ACKNOWLEDGED:         return "NET_FILE_ACKNOWLEDGED";
 	case NET_MAX_TYPE:                  return "NET_MAX_TYPE";
 
 	// Game-state-related messages, must be processed by all clients at the same game time.
@@ -93,6 +93,7 @@ enum MESSAGE_TYPES
 	NET_DEBUG_SYNC,                 ///< Synch error messages, so people don't have to use pastebin.
 	NET_VOTE,                       ///< player vote
 	NET_VOTE_REQUEST,               ///< Setup a vote popup
+	NET_FILE_ACKNOWLEDGED,          ///< Player has received and written part of a file
 	NET_MAX_TYPE,                   ///< Maximum+1 valid NET_ type, *MUST* be last.
 
 	// Game-state-related messages, must be processed by all clients at the same game time.
@@ -207,14 +208,19 @@ struct SYNC_COUNTER
 
 struct WZFile
 {
-	//WZFile() : handle(nullptr), size(0), pos(0) { hash.setZero(); }
-	WZFile(PHYSFS_file *handle, const std::string &filename, Sha256 hash, uint32_t size = 0) : handle(handle), filename(filename), hash(hash), size(size), pos(0) {}
+	/// A file being received, and written to handle.
+	WZFile(PHYSFS_file *handle, const std::string &filename, Sha256 hash, uint32_t size = 0) : handle(handle), filename(filename), hash(hash), size(size), pos(0), acknowledged(0) {}
+	/// A file being sent, see NETloadFileToSend.
+	WZFile(std::shared_ptr<std::vector<uint8_t> const> const &data, const std::string &filename, Sha256 hash) : handle(nullptr), data(data), filename(filename), hash(hash), size(static_cast<uint32_t>(data->size())), pos(0), acknowledged(0) {}
 
-	PHYSFS_file *handle;
+	PHYSFS_file *handle;  // When receiving, the file being written, nullptr when done.
+	std::shared_ptr<std::vector<uint8_t> const> data;  // When sending, the contents of the file, nullptr when all of it has been sent.
 	std::string filename;
 	Sha256 hash;
 	uint32_t size;
 	uint32_t pos;  // Current position, the range [0; currPos[ has been sent or received already.
+	uint32_t acknowledged;  // When sending, the range [0; acknowledged[ has been written to disk by the receiver.
+	Sha256Hasher receivedHash;  // When receiving, the hash of the range [0; pos[, so the file doesn't have to be read again to check it.
 };
 
 enum class AIDifficulty : int8_t
@@ -319,8 +325,12 @@ WZ_DECL_NONNULL(1, 2) bool NETrecvNet(NETQUEUE *queue, uint8_t *type);        //
 WZ_DECL_NONNULL(1, 2) bool NETrecvGame(NETQUEUE *queue, uint8_t *type);       ///< recv a message from the game queues which is sceduled to execute by time, if possible.
 void NETflush();                                                              ///< Flushes any data stuck in compression buffers.
 
-int NETsendFile(WZFile &file, unsigned player);  ///< Send file chunk. Returns 100 when done.
+std::shared_ptr<std::vector<uint8_t> const> NETloadFileToSend(std::string const &filename, Sha256 const &hash, bool *openFailed = nullptr);  ///< Reads a file to send, or shares the data if it is already being sent to someone. Returns nullptr on failure, and sets *openFailed if the file could not be opened at all.
+void NETsetFileTransferWindow(uint32_t bytes);   ///< Sets how many bytes of a file may be sent before the receiver has acknowledged them.
+uint32_t NETgetFileTransferWindow();
+bool NETsendFile(WZFile &file, unsigned player); ///< Send file chunk. Returns false if all of the file or the whole window has been sent.
 int NETrecvFile(NETQUEUE queue);                 ///< Receive file chunk. Returns 100 when done.
+void NETrecvFileAcknowledged(NETQUEUE queue);    ///< Host only, the receiver has written a file chunk.
 unsigned NETgetDownloadProgress(unsigned player);     ///< Returns 100 when done.
 
 int NETclose();					// close current game
@@ -330,7 +340,7 @@ void NETaddRedirects();
 void NETremRedirects();
 void NETdiscoverUPnPDevices();
 
-enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets};
+enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets, NetStatisticBroadcasts, NetStatisticBroadcastBytes, NetStatisticBroadcastMicroseconds};
 size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal = false);     // Return some statistic. Call regularly for good results.
 
 void NETplayerKicked(UDWORD index);			// Cleanup after player has been kicked
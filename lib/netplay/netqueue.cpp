@@ -118,6 +118,23 @@ uint8_t *NetMessage::rawDataDup() const
 	return ret;
 }
 
+void NetMessage::rawDataAppendToVector(std::vector<uint8_t> &output) const
+{
+	unsigned encodedLengthOfSize = encodedlength_uint32_t(data.size());
+
+	output.push_back(type);
+
+	uint32_t len = data.size();
+	for (unsigned n = 0; n < encodedLengthOfSize; ++n)
+	{
+		uint8_t b;
+		encode_uint32_t(b, len, n);
+		output.push_back(b);
+	}
+
+	output.insert(output.end(), data.begin(), data.end());
+}
+
 size_t NetMessage::rawLen() const
 {
 	return 1 + static_cast<size_t>(encodedlength_uint32_t(data.size())) + data.size();
@@ -126,46 +143,89 @@ size_t NetMessage::rawLen() const
 NetQueue::NetQueue()
 	: canGetMessagesForNet(true)
 	, canGetMessages(true)
+	, oldestPos(0)
+	, dataPos(0)
+	, messagePos(0)
+	, endPos(0)
+{}
+
+NetMessage &NetQueue::messageAt(uint32_t pos) const
 {
-	dataPos = messages.end();
-	messagePos = messages.end();
+	return *messages[pos & (messages.size() - 1)];
+}
+
+NetMessage &NetQueue::newMessage()
+{
+	if (endPos - oldestPos == messages.size())
+	{
+		// Full, double the size of the ring. Only the pointers are moved, so references to messages stay valid.
+		std::vector<std::unique_ptr<NetMessage>> newMessages(std::max<size_t>(messages.size() * 2, 16));
+		for (uint32_t pos = oldestPos; pos != oldestPos + static_cast<uint32_t>(messages.size()); ++pos)
+		{
+			newMessages[pos & (newMessages.size() - 1)] = std::move(messages[pos & (messages.size() - 1)]);
+		}
+		messages.swap(newMessages);
+	}
+
+	std::unique_ptr<NetMessage> &slot = messages[endPos & (messages.size() - 1)];
+	if (!slot)
+	{
+		slot.reset(new NetMessage);
+	}
+	slot->receivedTime = 0;
+	++endPos;
+	return *slot;
 }
 
 void NetQueue::writeRawData(const uint8_t *netData, size_t netLen)
 {
-	size_t used = 0;
 	std::vector<uint8_t> &buffer = incompleteReceivedMessageData;  // Short alias.
 
-	// Insert the data.
-	buffer.insert(buffer.end(), netData, netData + netLen);
+	// Only copy the data if there is an incomplete message from before, which it needs to be appended to.
+	bool haveIncomplete = !buffer.empty();
+	if (haveIncomplete)
+	{
+		buffer.insert(buffer.end(), netData, netData + netLen);
+		netData = &buffer[0];
+		netLen = buffer.size();
+	}
 
 	// Extract the messages.
-	while (buffer.size() - used > 1)
+	size_t used = 0;
+	while (netLen - used > 1)
 	{
-		uint8_t type = buffer[used];
+		uint8_t type = netData[used];
 
 		uint32_t len = 0;
 		bool moreBytes = true;
 		unsigned n;
-		for (n = 0; moreBytes && buffer.size() - used > 1 + n; ++n)
+		for (n = 0; moreBytes && netLen - used > 1 + n; ++n)
 		{
-			moreBytes = decode_uint32_t(buffer[used + 1 + n], len, n);
+			moreBytes = decode_uint32_t(netData[used + 1 + n], len, n);
 		}
 		unsigned headerLen = 1 + n;
 
 		ASSERT(len < 40000000, "Trying to write a very large packet (%u bytes) to the queue.", len);
-		if (buffer.size() - used - headerLen < len)
+		if (netLen - used - headerLen < len)
 		{
 			break;  // Don't have a whole message ready yet.
 		}
 
-		messages.push_front(NetMessage(type));
-		messages.front().data.assign(buffer.begin() + used + headerLen, buffer.begin() + used + headerLen + len);
+		NetMessage &message = newMessage();
+		message.type = type;
+		message.data.assign(netData + used + headerLen, netData + used + headerLen + len);
 		used += headerLen + len;
 	}
 
-	// Recycle old data.
-	buffer.erase(buffer.begin(), buffer.begin() + used);
+	// Keep the rest, until the rest of the message arrives.
+	if (haveIncomplete)
+	{
+		buffer.erase(buffer.begin(), buffer.begin() + used);
+	}
+	else
+	{
+		buffer.assign(netData + used, netData + netLen);
+	}
 }
 
 void NetQueue::setWillNeverGetMessagesForNet()
@@ -175,44 +235,36 @@ void NetQueue::setWillNeverGetMessagesForNet()
 
 unsigned NetQueue::numMessagesForNet() const
 {
-	unsigned count = 0;
-	if (canGetMessagesForNet)
-	{
-		for (List::iterator i = dataPos; i != messages.begin(); --i)
-		{
-			++count;
-		}
-	}
-
-	return count;
+	return canGetMessagesForNet ? endPos - dataPos : 0;
 }
 
 const NetMessage &NetQueue::getMessageForNet() const
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for getMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to get!");
+	ASSERT(dataPos != endPos, "No message to get!");
 
 	// Return the message.
-	List::iterator i = dataPos;
-	--i;
-	return *i;
+	return messageAt(dataPos);
 }
 
 void NetQueue::popMessageForNet()
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for popMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to pop!");
+	ASSERT(dataPos != endPos, "No message to pop!");
 
 	// Pop the message.
-	--dataPos;
+	++dataPos;
 
 	// Recycle old data.
 	popOldMessages();
 }
 
-void NetQueue::pushMessage(const NetMessage &message)
+void NetQueue::pushMessage(const NetMessage &message, uint32_t receivedTime)
 {
-	messages.push_front(message);
+	NetMessage &copy = newMessage();
+	copy.type = message.type;
+	copy.data.assign(message.data.begin(), message.data.end());
+	copy.receivedTime = receivedTime;
 }
 
 void NetQueue::setWillNeverGetMessages()
@@ -223,57 +275,54 @@ void NetQueue::setWillNeverGetMessages()
 bool NetQueue::haveMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for haveMessage.");
-	return messagePos != messages.begin();
+	return messagePos != endPos;
 }
 
 const NetMessage &NetQueue::getMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for getMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to get!");
+	ASSERT(messagePos != endPos, "No message to get!");
 
 	// Return the message.
-	List::iterator i = messagePos;
-	--i;
-	return *i;
+	return messageAt(messagePos);
 }
 
 void NetQueue::popMessage()
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for popMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to pop!");
+	ASSERT(messagePos != endPos, "No message to pop!");
 
 	// Pop the message.
-	--messagePos;
+	++messagePos;
 
 	// Recycle old data.
 	popOldMessages();
 }
 
+unsigned NetQueue::numMessages() const
+{
+	return canGetMessages ? endPos - messagePos : 0;
+}
+
 void NetQueue::popOldMessages()
 {
 	if (!canGetMessagesForNet)
 	{
-		dataPos = messages.begin();
+		dataPos = endPos;
 	}
 	if (!canGetMessages)
 	{
-		messagePos = messages.begin();
-	}
-
-	List::iterator i = messages.end();
-	while (i != dataPos && i != messagePos)
-	{
-		--i;
+		messagePos = endPos;
 	}
 
-	if (i == dataPos)
-	{
-		dataPos = messages.end();  // Old iterator will become invalid.
-	}
-	if (i == messagePos)
+	uint32_t newOldestPos = dataPos - oldestPos < messagePos - oldestPos ? dataPos : messagePos;
+	for (; oldestPos != newOldestPos; ++oldestPos)
 	{
-		messagePos = messages.end();  // Old iterator will become invalid.
+		// Keep the slot for reuse, but don't hang on to unusually large buffers.
+		std::vector<uint8_t> &data = messageAt(oldestPos).data;
+		if (data.capacity() > 65536)
+		{
+			std::vector<uint8_t>().swap(data);
+		}
 	}
-
-	messages.erase(i, messages.end());
 }
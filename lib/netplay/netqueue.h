@@ -28,6 +28,7 @@
 #include <vector>
 #include <list>
 #include <deque>
+#include <memory>
 
 // At game level:
 // There should be a NetQueue representing each client.
@@ -46,9 +47,11 @@ class NetMessage
 public:
 	NetMessage(uint8_t type_ = 0xFF) : type(type_) {}
 	uint8_t *rawDataDup() const;  ///< Returns data compatible with NetQueue::writeRawData(). Must be delete[]d.
+	void rawDataAppendToVector(std::vector<uint8_t> &output) const;  ///< Appends the same data as rawDataDup() returns to output.
 	size_t rawLen() const;        ///< Returns the length of the return value of rawDataDup().
 	uint8_t type;
 	std::vector<uint8_t> data;
+	uint32_t receivedTime = 0;    ///< wzGetTicks() when the message arrived from the network, if network statistics are enabled, otherwise 0. Not sent.
 };
 
 /// MessageWriter is used for serialising, using the same interface as MessageReader.
@@ -63,6 +66,11 @@ public:
 	{
 		message->data.push_back(v);
 	}
+	/// Same as calling byte() for each of the n bytes.
+	void bytes(uint8_t const *v, size_t n) const
+	{
+		message->data.insert(message->data.end(), v, v + n);
+	}
 	bool valid() const
 	{
 		return true;
@@ -82,6 +90,22 @@ public:
 		v = index >= message->data.size() ? 0x00 : message->data[index];
 		++index;
 	}
+	/// Same as calling byte() for each of the n bytes.
+	void bytes(uint8_t *v, size_t n) const
+	{
+		size_t available = std::min(n, bytesLeft());
+		if (available != 0)
+		{
+			memcpy(v, &message->data[index], available);
+		}
+		std::fill(v + available, v + n, 0x00);
+		index += n;
+	}
+	/// Number of bytes left to read. If reading has already gone past the end of the message, returns 0.
+	size_t bytesLeft() const
+	{
+		return index >= message->data.size() ? 0 : message->data.size() - index;
+	}
 	bool valid() const
 	{
 		return index <= message->data.size();
@@ -106,14 +130,17 @@ public:
 
 	// All game clients should check game messages from all queues, including their own, and only the net messages sent to them.
 	// Message related, storing.
-	void pushMessage(const NetMessage &message);                       ///< Adds a message to the queue.
+	void pushMessage(const NetMessage &message, uint32_t receivedTime = 0);  ///< Adds a message to the queue.
 	// Message related, extracting.
 	void setWillNeverGetMessages();                                    ///< Marks that we will not be reading any of the messages (only sending over the network).
 	bool haveMessage() const;                                          ///< Return true if we have a message ready to return.
 	const NetMessage &getMessage() const;                              ///< Returns a message.
 	void popMessage();                                                 ///< Pops the last returned message.
+	unsigned numMessages() const;                                      ///< Returns the number of messages not yet returned by getMessage.
 
 private:
+	NetMessage &newMessage();                                          ///< Adds an empty message to the queue, reusing the slot of an old message if possible.
+	NetMessage &messageAt(uint32_t pos) const;                         ///< Returns the message with the given position, which must be between oldestPos and endPos.
 	void popOldMessages();                                             ///< Pops any messages that are no longer needed.
 
 	// Disable copy constructor and assignment operator.
@@ -123,10 +150,12 @@ private:
 	bool canGetMessagesForNet;                                         ///< True if we will send the messages over the network, false if we don't.
 	bool canGetMessages;                                               ///< True if we will get the messages, false if we don't use them ourselves.
 
-	typedef std::list<NetMessage> List;
-	List::iterator                dataPos;                             ///< Last message which was sent over the network.
-	List::iterator                messagePos;                          ///< Last message which was popped.
-	List                          messages;                            ///< List of messages. Messages are added to the front and read from the back.
+	// Messages are numbered in the order they are added, wrapping around at 2³². Each message is stored in slot (position & (messages.size() - 1)).
+	uint32_t                      oldestPos;                           ///< Oldest message which is still needed.
+	uint32_t                      dataPos;                             ///< Next message to send over the network.
+	uint32_t                      messagePos;                          ///< Next message to return from getMessage.
+	uint32_t                      endPos;                              ///< Position the next added message will get.
+	std::vector<std::unique_ptr<NetMessage>> messages;                 ///< Ring buffer of messages, size is a power of 2. The slots of popped messages are reused, so that their data buffers don't have to be reallocated.
 	std::vector<uint8_t>          incompleteReceivedMessageData;       ///< Data from network which has not yet formed an entire message.
 };
 
@@ -0,0 +1,261 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netreplay.cpp
+ * Replay recording and playback, see netreplay.h.
+ */
+
+#include "lib/framework/frame.h"
+
+#include <physfs.h>
+#include "lib/framework/physfs_ext.h"
+
+#include "netplay.h"
+#include "netreplay.h"
+#include "nettypes.h"
+
+#include <limits>
+#include <vector>
+
+#define REPLAY_MAGIC       "WZrp"
+#define REPLAY_VERSION     1
+#define REPLAY_END_MARKER  0xFF
+#define REPLAY_BUFFER_SIZE (64 * 1024)  ///< Bytes to collect before writing them to the file.
+
+static PHYSFS_file *replaySaveHandle = nullptr;
+static std::vector<uint8_t> replaySaveBuffer;       ///< Recorded data not yet written to replaySaveHandle.
+
+static bool replayLoading = false;
+static std::vector<uint8_t> replayLoadData;         ///< The whole replay file.
+static size_t replayLoadPos = 0;                    ///< Start of the next message in replayLoadData.
+static bool replayLoadEnded = false;
+
+static void appendUint32(std::vector<uint8_t> &buffer, uint32_t v)
+{
+	uint8_t bytes[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)};
+	buffer.insert(buffer.end(), bytes, bytes + 4);
+}
+
+static bool readUint32(uint32_t &v)
+{
+	if (replayLoadData.size() - replayLoadPos < 4)
+	{
+		return false;
+	}
+	uint8_t const *bytes = &replayLoadData[replayLoadPos];
+	v = uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]);
+	replayLoadPos += 4;
+	return true;
+}
+
+static bool replayFlushSaveBuffer()
+{
+	if (replaySaveBuffer.empty())
+	{
+		return true;
+	}
+	PHYSFS_sint64 written = WZ_PHYSFS_writeBytes(replaySaveHandle, replaySaveBuffer.data(), static_cast<PHYSFS_uint32>(replaySaveBuffer.size()));
+	bool ok = written == static_cast<PHYSFS_sint64>(replaySaveBuffer.size());
+	replaySaveBuffer.clear();
+	return ok;
+}
+
+bool NETreplaySaveStart(std::string const &filename, std::string const &settings)
+{
+	if (replaySaveHandle != nullptr)
+	{
+		NETreplaySaveStop();
+	}
+
+	replaySaveHandle = PHYSFS_openWrite(filename.c_str());
+	if (replaySaveHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not create replay %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+
+	replaySaveBuffer.clear();
+	replaySaveBuffer.reserve(REPLAY_BUFFER_SIZE);
+	replaySaveBuffer.insert(replaySaveBuffer.end(), REPLAY_MAGIC, REPLAY_MAGIC + 4);
+	appendUint32(replaySaveBuffer, REPLAY_VERSION);
+	appendUint32(replaySaveBuffer, static_cast<uint32_t>(settings.size()));
+	replaySaveBuffer.insert(replaySaveBuffer.end(), settings.begin(), settings.end());
+	if (!replayFlushSaveBuffer())
+	{
+		debug(LOG_ERROR, "Could not write replay %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		PHYSFS_close(replaySaveHandle);
+		replaySaveHandle = nullptr;
+		return false;
+	}
+
+	debug(LOG_INFO, "Recording replay to %s", filename.c_str());
+	return true;
+}
+
+bool NETreplaySaveStop()
+{
+	if (replaySaveHandle == nullptr)
+	{
+		return false;
+	}
+
+	replaySaveBuffer.push_back(REPLAY_END_MARKER);
+	bool ok = replayFlushSaveBuffer();
+	if (!PHYSFS_close(replaySaveHandle) || !ok)
+	{
+		debug(LOG_ERROR, "Could not write replay: %s", WZ_PHYSFS_getLastError());
+		ok = false;
+	}
+	replaySaveHandle = nullptr;
+	replaySaveBuffer = std::vector<uint8_t>();
+	return ok;
+}
+
+void NETreplaySaveNetMessage(NetMessage const &message, uint8_t player)
+{
+	if (replaySaveHandle == nullptr)
+	{
+		return;
+	}
+
+	replaySaveBuffer.push_back(player);
+	message.rawDataAppendToVector(replaySaveBuffer);
+	if (replaySaveBuffer.size() >= REPLAY_BUFFER_SIZE && !replayFlushSaveBuffer())
+	{
+		debug(LOG_ERROR, "Could not write replay, stopping recording: %s", WZ_PHYSFS_getLastError());
+		PHYSFS_close(replaySaveHandle);
+		replaySaveHandle = nullptr;
+	}
+}
+
+bool NETreplayLoadStart(std::string const &filename, std::string &settings)
+{
+	NETreplayLoadStop();
+
+	PHYSFS_file *fileHandle = PHYSFS_openRead(filename.c_str());
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not open replay %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+	PHYSFS_sint64 fileSize = PHYSFS_fileLength(fileHandle);
+	if (fileSize < 0 || static_cast<uint64_t>(fileSize) > std::numeric_limits<PHYSFS_uint32>::max())
+	{
+		debug(LOG_ERROR, "Bad replay file size for %s", filename.c_str());
+		PHYSFS_close(fileHandle);
+		return false;
+	}
+	replayLoadData.resize(static_cast<size_t>(fileSize));
+	bool readOk = fileSize == 0 || WZ_PHYSFS_readBytes(fileHandle, replayLoadData.data(), static_cast<PHYSFS_uint32>(fileSize)) == fileSize;
+	PHYSFS_close(fileHandle);
+
+	uint32_t version = 0;
+	uint32_t settingsLength = 0;
+	replayLoadPos = 4;
+	if (!readOk || replayLoadData.size() < 4 || memcmp(replayLoadData.data(), REPLAY_MAGIC, 4) != 0 || !readUint32(version) || !readUint32(settingsLength)
+	    || replayLoadData.size() - replayLoadPos < settingsLength)
+	{
+		debug(LOG_ERROR, "%s is not a valid replay", filename.c_str());
+		replayLoadData = std::vector<uint8_t>();
+		return false;
+	}
+	if (version != REPLAY_VERSION)
+	{
+		debug(LOG_ERROR, "Replay %s has version %u, only version %u is supported", filename.c_str(), version, REPLAY_VERSION);
+		replayLoadData = std::vector<uint8_t>();
+		return false;
+	}
+	settings.assign(replayLoadData.begin() + replayLoadPos, replayLoadData.begin() + replayLoadPos + settingsLength);
+	replayLoadPos += settingsLength;
+
+	replayLoading = true;
+	replayLoadEnded = false;
+	debug(LOG_INFO, "Playing back replay %s", filename.c_str());
+	return true;
+}
+
+bool NETreplayLoadNetMessage()
+{
+	if (!replayLoading || replayLoadEnded)
+	{
+		return false;
+	}
+
+	size_t left = replayLoadData.size() - replayLoadPos;
+	uint8_t const *data = replayLoadData.data() + replayLoadPos;
+	if (left < 1)
+	{
+		debug(LOG_WARNING, "Replay has no end marker, the recording was cut short");
+		replayLoadEnded = true;
+		return false;
+	}
+	if (data[0] == REPLAY_END_MARKER)
+	{
+		debug(LOG_INFO, "End of replay");
+		replayLoadEnded = true;
+		return false;
+	}
+
+	// Decode the header of the message, player, type and length.
+	uint8_t player = data[0];
+	uint32_t len = 0;
+	bool moreBytes = true;
+	size_t n;
+	for (n = 0; moreBytes && 2 + n < left; ++n)
+	{
+		moreBytes = decode_uint32_t(data[2 + n], len, n);
+	}
+	size_t headerLen = 2 + n;
+	if (left < 2 || moreBytes || left - headerLen < len || player >= MAX_PLAYERS)
+	{
+		debug(LOG_ERROR, "Replay is corrupt at offset %zu", replayLoadPos);
+		replayLoadEnded = true;
+		return false;
+	}
+
+	NetMessage message(data[1]);
+	message.data.assign(data + headerLen, data + headerLen + len);
+	NETinsertMessageFromNet(NETgameQueue(player), &message);
+	replayLoadPos += headerLen + len;
+	return true;
+}
+
+bool NETreplayLoadStop()
+{
+	if (!replayLoading)
+	{
+		return false;
+	}
+
+	replayLoading = false;
+	replayLoadEnded = false;
+	replayLoadData = std::vector<uint8_t>();
+	replayLoadPos = 0;
+	return true;
+}
+
+bool NETisReplay()
+{
+	return replayLoading;
+}
+
+bool NETreplayLoadFinished()
+{
+	return replayLoading && replayLoadEnded;
+}
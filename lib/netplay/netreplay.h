@@ -0,0 +1,61 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Replays of multiplayer and skirmish games.
+ *
+ *  A replay is the game settings, followed by every game message in the order the game processed it, tagged
+ *  with the game queue it came from. Since the game state only changes through game messages and the
+ *  synchronised random numbers, feeding the messages back into the game queues after starting from the same
+ *  settings replays the game. The GAME_GAME_TIME messages are recorded too, so the sync CRCs they carry are
+ *  checked during playback exactly as when playing online.
+ *
+ *  File format, all integers big endian:
+ *   - "WZrp", uint32 version, uint32 length of the settings, settings (JSON text, written and read by the game).
+ *   - For each message, uint8 player, then the message as sent over the network (see NetMessage::rawDataDup).
+ *   - uint8 0xFF, marking the end of the replay.
+ */
+
+#ifndef __INCLUDED_LIB_NETPLAY_NETREPLAY_H__
+#define __INCLUDED_LIB_NETPLAY_NETREPLAY_H__
+
+#include "lib/framework/frame.h"
+#include "netqueue.h"
+
+#include <string>
+
+/// Starts writing a replay to filename, with the given settings. Returns false if the file couldn't be created.
+bool NETreplaySaveStart(std::string const &filename, std::string const &settings);
+/// Finishes writing the replay, if one is being written.
+bool NETreplaySaveStop();
+/// Adds a game message from the queue of the given player, call when the message has been processed.
+void NETreplaySaveNetMessage(NetMessage const &message, uint8_t player);
+
+/// Starts playing back the replay in filename, returning its settings. Returns false if the file isn't a valid replay.
+bool NETreplayLoadStart(std::string const &filename, std::string &settings);
+/// Reads the next message of the replay into the game queue of its player. Returns false at the end of the replay.
+bool NETreplayLoadNetMessage();
+/// Stops playing back the replay.
+bool NETreplayLoadStop();
+
+/// Returns true while playing back a replay. The game messages then come from the replay, not from the players.
+bool NETisReplay();
+/// Returns true if the whole replay has been read.
+bool NETreplayLoadFinished();
+
+#endif // __INCLUDED_LIB_NETPLAY_NETREPLAY_H__
@@ -31,6 +31,11 @@
 #include <algorithm>
 #include <map>
 
+#if defined(WZ_OS_LINUX)
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
+
 #if !defined(ZLIB_CONST)
 #  define ZLIB_CONST
 #endif
@@ -52,7 +57,7 @@ struct Socket
 	 *
 	 * All non-listening sockets will only use the first socket handle.
 	 */
-	Socket() : ready(false), writeError(false), deleteLater(false), isCompressed(false), readDisconnected(false), zDeflateInSize(0)
+	Socket() : ready(false), writeError(false), deleteLater(false), writable(true), writeWatched(false), isCompressed(false), readDisconnected(false), zDeflateInSize(0)
 	{
 		memset(&zDeflate, 0, sizeof(zDeflate));
 		memset(&zInflate, 0, sizeof(zInflate));
@@ -63,6 +68,8 @@ struct Socket
 	bool ready;
 	bool writeError;
 	bool deleteLater;
+	bool writable;          ///< Only used with epoll. False if send() would have blocked, until epoll says the socket is writable again.
+	bool writeWatched;      ///< Only used with epoll. Whether the socket is registered with the writer's epoll, otherwise it's retried every 50ms.
 	char textAddress[40];
 
 	bool isCompressed;
@@ -78,6 +85,80 @@ struct Socket
 struct SocketSet
 {
 	std::vector<Socket *> fds;
+	int epollFd = -1;                         ///< Watches the sockets in fds for reading. If -1, checkSockets uses select() instead.
+#if defined(WZ_OS_LINUX)
+	mutable std::vector<epoll_event> events;  ///< Buffer for epoll_wait.
+#endif
+};
+
+/**
+ * Data waiting to be sent on a socket. A ring buffer, so that sending the start of the
+ * queue doesn't need to move the rest of it.
+ */
+class SocketWriteQueue
+{
+public:
+	bool empty() const
+	{
+		return used == 0;
+	}
+	void append(uint8_t const *data, size_t size)
+	{
+		if (size == 0)
+		{
+			return;  // Nothing to do, and an empty buffer has no position to copy to.
+		}
+		if (used + size > buffer.size())
+		{
+			grow(used + size);
+		}
+		size_t end = (begin + used) & (buffer.size() - 1);
+		size_t first = std::min(size, buffer.size() - end);
+		memcpy(&buffer[end], data, first);
+		if (first < size)
+		{
+			memcpy(&buffer[0], data + first, size - first);
+		}
+		used += size;
+	}
+	/// The start of the queue, up to where it wraps around to the start of the buffer.
+	uint8_t const *front() const
+	{
+		return &buffer[begin];
+	}
+	size_t frontSize() const
+	{
+		return std::min(used, buffer.size() - begin);
+	}
+	/// Removes size bytes from the start of the queue.
+	void pop(size_t size)
+	{
+		begin = (begin + size) & (buffer.size() - 1);
+		used -= size;
+	}
+
+private:
+	void grow(size_t minSize)
+	{
+		size_t newSize = std::max<size_t>(buffer.size(), 4096);
+		while (newSize < minSize)
+		{
+			newSize *= 2;
+		}
+		std::vector<uint8_t> newBuffer(newSize);
+		if (used != 0)
+		{
+			size_t first = frontSize();
+			memcpy(&newBuffer[0], front(), first);
+			memcpy(&newBuffer[first], &buffer[0], used - first);
+		}
+		buffer.swap(newBuffer);
+		begin = 0;
+	}
+
+	std::vector<uint8_t> buffer;  ///< Size is 0 or a power of 2.
+	size_t begin = 0;
+	size_t used = 0;
 };
 
 
@@ -85,9 +166,15 @@ static WZ_MUTEX *socketThreadMutex;
 static WZ_SEMAPHORE *socketThreadSemaphore;
 static WZ_THREAD *socketThread = nullptr;
 static bool socketThreadQuit;
-typedef std::map<Socket *, std::vector<uint8_t>> SocketThreadWriteMap;
+typedef std::map<Socket *, SocketWriteQueue> SocketThreadWriteMap;
 static SocketThreadWriteMap socketThreadWrites;
 
+#if defined(WZ_OS_LINUX)
+static int socketThreadEpoll = -1;                ///< Edge triggered, watches the sockets in socketThreadFds for writing, and socketThreadWakeFd.
+static int socketThreadWakeFd = -1;               ///< eventfd, for waking up the writer thread.
+static std::map<SOCKET, Socket *> socketThreadFds;  ///< Sockets registered with socketThreadEpoll.
+#endif
+
 
 static void socketCloseNow(Socket *sock);
 
@@ -388,6 +475,67 @@ static bool connectionIsOpen(Socket *sock)
 	return true;
 }
 
+/**
+ * Sends as much of the write queue of the socket as can be sent without blocking. Call with socketThreadMutex locked.
+ * Once the whole queue is sent, or the socket is broken, the socket is removed from socketThreadWrites, and closed if
+ * socketClose was called for it already.
+ *
+ * @return false if the socket can't take any more data for now, in which case nothing has been removed or closed.
+ */
+static bool socketThreadSend(SocketThreadWriteMap::iterator w)
+{
+	Socket *sock = w->first;
+	SocketWriteQueue &writeQueue = w->second;
+	ASSERT(!writeQueue.empty(), "writeQueue[sock] must not be empty.");
+
+	while (!writeQueue.empty() && !sock->writeError)
+	{
+		// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
+		size_t size = writeQueue.frontSize();
+		ssize_t ret = send(sock->fd[SOCK_CONNECTION], reinterpret_cast<char const *>(writeQueue.front()), size, MSG_NOSIGNAL);
+		if (ret != SOCKET_ERROR)
+		{
+			// Erase as much data as written.
+			writeQueue.pop(ret);
+			if ((size_t)ret < size)
+			{
+				return false;  // The send buffer is full, no point in trying again until it isn't.
+			}
+			continue;
+		}
+
+		switch (getSockErr())
+		{
+		case EAGAIN:
+#if defined(EWOULDBLOCK) && EAGAIN != EWOULDBLOCK
+		case EWOULDBLOCK:
+#endif
+			if (!connectionIsOpen(sock))
+			{
+				debug(LOG_NET, "Socket error");
+				sock->writeError = true;  // Socket broken, don't try writing to it again.
+				break;
+			}
+			return false;
+		case EINTR:
+			break;
+#if defined(EPIPE)
+		case EPIPE:
+#endif
+		default:
+			sock->writeError = true;  // Socket broken, don't try writing to it again.
+			break;
+		}
+	}
+
+	socketThreadWrites.erase(w);  // Nothing left to write, delete from pending list.
+	if (sock->deleteLater)
+	{
+		socketCloseNow(sock);
+	}
+	return true;
+}
+
 static int socketThreadFunction(void *)
 {
 	wzMutexLock(socketThreadMutex);
@@ -425,65 +573,12 @@ static int socketThreadFunction(void *)
 				SocketThreadWriteMap::iterator w = i;
 				++i;
 
-				Socket *sock = w->first;
-				std::vector<uint8_t> &writeQueue = w->second;
-				ASSERT(!writeQueue.empty(), "writeQueue[sock] must not be empty.");
-
-				if (!FD_ISSET(sock->fd[SOCK_CONNECTION], &fds))
+				if (!FD_ISSET(w->first->fd[SOCK_CONNECTION], &fds))
 				{
 					continue;  // This socket is not ready for writing, or we don't have anything to write.
 				}
 
-				// Write data.
-				// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
-				ssize_t ret = send(sock->fd[SOCK_CONNECTION], reinterpret_cast<char *>(&writeQueue[0]), writeQueue.size(), MSG_NOSIGNAL);
-				if (ret != SOCKET_ERROR)
-				{
-					// Erase as much data as written.
-					writeQueue.erase(writeQueue.begin(), writeQueue.begin() + ret);
-					if (writeQueue.empty())
-					{
-						socketThreadWrites.erase(w);  // Nothing left to write, delete from pending list.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-					}
-				}
-				else
-				{
-					switch (getSockErr())
-					{
-					case EAGAIN:
-#if defined(EWOULDBLOCK) && EAGAIN != EWOULDBLOCK
-					case EWOULDBLOCK:
-#endif
-						if (!connectionIsOpen(sock))
-						{
-							debug(LOG_NET, "Socket error");
-							sock->writeError = true;
-							socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-							if (sock->deleteLater)
-							{
-								socketCloseNow(sock);
-							}
-							break;
-						}
-					case EINTR:
-						break;
-#if defined(EPIPE)
-					case EPIPE:
-#endif
-					default:
-						sock->writeError = true;
-						socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-						break;
-					}
-				}
+				socketThreadSend(w);
 			}
 		}
 
@@ -500,6 +595,115 @@ static int socketThreadFunction(void *)
 	return 42;  // Return value arbitrary and unused.
 }
 
+#if defined(WZ_OS_LINUX)
+static void socketThreadEpollWake()
+{
+	uint64_t one = 1;
+	ssize_t ret = write(socketThreadWakeFd, &one, sizeof(one));
+	(void)ret;  // Can only fail if the counter is about to overflow, in which case the thread will wake up anyway.
+}
+
+/// Like socketThreadFunction, but instead of polling every socket with queued data every 50ms, sleeps until epoll says that a socket which previously couldn't take any more data is writable again.
+static int socketThreadEpollFunction(void *)
+{
+	epoll_event events[64];
+
+	wzMutexLock(socketThreadMutex);
+	while (!socketThreadQuit)
+	{
+		// Write to all sockets which haven't blocked since they were last reported as writable.
+		// Sockets which epoll couldn't watch are tried again every 50ms instead, as the select() writer does.
+		int timeout = -1;
+		for (SocketThreadWriteMap::iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end();)
+		{
+			SocketThreadWriteMap::iterator w = i;
+			++i;
+
+			Socket *sock = w->first;
+			if (!sock->writeWatched)
+			{
+				sock->writable = true;
+			}
+			if (sock->writable && !socketThreadSend(w))
+			{
+				sock->writable = false;
+				if (!sock->writeWatched)
+				{
+					timeout = 50;
+				}
+			}
+		}
+
+		// Wait until a socket is writable again, or until socketThreadQueue wakes us up.
+		wzMutexUnlock(socketThreadMutex);
+		int ret = epoll_wait(socketThreadEpoll, events, ARRAY_SIZE(events), timeout);
+		wzMutexLock(socketThreadMutex);
+
+		// Ignore errors from epoll_wait, which would be EINTR.
+		for (int e = 0; e < ret; ++e)
+		{
+			if (events[e].data.fd == socketThreadWakeFd)
+			{
+				uint64_t count;
+				ssize_t ignored = read(socketThreadWakeFd, &count, sizeof(count));
+				(void)ignored;
+				continue;
+			}
+			std::map<SOCKET, Socket *>::iterator s = socketThreadFds.find(events[e].data.fd);
+			if (s != socketThreadFds.end())
+			{
+				s->second->writable = true;  // Or broken, if EPOLLERR or EPOLLHUP, in which case the next send() fails.
+			}
+		}
+	}
+	wzMutexUnlock(socketThreadMutex);
+
+	return 42;  // Return value arbitrary and unused.
+}
+#endif
+
+/// Queues data to be written by the writer thread.
+static void socketThreadQueue(Socket *sock, uint8_t const *data, size_t size)
+{
+	wzMutexLock(socketThreadMutex);
+	bool wasIdle = socketThreadWrites.empty();
+#if defined(WZ_OS_LINUX)
+	if (socketThreadEpoll != -1)
+	{
+		wasIdle = false;  // The semaphore is only used by the select() writer.
+		if (socketThreadWrites.find(sock) == socketThreadWrites.end())
+		{
+			// The writer thread isn't waiting for this socket, so make sure it tries writing to it.
+			SOCKET fd = sock->fd[SOCK_CONNECTION];
+			if (socketThreadFds.find(fd) == socketThreadFds.end())
+			{
+				epoll_event event;
+				event.events = EPOLLOUT | EPOLLET;
+				event.data.fd = fd;
+				if (epoll_ctl(socketThreadEpoll, EPOLL_CTL_ADD, fd, &event) == 0)
+				{
+					socketThreadFds[fd] = sock;
+					sock->writeWatched = true;
+				}
+				else
+				{
+					debug(LOG_ERROR, "Failed to watch socket %p for writing, polling it instead: %s", static_cast<void *>(sock), strSockError(getSockErr()));
+					sock->writeWatched = false;
+				}
+			}
+			sock->writable = true;
+			socketThreadEpollWake();
+		}
+	}
+#endif
+	if (wasIdle)
+	{
+		wzSemaphorePost(socketThreadSemaphore);
+	}
+	socketThreadWrites[sock].append(data, size);
+	wzMutexUnlock(socketThreadMutex);
+}
+
 /**
  * Similar to read(2) with the exception that this function won't be
  * interrupted by signals (EINTR).
@@ -627,14 +831,7 @@ ssize_t writeAll(Socket *sock, const void *buf, size_t size, size_t *rawByteCoun
 	{
 		if (!sock->isCompressed)
 		{
-			wzMutexLock(socketThreadMutex);
-			if (socketThreadWrites.empty())
-			{
-				wzSemaphorePost(socketThreadSemaphore);
-			}
-			std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-			writeQueue.insert(writeQueue.end(), static_cast<char const *>(buf), static_cast<char const *>(buf) + size);
-			wzMutexUnlock(socketThreadMutex);
+			socketThreadQueue(sock, static_cast<uint8_t const *>(buf), size);
 			rawBytes = size;
 		}
 		else
@@ -722,14 +919,7 @@ void socketFlush(Socket *sock, size_t *rawByteCount)
 		return;  // No data to flush out.
 	}
 
-	wzMutexLock(socketThreadMutex);
-	if (socketThreadWrites.empty())
-	{
-		wzSemaphorePost(socketThreadSemaphore);
-	}
-	std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-	writeQueue.insert(writeQueue.end(), sock->zDeflateOutBuf.begin(), sock->zDeflateOutBuf.end());
-	wzMutexUnlock(socketThreadMutex);
+	socketThreadQueue(sock, &sock->zDeflateOutBuf[0], sock->zDeflateOutBuf.size());
 
 	// Primitive network logging, uncomment to use.
 	//printf("Size %3u ->%3zu, buf =", sock->zDeflateInSize, sock->zDeflateOutBuf.size());
@@ -783,11 +973,25 @@ Socket::~Socket()
 
 SocketSet *allocSocketSet()
 {
-	return new SocketSet;
+	SocketSet *set = new SocketSet;
+#if defined(WZ_OS_LINUX)
+	set->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epollFd == -1)
+	{
+		debug(LOG_NET, "epoll_create1 failed, using select: %s", strSockError(getSockErr()));
+	}
+#endif
+	return set;
 }
 
 void deleteSocketSet(SocketSet *set)
 {
+#if defined(WZ_OS_LINUX)
+	if (set->epollFd != -1)
+	{
+		close(set->epollFd);
+	}
+#endif
 	delete set;
 }
 
@@ -810,6 +1014,22 @@ void SocketSet_AddSocket(SocketSet *set, Socket *socket)
 
 	set->fds.push_back(socket);
 	debug(LOG_NET, "Socket added: set->fds[%lu] = %p", (unsigned long)i, static_cast<void *>(socket));
+
+#if defined(WZ_OS_LINUX)
+	if (set->epollFd != -1)
+	{
+		// Level triggered, since callers read at most one message each time checkSockets says the socket is ready.
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = socket;
+		if (epoll_ctl(set->epollFd, EPOLL_CTL_ADD, socket->fd[SOCK_CONNECTION], &event) != 0)
+		{
+			debug(LOG_NET, "epoll_ctl failed, using select: %s", strSockError(getSockErr()));
+			close(set->epollFd);
+			set->epollFd = -1;
+		}
+	}
+#endif
 }
 
 /**
@@ -822,6 +1042,12 @@ void SocketSet_DelSocket(SocketSet *set, Socket *socket)
 	{
 		debug(LOG_NET, "Socket %p erased (set->fds[%lu])", static_cast<void *>(socket), (unsigned long)i);
 		set->fds.erase(set->fds.begin() + i);
+#if defined(WZ_OS_LINUX)
+		if (set->epollFd != -1 && socket->fd[SOCK_CONNECTION] != INVALID_SOCKET)
+		{
+			epoll_ctl(set->epollFd, EPOLL_CTL_DEL, socket->fd[SOCK_CONNECTION], nullptr);  // Fails harmlessly if the socket was closed already.
+		}
+#endif
 	}
 }
 
@@ -958,6 +1184,36 @@ int checkSockets(const SocketSet *set, unsigned int timeout)
 		return ret;
 	}
 
+#if defined(WZ_OS_LINUX)
+	if (set->epollFd != -1)
+	{
+		set->events.resize(set->fds.size());
+		int ret;
+		do
+		{
+			ret = epoll_wait(set->epollFd, &set->events[0], (int)set->events.size(), timeout);
+		}
+		while (ret == SOCKET_ERROR && getSockErr() == EINTR);
+
+		if (ret == SOCKET_ERROR)
+		{
+			debug(LOG_ERROR, "epoll_wait failed: %s", strSockError(getSockErr()));
+			return SOCKET_ERROR;
+		}
+
+		for (size_t i = 0; i < set->fds.size(); ++i)
+		{
+			set->fds[i]->ready = false;
+		}
+		for (int e = 0; e < ret; ++e)
+		{
+			static_cast<Socket *>(set->events[e].data.ptr)->ready = true;
+		}
+
+		return ret;
+	}
+#endif
+
 	int ret;
 	fd_set fds;
 	do
@@ -1074,6 +1330,14 @@ ssize_t readAll(Socket *sock, void *buf, size_t size, unsigned int timeout)
 
 static void socketCloseNow(Socket *sock)
 {
+#if defined(WZ_OS_LINUX)
+	std::map<SOCKET, Socket *>::iterator registered = socketThreadFds.find(sock->fd[SOCK_CONNECTION]);
+	if (registered != socketThreadFds.end() && registered->second == sock)
+	{
+		epoll_ctl(socketThreadEpoll, EPOLL_CTL_DEL, sock->fd[SOCK_CONNECTION], nullptr);
+		socketThreadFds.erase(registered);
+	}
+#endif
 	for (unsigned i = 0; i < ARRAY_SIZE(sock->fd); ++i)
 	{
 		if (sock->fd[i] != INVALID_SOCKET)
@@ -1693,7 +1957,28 @@ void SOCKETinit()
 		socketThreadQuit = false;
 		socketThreadMutex = wzMutexCreate();
 		socketThreadSemaphore = wzSemaphoreCreate(0);
-		socketThread = wzThreadCreate(socketThreadFunction, nullptr);
+		int (*threadFunction)(void *) = socketThreadFunction;
+#if defined(WZ_OS_LINUX)
+		socketThreadEpoll = epoll_create1(EPOLL_CLOEXEC);
+		socketThreadWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.fd = socketThreadWakeFd;
+		if (socketThreadEpoll == -1 || socketThreadWakeFd == -1 || epoll_ctl(socketThreadEpoll, EPOLL_CTL_ADD, socketThreadWakeFd, &event) != 0)
+		{
+			debug(LOG_NET, "Failed to set up epoll, using select: %s", strSockError(getSockErr()));
+			if (socketThreadEpoll != -1)
+			{
+				close(socketThreadEpoll);
+				socketThreadEpoll = -1;
+			}
+		}
+		if (socketThreadEpoll != -1)
+		{
+			threadFunction = socketThreadEpollFunction;
+		}
+#endif
+		socketThread = wzThreadCreate(threadFunction, nullptr);
 		wzThreadStart(socketThread);
 	}
 }
@@ -1707,7 +1992,26 @@ void SOCKETshutdown()
 		socketThreadWrites.clear();
 		wzMutexUnlock(socketThreadMutex);
 		wzSemaphorePost(socketThreadSemaphore);  // Wake up the thread, so it can quit.
+#if defined(WZ_OS_LINUX)
+		if (socketThreadEpoll != -1)
+		{
+			socketThreadEpollWake();
+		}
+#endif
 		wzThreadJoin(socketThread);
+#if defined(WZ_OS_LINUX)
+		if (socketThreadEpoll != -1)
+		{
+			close(socketThreadEpoll);
+			socketThreadEpoll = -1;
+		}
+		if (socketThreadWakeFd != -1)
+		{
+			close(socketThreadWakeFd);
+			socketThreadWakeFd = -1;
+		}
+		socketThreadFds.clear();
+#endif
 		wzMutexDestroy(socketThreadMutex);
 		wzSemaphoreDestroy(socketThreadSemaphore);
 		socketThread = nullptr;
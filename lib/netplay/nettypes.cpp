@@ -34,11 +34,14 @@
 #endif
 
 #include "../framework/frame.h"
+#include "lib/framework/wzapp.h"
 #include "netplay.h"
 #include "nettypes.h"
 #include "netqueue.h"
 #include "netlog.h"
+#include "netreplay.h"
 #include "src/order.h"
+#include <chrono>
 #include <cstring>
 
 /// There is a game queue representing each player. The game queues are synchronised among all players, so that all players process the same game queue
@@ -62,6 +65,7 @@ static MessageReader reader;  ///< Used when deserialising a message.
 static NetMessage message;    ///< A message which is being serialised or deserialised.
 static NETQUEUE queueInfo;    ///< Indicates which queue is currently being (de)serialised.
 static PACKETDIR NetDir;      ///< Indicates whether a message is being serialised (PACKET_ENCODE) or deserialised (PACKET_DECODE), or not doing anything (PACKET_INVALID).
+static std::chrono::steady_clock::time_point messageStartTime;  ///< When the (de)serialisation started, only set if network statistics are enabled.
 
 static void NETsetPacketDir(PACKETDIR dir)
 {
@@ -88,8 +92,7 @@ template<class Q>
 static void queue(const Q &q, uint16_t &v)
 {
 	uint8_t b[2] = {uint8_t(v >> 8), uint8_t(v)};
-	queue(q, b[0]);
-	queue(q, b[1]);
+	q.bytes(b, 2);
 	if (Q::Direction == Q::Read)
 	{
 		v = b[0] << 8 | b[1];
@@ -102,13 +105,14 @@ static void queue(const Q &q, uint32_t &vOrig)
 	if (Q::Direction == Q::Write)
 	{
 		uint32_t v = vOrig;
+		uint8_t b[5];
 		bool moreBytes = true;
-		for (int n = 0; moreBytes; ++n)
+		int n;
+		for (n = 0; moreBytes; ++n)
 		{
-			uint8_t b;
-			moreBytes = encode_uint32_t(b, v, n);
-			queue(q, b);
+			moreBytes = encode_uint32_t(b[n], v, n);
 		}
+		q.bytes(b, n);
 	}
 	else if (Q::Direction == Q::Read)
 	{
@@ -265,6 +269,25 @@ static void queue(const Q &q, std::vector<T> &v)
 	}
 }
 
+// Byte vectors are copied in one go, instead of a byte at a time.
+static void queue(const MessageWriter &q, std::vector<uint8_t> &v)
+{
+	ASSERT(v.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "v.size() exceeds uint32_t max");
+	uint32_t len = static_cast<uint32_t>(std::min(v.size(), static_cast<size_t>(std::numeric_limits<uint32_t>::max())));
+	queue(q, len);
+	q.bytes(v.data(), len);
+}
+
+static void queue(const MessageReader &q, std::vector<uint8_t> &v)
+{
+	uint32_t len = 0;
+	queue(q, len);
+	// Like the generic version, stop after the first byte past the end of the message, if the length is wrong.
+	size_t n = q.valid() ? std::min<size_t>(len, q.bytesLeft() + 1) : 0;
+	v.resize(n);
+	q.bytes(v.data(), n);
+}
+
 template<class Q>
 static void queue(const Q &q, NetMessage &v)
 {
@@ -383,7 +406,17 @@ void NETinsertRawData(NETQUEUE queue, uint8_t *data, size_t dataLen)
 
 void NETinsertMessageFromNet(NETQUEUE queue, NetMessage const *message)
 {
-	receiveQueue(queue)->pushMessage(*message);
+	if (!NETstatisticsEnabled())
+	{
+		receiveQueue(queue)->pushMessage(*message);
+		return;
+	}
+
+	receiveQueue(queue)->pushMessage(*message, std::max<uint32_t>(wzGetTicks(), 1));  // 0 means no time.
+	if (queue.queueType == QUEUE_GAME)
+	{
+		NETlogGameQueueDepth(queue.index, receiveQueue(queue)->numMessages());
+	}
 }
 
 bool NETisMessageReady(NETQUEUE queue)
@@ -455,8 +488,13 @@ void NETbeginEncode(NETQUEUE queue, uint8_t type)
 	NETsetPacketDir(PACKET_ENCODE);
 
 	queueInfo = queue;
-	message = type;
+	message.type = type;
+	message.data.clear();  // Keep the capacity, for the next message.
 	writer = MessageWriter(message);
+	if (NETstatisticsEnabled())
+	{
+		messageStartTime = std::chrono::steady_clock::now();
+	}
 }
 
 void NETbeginDecode(NETQUEUE queue, uint8_t type)
@@ -466,15 +504,44 @@ void NETbeginDecode(NETQUEUE queue, uint8_t type)
 	queueInfo = queue;
 	message = receiveQueue(queueInfo)->getMessage();
 	reader = MessageReader(message);
+	if (NETstatisticsEnabled())
+	{
+		messageStartTime = std::chrono::steady_clock::now();
+	}
 
 	assert(type == message.type);
 }
 
+size_t NETencodedSize()
+{
+	ASSERT(NETgetPacketDir() == PACKET_ENCODE, "Not encoding.");
+	return message.data.size();
+}
+
+size_t NETdecodeBytesLeft()
+{
+	ASSERT(NETgetPacketDir() == PACKET_DECODE, "Not decoding.");
+	return reader.bytesLeft();
+}
+
 bool NETend()
 {
+	if (NETstatisticsEnabled() && NETgetPacketDir() != PACKET_INVALID)
+	{
+		uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - messageStartTime).count();
+		NETlogPacketTime(message.type, microseconds, NETgetPacketDir() == PACKET_DECODE);
+	}
+
 	// If we are encoding just return true
 	if (NETgetPacketDir() == PACKET_ENCODE)
 	{
+		if (NETisReplay() && (queueInfo.queueType == QUEUE_GAME || queueInfo.queueType == QUEUE_GAME_FORCED))
+		{
+			// When playing back a replay, the game messages all come from the replay, so drop our own.
+			NETsetPacketDir(PACKET_INVALID);
+			return true;
+		}
+
 		// Push the message onto the list.
 		NetQueue *queue = sendQueue(queueInfo);
 		if (queue == nullptr) {
@@ -586,7 +653,20 @@ void NETflushGameQueues()
 
 void NETpop(NETQUEUE queue)
 {
+	if (queue.queueType == QUEUE_GAME)
+	{
+		NetMessage const &poppedMessage = receiveQueue(queue)->getMessage();
+		NETreplaySaveNetMessage(poppedMessage, queue.index);
+		if (poppedMessage.receivedTime != 0)
+		{
+			NETlogGameMessageLatency(queue.index, wzGetTicks() - poppedMessage.receivedTime);
+		}
+	}
 	receiveQueue(queue)->popMessage();
+	if (queue.queueType == QUEUE_GAME && NETstatisticsEnabled())
+	{
+		NETlogGameQueueDepth(queue.index, receiveQueue(queue)->numMessages());
+	}
 }
 
 void NETint8_t(int8_t *ip)
@@ -76,6 +76,8 @@ void NETdeleteQueue();					///< Delete queues for cleanup
 void NETbeginEncode(NETQUEUE queue, uint8_t type);
 void NETbeginDecode(NETQUEUE queue, uint8_t type);
 bool NETend();
+size_t NETencodedSize();  ///< Returns the number of bytes of the message serialised so far, between NETbeginEncode and NETend.
+size_t NETdecodeBytesLeft();  ///< Returns the number of bytes of the message left to deserialise, or 0 if reading has gone past the end.
 void NETflushGameQueues();
 void NETpop(NETQUEUE queue);
 
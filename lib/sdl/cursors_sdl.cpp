@@ -22,6 +22,7 @@
  */
 
 #include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
 #include "lib/ivis_opengl/bitimage.h"
 #include "lib/ivis_opengl/tex.h"
 #include "src/warzoneconfig.h"
@@ -1367,6 +1368,11 @@ void wzSetCursor(CURSOR cur)
 
 void wzApplyCursor()
 {
+	if (wzIsHeadless())
+	{
+		return;  // No window to show a cursor in.
+	}
+
 	// If mouse cursor options change, change cursors (used to only work on mouse options screen for some reason)
 	if (!(war_GetColouredCursor() ^ monoCursor))
 	{
@@ -95,6 +95,9 @@ int main(int argc, char *argv[])
 // At this time, we only have 1 window.
 static SDL_Window *WZwindow = nullptr;
 static video_backend WZbackend = video_backend::opengl;
+// Running without a window, renderer or audio, see wzSetHeadless.
+static bool headlessMode = false;
+#define HEADLESS_IDLE_DELAY 5  ///< Milliseconds to sleep for after each frame, when running headless.
 
 // The screen that the game window is on.
 int screenIndex = 0;
@@ -365,6 +368,16 @@ unsigned int wzGetCurrentDisplayScale()
 	return current_displayScale;
 }
 
+void wzSetHeadless(bool headless)
+{
+	headlessMode = headless;
+}
+
+bool wzIsHeadless()
+{
+	return headlessMode;
+}
+
 void wzShowMouse(bool visible)
 {
 	SDL_ShowCursor(visible ? SDL_ENABLE : SDL_DISABLE);
@@ -390,6 +403,11 @@ void wzDisplayDialog(DialogType type, const char *title, const char *message)
 			sdl_messagebox_flags = SDL_MESSAGEBOX_INFORMATION;
 			break;
 	}
+	if (headlessMode)
+	{
+		// Nobody to show it to, the message is already in the log.
+		return;
+	}
 	SDL_ShowSimpleMessageBox(sdl_messagebox_flags, title, message, WZwindow);
 }
 
@@ -499,6 +517,11 @@ void wzYieldCurrentThread()
 	SDL_Delay(40);
 }
 
+unsigned wzGetLogicalCPUCount()
+{
+	return static_cast<unsigned>(std::max(SDL_GetCPUCount(), 1));
+}
+
 WZ_MUTEX *wzMutexCreate()
 {
 	return (WZ_MUTEX *)SDL_CreateMutex();
@@ -1565,8 +1588,11 @@ void wzGetWindowResolution(int *screen, unsigned int *width, unsigned int *heigh
 		*screen = screenIndex;
 	}
 
-	int currentWidth = 0, currentHeight = 0;
-	SDL_GetWindowSize(WZwindow, &currentWidth, &currentHeight);
+	int currentWidth = windowWidth, currentHeight = windowHeight;
+	if (WZwindow != nullptr)
+	{
+		SDL_GetWindowSize(WZwindow, &currentWidth, &currentHeight);
+	}
 	assert(currentWidth >= 0);
 	assert(currentHeight >= 0);
 	if (width != nullptr)
@@ -1652,7 +1678,8 @@ void resetGfxBackend(video_backend newBackend, bool displayRestartMessage = true
 
 bool wzSDLOneTimeInit()
 {
-	const Uint32 sdl_init_flags = SDL_INIT_VIDEO | SDL_INIT_TIMER;
+	// Without a window, only the event queue is needed, for wzQuit and wzAsyncExecOnMainThread.
+	const Uint32 sdl_init_flags = headlessMode ? SDL_INIT_EVENTS | SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_TIMER;
 	if (!(SDL_WasInit(sdl_init_flags) == sdl_init_flags))
 	{
 		if (SDL_Init(sdl_init_flags) != 0)
@@ -1676,9 +1703,42 @@ bool wzSDLOneTimeInit()
 	return true;
 }
 
+// Sets up the null renderer at a fixed game screen size, without creating a window.
+static bool wzMainScreenSetupHeadless()
+{
+	if (!wzSDLOneTimeInit())
+	{
+		// wzSDLOneTimeInit already logged an error on failure
+		return false;
+	}
+
+	setDisplayScale(100);
+	windowWidth = screenWidth = MIN_WZ_GAMESCREEN_WIDTH;
+	windowHeight = screenHeight = MIN_WZ_GAMESCREEN_HEIGHT;
+	pie_SetVideoBufferWidth(screenWidth);
+	pie_SetVideoBufferHeight(screenHeight);
+
+	// The script engine only needs the Qt event loop, not a GUI, so there is no display connection either.
+	appPtr = new QCoreApplication(copied_argc, copied_argv);
+	setlocale(LC_NUMERIC, "C"); // set radix character to the period (".")
+
+	if (!gfx_api::context::initializeNull())
+	{
+		debug(LOG_FATAL, "Failed to initialise the null renderer");
+		return false;
+	}
+	debug(LOG_INFO, "Running headless, without a window, rendering or audio");
+	return true;
+}
+
 // This stage, we handle display mode setting
 bool wzMainScreenSetup(const video_backend& backend, int antialiasing, bool fullscreen, int vsync, bool highDPI)
 {
+	if (headlessMode)
+	{
+		return wzMainScreenSetupHeadless();
+	}
+
 	const bool useOpenGLES = (backend == video_backend::opengles)
 #if defined(WZ_BACKEND_DIRECTX)
 		|| (backend == video_backend::directx)
@@ -2112,6 +2172,18 @@ bool wzMainScreenSetup(const video_backend& backend, int antialiasing, bool full
 //
 void wzGetWindowToRendererScaleFactor(float *horizScaleFactor, float *vertScaleFactor)
 {
+	if (headlessMode)
+	{
+		if (horizScaleFactor != nullptr)
+		{
+			*horizScaleFactor = current_displayScaleFactor;
+		}
+		if (vertScaleFactor != nullptr)
+		{
+			*vertScaleFactor = current_displayScaleFactor;
+		}
+		return;
+	}
 	assert(WZwindow != nullptr);
 
 	// Obtain the window context's drawable size in pixels
@@ -2367,6 +2439,11 @@ void wzMainEventLoop(void)
 		processScreenSizeChangeNotificationIfNeeded();
 		mainLoop();				// WZ does its thing
 		inputNewFrame();			// reset input states
+		if (headlessMode)
+		{
+			// Nothing is drawn, so there is no vsync to wait for. Sleep instead of spinning until the next game tick or network message.
+			SDL_Delay(HEADLESS_IDLE_DELAY);
+		}
 	}
 }
 
@@ -24,6 +24,7 @@
 #include "lib/framework/frame.h"
 #include "lib/framework/string_ext.h"
 #include "lib/framework/utf.h"
+#include "lib/framework/wzapp.h"
 #include "lib/ivis_opengl/textdraw.h"
 #include "lib/ivis_opengl/pieblitfunc.h"
 #include "lib/ivis_opengl/piestate.h"
@@ -1028,17 +1029,28 @@ void widgDisplayScreen(W_SCREEN *psScreen)
 	sContext.my = mouseY();
 	psScreen->psForm->processCallbacksRecursive(&sContext);
 
-	// Display the widgets.
-	psScreen->psForm->displayRecursive();
+	// Display the widgets. When headless only the callbacks run, since some screens are updated by them.
+	bool display = !wzIsHeadless();
+	if (display)
+	{
+		psScreen->psForm->displayRecursive();
+	}
 
 	// Always overlays on-top (i.e. draw them last)
 	for (const auto& overlay : overlays)
 	{
 		overlay.psScreen->psForm->processCallbacksRecursive(&sContext);
-		overlay.psScreen->psForm->displayRecursive();
+		if (display)
+		{
+			overlay.psScreen->psForm->displayRecursive();
+		}
 	}
 
 	deleteOldWidgets();  // Delete any widgets that called deleteLater() while being displayed.
+	if (!display)
+	{
+		return;
+	}
 
 	/* Display the tool tip if there is one */
 	tipDisplay();
@@ -35,9 +35,9 @@
  *    is continued until the new source is reached.  If the new source is  not reached,
  *    the droid is  on a  different island than the previous droid,  and pathfinding is
  *    restarted from the first step.
- *  Up to 30 pathfinding maps from A* are cached, in a LRU list. The PathNode heap con-
- *  tains the  priority-heap-sorted  nodes which are to be explored.  The path back  is
- *  stored in the PathExploredTile 2D array of tiles.
+ *  Up to 30 pathfinding maps from A* are cached  for each path job shard,  in a LRU list.
+ *  The PathNode heap contains the priority-heap-sorted nodes which are to be explored.
+ *  The path back is stored in the PathExploredTile 2D array of tiles.
  */
 
 #ifndef WZ_TESTING
@@ -54,170 +54,28 @@
 
 #include "lib/netplay/netplay.h"
 
-/// A coordinate.
-struct PathCoord
-{
-	PathCoord() {}
-	PathCoord(int16_t x_, int16_t y_) : x(x_), y(y_) {}
-	bool operator ==(PathCoord const &z) const
-	{
-		return x == z.x && y == z.y;
-	}
-	bool operator !=(PathCoord const &z) const
-	{
-		return !(*this == z);
-	}
-
-	int16_t x, y;
-};
-
-/** The structure to store a node of the route in node table
- *
- *  @ingroup pathfinding
- */
-struct PathNode
-{
-	bool operator <(PathNode const &z) const
-	{
-		// Sort descending est, fallback to ascending dist, fallback to sorting by position.
-		if (est  != z.est)
-		{
-			return est  > z.est;
-		}
-		if (dist != z.dist)
-		{
-			return dist < z.dist;
-		}
-		if (p.x  != z.p.x)
-		{
-			return p.x  < z.p.x;
-		}
-		return p.y  < z.p.y;
-	}
-
-	PathCoord p;                    // Map coords.
-	unsigned  dist, est;            // Distance so far and estimate to end.
-};
-struct PathExploredTile
-{
-	PathExploredTile() : iteration(0xFFFF), dx(0), dy(0), dist(0), visited(false) {}
-
-	uint16_t iteration;
-	int8_t   dx, dy;                // Offset from previous point in the route.
-	unsigned dist;                  // Shortest known distance to tile.
-	bool     visited;
-};
-
-struct PathBlockingType
-{
-	uint32_t gameTime;
-
-	PROPULSION_TYPE propulsion;
-	int owner;
-	FPATH_MOVETYPE moveType;
-};
-/// Pathfinding blocking map
-struct PathBlockingMap
-{
-	bool operator ==(PathBlockingType const &z) const
-	{
-		return type.gameTime == z.gameTime &&
-		       fpathIsEquivalentBlocking(type.propulsion, type.owner, type.moveType,
-		                                 z.propulsion,    z.owner,    z.moveType);
-	}
-
-	PathBlockingType type;
-	std::vector<bool> map;
-	std::vector<bool> dangerMap;	// using threatBits
-};
-
-struct PathNonblockingArea
-{
-	PathNonblockingArea() {}
-	PathNonblockingArea(StructureBounds const &st) : x1(st.map.x), x2(st.map.x + st.size.x), y1(st.map.y), y2(st.map.y + st.size.y) {}
-	bool operator ==(PathNonblockingArea const &z) const
-	{
-		return x1 == z.x1 && x2 == z.x2 && y1 == z.y1 && y2 == z.y2;
-	}
-	bool operator !=(PathNonblockingArea const &z) const
-	{
-		return !(*this == z);
-	}
-	bool isNonblocking(int x, int y) const
-	{
-		return x >= x1 && x < x2 && y >= y1 && y < y2;
-	}
-
-	int16_t x1 = 0;
-	int16_t x2 = 0;
-	int16_t y1 = 0;
-	int16_t y2 = 0;
-};
-
-// Data structures used for pathfinding, can contain cached results.
-struct PathfindContext
-{
-	PathfindContext() : myGameTime(0), iteration(0), blockingMap(nullptr) {}
-	bool isBlocked(int x, int y) const
-	{
-		if (dstIgnore.isNonblocking(x, y))
-		{
-			return false;  // The path is actually blocked here by a structure, but ignore it since it's where we want to go (or where we came from).
-		}
-		// Not sure whether the out-of-bounds check is needed, can only happen if pathfinding is started on a blocking tile (or off the map).
-		return x < 0 || y < 0 || x >= mapWidth || y >= mapHeight || blockingMap->map[x + y * mapWidth];
-	}
-	bool isDangerous(int x, int y) const
-	{
-		return !blockingMap->dangerMap.empty() && blockingMap->dangerMap[x + y * mapWidth];
-	}
-	bool matches(std::shared_ptr<PathBlockingMap> &blockingMap_, PathCoord tileS_, PathNonblockingArea dstIgnore_) const
-	{
-		// Must check myGameTime == blockingMap_->type.gameTime, otherwise blockingMap could be a deleted pointer which coincidentally compares equal to the valid pointer blockingMap_.
-		return myGameTime == blockingMap_->type.gameTime && blockingMap == blockingMap_ && tileS == tileS_ && dstIgnore == dstIgnore_;
-	}
-	void assign(std::shared_ptr<PathBlockingMap> &blockingMap_, PathCoord tileS_, PathNonblockingArea dstIgnore_)
-	{
-		blockingMap = blockingMap_;
-		tileS = tileS_;
-		dstIgnore = dstIgnore_;
-		myGameTime = blockingMap->type.gameTime;
-		nodes.clear();
-
-		// Make the iteration not match any value of iteration in map.
-		if (++iteration == 0xFFFF)
-		{
-			map.clear();  // There are no values of iteration guaranteed not to exist in map, so clear the map.
-			iteration = 0;
-		}
-		map.resize(static_cast<size_t>(mapWidth) * static_cast<size_t>(mapHeight));  // Allocate space for map, if needed.
-	}
-
-	PathCoord       tileS;                // Start tile for pathfinding. (May be either source or target tile.)
-	uint32_t        myGameTime;
-
-	PathCoord       nearestCoord;         // Nearest reachable tile to destination.
-
-	/** Counter to implement lazy deletion from map.
-	 *
-	 *  @see fpathTableReset
-	 */
-	uint16_t        iteration;
-
-	std::vector<PathNode> nodes;        ///< Edge of explored region of the map.
-	std::vector<PathExploredTile> map;  ///< Map, with paths leading back to tileS.
-	std::shared_ptr<PathBlockingMap> blockingMap; ///< Map of blocking tiles for the type of object which needs a path.
-	PathNonblockingArea dstIgnore;      ///< Area of structure at destination which should be considered nonblocking.
-};
-
-/// Last recently used list of contexts.
-static std::list<PathfindContext> fpathContexts;
-
 /// Lists of blocking maps from current tick.
 static std::vector<std::shared_ptr<PathBlockingMap>> fpathBlockingMaps;
 /// Game time for all blocking maps in fpathBlockingMaps.
 static uint32_t fpathCurrentGameTime;
 
+/// The latest blocking map of a kind, kept between ticks so that the next one only needs the changed tiles recalculated.
+struct PathBlockingCache
+{
+	std::shared_ptr<PathBlockingMap> latest;
+	uint32_t dirtySequence;             ///< auxDirtySequence() when latest was calculated.
+	uint32_t threatChanges;             ///< auxThreatChanges(owner) when latest was calculated.
+
+	// If any of these change, nothing in latest can be reused.
+	int width, height;
+	int scrollMinX, scrollMinY, scrollMaxX, scrollMaxY;
+	uint8_t const *blockMap, *auxMap;
+};
+/// Maximum number of kinds of blocking map in fpathBlockingCaches.
+#define PATH_BLOCKING_CACHE_SIZE 32
+/// Last recently used list of blocking maps from earlier ticks.
+static std::list<PathBlockingCache> fpathBlockingCaches;
+
 // Convert a direction into an offset
 // dir 0 => x = 0, y = -1
 static const Vector2i aDirOffset[] =
@@ -232,10 +90,32 @@ static const Vector2i aDirOffset[] =
 	Vector2i(1, 1),
 };
 
+/// Returns a bit for each direction in aDirOffset order, set if context.isBlocked() is true for that neighbour of (x, y).
+static inline unsigned fpathBlockedNeighbours(PathfindContext const &context, int x, int y)
+{
+	PathNonblockingArea const &ignore = context.dstIgnore;
+	bool onMap = x >= 0 && y >= 0 && x < mapWidth && y < mapHeight;
+	bool nearIgnore = x + 1 >= ignore.x1 && x - 1 < ignore.x2 && y + 1 >= ignore.y1 && y - 1 < ignore.y2;
+	bool nearCorridor = onMap && !context.corridor.empty() && (x % PATH_CLUSTER_SIZE == 0 || x % PATH_CLUSTER_SIZE == PATH_CLUSTER_SIZE - 1 || y % PATH_CLUSTER_SIZE == 0 || y % PATH_CLUSTER_SIZE == PATH_CLUSTER_SIZE - 1
+	                                                           || !context.corridor[x / PATH_CLUSTER_SIZE + y / PATH_CLUSTER_SIZE * fpathClusterMapWidth(mapWidth)]);
+	if (onMap && !nearIgnore && !nearCorridor)
+	{
+		// All 8 neighbours come straight from the blocking bitmap.
+		return context.blockingMap->map.neighbours(x, y);
+	}
+	unsigned mask = 0;
+	for (unsigned dir = 0; dir < ARRAY_SIZE(aDirOffset); ++dir)
+	{
+		mask |= unsigned(context.isBlocked(x + aDirOffset[dir].x, y + aDirOffset[dir].y)) << dir;
+	}
+	return mask;
+}
+
 void fpathHardTableReset()
 {
-	fpathContexts.clear();
 	fpathBlockingMaps.clear();
+	fpathBlockingCaches.clear();
+	fpathClusterReset();
 }
 
 /** Get the nearest entry in the open list
@@ -384,6 +264,8 @@ static PathCoord fpathAStarExplore(PathfindContext &context, PathCoord tileF)
 		}
 
 		// loop through possible moves in 8 directions to find a valid move
+		unsigned blocked = fpathBlockedNeighbours(context, node.p.x, node.p.y);
+		bool ignoreNode = context.dstIgnore.isNonblocking(node.p.x, node.p.y);
 		for (unsigned dir = 0; dir < ARRAY_SIZE(aDirOffset); ++dir)
 		{
 			// Try a new location
@@ -398,27 +280,17 @@ static PathCoord fpathAStarExplore(PathfindContext &context, PathCoord tileF)
 			   3  2  1
 			   odd:orthogonal-adjacent tiles even:non-orthogonal-adjacent tiles
 			*/
-			if (dir % 2 != 0 && !context.dstIgnore.isNonblocking(node.p.x, node.p.y) && !context.dstIgnore.isNonblocking(x, y))
+			if (dir % 2 != 0 && !ignoreNode && !context.dstIgnore.isNonblocking(x, y))
 			{
-				int x, y;
-
 				// We cannot cut corners
-				x = node.p.x + aDirOffset[(dir + 1) % 8].x;
-				y = node.p.y + aDirOffset[(dir + 1) % 8].y;
-				if (context.isBlocked(x, y))
-				{
-					continue;
-				}
-				x = node.p.x + aDirOffset[(dir + 7) % 8].x;
-				y = node.p.y + aDirOffset[(dir + 7) % 8].y;
-				if (context.isBlocked(x, y))
+				if ((blocked & (1 << (dir + 1) % 8)) != 0 || (blocked & (1 << (dir + 7) % 8)) != 0)
 				{
 					continue;
 				}
 			}
 
 			// See if the node is a blocking tile
-			if (context.isBlocked(x, y))
+			if ((blocked & (1 << dir)) != 0)
 			{
 				// tile is blocked, skip it
 				continue;
@@ -432,16 +304,16 @@ static PathCoord fpathAStarExplore(PathfindContext &context, PathCoord tileF)
 	return nearestCoord;
 }
 
-static void fpathInitContext(PathfindContext &context, std::shared_ptr<PathBlockingMap> &blockingMap, PathCoord tileS, PathCoord tileRealS, PathCoord tileF, PathNonblockingArea dstIgnore)
+static void fpathInitContext(PathfindContext &context, std::shared_ptr<PathBlockingMap> &blockingMap, PathCoord tileS, PathCoord tileRealS, PathCoord tileF, PathNonblockingArea dstIgnore, std::vector<bool> corridor)
 {
-	context.assign(blockingMap, tileS, dstIgnore);
+	context.assign(blockingMap, tileS, dstIgnore, std::move(corridor));
 
 	// Add the start point to the open list
 	fpathNewNode(context, tileF, tileRealS, 0, tileRealS);
 	ASSERT(!context.nodes.empty(), "fpathNewNode failed to add node.");
 }
 
-ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
+ASR_RETVAL fpathAStarRoute(PathfindContextList &fpathContexts, MOVE_CONTROL *psMove, PATHJOB *psJob)
 {
 	ASR_RETVAL      retval = ASR_OK;
 
@@ -453,7 +325,7 @@ ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
 
 	PathCoord endCoord;  // Either nearest coord (mustReverse = true) or orig (mustReverse = false).
 
-	std::list<PathfindContext>::iterator contextIterator = fpathContexts.begin();
+	PathfindContextList::iterator contextIterator = fpathContexts.begin();
 	for (contextIterator = fpathContexts.begin(); contextIterator != fpathContexts.end(); ++contextIterator)
 	{
 		if (!contextIterator->matches(psJob->blockingMap, tileDest, dstIgnore))
@@ -497,10 +369,24 @@ ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
 		}
 		--contextIterator;
 
+		// For long routes, plan the route on the cluster graph first, and only search the tiles near that route.
+		std::vector<bool> corridor;
+		if (psJob->clusterGraph != nullptr && !fpathClusterCorridor(*psJob->clusterGraph, *psJob->blockingMap, tileOrig, tileDest, dstIgnore, corridor))
+		{
+			corridor.clear();
+		}
+		bool usedCorridor = !corridor.empty();
+
 		// Init a new context, overwriting the oldest one if we are caching too many.
 		// We will be searching from orig to dest, since we don't know where the nearest reachable tile to dest is.
-		fpathInitContext(*contextIterator, psJob->blockingMap, tileOrig, tileOrig, tileDest, dstIgnore);
+		fpathInitContext(*contextIterator, psJob->blockingMap, tileOrig, tileOrig, tileDest, dstIgnore, std::move(corridor));
 		endCoord = fpathAStarExplore(*contextIterator, tileDest);
+		if (usedCorridor && endCoord != tileDest)
+		{
+			// The cluster graph found a route, but the tile A* could not follow it within the corridor. Search the whole map instead.
+			fpathInitContext(*contextIterator, psJob->blockingMap, tileOrig, tileOrig, tileDest, dstIgnore, std::vector<bool>());
+			endCoord = fpathAStarExplore(*contextIterator, tileDest);
+		}
 		contextIterator->nearestCoord = endCoord;
 	}
 
@@ -513,8 +399,7 @@ ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
 	}
 
 	// Get route, in reverse order.
-	static std::vector<Vector2i> path;  // Declared static to save allocations.
-	path.clear();
+	std::vector<Vector2i> path;
 
 	Vector2i newP(0, 0);
 	for (Vector2i p(world_coord(endCoord.x) + TILE_UNITS / 2, world_coord(endCoord.y) + TILE_UNITS / 2); true; p = newP)
@@ -578,7 +463,8 @@ ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
 		if (!context.isBlocked(tileOrig.x, tileOrig.y))  // If blocked, searching from tileDest to tileOrig wouldn't find the tileOrig tile.
 		{
 			// Next time, search starting from nearest reachable tile to the destination.
-			fpathInitContext(context, psJob->blockingMap, tileDest, context.nearestCoord, tileOrig, dstIgnore);
+			// The corridor was planned for this job's origin, so later jobs from other origins must not be limited to it.
+			fpathInitContext(context, psJob->blockingMap, tileDest, context.nearestCoord, tileOrig, dstIgnore, std::vector<bool>());
 		}
 	}
 	else
@@ -598,6 +484,102 @@ ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob)
 	return retval;
 }
 
+/// Calculates the blocking (and danger) bits of the tiles x1 <= x <= x2, y1 <= y <= y2.
+static void fpathCalculateBlockingTiles(PathBlockingMap &blockMap, int x1, int y1, int x2, int y2, bool blocking, bool danger)
+{
+	PathBlockingType const &type = blockMap.type;
+	for (int y = std::max(y1, 0); y <= std::min(y2, mapHeight - 1); ++y)
+	{
+		for (int x = std::max(x1, 0); x <= std::min(x2, mapWidth - 1); ++x)
+		{
+			if (blocking)
+			{
+				blockMap.map.set(x, y, fpathBaseBlockingTile(x, y, type.propulsion, type.owner, type.moveType));
+			}
+			if (danger)
+			{
+				blockMap.dangerMap.set(x, y, auxTile(x, y, type.owner) & AUXBITS_THREAT);
+			}
+		}
+	}
+}
+
+/// Fills in blockMap, by copying the latest map of the same kind and recalculating just the tiles which changed since then, if possible.
+static void fpathCalculateBlockingMap(std::shared_ptr<PathBlockingMap> const &blockMapPtr)
+{
+	PathBlockingMap &blockMap = *blockMapPtr;
+	PathBlockingType const &type = blockMap.type;
+	bool needDanger = !isHumanPlayer(type.owner) && type.moveType == FMT_MOVE;
+
+	// Air units share blocking maps between players, but the danger map depends on the owner, so match the owner too.
+	auto cache = std::find_if(fpathBlockingCaches.begin(), fpathBlockingCaches.end(), [&](PathBlockingCache const &c) {
+		PathBlockingType const &cType = c.latest->type;
+		return cType.owner == type.owner && fpathIsEquivalentBlocking(cType.propulsion, cType.owner, cType.moveType, type.propulsion, type.owner, type.moveType);
+	});
+	if (cache == fpathBlockingCaches.end())
+	{
+		if (fpathBlockingCaches.size() >= PATH_BLOCKING_CACHE_SIZE)
+		{
+			fpathBlockingCaches.pop_back();
+		}
+		fpathBlockingCaches.emplace_front();
+	}
+	else
+	{
+		fpathBlockingCaches.splice(fpathBlockingCaches.begin(), fpathBlockingCaches, cache);
+	}
+	cache = fpathBlockingCaches.begin();
+
+	uint8_t const *auxMap = psAuxMap[type.owner];
+	bool sameMap = cache->latest != nullptr && cache->width == mapWidth && cache->height == mapHeight
+	               && cache->scrollMinX == scrollMinX && cache->scrollMinY == scrollMinY && cache->scrollMaxX == scrollMaxX && cache->scrollMaxY == scrollMaxY
+	               && cache->blockMap == psBlockMap[0] && cache->auxMap == auxMap;
+	size_t numDirty = 0;
+	AuxDirtyRect const *dirty = sameMap ? auxDirtyRects(cache->dirtySequence, &numDirty) : nullptr;
+	if (dirty != nullptr)
+	{
+		// Only the tiles in the dirty areas can have changed. If no path job still uses the latest map, take its bits instead of copying them.
+		bool steal = cache->latest.use_count() == 1;
+		PathBlockingMap &latest = *cache->latest;
+		blockMap.map = steal ? std::move(latest.map) : latest.map;
+		bool copyDanger = needDanger && !latest.dangerMap.empty() && cache->threatChanges == auxThreatChanges(type.owner);
+		if (copyDanger)
+		{
+			blockMap.dangerMap = steal ? std::move(latest.dangerMap) : latest.dangerMap;
+		}
+		else if (needDanger)
+		{
+			blockMap.dangerMap.resize(mapWidth, mapHeight);
+			fpathCalculateBlockingTiles(blockMap, 0, 0, mapWidth - 1, mapHeight - 1, false, true);
+		}
+		for (size_t i = 0; i < numDirty; ++i)
+		{
+			fpathCalculateBlockingTiles(blockMap, dirty[i].x1, dirty[i].y1, dirty[i].x2, dirty[i].y2, true, copyDanger);
+		}
+	}
+	else
+	{
+		blockMap.map.resize(mapWidth, mapHeight);
+		if (needDanger)
+		{
+			blockMap.dangerMap.resize(mapWidth, mapHeight);
+		}
+		fpathCalculateBlockingTiles(blockMap, 0, 0, mapWidth - 1, mapHeight - 1, true, needDanger);
+	}
+
+	cache->latest = blockMapPtr;
+	cache->dirtySequence = auxDirtySequence();
+	cache->threatChanges = auxThreatChanges(type.owner);
+	cache->width = mapWidth;
+	cache->height = mapHeight;
+	cache->scrollMinX = scrollMinX;
+	cache->scrollMinY = scrollMinY;
+	cache->scrollMaxX = scrollMaxX;
+	cache->scrollMaxY = scrollMaxY;
+	cache->blockMap = psBlockMap[0];
+	cache->auxMap = auxMap;
+}
+
 void fpathSetBlockingMap(PATHJOB *psJob)
 {
 	if (fpathCurrentGameTime != gameTime)
@@ -626,27 +608,8 @@ void fpathSetBlockingMap(PATHJOB *psJob)
 
 		// blockMap now points to an empty map with no data. Fill the map.
 		blockMap->type = type;
-		std::vector<bool> &map = blockMap->map;
-		map.resize(static_cast<size_t>(mapWidth) * static_cast<size_t>(mapHeight));
-		uint32_t checksumMap = 0, checksumDangerMap = 0, factor = 0;
-		for (int y = 0; y < mapHeight; ++y)
-			for (int x = 0; x < mapWidth; ++x)
-			{
-				map[x + y * mapWidth] = fpathBaseBlockingTile(x, y, type.propulsion, type.owner, type.moveType);
-				checksumMap ^= map[x + y * mapWidth] * (factor = 3 * factor + 1);
-			}
-		if (!isHumanPlayer(type.owner) && type.moveType == FMT_MOVE)
-		{
-			std::vector<bool> &dangerMap = blockMap->dangerMap;
-			dangerMap.resize(static_cast<size_t>(mapWidth) * static_cast<size_t>(mapHeight));
-			for (int y = 0; y < mapHeight; ++y)
-				for (int x = 0; x < mapWidth; ++x)
-				{
-					dangerMap[x + y * mapWidth] = auxTile(x, y, type.owner) & AUXBITS_THREAT;
-					checksumDangerMap ^= dangerMap[x + y * mapWidth] * (factor = 3 * factor + 1);
-				}
-		}
-		syncDebug("blockingMap(%d,%d,%d,%d) = %08X %08X", gameTime, psJob->propulsion, psJob->owner, psJob->moveType, checksumMap, checksumDangerMap);
+		fpathCalculateBlockingMap(fpathBlockingMaps.back());
+		syncDebug("blockingMap(%d,%d,%d,%d) = %08X %08X", gameTime, psJob->propulsion, psJob->owner, psJob->moveType, blockMap->map.checksum(), blockMap->dangerMap.checksum());
 
 		psJob->blockingMap = fpathBlockingMaps.back();
 	}
@@ -656,4 +619,13 @@ void fpathSetBlockingMap(PATHJOB *psJob)
 
 		psJob->blockingMap = *i;
 	}
+
+	// Long routes get planned on the cluster graph first. Skip maps with danger costs, which the cluster graph doesn't know about.
+	psJob->clusterGraph = nullptr;
+	PathCoord tileOrig(map_coord(psJob->origX), map_coord(psJob->origY));
+	PathCoord tileDest(map_coord(psJob->destX), map_coord(psJob->destY));
+	if (psJob->propulsion != PROPULSION_TYPE_LIFT && psJob->blockingMap->dangerMap.empty() && fpathClusterRouteIsLong(tileOrig, tileDest))
+	{
+		psJob->clusterGraph = fpathClusterGraph(psJob->blockingMap);
+	}
 }
@@ -22,6 +22,13 @@
 #define __INCLUDED_SRC_ASTART_H__
 
 #include "fpath.h"
+#include "map.h"
+#include "pathcluster.h"
+
+#include <array>
+#include <list>
+#include <vector>
+#include <memory>
 
 /** return codes for astar
  *
@@ -34,17 +41,273 @@ enum ASR_RETVAL
 	ASR_NEAREST,    ///< found a partial route to a nearby position
 };
 
+/// A coordinate.
+struct PathCoord
+{
+	PathCoord() {}
+	PathCoord(int16_t x_, int16_t y_) : x(x_), y(y_) {}
+	bool operator ==(PathCoord const &z) const
+	{
+		return x == z.x && y == z.y;
+	}
+	bool operator !=(PathCoord const &z) const
+	{
+		return !(*this == z);
+	}
+
+	int16_t x, y;
+};
+
+/** The structure to store a node of the route in node table
+ *
+ *  @ingroup pathfinding
+ */
+struct PathNode
+{
+	bool operator <(PathNode const &z) const
+	{
+		// Sort descending est, fallback to ascending dist, fallback to sorting by position.
+		if (est  != z.est)
+		{
+			return est  > z.est;
+		}
+		if (dist != z.dist)
+		{
+			return dist < z.dist;
+		}
+		if (p.x  != z.p.x)
+		{
+			return p.x  < z.p.x;
+		}
+		return p.y  < z.p.y;
+	}
+
+	PathCoord p;                    // Map coords.
+	unsigned  dist, est;            // Distance so far and estimate to end.
+};
+struct PathExploredTile
+{
+	PathExploredTile() : iteration(0xFFFF), dx(0), dy(0), dist(0), visited(false) {}
+
+	uint16_t iteration;
+	int8_t   dx, dy;                // Offset from previous point in the route.
+	unsigned dist;                  // Shortest known distance to tile.
+	bool     visited;
+};
+
+struct PathBlockingType
+{
+	uint32_t gameTime;
+
+	PROPULSION_TYPE propulsion;
+	int owner;
+	FPATH_MOVETYPE moveType;
+};
+/** One bit per map tile. Each row is padded to a whole number of 64-bit words, so that a row can be scanned
+ *  (or copied) a word at a time instead of a tile at a time. Padding bits are always 0.
+ */
+struct PathBitmap
+{
+	void resize(int width_, int height_)
+	{
+		width = width_;
+		height = height_;
+		wordsPerRow = (width + 63) / 64;
+		words.assign(static_cast<size_t>(wordsPerRow) * static_cast<size_t>(height), 0);
+	}
+	bool empty() const
+	{
+		return words.empty();
+	}
+	bool get(int x, int y) const
+	{
+		return (words[static_cast<size_t>(y) * wordsPerRow + x / 64] >> (x % 64)) & 1;
+	}
+	void set(int x, int y, bool value)
+	{
+		uint64_t &word = words[static_cast<size_t>(y) * wordsPerRow + x / 64];
+		uint64_t bit = uint64_t(1) << (x % 64);
+		word = value ? word | bit : word & ~bit;
+	}
+	/// Returns count (at most 64) bits of row y, starting at tile x. Tiles past the end of the row are 0.
+	uint64_t bits(int x, int y, int count) const
+	{
+		uint64_t const *row = &words[static_cast<size_t>(y) * wordsPerRow];
+		unsigned shift = x % 64;
+		uint64_t ret = row[x / 64] >> shift;
+		if (shift != 0 && x / 64 + 1 < wordsPerRow)
+		{
+			ret |= row[x / 64 + 1] << (64 - shift);
+		}
+		return count < 64 ? ret & ((uint64_t(1) << count) - 1) : ret;
+	}
+	/// Returns a bit for each of the 8 neighbours of tile (x, y), set if the neighbour is set or off the map.
+	/// Bit n is the direction n in the A* direction order, (0, 1), (-1, 1), (-1, 0), (-1, -1), (0, -1), (1, -1), (1, 0), (1, 1).
+	unsigned neighbours(int x, int y) const
+	{
+		return neighbourTable()[triple(x, y - 1) | triple(x, y) << 3 | triple(x, y + 1) << 6];
+	}
+	/// Cheap hash of the whole bitmap, for sync logs.
+	uint32_t checksum() const
+	{
+		uint64_t sum = 0;
+		for (uint64_t word : words)
+		{
+			sum = (sum ^ word) * 0x100000001B3ULL;
+		}
+		return static_cast<uint32_t>(sum ^ sum >> 32);
+	}
+
+	int width = 0;
+	int height = 0;
+	int wordsPerRow = 0;
+	std::vector<uint64_t> words;
+
+private:
+	/// Bits for tiles x - 1, x and x + 1 of row y. Tiles off the map are set.
+	unsigned triple(int x, int y) const
+	{
+		if (y < 0 || y >= height)
+		{
+			return 7;
+		}
+		unsigned ret = x > 0 ? bits(x - 1, y, 3) : 1 | (bits(0, y, 2) << 1);
+		return x + 1 >= width ? ret | 4 : ret;
+	}
+	/// Maps three rows of tile triples to the A* direction order of neighbours.
+	static uint8_t const *neighbourTable()
+	{
+		static const std::array<uint8_t, 512> table = [] {
+			static const int dirOffset[8][2] = {{0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}};
+			std::array<uint8_t, 512> t;
+			for (unsigned i = 0; i < 512; ++i)
+			{
+				// Row above (dy = -1) is bits 0-2, this row bits 3-5, row below (dy = +1) bits 6-8, left to right.
+				t[i] = 0;
+				for (unsigned dir = 0; dir < 8; ++dir)
+				{
+					t[i] |= ((i >> ((dirOffset[dir][1] + 1) * 3 + dirOffset[dir][0] + 1)) & 1) << dir;
+				}
+			}
+			return t;
+		}();
+		return table.data();
+	}
+};
+
+/// Pathfinding blocking map
+struct PathBlockingMap
+{
+	bool operator ==(PathBlockingType const &z) const
+	{
+		return type.gameTime == z.gameTime &&
+		       fpathIsEquivalentBlocking(type.propulsion, type.owner, type.moveType,
+		                                 z.propulsion,    z.owner,    z.moveType);
+	}
+
+	PathBlockingType type;
+	PathBitmap map;
+	PathBitmap dangerMap;	// using threatBits
+};
+
+struct PathNonblockingArea
+{
+	PathNonblockingArea() {}
+	PathNonblockingArea(StructureBounds const &st) : x1(st.map.x), x2(st.map.x + st.size.x), y1(st.map.y), y2(st.map.y + st.size.y) {}
+	bool operator ==(PathNonblockingArea const &z) const
+	{
+		return x1 == z.x1 && x2 == z.x2 && y1 == z.y1 && y2 == z.y2;
+	}
+	bool operator !=(PathNonblockingArea const &z) const
+	{
+		return !(*this == z);
+	}
+	bool isNonblocking(int x, int y) const
+	{
+		return x >= x1 && x < x2 && y >= y1 && y < y2;
+	}
+
+	int16_t x1 = 0;
+	int16_t x2 = 0;
+	int16_t y1 = 0;
+	int16_t y2 = 0;
+};
+
+// Data structures used for pathfinding, can contain cached results.
+struct PathfindContext
+{
+	PathfindContext() : myGameTime(0), iteration(0), blockingMap(nullptr) {}
+	bool isBlocked(int x, int y) const
+	{
+		if (dstIgnore.isNonblocking(x, y))
+		{
+			return false;  // The path is actually blocked here by a structure, but ignore it since it's where we want to go (or where we came from).
+		}
+		// Not sure whether the out-of-bounds check is needed, can only happen if pathfinding is started on a blocking tile (or off the map).
+		return x < 0 || y < 0 || x >= mapWidth || y >= mapHeight || blockingMap->map.get(x, y) ||
+		       (!corridor.empty() && !corridor[x / PATH_CLUSTER_SIZE + y / PATH_CLUSTER_SIZE * fpathClusterMapWidth(mapWidth)]);
+	}
+	bool isDangerous(int x, int y) const
+	{
+		return !blockingMap->dangerMap.empty() && blockingMap->dangerMap.get(x, y);
+	}
+	bool matches(std::shared_ptr<PathBlockingMap> &blockingMap_, PathCoord tileS_, PathNonblockingArea dstIgnore_) const
+	{
+		// Must check myGameTime == blockingMap_->type.gameTime, otherwise blockingMap could be a deleted pointer which coincidentally compares equal to the valid pointer blockingMap_.
+		return myGameTime == blockingMap_->type.gameTime && blockingMap == blockingMap_ && tileS == tileS_ && dstIgnore == dstIgnore_;
+	}
+	void assign(std::shared_ptr<PathBlockingMap> &blockingMap_, PathCoord tileS_, PathNonblockingArea dstIgnore_, std::vector<bool> corridor_)
+	{
+		blockingMap = blockingMap_;
+		tileS = tileS_;
+		dstIgnore = dstIgnore_;
+		corridor = std::move(corridor_);
+		myGameTime = blockingMap->type.gameTime;
+		nodes.clear();
+
+		// Make the iteration not match any value of iteration in map.
+		if (++iteration == 0xFFFF)
+		{
+			map.clear();  // There are no values of iteration guaranteed not to exist in map, so clear the map.
+			iteration = 0;
+		}
+		map.resize(static_cast<size_t>(mapWidth) * static_cast<size_t>(mapHeight));  // Allocate space for map, if needed.
+	}
+
+	PathCoord       tileS;                // Start tile for pathfinding. (May be either source or target tile.)
+	uint32_t        myGameTime;
+
+	PathCoord       nearestCoord;         // Nearest reachable tile to destination.
+
+	/** Counter to implement lazy deletion from map.
+	 *
+	 *  @see fpathTableReset
+	 */
+	uint16_t        iteration;
+
+	std::vector<PathNode> nodes;        ///< Edge of explored region of the map.
+	std::vector<PathExploredTile> map;  ///< Map, with paths leading back to tileS.
+	std::shared_ptr<PathBlockingMap> blockingMap; ///< Map of blocking tiles for the type of object which needs a path.
+	PathNonblockingArea dstIgnore;      ///< Area of structure at destination which should be considered nonblocking.
+	std::vector<bool> corridor;         ///< If not empty, clusters outside the route planned by fpathClusterCorridor are considered blocking.
+};
+
+/// Last recently used list of contexts. Each path thread owns its own list, the contexts are not thread safe.
+typedef std::list<PathfindContext> PathfindContextList;
+
 /** Use the A* algorithm to find a path
+ *
+ *  @param fpathContexts Cached contexts, which may be reused if a previous job had the same destination. Only one thread at a time may use a given list.
  *
  *  @ingroup pathfinding
  */
-ASR_RETVAL fpathAStarRoute(MOVE_CONTROL *psMove, PATHJOB *psJob);
+ASR_RETVAL fpathAStarRoute(PathfindContextList &fpathContexts, MOVE_CONTROL *psMove, PATHJOB *psJob);
 
 /// Call from main thread.
 /// Sets psJob->blockingMap for later use by pathfinding thread, generating the required map if not already generated.
 void fpathSetBlockingMap(PATHJOB *psJob);
 
-/** Clean up the path finding node table.
+/** Clean up the cached blocking maps. The per-thread context lists must be cleared by their owners.
  *
  *  @note Call this on shutdown to prevent memory from leaking, or if loading/saving, to prevent stale data from being reused.
  *
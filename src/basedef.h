@@ -116,6 +116,8 @@ struct BASE_OBJECT : public SIMPLE_OBJECT
 	UBYTE               selected;                   ///< Whether the object is selected (might want this elsewhere)
 	UBYTE               visible[MAX_PLAYERS];       ///< Whether object is visible to specific player
 	UBYTE               seenThisTick[MAX_PLAYERS];  ///< Whether object has been seen this tick by the specific player.
+	uint32_t            gridIndex = UINT32_MAX;     ///< Where the map grid keeps track of the object, see gridReset.
+	uint32_t            indexedId = 0;              ///< Id the object is known by in the object id index, 0 if not indexed, see getBaseObjFromId.
 	UDWORD              lastEmission;               ///< When did it last puff out smoke?
 	WEAPON_SUBCLASS     lastHitWeapon;              ///< The weapon that last hit it
 	UDWORD              timeLastHit;                ///< The time the structure was last attacked
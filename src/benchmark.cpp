@@ -0,0 +1,155 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file benchmark.cpp
+ * Simulation benchmark, see benchmark.h.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/framework/crc.h"
+#include "lib/gamelib/gtime.h"
+#include "lib/netplay/netplay.h"
+
+#include "benchmark.h"
+
+#include <chrono>
+
+using benchmarkClock = std::chrono::steady_clock;
+
+static const char *const benchmarkStageNames[BENCHMARK_STAGE_COUNT] =
+{
+	"other",
+	"scripts",
+	"grid",
+	"visibility",
+	"pathfinding",
+	"droids",
+	"structures",
+	"projectiles",
+	"features",
+	"objmem",
+};
+
+static bool benchmarkRequested = false;
+static bool benchmarkRunning = false;              ///< True while inside a timed gameStateUpdate.
+static unsigned benchmarkTicks = 0;                ///< Number of ticks to run.
+static unsigned benchmarkTicksDone = 0;
+static BENCHMARK_STAGE benchmarkCurrentStage = BENCHMARK_OTHER;
+static benchmarkClock::time_point benchmarkStageStart;
+static benchmarkClock::time_point benchmarkStartTime;
+static benchmarkClock::duration benchmarkStageTimes[BENCHMARK_STAGE_COUNT];
+static benchmarkClock::duration benchmarkMaxTickTime;
+static benchmarkClock::time_point benchmarkTickStart;
+static uint32_t benchmarkFirstGameTime = 0;
+static uint32_t benchmarkCrc = 0xFFFFFFFF;         ///< CRC of the sync debug CRCs of all the ticks.
+static uint32_t benchmarkSeed = 1;                 ///< Seed of the synchronised random numbers, fixed so that every run simulates the same game.
+
+void benchmarkEnable(unsigned ticks)
+{
+	benchmarkRequested = true;
+	benchmarkTicks = ticks;
+}
+
+bool benchmarkEnabled()
+{
+	return benchmarkRequested;
+}
+
+void benchmarkSetRandomSeed(uint32_t seed)
+{
+	benchmarkSeed = seed;
+}
+
+uint32_t benchmarkRandomSeed()
+{
+	return benchmarkSeed;
+}
+
+bool benchmarkTicksLeft()
+{
+	return benchmarkRequested && benchmarkTicksDone < benchmarkTicks;
+}
+
+void benchmarkTickBegin()
+{
+	benchmarkTickStart = benchmarkClock::now();
+	if (benchmarkTicksDone == 0)
+	{
+		benchmarkStartTime = benchmarkTickStart;
+		benchmarkFirstGameTime = gameTime;
+	}
+	benchmarkRunning = true;
+	benchmarkCurrentStage = BENCHMARK_OTHER;
+	benchmarkStageStart = benchmarkTickStart;
+}
+
+void benchmarkTickEnd()
+{
+	benchmarkStage(BENCHMARK_OTHER);
+	benchmarkRunning = false;
+	benchmarkMaxTickTime = std::max(benchmarkMaxTickTime, benchmarkStageStart - benchmarkTickStart);
+	++benchmarkTicksDone;
+
+	// The sync debug CRC so far covers everything logged with syncDebug during this tick. Add it a byte at a time, so the result doesn't depend on endianness.
+	uint32_t tickCrc = syncDebugGetCrc();
+	uint8_t bytes[4] = {uint8_t(tickCrc >> 24), uint8_t(tickCrc >> 16), uint8_t(tickCrc >> 8), uint8_t(tickCrc)};
+	benchmarkCrc = crcSum(benchmarkCrc, bytes, sizeof(bytes));
+}
+
+void benchmarkStage(BENCHMARK_STAGE stage)
+{
+	if (!benchmarkRunning)
+	{
+		return;
+	}
+	benchmarkClock::time_point now = benchmarkClock::now();
+	benchmarkStageTimes[benchmarkCurrentStage] += now - benchmarkStageStart;
+	benchmarkCurrentStage = stage;
+	benchmarkStageStart = now;
+}
+
+static uint64_t benchmarkMicroseconds(benchmarkClock::duration time)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+
+void benchmarkReport()
+{
+	if (benchmarkTicksDone == 0)
+	{
+		debug(LOG_INFO, "Benchmark: no game ticks were run");
+		return;
+	}
+
+	benchmarkClock::duration total = benchmarkClock::duration::zero();
+	for (benchmarkClock::duration time : benchmarkStageTimes)
+	{
+		total += time;
+	}
+	debug(LOG_INFO, "Benchmark: %u ticks (gameTime %u to %u) in %" PRIu64 " ms wall time, %" PRIu64 " ms updating, %" PRIu64 " us per tick on average, %" PRIu64 " us at most",
+	      benchmarkTicksDone, benchmarkFirstGameTime, gameTime, benchmarkMicroseconds(benchmarkClock::now() - benchmarkStartTime) / 1000, benchmarkMicroseconds(total) / 1000,
+	      benchmarkMicroseconds(total) / benchmarkTicksDone, benchmarkMicroseconds(benchmarkMaxTickTime));
+	for (int stage = 0; stage < BENCHMARK_STAGE_COUNT; ++stage)
+	{
+		uint64_t time = benchmarkMicroseconds(benchmarkStageTimes[stage]);
+		debug(LOG_INFO, "Benchmark: %-12s %8" PRIu64 " ms, %6" PRIu64 " us per tick, %5.1f%%", benchmarkStageNames[stage], time / 1000, time / benchmarkTicksDone,
+		      total.count() > 0 ? 100. * benchmarkStageTimes[stage].count() / total.count() : 0.);
+	}
+	debug(LOG_INFO, "Benchmark: sync CRC 0x%08X, random seed %u", benchmarkCrc, benchmarkSeed);
+}
@@ -0,0 +1,72 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Simulation benchmark, started with --benchmark.
+ *
+ *  Runs a given number of game state updates back to back, without rendering in between, timing the
+ *  stages of gameStateUpdate. At the end, the times and a CRC of the sync debug output of all the ticks
+ *  are logged, and the game quits. Used with --autogame and --skirmish, the CRC must be the same on every
+ *  run, so it shows whether a change to the simulation changed the outcome. For that, the synchronised random
+ *  numbers always start from the same seed when benchmarking, which can be changed with --benchmarkseed.
+ */
+
+#ifndef __INCLUDED_SRC_BENCHMARK_H__
+#define __INCLUDED_SRC_BENCHMARK_H__
+
+/// Stages of gameStateUpdate, timed separately.
+enum BENCHMARK_STAGE
+{
+	BENCHMARK_OTHER,
+	BENCHMARK_SCRIPTS,
+	BENCHMARK_GRID,
+	BENCHMARK_VISIBILITY,
+	BENCHMARK_PATHFINDING,          ///< Map updates and handing out path finding jobs.
+	BENCHMARK_DROIDS,
+	BENCHMARK_STRUCTURES,
+	BENCHMARK_PROJECTILES,
+	BENCHMARK_FEATURES,
+	BENCHMARK_OBJMEM,
+	BENCHMARK_STAGE_COUNT
+};
+
+/// Call from the command line parser. Runs the benchmark for the given number of ticks, once the game starts.
+void benchmarkEnable(unsigned ticks);
+
+/// Returns true if a benchmark was requested.
+bool benchmarkEnabled();
+
+/// Call from the command line parser. Sets the seed of the synchronised random numbers for the benchmark.
+void benchmarkSetRandomSeed(uint32_t seed);
+/// Returns the seed of the synchronised random numbers to use when benchmarking.
+uint32_t benchmarkRandomSeed();
+
+/// Returns true if there are ticks left to run.
+bool benchmarkTicksLeft();
+
+/// Call before and after each gameStateUpdate.
+void benchmarkTickBegin();
+void benchmarkTickEnd();
+
+/// Starts timing the given stage, the time since the previous call is counted for the previous stage. Does nothing unless benchmarking.
+void benchmarkStage(BENCHMARK_STAGE stage);
+
+/// Logs the results.
+void benchmarkReport();
+
+#endif // __INCLUDED_SRC_BENCHMARK_H__
@@ -25,10 +25,12 @@
  */
 
 #include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
 #include "lib/ivis_opengl/screen.h"
 #include "lib/netplay/netplay.h"
 #include "lib/ivis_opengl/pieclip.h"
 
+#include "benchmark.h"
 #include "levels.h"
 #include "clparse.h"
 #include "display3d.h"
@@ -38,6 +40,7 @@
 #include "main.h"
 #include "modding.h"
 #include "multiplay.h"
+#include "qtscript.h"
 #include "version.h"
 #include "warzoneconfig.h"
 #include "wrappers.h"
@@ -81,6 +84,8 @@ static bool wz_autogame = false;
 static std::string wz_saveandquit;
 static std::string wz_test;
 static std::string wz_autoratingUrl;
+static std::string wz_replay;
+static unsigned wz_replayskip = 0;
 
 static void poptPrintHelp(poptContext ctx, FILE *output)
 {
@@ -257,6 +262,14 @@ typedef enum
 	CLI_CONTINUE,
 	CLI_AUTOHOST,
 	CLI_AUTORATING,
+	CLI_BENCHMARK,
+	CLI_BENCHMARKSEED,
+	CLI_REPLAY,
+	CLI_REPLAYSKIP,
+	CLI_HEADLESS,
+	CLI_GAMEPORT,
+	CLI_NETSTATS,
+	CLI_SCRIPTPROFILE,
 } CLI_OPTIONS;
 
 static const struct poptOption *getOptionsTable()
@@ -312,6 +325,14 @@ static const struct poptOption *getOptionsTable()
 		{ "continue", POPT_ARG_NONE, CLI_CONTINUE,   N_("Continue the last saved game"), nullptr },
 		{ "autohost", POPT_ARG_STRING, CLI_AUTOHOST,   N_("Start host game with given settings file"), N_("autohost") },
 		{ "autorating", POPT_ARG_STRING, CLI_AUTORATING,   N_("Query ratings from given server url (containing \"{HASH}\"), when hosting"), N_("autorating") },
+		{ "benchmark", POPT_ARG_STRING, CLI_BENCHMARK,   N_("Run the given number of game ticks without rendering, log the time taken and quit (use with --autogame and --skirmish)"), N_("ticks") },
+		{ "benchmarkseed", POPT_ARG_STRING, CLI_BENCHMARKSEED,   N_("Use the given seed for the synchronised random numbers when benchmarking, instead of 1"), N_("seed") },
+		{ "replay", POPT_ARG_STRING, CLI_REPLAY,   N_("Play back the given replay file from replay/multiplay/"), N_("replay") },
+		{ "replayskip", POPT_ARG_STRING, CLI_REPLAYSKIP,   N_("Skip rendering until the given number of game ticks of the replay have run, quitting if the replay ends first"), N_("ticks") },
+		{ "headless", POPT_ARG_NONE, CLI_HEADLESS,   N_("Run without a window, rendering or audio, quitting when the game ends (use with --autohost, --skirmish or --replay)"), nullptr },
+		{ "gameport", POPT_ARG_STRING, CLI_GAMEPORT,   N_("Host games on the given port"), N_("port") },
+		{ "netstats", POPT_ARG_STRING, CLI_NETSTATS,   N_("Write network statistics to logs/ as JSON every given number of seconds"), N_("seconds") },
+		{ "scriptprofile", POPT_ARG_NONE, CLI_SCRIPTPROFILE,   N_("Profile the scripts, writing the time and memory each script function took to logs/ as JSON at the end of the game"), nullptr },
 		// Terminating entry
 		{ nullptr, 0, 0,              nullptr,                                    nullptr },
 	};
@@ -748,9 +769,93 @@ bool ParseCommandLine(int argc, const char * const *argv)
 			}
 			wz_autoratingUrl = token;
 			debug(LOG_INFO, "Using \"%s\" for ratings.", wz_autoratingUrl.c_str());
+			break;
+
+		case CLI_BENCHMARK:
+			{
+				token = poptGetOptArg(poptCon);
+				unsigned ticks = 0;
+				if (token == nullptr || sscanf(token, "%u", &ticks) != 1 || ticks == 0)
+				{
+					qFatal("Bad number of benchmark ticks");
+				}
+				benchmarkEnable(ticks);
+				break;
+			}
+
+		case CLI_BENCHMARKSEED:
+			{
+				token = poptGetOptArg(poptCon);
+				unsigned seed = 0;
+				if (token == nullptr || sscanf(token, "%u", &seed) != 1)
+				{
+					qFatal("Bad benchmark random seed");
+				}
+				benchmarkSetRandomSeed(seed);
+				break;
+			}
+
+		case CLI_REPLAY:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr)
+			{
+				qFatal("Missing replay name");
+			}
+			wz_replay = token;
+			if (wz_replay.find('/') == std::string::npos)
+			{
+				wz_replay = "replay/multiplay/" + wz_replay;
+			}
+			break;
+
+		case CLI_REPLAYSKIP:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || sscanf(token, "%u", &wz_replayskip) != 1)
+			{
+				qFatal("Bad number of replay ticks to skip");
+			}
+			break;
+
+		case CLI_HEADLESS:
+			wzSetHeadless(true);
+			break;
+
+		case CLI_GAMEPORT:
+			{
+				token = poptGetOptArg(poptCon);
+				unsigned port = 0;
+				if (token == nullptr || sscanf(token, "%u", &port) != 1 || port == 0 || port > 65535)
+				{
+					qFatal("Bad game port");
+				}
+				NETsetGameserverPort(port);
+				break;
+			}
+
+		case CLI_NETSTATS:
+			{
+				token = poptGetOptArg(poptCon);
+				unsigned seconds = 0;
+				if (token == nullptr || sscanf(token, "%u", &seconds) != 1 || seconds == 0)
+				{
+					qFatal("Bad number of seconds between network statistics");
+				}
+				NETsetStatisticsInterval(seconds);
+				break;
+			}
+
+		case CLI_SCRIPTPROFILE:
+			scriptSetProfiling(true);
+			break;
 		};
 	}
 
+	if (wzIsHeadless() && hostlaunch == HostLaunch::Normal && wz_replay.empty())
+	{
+		// Without a window, there would be no way to get past the title screen.
+		qFatal("--headless needs --autohost, --skirmish or --replay");
+	}
+
 	return true;
 }
 
@@ -769,6 +874,16 @@ const std::string &wz_skirmish_test()
 	return wz_test;
 }
 
+const std::string &wz_replay_file()
+{
+	return wz_replay;
+}
+
+unsigned wz_replay_skip_ticks()
+{
+	return wz_replayskip;
+}
+
 std::string autoratingUrl(std::string const &hash) {
 	auto url = wz_autoratingUrl;
 	auto h = wz_autoratingUrl.find_first_of("{HASH}");
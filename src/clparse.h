@@ -31,6 +31,8 @@ bool ParseCommandLineEarly(int argc, const char * const *argv);
 bool autogame_enabled();
 const std::string &saveandquit_enabled();
 const std::string &wz_skirmish_test();
+const std::string &wz_replay_file();
+unsigned wz_replay_skip_ticks();
 std::string autoratingUrl(std::string const &hash);
 
 #endif // __INCLUDED_SRC_CLPARSE_H__
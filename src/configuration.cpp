@@ -50,6 +50,7 @@
 #include "ingameop.h"
 #include "multiint.h"
 #include "multiplay.h"
+#include "qtscript.h"
 #include "radar.h"
 #include "seqdisp.h"
 #include "texture.h"
@@ -154,6 +155,8 @@ bool loadConfig()
 	radarRotationArrow = ini.value("radarRotationArrow", true).toBool();
 	hostQuitConfirmation = ini.value("hostQuitConfirmation", true).toBool();
 	war_SetPauseOnFocusLoss(ini.value("PauseOnFocusLoss", false).toBool());
+	war_SetRecordReplays(ini.value("recordReplays", false).toBool());
+	war_SetMaxReplays(ini.value("maxReplays", 20).toInt());
 	NETsetMasterserverName(ini.value("masterserver_name", "lobby.wz2100.net").toString().toUtf8().constData());
 	mpSetServerName(ini.value("server_name").toString().toUtf8().constData());
 	iV_font(ini.value("fontname", "DejaVu Sans").toString().toUtf8().constData(),
@@ -161,6 +164,7 @@ bool loadConfig()
 	        ini.value("fontfacebold", "Bold").toString().toUtf8().constData());
 	NETsetMasterserverPort(ini.value("masterserver_port", MASTERSERVERPORT).toInt());
 	NETsetGameserverPort(ini.value("gameserver_port", GAMESERVERPORT).toInt());
+	NETsetFileTransferWindow(ini.value("file_transfer_window_kib", NETgetFileTransferWindow() / 1024).toUInt() * 1024);
 	NETsetJoinPreferenceIPv6(ini.value("prefer_ipv6", true).toBool());
 	setPublicIPv4LookupService(ini.value("publicIPv4LookupService_Url", WZ_DEFAULT_PUBLIC_IPv4_LOOKUP_SERVICE_URL).toString().toStdString(), ini.value("publicIPv4LookupService_JSONKey", WZ_DEFAULT_PUBLIC_IPv4_LOOKUP_SERVICE_JSONKEY).toString().toStdString());
 	setPublicIPv6LookupService(ini.value("publicIPv6LookupService_Url", WZ_DEFAULT_PUBLIC_IPv6_LOOKUP_SERVICE_URL).toString().toStdString(), ini.value("publicIPv6LookupService_JSONKey", WZ_DEFAULT_PUBLIC_IPv6_LOOKUP_SERVICE_JSONKEY).toString().toStdString());
@@ -258,6 +262,8 @@ bool loadConfig()
 		}
 	}
 	BlueprintTrackAnimationSpeed = ini.value("BlueprintTrackAnimationSpeed", 20).toInt();
+	scriptSetTimerStagger(ini.value("scriptTimerStagger", false).toBool());
+	scriptSetParallelAI(ini.value("scriptParallelAI", false).toBool());
 	ActivityManager::instance().endLoadingSettings();
 	return true;
 }
@@ -318,10 +324,13 @@ bool saveConfig()
 	ini.setValue("radarRotationArrow", radarRotationArrow);
 	ini.setValue("hostQuitConfirmation", hostQuitConfirmation);
 	ini.setValue("PauseOnFocusLoss", war_GetPauseOnFocusLoss());
+	ini.setValue("recordReplays", war_GetRecordReplays());
+	ini.setValue("maxReplays", war_GetMaxReplays());
 	ini.setValue("masterserver_name", NETgetMasterserverName());
 	ini.setValue("masterserver_port", NETgetMasterserverPort());
 	ini.setValue("server_name", mpGetServerName());
 	ini.setValue("gameserver_port", NETgetGameserverPort());
+	ini.setValue("file_transfer_window_kib", NETgetFileTransferWindow() / 1024);
 	ini.setValue("prefer_ipv6", NETgetJoinPreferenceIPv6());
 	ini.setValue("publicIPv4LookupService_Url", getPublicIPv4LookupServiceUrl().c_str());
 	ini.setValue("publicIPv4LookupService_JSONKey", getPublicIPv4LookupServiceJSONKey().c_str());
@@ -354,6 +363,8 @@ bool saveConfig()
 	ini.setValue("gfxbackend", to_string(war_getGfxBackend()).c_str());
 	ini.setValue("jsbackend", to_string(war_getJSBackend()).c_str());
 	ini.setValue("BlueprintTrackAnimationSpeed", BlueprintTrackAnimationSpeed);
+	ini.setValue("scriptTimerStagger", scriptGetTimerStagger());
+	ini.setValue("scriptParallelAI", scriptGetParallelAI());
 	ini.sync();
 	return true;
 }
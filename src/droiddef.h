@@ -94,6 +94,10 @@ struct DROID : public BASE_OBJECT
 	DROID(uint32_t id, unsigned player);
 	~DROID();
 
+	// Memory comes from a pool, see objpool.h.
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	/// UTF-8 name of the droid. This is generated from the droid template
 	///  WARNING: This *can* be changed by the game player after creation & can be translated, do NOT rely on this being the same for everyone!
 	char            aName[MAX_STR_LENGTH];
@@ -69,6 +69,10 @@ struct FEATURE : public BASE_OBJECT
 	FEATURE(uint32_t id, FEATURE_STATS const *psStats);
 	~FEATURE();
 
+	// Memory comes from a pool, see objpool.h.
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	FEATURE_STATS const *psStats;
 
 	inline Vector2i size() const { return psStats->size(); }
@@ -24,11 +24,15 @@
  *
  */
 
-#include <future>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <unordered_map>
 
 #include "lib/framework/frame.h"
 #include "lib/framework/crc.h"
+#include "lib/framework/math_ext.h"
 #include "lib/netplay/netplay.h"
 
 #include "lib/framework/wzapp.h"
@@ -54,54 +58,229 @@ struct PATHRESULT
 	Vector2i        originalDest;   ///< Used to check if the pathfinding job is to the right destination.
 };
 
+struct PathJobShard;
+
+/// Where a path thread puts the result of a job. Slots are reused, so queuing a job doesn't allocate.
+struct PathResultSlot
+{
+	PATHRESULT result;
+	std::atomic<bool> ready{false};  ///< Set by the path thread, once result has been written.
+	bool abandoned = false;          ///< Main thread only. Nobody wants the result any more, so recycle the slot once it's ready.
+	PathJobShard *overflowShard = nullptr;  ///< Main thread only. Shard whose overflow list the job is waiting in, if any.
+};
+
 
 // threading stuff
-static WZ_THREAD        *fpathThread = nullptr;
-static WZ_MUTEX         *fpathMutex = nullptr;
-static WZ_SEMAPHORE     *fpathSemaphore = nullptr;
-using packagedPathJob = wz::packaged_task<PATHRESULT()>;
-static std::list<packagedPathJob>    pathJobs;
-static std::unordered_map<uint32_t, wz::future<PATHRESULT>> pathResults;
 
-static bool             waitingForResult = false;
-static uint32_t         waitingForResultId;
-static WZ_SEMAPHORE     *waitingForResultSemaphore = nullptr;
+/** Number of path job shards. Jobs are assigned to a shard by destination, and each shard owns its own
+ *  context cache and processes its jobs in the order they were queued. Since reusing a context can affect
+ *  the resulting path, this keeps the paths independent of the number of path threads and of thread
+ *  scheduling. Must not depend on the local machine, or multiplayer games would desync.
+ */
+#define FPATH_JOB_SHARDS 8
+/// Number of jobs each shard can hold, must be a power of 2. Any more wait in the shard's overflow list.
+#define FPATH_JOB_QUEUE_SIZE 256
+
+using fpathClock = std::chrono::steady_clock;
 
-static PATHRESULT fpathExecute(PATHJOB psJob);
+struct QueuedPathJob
+{
+	PATHJOB job;
+	PathResultSlot *resultSlot = nullptr;
+	fpathClock::time_point queuedTime;   ///< For the latency statistics.
+};
 
+/** A ring of jobs, without locks. The main thread is the only one adding jobs. A path thread must claim the
+ *  shard by setting busy before taking a job, so only one thread at a time takes jobs, in order.
+ */
+struct PathJobShard
+{
+	QueuedPathJob ring[FPATH_JOB_QUEUE_SIZE];
+	PathResultSlot *ringSlots[FPATH_JOB_QUEUE_SIZE];  ///< Main thread only. Result slot of each job in the ring.
+	std::atomic<uint32_t> head{0};       ///< Position of the next job to process, only changed by the path thread which claimed the shard.
+	std::atomic<uint32_t> tail{0};       ///< Position the next queued job will get, only changed by the main thread.
+	std::deque<QueuedPathJob> overflow;  ///< Main thread only. Jobs waiting for space in the ring.
+	std::atomic<bool> busy{false};       ///< A path thread has claimed this shard.
+	PathfindContextList contexts;        ///< Only touched by the path thread which claimed this shard.
+};
 
-/** This runs in a separate thread */
-static int fpathThreadFunc(void *)
+static std::vector<WZ_THREAD *> fpathThreads;
+static WZ_SEMAPHORE     *fpathSemaphore = nullptr;           ///< Posted to wake up a path thread.
+static WZ_SEMAPHORE     *fpathResultSemaphore = nullptr;     ///< Posted to wake up the main thread, when it's waiting for a result.
+static std::atomic<unsigned> fpathSleepingThreads{0};       ///< Path threads waiting on fpathSemaphore, or about to.
+static std::atomic<PathResultSlot *> fpathWaitingForResult{nullptr};  ///< Result the main thread is waiting for.
+static PathJobShard     fpathShards[FPATH_JOB_SHARDS];
+static std::atomic<unsigned> fpathNextShard{0};             ///< Shard to look at first, so that all shards get processed.
+static std::atomic<size_t> fpathQueuedJobs{0};              ///< Total number of jobs in all shards.
+
+// Result slots, main thread only. The path threads only write to the slot given with their job.
+static std::vector<std::unique_ptr<PathResultSlot>> fpathResultSlots;  ///< All slots, which never move.
+static std::vector<PathResultSlot *> fpathFreeResultSlots;
+static std::vector<PathResultSlot *> fpathAbandonedResultSlots;        ///< Slots of removed droids, still waiting for their job to finish.
+static std::unordered_map<uint32_t, PathResultSlot *> pathResults;     ///< Result of the job of each droid.
+
+// statistics
+static std::atomic<uint64_t> fpathJobsCompleted{0};
+static std::atomic<uint64_t> fpathTotalLatency{0};       ///< In microseconds.
+static std::atomic<uint64_t> fpathTotalExecuteTime{0};   ///< In microseconds.
+static std::atomic<uint32_t> fpathMaxLatency{0};         ///< In microseconds.
+static std::atomic<size_t>   fpathMaxQueuedJobs{0};
+
+static PATHRESULT fpathExecute(PathfindContextList &fpathContexts, PATHJOB job);
+
+
+/// Returns a shard which has jobs waiting, after claiming it, or nullptr if there are none.
+static PathJobShard *fpathClaimWaitingShard()
 {
-	wzMutexLock(fpathMutex);
+	unsigned first = fpathNextShard.fetch_add(1);
+	for (unsigned n = 0; n < FPATH_JOB_SHARDS; ++n)
+	{
+		PathJobShard &shard = fpathShards[(first + n) % FPATH_JOB_SHARDS];
+		if (shard.head != shard.tail && !shard.busy.exchange(true))
+		{
+			if (shard.head != shard.tail)
+			{
+				return &shard;
+			}
+			shard.busy = false;  // Another thread took the last job, before we claimed the shard.
+		}
+	}
+	return nullptr;
+}
+
+/// Moves jobs from the overflow list to the ring, if there is space. Call from main thread.
+static void fpathMoveOverflowJobs(PathJobShard &shard)
+{
+	uint32_t tail = shard.tail;
+	while (!shard.overflow.empty() && tail - shard.head < FPATH_JOB_QUEUE_SIZE)
+	{
+		QueuedPathJob &queued = shard.ring[tail % FPATH_JOB_QUEUE_SIZE];
+		queued = std::move(shard.overflow.front());
+		shard.overflow.pop_front();
+		queued.resultSlot->overflowShard = nullptr;
+		shard.ringSlots[tail % FPATH_JOB_QUEUE_SIZE] = queued.resultSlot;
+		shard.tail = ++tail;
+	}
+}
+
+/// Wakes up a path thread, if any are sleeping. Call from main thread after queuing jobs.
+static void fpathWakeThread()
+{
+	if (fpathSleepingThreads != 0)
+	{
+		wzSemaphorePost(fpathSemaphore);
+	}
+}
 
+/** This runs in a separate thread, one per path thread */
+static int fpathThreadFunc(void *)
+{
 	while (!fpathQuit)
 	{
-		if (pathJobs.empty())
+		PathJobShard *shard = fpathClaimWaitingShard();
+		if (shard == nullptr)
 		{
-			ASSERT(!waitingForResult, "Waiting for a result (id %u) that doesn't exist.", waitingForResultId);
-			wzMutexUnlock(fpathMutex);
-			wzSemaphoreWait(fpathSemaphore);  // Go to sleep until needed.
-			wzMutexLock(fpathMutex);
-			continue;
+			++fpathSleepingThreads;
+			shard = fpathClaimWaitingShard();  // Check again, in case a job was queued before the main thread could see we were about to sleep.
+			if (shard == nullptr)
+			{
+				wzSemaphoreWait(fpathSemaphore);  // Go to sleep until needed.
+				--fpathSleepingThreads;
+				continue;
+			}
+			--fpathSleepingThreads;
 		}
 
-		// Copy the first job from the queue.
-		packagedPathJob job = std::move(pathJobs.front());
-		pathJobs.pop_front();
+		// Take the first job from the shard. No other thread touches the shard until we are done with it.
+		uint32_t head = shard->head;
+		QueuedPathJob job = std::move(shard->ring[head % FPATH_JOB_QUEUE_SIZE]);
+		shard->head = head + 1;  // The main thread may now reuse the ring position.
+		--fpathQueuedJobs;
 
-		wzMutexUnlock(fpathMutex);
-		job();
-		wzMutexLock(fpathMutex);
+		fpathClock::time_point startTime = fpathClock::now();
+		job.resultSlot->result = fpathExecute(shard->contexts, std::move(job.job));
+		fpathClock::time_point endTime = fpathClock::now();
+		shard->busy = false;
 
-		waitingForResult = false;
-		objTrace(waitingForResultId, "These are the droids you are looking for.");
-		wzSemaphorePost(waitingForResultSemaphore);
+		job.resultSlot->ready = true;
+		PathResultSlot *waitingFor = job.resultSlot;
+		if (fpathWaitingForResult.compare_exchange_strong(waitingFor, nullptr))
+		{
+			wzSemaphorePost(fpathResultSemaphore);  // The main thread was waiting for this result.
+		}
+
+		uint32_t latency = std::chrono::duration_cast<std::chrono::microseconds>(endTime - job.queuedTime).count();
+		++fpathJobsCompleted;
+		fpathTotalLatency += latency;
+		fpathTotalExecuteTime += std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+		uint32_t maxLatency = fpathMaxLatency;
+		while (latency > maxLatency && !fpathMaxLatency.compare_exchange_weak(maxLatency, latency)) {}
 	}
-	wzMutexUnlock(fpathMutex);
 	return 0;
 }
 
+/// Returns an unused result slot. Call from main thread.
+static PathResultSlot *fpathNewResultSlot()
+{
+	if (fpathFreeResultSlots.empty())
+	{
+		fpathResultSlots.emplace_back(new PathResultSlot);
+		return fpathResultSlots.back().get();
+	}
+	PathResultSlot *slot = fpathFreeResultSlots.back();
+	fpathFreeResultSlots.pop_back();
+	return slot;
+}
+
+/// Makes a slot available for reuse, the path thread must be done with it. Call from main thread.
+static void fpathFreeResultSlot(PathResultSlot *slot)
+{
+	slot->ready = false;
+	slot->abandoned = false;
+	slot->overflowShard = nullptr;
+	slot->result.sMove.asPath.clear();
+	fpathFreeResultSlots.push_back(slot);
+}
+
+/// Waits until a path thread has finished the job of the slot, which must be in a ring. Call from main thread.
+static void fpathWaitForJob(PathResultSlot *slot)
+{
+	if (slot->ready)
+	{
+		return;
+	}
+	fpathWaitingForResult = slot;
+	if (slot->ready && fpathWaitingForResult.exchange(nullptr) == slot)
+	{
+		return;  // Finished just now, and the path thread didn't see that we were waiting, so won't wake us.
+	}
+	wzSemaphoreWait(fpathResultSemaphore);
+}
+
+/// Waits until a path thread has finished the job of the slot. Call from main thread.
+static void fpathWaitForResult(PathResultSlot *slot)
+{
+	// The path threads can't see jobs in an overflow list, so keep moving them to the ring as the jobs before them finish.
+	while (slot->overflowShard != nullptr)
+	{
+		PathJobShard &shard = *slot->overflowShard;
+		fpathMoveOverflowJobs(shard);
+		fpathWakeThread();
+		if (slot->overflowShard == nullptr)
+		{
+			break;
+		}
+		// Read head once. If the ring is still full, the job at head hasn't been taken yet, so its slot is current.
+		// Otherwise the path threads made space since fpathMoveOverflowJobs looked, so move more jobs instead.
+		uint32_t head = shard.head;
+		if (shard.tail - head == FPATH_JOB_QUEUE_SIZE)
+		{
+			fpathWaitForJob(shard.ringSlots[head % FPATH_JOB_QUEUE_SIZE]);  // Wait for space.
+		}
+	}
+	fpathWaitForJob(slot);
+}
+
 
 // initialise the findpath module
 bool fpathInitialise()
@@ -109,13 +288,27 @@ bool fpathInitialise()
 	// The path system is up
 	fpathQuit = false;
 
-	if (!fpathThread)
+	if (fpathThreads.empty())
 	{
-		fpathMutex = wzMutexCreate();
 		fpathSemaphore = wzSemaphoreCreate(0);
-		waitingForResultSemaphore = wzSemaphoreCreate(0);
-		fpathThread = wzThreadCreate(fpathThreadFunc, nullptr);
-		wzThreadStart(fpathThread);
+		fpathResultSemaphore = wzSemaphoreCreate(0);
+
+		// Leave a core for the main thread. More threads than shards would never have anything to do.
+		unsigned numThreads = clip<unsigned>(wzGetLogicalCPUCount() - 1, 1, FPATH_JOB_SHARDS);
+		for (unsigned n = 0; n < numThreads; ++n)
+		{
+			WZ_THREAD *thread = wzThreadCreate(fpathThreadFunc, nullptr);
+			wzThreadStart(thread);
+			fpathThreads.push_back(thread);
+		}
+		debug(LOG_INFO, "Started %u path finding threads", numThreads);
+	}
+
+	// Allocate the result slots up front, so that queuing jobs doesn't usually need to.
+	while (fpathResultSlots.size() < FPATH_JOB_QUEUE_SIZE)
+	{
+		fpathResultSlots.emplace_back(new PathResultSlot);
+		fpathFreeResultSlots.push_back(fpathResultSlots.back().get());
 	}
 
 	return true;
@@ -124,21 +317,58 @@ bool fpathInitialise()
 
 void fpathShutdown()
 {
-	if (fpathThread)
+	if (!fpathThreads.empty())
 	{
-		// Signal the path finding thread to quit
+		// Signal the path finding threads to quit
 		fpathQuit = true;
-		wzSemaphorePost(fpathSemaphore);  // Wake up thread.
+		for (size_t n = 0; n < fpathThreads.size(); ++n)
+		{
+			wzSemaphorePost(fpathSemaphore);  // Wake up threads.
+		}
+
+		for (WZ_THREAD *thread : fpathThreads)
+		{
+			wzThreadJoin(thread);
+		}
+		fpathThreads.clear();
+
+		FPATH_STATISTICS stats = fpathGetStatistics();
+		debug(LOG_INFO, "Path finding: %" PRIu64 " jobs, average latency %u us (%u us executing), max latency %u us, max queue length %u",
+		      stats.jobsCompleted, stats.averageLatency, stats.averageExecuteTime, stats.maxLatency, (unsigned)stats.maxQueueLength);
 
-		wzThreadJoin(fpathThread);
-		fpathThread = nullptr;
-		wzMutexDestroy(fpathMutex);
-		fpathMutex = nullptr;
 		wzSemaphoreDestroy(fpathSemaphore);
 		fpathSemaphore = nullptr;
-		wzSemaphoreDestroy(waitingForResultSemaphore);
-		waitingForResultSemaphore = nullptr;
+		wzSemaphoreDestroy(fpathResultSemaphore);
+		fpathResultSemaphore = nullptr;
+		fpathSleepingThreads = 0;
+		fpathWaitingForResult = nullptr;
 	}
+	for (PathJobShard &shard : fpathShards)
+	{
+		for (QueuedPathJob &job : shard.ring)
+		{
+			job = QueuedPathJob();  // Release the blocking maps.
+		}
+		shard.head = 0;
+		shard.tail = 0;
+		shard.overflow.clear();
+		shard.contexts.clear();
+		shard.busy = false;
+	}
+	// No threads left, so every slot is free.
+	pathResults.clear();
+	fpathAbandonedResultSlots.clear();
+	fpathFreeResultSlots.clear();
+	for (auto &slot : fpathResultSlots)
+	{
+		fpathFreeResultSlot(slot.get());
+	}
+	fpathQueuedJobs = 0;
+	fpathJobsCompleted = 0;
+	fpathTotalLatency = 0;
+	fpathTotalExecuteTime = 0;
+	fpathMaxLatency = 0;
+	fpathMaxQueuedJobs = 0;
 	fpathHardTableReset();
 }
 
@@ -149,7 +379,36 @@ void fpathShutdown()
  */
 void fpathUpdate()
 {
-	// Nothing now
+	// Queue any jobs which didn't fit in the rings before.
+	bool queuedJobs = false;
+	for (PathJobShard &shard : fpathShards)
+	{
+		if (!shard.overflow.empty())
+		{
+			fpathMoveOverflowJobs(shard);
+			queuedJobs = true;
+		}
+	}
+	if (queuedJobs)
+	{
+		fpathWakeThread();
+	}
+
+	// Recycle the result slots of removed droids, once their jobs are done.
+	for (size_t n = 0; n < fpathAbandonedResultSlots.size();)
+	{
+		PathResultSlot *slot = fpathAbandonedResultSlots[n];
+		if (slot->ready)
+		{
+			fpathFreeResultSlot(slot);
+			fpathAbandonedResultSlots[n] = fpathAbandonedResultSlots.back();
+			fpathAbandonedResultSlots.pop_back();
+		}
+		else
+		{
+			++n;
+		}
+	}
 }
 
 
@@ -308,7 +567,23 @@ void fpathSetDirectRoute(DROID *psDroid, SDWORD targetX, SDWORD targetY)
 
 void fpathRemoveDroidData(int id)
 {
-	pathResults.erase(id);
+	auto I = pathResults.find(id);
+	if (I == pathResults.end())
+	{
+		return;
+	}
+	PathResultSlot *slot = I->second;
+	pathResults.erase(I);
+	if (slot->ready)
+	{
+		fpathFreeResultSlot(slot);
+	}
+	else
+	{
+		// The job must still run, since processing order can affect resulting paths, so can't reuse the slot yet.
+		slot->abandoned = true;
+		fpathAbandonedResultSlots.push_back(slot);
+	}
 }
 
 static FPATH_RETVAL fpathRoute(MOVE_CONTROL *psMove, unsigned id, int startX, int startY, int tX, int tY, PROPULSION_TYPE propulsionType,
@@ -339,8 +614,10 @@ static FPATH_RETVAL fpathRoute(MOVE_CONTROL *psMove, unsigned id, int startX, in
 		objTrace(id, "Checking if we have a path yet");
 
 		auto const &I = pathResults.find(id);
-		ASSERT(I != pathResults.end(), "Missing path result promise");
-		PATHRESULT result = I->second.get();
+		ASSERT_OR_RETURN(FPR_FAILED, I != pathResults.end(), "Missing path result");
+		PathResultSlot *slot = I->second;
+		fpathWaitForResult(slot);
+		PATHRESULT &result = slot->result;
 		ASSERT(result.retval != FPR_OK || result.sMove.asPath.size() > 0, "Ok result but no path in list");
 
 		// Copy over select fields - preserve others
@@ -348,12 +625,13 @@ static FPATH_RETVAL fpathRoute(MOVE_CONTROL *psMove, unsigned id, int startX, in
 		bool correctDestination = tX == result.originalDest.x && tY == result.originalDest.y;
 		psMove->pathIndex = 0;
 		psMove->Status = MOVENAVIGATE;
-		psMove->asPath = result.sMove.asPath;
+		psMove->asPath.swap(result.sMove.asPath);
 		FPATH_RETVAL retval = result.retval;
 		ASSERT(retval != FPR_OK || psMove->asPath.size() > 0, "Ok result but no path after copy");
 
 		// Remove it from the result list
-		pathResults.erase(id);
+		pathResults.erase(I);
+		fpathFreeResultSlot(slot);
 
 		objTrace(id, "Got a path to (%d, %d)! Length=%d Retval=%d", psMove->destination.x, psMove->destination.y, (int)psMove->asPath.size(), (int)retval);
 		syncDebug("fpathRoute(..., %d, %d, %d, %d, %d, %d, %d, %d, %d) = %d, path[%d] = %08X->(%d, %d)", id, startX, startY, tX, tY, propulsionType, droidType, moveType, owner, retval, (int)psMove->asPath.size(), ~crcSumVector2i(0, psMove->asPath.data(), psMove->asPath.size()), psMove->destination.x, psMove->destination.y);
@@ -388,21 +666,40 @@ queuePathfinding:
 	// job or result for each droid in the system at any time.
 	fpathRemoveDroidData(id);
 
-	packagedPathJob task([job]() { return fpathExecute(job); });
-	pathResults[id] = task.get_future();
+	PathResultSlot *slot = fpathNewResultSlot();
+	pathResults[id] = slot;
 
-	// Add to end of list
-	wzMutexLock(fpathMutex);
-	bool isFirstJob = pathJobs.empty();
-	pathJobs.push_back(std::move(task));
-	wzMutexUnlock(fpathMutex);
+	// Jobs to the same destination go to the same shard, so they can reuse each other's contexts.
+	unsigned shardIndex = (map_coord(tX) * 7 + map_coord(tY) * 13) % FPATH_JOB_SHARDS;
+	PathJobShard &shard = fpathShards[shardIndex];
 
-	if (isFirstJob)
+	// Add to end of the ring, or of the overflow list if the ring is full, so the jobs stay in order.
+	size_t earlierJobs = shard.tail - shard.head + shard.overflow.size();
+	size_t queuedJobs = ++fpathQueuedJobs;
+	fpathMaxQueuedJobs = std::max<size_t>(fpathMaxQueuedJobs, queuedJobs);
+	uint32_t tail = shard.tail;
+	if (shard.overflow.empty() && tail - shard.head < FPATH_JOB_QUEUE_SIZE)
 	{
-		wzSemaphorePost(fpathSemaphore);  // Wake up processing thread.
+		QueuedPathJob &queued = shard.ring[tail % FPATH_JOB_QUEUE_SIZE];
+		queued.job = std::move(job);
+		queued.resultSlot = slot;
+		queued.queuedTime = fpathClock::now();
+		shard.ringSlots[tail % FPATH_JOB_QUEUE_SIZE] = slot;
+		shard.tail = tail + 1;
+	}
+	else
+	{
+		shard.overflow.emplace_back();
+		QueuedPathJob &queued = shard.overflow.back();
+		queued.job = std::move(job);
+		queued.resultSlot = slot;
+		queued.queuedTime = fpathClock::now();
+		slot->overflowShard = &shard;
 	}
 
-	objTrace(id, "Queued up a path-finding request to (%d, %d), at least %d items earlier in queue", tX, tY, isFirstJob);
+	fpathWakeThread();
+
+	objTrace(id, "Queued up a path-finding request to (%d, %d), %d items earlier in shard %u", tX, tY, (int)earlierJobs, shardIndex);
 	syncDebug("fpathRoute(..., %d, %d, %d, %d, %d, %d, %d, %d, %d) = FPR_WAIT", id, startX, startY, tX, tY, propulsionType, droidType, moveType, owner);
 	return FPR_WAIT;	// wait while polling result queue
 }
@@ -453,14 +750,14 @@ FPATH_RETVAL fpathDroidRoute(DROID *psDroid, SDWORD tX, SDWORD tY, FPATH_MOVETYP
 }
 
 // Run only from path thread
-PATHRESULT fpathExecute(PATHJOB job)
+PATHRESULT fpathExecute(PathfindContextList &fpathContexts, PATHJOB job)
 {
 	PATHRESULT result;
 	result.droidID = job.droidID;
 	result.retval = FPR_FAILED;
 	result.originalDest = Vector2i(job.destX, job.destY);
 
-	ASR_RETVAL retval = fpathAStarRoute(&result.sMove, &job);
+	ASR_RETVAL retval = fpathAStarRoute(fpathContexts, &result.sMove, &job);
 
 	ASSERT(retval != ASR_OK || result.sMove.asPath.size() > 0, "Ok result but no path in result");
 	switch (retval)
@@ -500,26 +797,30 @@ PATHRESULT fpathExecute(PATHJOB job)
 }
 
 /** Find the length of the job queue. Function is thread-safe. */
-static size_t fpathJobQueueLength()
+size_t fpathJobQueueLength()
 {
-	size_t count = 0;
+	return fpathQueuedJobs;
+}
 
-	wzMutexLock(fpathMutex);
-	count = pathJobs.size();  // O(N) function call for std::list. .empty() is faster, but this function isn't used except in tests.
-	wzMutexUnlock(fpathMutex);
-	return count;
+FPATH_STATISTICS fpathGetStatistics()
+{
+	FPATH_STATISTICS stats;
+
+	stats.threads = fpathThreads.size();
+	stats.queueLength = fpathQueuedJobs;
+	stats.maxQueueLength = fpathMaxQueuedJobs;
+	stats.jobsCompleted = fpathJobsCompleted;
+	stats.averageLatency = stats.jobsCompleted != 0 ? static_cast<uint32_t>(fpathTotalLatency / stats.jobsCompleted) : 0;
+	stats.averageExecuteTime = stats.jobsCompleted != 0 ? static_cast<uint32_t>(fpathTotalExecuteTime / stats.jobsCompleted) : 0;
+	stats.maxLatency = fpathMaxLatency;
+	return stats;
 }
 
 
-/** Find the length of the result queue, excepting future results. Function is thread-safe. */
+/** Find the number of droids with a result, including results still being calculated. Call from main thread. */
 static size_t fpathResultQueueLength()
 {
-	size_t count = 0;
-
-	wzMutexLock(fpathMutex);
-	count = pathResults.size();  // O(N) function call for std::list. .empty() is faster, but this function isn't used except in tests.
-	wzMutexUnlock(fpathMutex);
-	return count;
+	return pathResults.size();
 }
 
 
@@ -535,14 +836,11 @@ void fpathTest(int x, int y, int x2, int y2)
 	FPATH_RETVAL r;
 	int i;
 
-	// On non-debug builds prevent warnings about defining but not using fpathJobQueueLength
-	(void)fpathJobQueueLength();
-
 	/* Check initial state */
-	assert(fpathThread != nullptr);
-	assert(fpathMutex != nullptr);
+	assert(!fpathThreads.empty());
 	assert(fpathSemaphore != nullptr);
-	assert(pathJobs.empty());
+	assert(fpathResultSemaphore != nullptr);
+	assert(fpathJobQueueLength() == 0);
 	assert(pathResults.empty());
 	fpathRemoveDroidData(0);	// should not crash
 
@@ -610,6 +908,26 @@ void fpathTest(int x, int y, int x2, int y2)
 	}
 	//assert(pathJobs.empty()); // can now be marked .deleted as well
 	assert(pathResults.empty());
+
+	/* More jobs to one destination than fit in the ring, waiting on the last one first */
+	const int numJobs = FPATH_JOB_QUEUE_SIZE + 44;
+	sMove.Status = MOVEINACTIVE;
+	for (i = 1; i <= numJobs; i++)
+	{
+		r = fpathSimpleRoute(&sMove, i, x, y, x2, y2);
+		assert(r == FPR_WAIT);
+	}
+	for (i = numJobs; i >= 1; i--)
+	{
+		sMove.Status = MOVEWAITROUTE;
+		r = fpathSimpleRoute(&sMove, i, x, y, x2, y2);  // Must not wait forever for a job in the overflow list.
+		assert(r == FPR_OK);
+		assert(sMove.asPath.size() > 0);
+		assert(sMove.asPath[sMove.asPath.size() - 1].x == x2);
+		assert(sMove.asPath[sMove.asPath.size() - 1].y == y2);
+	}
+	assert(fpathJobQueueLength() == 0);
+	assert(pathResults.empty());
 	(void)r;  // Squelch unused-but-set warning.
 }
 
@@ -43,6 +43,7 @@ enum FPATH_MOVETYPE
 };
 
 struct PathBlockingMap;
+struct PathClusterGraph;
 
 struct PATHJOB
 {
@@ -55,6 +56,7 @@ struct PATHJOB
 	FPATH_MOVETYPE	moveType;
 	int		owner;		///< Player owner
 	std::shared_ptr<PathBlockingMap> blockingMap;   ///< Map of blocking tiles.
+	std::shared_ptr<PathClusterGraph> clusterGraph;  ///< Graph for planning long routes, or nullptr to search tiles only.
 	bool		acceptNearest;
 	bool            deleted;        ///< Droid was deleted, so throw away result when complete. Must still process this PATHJOB, since processing order can affect resulting paths (but can't affect the path length).
 };
@@ -66,6 +68,20 @@ enum FPATH_RETVAL
 	FPR_WAIT,       ///< route is being calculated by the path-finding thread
 };
 
+/** Statistics about the path-finding threads, for performance tuning.
+ *  Times are wall-clock times in microseconds.
+ */
+struct FPATH_STATISTICS
+{
+	unsigned        threads = 0;            ///< Number of path-finding threads.
+	size_t          queueLength = 0;        ///< Number of jobs waiting to be processed.
+	size_t          maxQueueLength = 0;     ///< Longest the job queue has been.
+	uint64_t        jobsCompleted = 0;      ///< Number of jobs processed.
+	uint32_t        averageLatency = 0;     ///< Average time from queueing a job until its result is ready.
+	uint32_t        averageExecuteTime = 0; ///< Average time spent calculating a path.
+	uint32_t        maxLatency = 0;         ///< Longest time from queueing a job until its result is ready.
+};
+
 /** Initialise the path-finding module.
  */
 bool fpathInitialise();
@@ -117,6 +133,12 @@ void fpathSetDirectRoute(DROID *psDroid, SDWORD targetX, SDWORD targetY);
 /** Clean up path jobs and results for a droid. Function is thread-safe. */
 void fpathRemoveDroidData(int id);
 
+/** Find the number of path jobs waiting to be processed. Function is thread-safe. */
+size_t fpathJobQueueLength();
+
+/** Get the path-finding thread statistics since fpathInitialise. Function is thread-safe. */
+FPATH_STATISTICS fpathGetStatistics();
+
 /** Quick O(1) test of whether it is theoretically possible to go from origin to destination
  *  using the given propulsion type. orig and dest are in world coordinates. */
 bool fpathCheck(Position orig, Position dest, PROPULSION_TYPE propulsion);
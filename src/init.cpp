@@ -748,11 +748,11 @@ bool systemInitialise(float horizScaleFactor, float vertScaleFactor)
 		return false;
 	}
 
-	if (!audio_Init(droidAudioTrackStopped, war_GetHRTFMode(), war_getSoundEnabled()))
+	if (!audio_Init(droidAudioTrackStopped, war_GetHRTFMode(), war_getSoundEnabled() && !wzIsHeadless()))
 	{
 		debug(LOG_SOUND, "Continuing without audio");
 	}
-	if (war_getSoundEnabled() && war_GetMusicEnabled())
+	if (war_getSoundEnabled() && war_GetMusicEnabled() && !wzIsHeadless())
 	{
 		cdAudio_Open(UserMusicPath);
 	}
@@ -1031,6 +1031,8 @@ bool stageOneShutDown()
 
 	proj_Shutdown();
 
+	visShutdown();
+
 	releaseMission();
 
 	if (!aiShutdown())
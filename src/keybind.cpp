@@ -650,6 +650,17 @@ void	kf_FrameRate()
 		                          NETgetStatistic(NetStatisticUncompressedBytes, false),
 		                          NETgetStatistic(NetStatisticPackets, true),
 		                          NETgetStatistic(NetStatisticPackets, false));
+		CONPRINTF("NETWORK:  Broadcasts: %zu  Broadcast Bytes: %zu  Broadcast Time: %zuus",
+		                          NETgetStatistic(NetStatisticBroadcasts, true),
+		                          NETgetStatistic(NetStatisticBroadcastBytes, true),
+		                          NETgetStatistic(NetStatisticBroadcastMicroseconds, true));
+		DroidInfoStatistics const &droidInfoStats = getDroidInfoStatistics();
+		CONPRINTF("NETWORK:  Droid Orders: %zu  Duplicates: %zu  Messages: %zu  Bytes: %zu  Saved by Batching: %zu",
+		                          droidInfoStats.orders,
+		                          droidInfoStats.duplicates,
+		                          droidInfoStats.messages,
+		                          droidInfoStats.bytes,
+		                          droidInfoStats.bytesSaved);
 	}
 	gameStats = !gameStats;
 	CONPRINTF("Built: %s %s", getCompileDate(), __TIME__);
@@ -39,6 +39,7 @@
 #include "lib/sound/cdaudio.h"
 #include "lib/sound/mixer.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netreplay.h"
 
 #include "loop.h"
 #include "objects.h"
@@ -82,6 +83,8 @@
 #include "qtscript.h"
 #include "version.h"
 #include "notifications.h"
+#include "benchmark.h"
+#include "clparse.h"
 
 #include "warzoneconfig.h"
 
@@ -528,37 +531,45 @@ static void gameStateUpdate()
 	sendPlayerGameTime();
 	NETflush();  // Make sure the game time tick message is really sent over the network.
 
+	benchmarkStage(BENCHMARK_SCRIPTS);
 	if (!paused && !scriptPaused())
 	{
 		updateScripts();
 	}
 
 	// Update abandoned structures
+	benchmarkStage(BENCHMARK_OTHER);
 	handleAbandonedStructures();
 
 	// Update the visibility change stuff
 	visUpdateLevel();
 
 	// Put all droids/structures/features into the grid.
+	benchmarkStage(BENCHMARK_GRID);
 	gridReset();
 
 	// Check which objects are visible.
+	benchmarkStage(BENCHMARK_VISIBILITY);
 	processVisibility();
 
 	// Update the map.
+	benchmarkStage(BENCHMARK_PATHFINDING);
 	mapUpdate();
 
 	//update the findpath system
 	fpathUpdate();
 
 	// update the command droids
+	benchmarkStage(BENCHMARK_DROIDS);
 	cmdDroidUpdate();
 
 	for (unsigned i = 0; i < MAX_PLAYERS; i++)
 	{
 		//update the current power available for a player
+		benchmarkStage(BENCHMARK_OTHER);
 		updatePlayerPower(i);
 
+		benchmarkStage(BENCHMARK_DROIDS);
 		DROID *psNext;
 		for (DROID *psCurr = apsDroidLists[i]; psCurr != nullptr; psCurr = psNext)
 		{
@@ -576,6 +587,7 @@ static void gameStateUpdate()
 		}
 
 		// FIXME: These for-loops are code duplicationo
+		benchmarkStage(BENCHMARK_STRUCTURES);
 		STRUCTURE *psNBuilding;
 		for (STRUCTURE *psCBuilding = apsStructLists[i]; psCBuilding != nullptr; psCBuilding = psNBuilding)
 		{
@@ -591,10 +603,13 @@ static void gameStateUpdate()
 		}
 	}
 
+	benchmarkStage(BENCHMARK_OTHER);
 	missionTimerUpdate();
 
+	benchmarkStage(BENCHMARK_PROJECTILES);
 	proj_UpdateAll();
 
+	benchmarkStage(BENCHMARK_FEATURES);
 	FEATURE *psNFeat;
 	for (FEATURE *psCFeat = apsFeatureLists[0]; psCFeat; psCFeat = psNFeat)
 	{
@@ -603,10 +618,13 @@ static void gameStateUpdate()
 	}
 
 	// Clean up dead droid pointers in UI.
+	benchmarkStage(BENCHMARK_OTHER);
 	hciUpdate();
 
 	// Free dead droid memory.
+	benchmarkStage(BENCHMARK_OBJMEM);
 	objmemUpdate();
+	benchmarkStage(BENCHMARK_OTHER);
 
 	// Must end update, since we may or may not have ticked, and some message queue processing code may vary depending on whether it's in an update.
 	gameTimeUpdateEnd();
@@ -621,6 +639,147 @@ static void gameStateUpdate()
 	}
 }
 
+/* Runs game state updates back to back for up to a tenth of a second, without rendering, see benchmark.h */
+static GAMECODE benchmarkLoop()
+{
+	static bool started = false;
+	if (!started)
+	{
+		// Let game time run far ahead of real time, so that a tick is due whenever the previous one is done.
+		gameTimeSetMod(Rational(1000));
+		started = true;
+	}
+
+	unsigned start = wzGetTicks();
+	while (benchmarkTicksLeft() && wzGetTicks() - start < 100)
+	{
+		recvMessage();
+		gameTimeUpdate(true);
+		if (deltaGameTime == 0)
+		{
+			continue;  // Waiting for real time to pass, or for our own GAME_GAME_TIME.
+		}
+
+		syncDebug("Begin game state update, gameTime = %d", gameTime);
+		benchmarkTickBegin();
+		gameStateUpdate();
+		benchmarkTickEnd();
+		syncDebug("End game state update, gameTime = %d", gameTime);
+	}
+
+	if (benchmarkTicksLeft())
+	{
+		return GAMECODE_CONTINUE;
+	}
+	benchmarkReport();
+	wzQuit();
+	return GAMECODE_QUITGAME;
+}
+
+static unsigned replayTicksDone = 0;  ///< Game state updates done while playing back a replay.
+
+static bool replaySkipping()
+{
+	return NETisReplay() && replayTicksDone < wz_replay_skip_ticks();
+}
+
+/* Runs the game state updates of a replay back to back for up to a tenth of a second, without rendering, until the ticks given with --replayskip are done */
+static GAMECODE replaySkipLoop()
+{
+	// Let game time run far ahead of real time, so that a tick is due whenever the previous one is done.
+	gameTimeSetMod(Rational(1000));
+
+	unsigned start = wzGetTicks();
+	while (replaySkipping() && wzGetTicks() - start < 100)
+	{
+		recvMessage();
+		gameTimeUpdate(true);
+		if (deltaGameTime == 0)
+		{
+			if (NETreplayLoadFinished() && !checkPlayerGameTime(NET_ALL_PLAYERS))
+			{
+				// Waiting for a GAME_GAME_TIME which isn't in the replay, so the replay is over.
+				debug(LOG_INFO, "Replay ended after %u ticks, at gameTime %u", replayTicksDone, gameTime);
+				wzQuit();
+				return GAMECODE_QUITGAME;
+			}
+			continue;
+		}
+
+		syncDebug("Begin game state update, gameTime = %d", gameTime);
+		gameStateUpdate();
+		syncDebug("End game state update, gameTime = %d", gameTime);
+		++replayTicksDone;
+	}
+
+	if (!replaySkipping())
+	{
+		debug(LOG_INFO, "Skipped %u ticks of the replay, now at gameTime %u", replayTicksDone, gameTime);
+		gameTimeSetMod(Rational(1));
+	}
+	return GAMECODE_CONTINUE;
+}
+
+/* Returns true if a human player other than the host is still in the game */
+static bool otherHumanPlayersInGame()
+{
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		if (player != NetPlay.hostPlayer && NetPlay.players[player].allocated)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Used instead of the rendering part of the game loop when running headless. Runs the game state updates and the
+ * multiplayer housekeeping, without drawing anything. Quits when all the other players have left, or the replay ends. */
+static GAMECODE headlessLoop()
+{
+	static uint32_t lastFlushTime = 0;
+
+	while (true)
+	{
+		recvMessage();
+		gameTimeUpdate(true);
+		if (deltaGameTime == 0)
+		{
+			break;  // Not doing a game state update.
+		}
+
+		syncDebug("Begin game state update, gameTime = %d", gameTime);
+		gameStateUpdate();
+		syncDebug("End game state update, gameTime = %d", gameTime);
+	}
+
+	if (bMultiPlayer && !gameUpdatePaused())
+	{
+		multiPlayerLoop();
+	}
+
+	if (realTime - lastFlushTime >= 400u)
+	{
+		lastFlushTime = realTime;
+		NETflush();  // Make sure that we aren't waiting too long to send data.
+	}
+
+	if (NetPlay.bComms && NetPlay.isHost && !otherHumanPlayersInGame())
+	{
+		debug(LOG_INFO, "All players have left the game, quitting at gameTime %u", gameTime);
+		wzQuit();
+		return GAMECODE_QUITGAME;
+	}
+	if (NETreplayLoadFinished() && !checkPlayerGameTime(NET_ALL_PLAYERS))
+	{
+		debug(LOG_INFO, "Replay ended at gameTime %u", gameTime);
+		wzQuit();
+		return GAMECODE_QUITGAME;
+	}
+
+	return GAMECODE_CONTINUE;
+}
+
 /* The main game loop */
 GAMECODE gameLoop()
 {
@@ -634,6 +793,19 @@ GAMECODE gameLoop()
 	// Shouldn't this be when initialising the game, rather than randomly called between ticks?
 	countUpdate(false); // kick off with correct counts
 
+	if (benchmarkEnabled())
+	{
+		return benchmarkLoop();
+	}
+	if (replaySkipping())
+	{
+		return replaySkipLoop();
+	}
+	if (wzIsHeadless())
+	{
+		return headlessLoop();
+	}
+
 	while (true)
 	{
 		// Receive NET_BLAH messages.
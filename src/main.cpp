@@ -1368,6 +1368,8 @@ int realmain(int argc, char *argv[])
 
 	PHYSFS_mkdir("music");	// custom music overriding default music and music mods
 
+	PHYSFS_mkdir("replay/multiplay");	// replays of skirmish and multiplayer games, played back with --replay=file
+
 	make_dir(SaveGamePath, "savegames", nullptr); 	// save games
 	PHYSFS_mkdir("savegames/campaign");		// campaign save games
 	PHYSFS_mkdir("savegames/campaign/auto");	// campaign autosave games
@@ -1553,10 +1555,13 @@ int realmain(int argc, char *argv[])
 	{
 		return EXIT_FAILURE;
 	}
-	unsigned int windowWidth = 0, windowHeight = 0;
-	wzGetWindowResolution(nullptr, &windowWidth, &windowHeight);
-	war_SetWidth(windowWidth);
-	war_SetHeight(windowHeight);
+	if (!wzIsHeadless())
+	{
+		unsigned int windowWidth = 0, windowHeight = 0;
+		wzGetWindowResolution(nullptr, &windowWidth, &windowHeight);
+		war_SetWidth(windowWidth);
+		war_SetHeight(windowHeight);
+	}
 
 	pie_SetFogStatus(false);
 	pie_ScreenFlip(CLEAR_BLACK);
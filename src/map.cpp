@@ -108,6 +108,16 @@ MAPTILE	*psMapTiles = nullptr;
 uint8_t *psBlockMap[AUX_MAX];
 uint8_t *psAuxMap[MAX_PLAYERS + AUX_MAX];        // yes, we waste one element... eyes wide open... makes API nicer
 
+/// Maximum number of areas remembered by auxMarkDirty, older areas are forgotten.
+#define AUX_DIRTY_MAX 1024
+/// Maximum width and height of an area recorded by auxMarkDirty, before starting a new area.
+#define AUX_DIRTY_RECT_SIZE 8
+
+static std::vector<AuxDirtyRect> auxDirty;      ///< Areas changed since auxDirtyFirst, oldest first.
+static uint32_t auxDirtyFirst = 0;              ///< Sequence number of auxDirty[0].
+static bool auxDirtySealed = true;              ///< True if the last area may already have been seen, so must not grow any more.
+static uint32_t auxThreatChangeCount[MAX_PLAYERS];
+
 #define WATER_MIN_DEPTH 500
 #define WATER_MAX_DEPTH (WATER_MIN_DEPTH + 400)
 
@@ -970,6 +980,7 @@ static bool afterMapLoad()
 	{
 		psAuxMap[x] = (uint8_t *)malloc(mapWidth * mapHeight * sizeof(*psAuxMap[0]));
 	}
+	auxMarkAllDirty();
 
 	// Set our blocking bits
 	for (int y = 0; y < mapHeight; ++y)
@@ -1138,6 +1149,7 @@ bool mapShutdown()
 		free(psAuxMap[x]);
 		psAuxMap[x] = nullptr;
 	}
+	auxMarkAllDirty();
 
 	map = nullptr;
 	floodbucket = nullptr;
@@ -2039,6 +2051,65 @@ static void threatUpdate(int player)
 	}
 }
 
+void auxMarkDirty(int x, int y)
+{
+	if (!auxDirtySealed)
+	{
+		// Grow the last area, if it stays small. Structures and features change a few neighbouring tiles at a time.
+		AuxDirtyRect &last = auxDirty.back();
+		int x1 = std::min<int>(last.x1, x), y1 = std::min<int>(last.y1, y);
+		int x2 = std::max<int>(last.x2, x), y2 = std::max<int>(last.y2, y);
+		if (x2 - x1 < AUX_DIRTY_RECT_SIZE && y2 - y1 < AUX_DIRTY_RECT_SIZE)
+		{
+			last = {(int16_t)x1, (int16_t)y1, (int16_t)x2, (int16_t)y2};
+			return;
+		}
+	}
+	if (auxDirty.size() >= AUX_DIRTY_MAX)
+	{
+		// Forget the old changes, anyone who still needs them recalculates everything instead.
+		auxDirtyFirst += auxDirty.size();
+		auxDirty.clear();
+	}
+	auxDirty.push_back({(int16_t)x, (int16_t)y, (int16_t)x, (int16_t)y});
+	auxDirtySealed = false;
+}
+
+void auxMarkAllDirty()
+{
+	auxDirtyFirst += auxDirty.size() + 1;  // Skip a sequence number, so that no earlier sequence number is valid.
+	auxDirty.clear();
+	auxDirtySealed = true;
+}
+
+uint32_t auxDirtySequence()
+{
+	auxDirtySealed = true;
+	return auxDirtyFirst + auxDirty.size();
+}
+
+AuxDirtyRect const *auxDirtyRects(uint32_t sequence, size_t *count)
+{
+	uint32_t offset = sequence - auxDirtyFirst;  // Unsigned, so sequence numbers which have been forgotten give a huge offset.
+	if (offset > auxDirty.size())
+	{
+		*count = 0;
+		return nullptr;
+	}
+	*count = auxDirty.size() - offset;
+	return auxDirty.data() + offset;
+}
+
+void auxMarkThreatDirty(int player)
+{
+	++auxThreatChangeCount[player];
+}
+
+uint32_t auxThreatChanges(int player)
+{
+	return auxThreatChangeCount[player];
+}
+
 void mapInit()
 {
 	int player;
@@ -157,6 +157,26 @@ WZ_DECL_ALWAYS_INLINE static inline uint8_t blockTile(int x, int y, int slot)
 	return psBlockMap[slot][x + y * mapWidth];
 }
 
+/// Area of tiles whose aux or blocking bits changed. Coordinates are inclusive.
+struct AuxDirtyRect
+{
+	int16_t x1, y1, x2, y2;
+};
+
+/// Records that the aux or blocking bits of a tile changed, so anything derived from them can be updated incrementally.
+/// Only changes to the real aux maps are recorded, not to the shadow copies used by the danger thread. Call from main thread.
+void auxMarkDirty(int x, int y);
+/// Forgets all recorded changes, so everything derived from the aux maps gets recalculated.
+void auxMarkAllDirty();
+/// Returns the position in the log of changes, for passing to auxDirtyRects later.
+uint32_t auxDirtySequence();
+/// Returns the areas changed since auxDirtySequence() returned sequence, or nullptr if those changes have been forgotten.
+AuxDirtyRect const *auxDirtyRects(uint32_t sequence, size_t *count);
+/// Records that auxMapRestore changed the threat bits of a player.
+void auxMarkThreatDirty(int player);
+/// Returns the number of times auxMapRestore changed the threat bits of a player.
+uint32_t auxThreatChanges(int player);
+
 /// Store a shadow copy of a player's aux map for use in threaded calculations
 static inline void auxMapStore(int player, int slot)
 {
@@ -176,12 +196,20 @@ static inline void auxMapRestore(int player, int slot, int mask)
 		cached = psAuxMap[MAX_PLAYERS + slot][i];
 		psAuxMap[player][i] = original ^ ((original ^ cached) & mask);
 	}
+	if ((mask & AUXBITS_THREAT) != 0)
+	{
+		auxMarkThreatDirty(player);
+	}
 }
 
 /// Set aux bits. Always set identically for all players. States not set are retained.
 WZ_DECL_ALWAYS_INLINE static inline void auxSet(int x, int y, int player, int state)
 {
 	psAuxMap[player][x + y * mapWidth] |= state;
+	if (player < MAX_PLAYERS)
+	{
+		auxMarkDirty(x, y);
+	}
 }
 
 /// Set aux bits. Always set identically for all players. States not set are retained.
@@ -193,6 +221,7 @@ WZ_DECL_ALWAYS_INLINE static inline void auxSetAll(int x, int y, int state)
 	{
 		psAuxMap[i][x + y * mapWidth] |= state;
 	}
+	auxMarkDirty(x, y);
 }
 
 /// Set aux bits. Always set identically for all players. States not set are retained.
@@ -207,6 +236,7 @@ WZ_DECL_ALWAYS_INLINE static inline void auxSetAllied(int x, int y, int player,
 			psAuxMap[i][x + y * mapWidth] |= state;
 		}
 	}
+	auxMarkDirty(x, y);
 }
 
 /// Set aux bits. Always set identically for all players. States not set are retained.
@@ -221,12 +251,17 @@ WZ_DECL_ALWAYS_INLINE static inline void auxSetEnemy(int x, int y, int player, i
 			psAuxMap[i][x + y * mapWidth] |= state;
 		}
 	}
+	auxMarkDirty(x, y);
 }
 
 /// Clear aux bits. Always set identically for all players. States not cleared are retained.
 WZ_DECL_ALWAYS_INLINE static inline void auxClear(int x, int y, int player, int state)
 {
 	psAuxMap[player][x + y * mapWidth] &= ~state;
+	if (player < MAX_PLAYERS)
+	{
+		auxMarkDirty(x, y);
+	}
 }
 
 /// Clear all aux bits. Always set identically for all players. States not cleared are retained.
@@ -238,18 +273,21 @@ WZ_DECL_ALWAYS_INLINE static inline void auxClearAll(int x, int y, int state)
 	{
 		psAuxMap[i][x + y * mapWidth] &= ~state;
 	}
+	auxMarkDirty(x, y);
 }
 
 /// Set blocking bits. Always set identically for all players. States not set are retained.
 WZ_DECL_ALWAYS_INLINE static inline void auxSetBlocking(int x, int y, int state)
 {
 	psBlockMap[0][x + y * mapWidth] |= state;
+	auxMarkDirty(x, y);
 }
 
 /// Clear blocking bits. Always set identically for all players. States not cleared are retained.
 WZ_DECL_ALWAYS_INLINE static inline void auxClearBlocking(int x, int y, int state)
 {
 	psBlockMap[0][x + y * mapWidth] &= ~state;
+	auxMarkDirty(x, y);
 }
 
 /**
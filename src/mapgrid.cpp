@@ -32,17 +32,49 @@
 #include "pointtree.h"
 
 
-static PointTree *gridPointTree = nullptr;  // A quad-tree-like object.
-static PointTree::Filter *gridFiltersUnseen;
-static PointTree::Filter *gridFiltersDroidsByPlayer;
+/// The objects which never move (structures and features) are kept in a separate tree from the droids, so that
+/// the tree of structures and features only needs updating when they are built or destroyed.
+enum GridLayer
+{
+	GRID_STATIC,
+	GRID_DYNAMIC,
+	GRID_LAYERS
+};
+
+/// Where an object was put into the grid.
+struct GridEntry
+{
+	BASE_OBJECT *psObj;      ///< Not dereferenced unless the object was found in an object list this tick, might have been freed.
+	uint32_t id;
+	int32_t x, y;
+	uint8_t layer;
+	bool markedSeen;         ///< Whether the entry is in gridSeenEntries.
+	uint32_t lastSeen;       ///< Value of gridGeneration when the object was last found in an object list.
+};
 
+static PointTree *gridPointTrees[GRID_LAYERS] = {nullptr, nullptr};  // Quad-tree-like objects.
+static PointTree::Filter *gridFiltersUnseen[GRID_LAYERS];
+static PointTree::Filter *gridFiltersDroidsByPlayer[GRID_LAYERS];
+static std::vector<GridEntry> gridEntries;  ///< Every object in the grid. BASE_OBJECT::gridIndex is the index of its entry.
+static uint32_t gridGeneration = 0;         ///< Incremented by gridReset.
+static std::vector<uint32_t> gridSeenEntries;  ///< Entries of the objects whose seenThisTick was set since the last gridReset.
+static bool gridStaticChanged = true;       ///< Whether a structure or feature was added or removed since the last gridReset.
+static BASE_OBJECT *gridStaticListHeads[2][MAX_PLAYERS];  ///< apsStructLists and apsFeatureLists at the last gridReset, to notice the lists being swapped.
+static size_t gridNumStaticEntries = 0;     ///< Number of entries in the GRID_STATIC layer.
 // initialise the grid system
 bool gridInitialise()
 {
-	ASSERT(gridPointTree == nullptr, "gridInitialise already called, without calling gridShutDown.");
-	gridPointTree = new PointTree;
-	gridFiltersUnseen = new PointTree::Filter[MAX_PLAYERS];
-	gridFiltersDroidsByPlayer = new PointTree::Filter[MAX_PLAYERS];
+	ASSERT(gridPointTrees[GRID_STATIC] == nullptr, "gridInitialise already called, without calling gridShutDown.");
+	for (unsigned layer = 0; layer < GRID_LAYERS; ++layer)
+	{
+		gridPointTrees[layer] = new PointTree;
+		gridFiltersUnseen[layer] = new PointTree::Filter[MAX_PLAYERS];
+		gridFiltersDroidsByPlayer[layer] = new PointTree::Filter[MAX_PLAYERS];
+	}
+	gridEntries.clear();
+	gridSeenEntries.clear();
+	gridStaticChanged = true;
+	gridNumStaticEntries = 0;
 
 	return true;  // Yay, nothing failed!
 }
@@ -50,46 +82,133 @@ bool gridInitialise()
 // reset the grid system
 void gridReset()
 {
-	gridPointTree->clear();
+	++gridGeneration;
+
+	// Structures and features never move, so their lists only need walking if something was added or removed, or the lists were swapped.
+	bool walkStatic = gridStaticChanged;
+	for (unsigned player = 0; player < MAX_PLAYERS; player++)
+	{
+		walkStatic = walkStatic || gridStaticListHeads[0][player] != apsStructLists[player] || gridStaticListHeads[1][player] != apsFeatureLists[player];
+		gridStaticListHeads[0][player] = apsStructLists[player];
+		gridStaticListHeads[1][player] = apsFeatureLists[player];
+	}
+	gridStaticChanged = false;
 
-	// Put all existing objects into the point tree.
+	// Find objects which moved or are new. Objects which didn't move stay where they are.
+	size_t numFound = walkStatic ? 0 : gridNumStaticEntries;
 	for (unsigned player = 0; player < MAX_PLAYERS; player++)
 	{
 		BASE_OBJECT *start[3] = {(BASE_OBJECT *)apsDroidLists[player], (BASE_OBJECT *)apsStructLists[player], (BASE_OBJECT *)apsFeatureLists[player]};
-		for (unsigned type = 0; type != sizeof(start) / sizeof(*start); ++type)
+		for (unsigned type = 0; type != (walkStatic ? 3 : 1); ++type)
 		{
 			for (BASE_OBJECT *psObj = start[type]; psObj != nullptr; psObj = psObj->psNext)
 			{
 				if (!psObj->died)
 				{
-					gridPointTree->insert(psObj, psObj->pos.x, psObj->pos.y);
-					for (unsigned char &viewer : psObj->seenThisTick)
+					GridEntry *entry = psObj->gridIndex < gridEntries.size() ? &gridEntries[psObj->gridIndex] : nullptr;
+					if (entry == nullptr || entry->psObj != psObj || entry->id != psObj->id || entry->lastSeen == gridGeneration)
 					{
-						viewer = 0;
+						// New object, or a new object allocated where an old one was. It may have been seen before it had an entry.
+						memset(psObj->seenThisTick, 0, sizeof(psObj->seenThisTick));
+						psObj->gridIndex = gridEntries.size();
+						gridEntries.push_back({psObj, psObj->id, psObj->pos.x, psObj->pos.y, uint8_t(psObj->type == OBJ_DROID ? GRID_DYNAMIC : GRID_STATIC), false, gridGeneration});
+						gridPointTrees[gridEntries.back().layer]->insert(psObj, psObj->pos.x, psObj->pos.y, psObj->id);
+						gridNumStaticEntries += gridEntries.back().layer == GRID_STATIC;
 					}
+					else
+					{
+						entry->lastSeen = gridGeneration;
+						if (entry->x != psObj->pos.x || entry->y != psObj->pos.y)
+						{
+							PointTree *pointTree = gridPointTrees[entry->layer];
+							pointTree->erase(psObj, entry->x, entry->y, entry->id);
+							pointTree->insert(psObj, psObj->pos.x, psObj->pos.y, psObj->id);
+							entry->x = psObj->pos.x;
+							entry->y = psObj->pos.y;
+						}
+					}
+					++numFound;
 				}
 			}
 		}
 	}
 
-	gridPointTree->sort();
+	// Clear seenThisTick of the objects seen since the last reset. Entries not found in the object lists may be for freed objects.
+	for (uint32_t index : gridSeenEntries)
+	{
+		GridEntry &entry = gridEntries[index];
+		entry.markedSeen = false;
+		if (entry.lastSeen == gridGeneration || (entry.layer == GRID_STATIC && !walkStatic))
+		{
+			memset(entry.psObj->seenThisTick, 0, sizeof(entry.psObj->seenThisTick));
+		}
+	}
+	gridSeenEntries.clear();
+
+	// Remove objects which died or were removed from the object lists, without touching the (possibly freed) objects.
+	if (numFound != gridEntries.size())
+	{
+		size_t n = 0;
+		gridNumStaticEntries = 0;
+		for (GridEntry &entry : gridEntries)
+		{
+			if (entry.lastSeen != gridGeneration && (walkStatic || entry.layer == GRID_DYNAMIC))
+			{
+				gridPointTrees[entry.layer]->erase(entry.psObj, entry.x, entry.y, entry.id);
+				continue;
+			}
+			entry.psObj->gridIndex = n;
+			gridEntries[n++] = entry;
+			gridNumStaticEntries += entry.layer == GRID_STATIC;
+		}
+		gridEntries.resize(n);
+	}
+
+	for (unsigned layer = 0; layer < GRID_LAYERS; ++layer)
+	{
+		gridPointTrees[layer]->sort();
+
+		for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+		{
+			gridFiltersUnseen[layer][player].reset(*gridPointTrees[layer]);
+			gridFiltersDroidsByPlayer[layer][player].reset(*gridPointTrees[layer]);
+		}
+	}
+}
 
-	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+void gridMarkSeen(BASE_OBJECT *psObj)
+{
+	// Objects without an entry yet get seenThisTick cleared when gridReset adds them.
+	if (psObj->gridIndex < gridEntries.size())
 	{
-		gridFiltersUnseen[player].reset(*gridPointTree);
-		gridFiltersDroidsByPlayer[player].reset(*gridPointTree);
+		GridEntry &entry = gridEntries[psObj->gridIndex];
+		if (entry.psObj == psObj && entry.id == psObj->id && !entry.markedSeen)
+		{
+			entry.markedSeen = true;
+			gridSeenEntries.push_back(psObj->gridIndex);
+		}
 	}
 }
 
+void gridStaticObjectsChanged()
+{
+	gridStaticChanged = true;
+}
+
 // shutdown the grid system
 void gridShutDown()
 {
-	delete gridPointTree;
-	gridPointTree = nullptr;
-	delete[] gridFiltersUnseen;
-	gridFiltersUnseen = nullptr;
-	delete[] gridFiltersDroidsByPlayer;
-	gridFiltersDroidsByPlayer = nullptr;
+	for (unsigned layer = 0; layer < GRID_LAYERS; ++layer)
+	{
+		delete gridPointTrees[layer];
+		gridPointTrees[layer] = nullptr;
+		delete[] gridFiltersUnseen[layer];
+		gridFiltersUnseen[layer] = nullptr;
+		delete[] gridFiltersDroidsByPlayer[layer];
+		gridFiltersDroidsByPlayer[layer] = nullptr;
+	}
+	gridEntries.clear();
+	gridSeenEntries.clear();
 }
 
 static bool isInRadius(int32_t x, int32_t y, uint32_t radius)
@@ -101,56 +220,68 @@ static bool isInRadius(int32_t x, int32_t y, uint32_t radius)
 // initialise the grid system to start iterating through units that
 // could affect a location (x,y in world coords)
 template<class Condition>
-static GridList const &gridStartIterateFiltered(int32_t x, int32_t y, uint32_t radius, PointTree::Filter *filter, Condition const &condition)
+static GridList const &gridStartIterateFiltered(int32_t x, int32_t y, uint32_t radius, PointTree::Filter **filters, Condition const &condition)
 {
-	if (filter == nullptr)
+	for (unsigned layer = 0; layer < GRID_LAYERS; ++layer)
 	{
-		gridPointTree->query(x, y, radius);
+		gridPointTrees[layer]->query(*filters[layer], x, y, radius);
 	}
-	else
-	{
-		gridPointTree->query(*filter, x, y, radius);
-	}
-	PointTree::ResultVector::iterator w = gridPointTree->lastQueryResults.begin(), i;
-	for (i = w; i != gridPointTree->lastQueryResults.end(); ++i)
+
+	// Merge the results of both layers, so they are in the same order as if all objects were in one tree.
+	static GridList gridList;
+	gridList.clear();
+	PointTree::ResultVector const &results0 = gridPointTrees[0]->lastQueryResults, &results1 = gridPointTrees[1]->lastQueryResults;
+	size_t i[GRID_LAYERS] = {0, 0};
+	while (i[0] < results0.size() || i[1] < results1.size())
 	{
-		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>(*i);
+		unsigned layer = i[0] == results0.size() || (i[1] < results1.size() && PointTree::isBefore(results1[i[1]], results0[i[0]])) ? 1 : 0;
+		size_t n = i[layer]++;
+		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>(gridPointTrees[layer]->lastQueryResults[n].data);
 		if (!condition.test(obj))  // Check if we should skip this object.
 		{
-			filter->erase(gridPointTree->lastFilteredQueryIndices[i - gridPointTree->lastQueryResults.begin()]);  // Stop the object from appearing in future searches.
+			filters[layer]->erase(gridPointTrees[layer]->lastFilteredQueryIndices[n]);  // Stop the object from appearing in future searches.
 		}
 		else if (isInRadius(obj->pos.x - x, obj->pos.y - y, radius))  // Check that search result is less than radius (since they can be up to a factor of sqrt(2) more).
 		{
-			*w = *i;
-			++w;
+			gridList.push_back(obj);
 		}
 	}
-	gridPointTree->lastQueryResults.erase(w, i);  // Erase all points that were a bit too far.
 	/*
 	// In case you are curious.
-	debug(LOG_WARNING, "gridStartIterateFiltered(%d, %d, %u) found %u objects", x, y, radius, (unsigned)gridPointTree->lastQueryResults.size());
+	debug(LOG_WARNING, "gridStartIterateFiltered(%d, %d, %u) found %u objects", x, y, radius, (unsigned)gridList.size());
 	*/
-	static GridList gridList;
-	gridList.resize(gridPointTree->lastQueryResults.size());
-	for (unsigned n = 0; n < gridList.size(); ++n)
-	{
-		gridList[n] = (BASE_OBJECT *)gridPointTree->lastQueryResults[n];
-	}
 	return gridList;
 }
 
-template<class Condition>
-static GridList const &gridStartIterateFilteredArea(int32_t x, int32_t y, int32_t x2, int32_t y2, Condition const &condition)
+/// Calls visit(obj) for each object in the square (or rectangle) of the cursors which passes the condition. The layers
+/// are merged, so that the objects are in the same order as if all objects were in one tree. Doesn't modify anything.
+template<class Condition, class Visit>
+static void gridVisitCursors(PointTree::Cursor staticCursor, PointTree::Cursor dynamicCursor, Condition const &condition, Visit const &visit)
 {
-	gridPointTree->query(x, y, x2, y2);
-
-	static GridList gridList;
-	gridList.resize(gridPointTree->lastQueryResults.size());
-	for (unsigned n = 0; n < gridList.size(); ++n)
+	PointTree::Cursor *cursors[GRID_LAYERS] = {&staticCursor, &dynamicCursor};
+	while (cursors[0]->valid() || cursors[1]->valid())
 	{
-		gridList[n] = (BASE_OBJECT *)gridPointTree->lastQueryResults[n];
+		bool dynamicFirst = !cursors[0]->valid() || (cursors[1]->valid() && PointTree::isBefore(**cursors[1], **cursors[0]));
+		PointTree::Cursor &cursor = *cursors[dynamicFirst ? GRID_DYNAMIC : GRID_STATIC];
+		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>((*cursor).data);
+		cursor.next();
+		if (condition.test(obj))
+		{
+			visit(obj);
+		}
 	}
-	return gridList;
+}
+
+/// Visits objects within radius, which pass the condition.
+template<class Condition, class Visit>
+static void gridVisitRadius(int32_t x, int32_t y, uint32_t radius, Condition const &condition, Visit const &visit)
+{
+	gridVisitCursors(gridPointTrees[GRID_STATIC]->cursor(x, y, radius), gridPointTrees[GRID_DYNAMIC]->cursor(x, y, radius), condition, [&](BASE_OBJECT *obj) {
+		if (isInRadius(obj->pos.x - x, obj->pos.y - y, radius))  // Check that search result is less than radius (since they can be up to a factor of sqrt(2) more).
+		{
+			visit(obj);
+		}
+	});
 }
 
 struct ConditionTrue
@@ -163,12 +294,27 @@ struct ConditionTrue
 
 GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius)
 {
-	return gridStartIterateFiltered(x, y, radius, nullptr, ConditionTrue());
+	static GridList gridList;
+	return gridStartIterate(x, y, radius, gridList);
+}
+
+GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius, GridList &buffer)
+{
+	buffer.clear();
+	gridVisitRadius(x, y, radius, ConditionTrue(), [&](BASE_OBJECT *obj) {
+		buffer.push_back(obj);
+	});
+	return buffer;
 }
 
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
 {
-	return gridStartIterateFilteredArea(x, y, x2, y2, ConditionTrue());
+	static GridList gridList;
+	gridList.clear();
+	gridVisitCursors(gridPointTrees[GRID_STATIC]->cursor(x, y, x2, y2), gridPointTrees[GRID_DYNAMIC]->cursor(x, y, x2, y2), ConditionTrue(), [](BASE_OBJECT *obj) {
+		gridList.push_back(obj);
+	});
+	return gridList;
 }
 
 struct ConditionDroidsByPlayer
@@ -183,7 +329,8 @@ struct ConditionDroidsByPlayer
 
 GridList const &gridStartIterateDroidsByPlayer(int32_t x, int32_t y, uint32_t radius, int player)
 {
-	return gridStartIterateFiltered(x, y, radius, &gridFiltersDroidsByPlayer[player], ConditionDroidsByPlayer(player));
+	PointTree::Filter *filters[GRID_LAYERS] = {&gridFiltersDroidsByPlayer[GRID_STATIC][player], &gridFiltersDroidsByPlayer[GRID_DYNAMIC][player]};
+	return gridStartIterateFiltered(x, y, radius, filters, ConditionDroidsByPlayer(player));
 }
 
 struct ConditionUnseen
@@ -198,13 +345,31 @@ struct ConditionUnseen
 
 GridList const &gridStartIterateUnseen(int32_t x, int32_t y, uint32_t radius, int player)
 {
-	return gridStartIterateFiltered(x, y, radius, &gridFiltersUnseen[player], ConditionUnseen(player));
+	PointTree::Filter *filters[GRID_LAYERS] = {&gridFiltersUnseen[GRID_STATIC][player], &gridFiltersUnseen[GRID_DYNAMIC][player]};
+	return gridStartIterateFiltered(x, y, radius, filters, ConditionUnseen(player));
 }
 
-BASE_OBJECT **gridIterateDup()
+GridList const &gridStartIterateUnseen(int32_t x, int32_t y, uint32_t radius, int player, GridList &buffer)
 {
-	size_t bytes = gridPointTree->lastQueryResults.size() * sizeof(void *);
-	BASE_OBJECT **ret = (BASE_OBJECT **)malloc(bytes);
-	memcpy(ret, &gridPointTree->lastQueryResults[0], bytes);
-	return ret;
+	buffer.clear();
+	gridVisitRadius(x, y, radius, ConditionUnseen(player), [&](BASE_OBJECT *obj) {
+		buffer.push_back(obj);
+	});
+	return buffer;
+}
+
+void gridVisitFunction(int32_t x, int32_t y, uint32_t radius, int unseenPlayer, GridVisitorFunction function, void *context)
+{
+	if (unseenPlayer >= 0)
+	{
+		gridVisitRadius(x, y, radius, ConditionUnseen(unseenPlayer), [&](BASE_OBJECT *obj) {
+			function(obj, context);
+		});
+	}
+	else
+	{
+		gridVisitRadius(x, y, radius, ConditionTrue(), [&](BASE_OBJECT *obj) {
+			function(obj, context);
+		});
+	}
 }
@@ -34,12 +34,23 @@ bool gridInitialise();
 void gridShutDown();
 
 // Reset the grid system. Called once per update.
-// Resets seenThisTick[] to false.
+// Resets seenThisTick[] to false. Only objects which moved, appeared or disappeared since the last reset are updated.
 void gridReset();
 
+/// Call after setting psObj->seenThisTick[], so that the next gridReset clears it.
+void gridMarkSeen(BASE_OBJECT *psObj);
+
+/// Call when a structure or feature is added to or removed from an object list, so that the next gridReset looks for them.
+void gridStaticObjectsChanged();
+
 /// Find all objects within radius.
+/// Not thread safe, the returned list is overwritten by the next call.
 GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius);
 
+/// Find all objects within radius, into the caller's buffer, which is returned.
+/// Thread safe, as long as each thread uses its own buffer and the grid isn't being reset.
+GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius, GridList &buffer);
+
 /// Find all objects within radius.
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2);
 
@@ -50,4 +61,33 @@ GridList const &gridStartIterateDroidsByPlayer(int32_t x, int32_t y, uint32_t ra
 /// Find all objects within radius where object->seenThisTick[player] != 255.
 GridList const &gridStartIterateUnseen(int32_t x, int32_t y, uint32_t radius, int player);
 
+/// Find all objects within radius where object->seenThisTick[player] != 255, into the caller's buffer, which is returned.
+/// Thread safe, as long as each thread uses its own buffer and the grid isn't being reset.
+GridList const &gridStartIterateUnseen(int32_t x, int32_t y, uint32_t radius, int player, GridList &buffer);
+
+typedef void (*GridVisitorFunction)(BASE_OBJECT *psObj, void *context);
+
+/// Calls function(psObj, context) for each object within radius, in the same order as gridStartIterate, or for each object
+/// which gridStartIterateUnseen would find, if unseenPlayer >= 0. Doesn't allocate, and is thread safe as long as the grid
+/// isn't being reset. Objects are checked just before visiting them, not all at the start.
+void gridVisitFunction(int32_t x, int32_t y, uint32_t radius, int unseenPlayer, GridVisitorFunction function, void *context);
+
+/// Calls visitor(psObj) for each object within radius, like gridVisitFunction.
+template<typename Visitor>
+static inline void gridVisit(int32_t x, int32_t y, uint32_t radius, Visitor visitor)
+{
+	gridVisitFunction(x, y, radius, -1, [](BASE_OBJECT *psObj, void *context) {
+		(*static_cast<Visitor *>(context))(psObj);
+	}, &visitor);
+}
+
+/// Calls visitor(psObj) for each object within radius where object->seenThisTick[player] != 255, like gridVisitFunction.
+template<typename Visitor>
+static inline void gridVisitUnseen(int32_t x, int32_t y, uint32_t radius, int player, Visitor visitor)
+{
+	gridVisitFunction(x, y, radius, player, [](BASE_OBJECT *psObj, void *context) {
+		(*static_cast<Visitor *>(context))(psObj);
+	}, &visitor);
+}
+
 #endif // __INCLUDED_SRC_MAPGRID_H__
@@ -44,6 +44,7 @@
 #include "mapgrid.h"
 #include "multirecv.h"
 #include "transporter.h"
+#include "loop.h"
 
 #include <vector>
 #include <algorithm>
@@ -175,6 +176,7 @@ struct QueuedDroidInfo
 };
 
 static std::vector<QueuedDroidInfo> queuedOrders;
+static DroidInfoStatistics droidInfoStats;
 
 
 // ////////////////////////////////////////////////////////////////////////////
@@ -504,12 +506,83 @@ static void NETQueuedDroidInfo(QueuedDroidInfo *info)
 	}
 }
 
+/// A run of droid IDs, the first one is delta more than the previous ID, the rest are each one more than the ID before.
+struct DroidIdRun
+{
+	uint32_t delta;
+	uint32_t extra;  ///< Number of IDs in the run after the first.
+};
+
+/** Encodes the sorted droid IDs of orders [begin, end) as runs of consecutive IDs. Each run is one number, the delta from the
+ *  previous ID, shifted left by 1, with the lowest bit set if it is followed by the number of extra IDs in the run. Returns false
+ *  if the deltas are too large to be shifted, or if the plain deltas would be no longer, in which case plain deltas are sent.
+ */
+static bool droidIdRuns(std::vector<QueuedDroidInfo>::const_iterator begin, std::vector<QueuedDroidInfo>::const_iterator end, std::vector<DroidIdRun> &runs, size_t &plainSize)
+{
+	runs.clear();
+	plainSize = 0;
+	bool fits = true;
+	uint32_t prevDroidId = 0;
+	for (auto i = begin; i != end; ++i)
+	{
+		uint32_t delta = i->droidId - prevDroidId;
+		plainSize += encodedlength_uint32_t(delta);
+		if (!runs.empty() && delta == 1)
+		{
+			++runs.back().extra;
+		}
+		else
+		{
+			fits = fits && delta < 0x80000000;
+			runs.push_back(DroidIdRun {delta, 0});
+		}
+		prevDroidId = i->droidId;
+	}
+	if (!fits)
+	{
+		return false;
+	}
+	size_t runSize = 0;
+	for (DroidIdRun const &run : runs)
+	{
+		runSize += encodedlength_uint32_t(run.delta << 1 | (run.extra != 0)) + (run.extra != 0 ? encodedlength_uint32_t(run.extra - 1) : 0);
+	}
+	return runSize < plainSize;
+}
+
 // Actually send the droid info.
 void sendQueuedDroidInfo()
 {
+	if (queuedOrders.empty())
+	{
+		return;
+	}
+
+	droidInfoStats.orders += queuedOrders.size();
+
 	// Sort queued orders, to group the same order to multiple droids.
 	std::sort(queuedOrders.begin(), queuedOrders.end());
 
+	// Drop repeated orders to the same droid. Giving a droid the order it was just given does nothing more, but adding the same order to its list twice does.
+	auto newEnd = std::unique(queuedOrders.begin(), queuedOrders.end(), [](QueuedDroidInfo const &a, QueuedDroidInfo const &b) {
+		return a.droidId == b.droidId && a.orderCompare(b) == 0 && (a.subType == SecondaryOrder || !a.add);
+	});
+	droidInfoStats.duplicates += queuedOrders.end() - newEnd;
+	queuedOrders.erase(newEnd, queuedOrders.end());
+
+	// Count the groups of orders which differ only by the droid ID.
+	uint32_t numGroups = 1;
+	for (auto i = queuedOrders.begin() + 1; i != queuedOrders.end(); ++i)
+	{
+		numGroups += i->orderCompare(*(i - 1)) != 0;
+	}
+
+	// All the groups go in a single message, rather than one message per group.
+	NETbeginEncode(NETgameQueue(selectedPlayer), GAME_DROIDINFO);
+	NETuint32_t(&numGroups);
+
+	std::vector<DroidIdRun> runs;
+	size_t unbatchedSize = 0;  // Size of one message per group, with plain deltas, as sent before batching.
 	std::vector<QueuedDroidInfo>::iterator eqBegin, eqEnd;
 	for (eqBegin = queuedOrders.begin(); eqBegin != queuedOrders.end(); eqBegin = eqEnd)
 	{
@@ -517,30 +590,67 @@ void sendQueuedDroidInfo()
 		for (eqEnd = eqBegin + 1; eqEnd != queuedOrders.end() && eqEnd->orderCompare(*eqBegin) == 0; ++eqEnd)
 		{}
 
-		NETbeginEncode(NETgameQueue(selectedPlayer), GAME_DROIDINFO);
+		size_t headerStart = NETencodedSize();
 		NETQueuedDroidInfo(&*eqBegin);
+		size_t headerSize = NETencodedSize() - headerStart;
 
 		uint32_t num = eqEnd - eqBegin;
-		NETuint32_t(&num);
+		size_t plainSize = 0;
+		bool useRuns = droidIdRuns(eqBegin, eqEnd, runs, plainSize);
+
+		// The lowest bit of the count says whether the IDs are encoded as runs.
+		uint32_t numAndFormat = num << 1 | useRuns;
+		NETuint32_t(&numAndFormat);
 
-		uint32_t prevDroidId = 0;
-		for (unsigned n = 0; n < num; ++n)
+		if (useRuns)
 		{
-			uint32_t droidId = (eqBegin + n)->droidId;
+			for (DroidIdRun const &run : runs)
+			{
+				uint32_t deltaAndHasExtra = run.delta << 1 | (run.extra != 0);
+				NETuint32_t(&deltaAndHasExtra);
+				if (run.extra != 0)
+				{
+					uint32_t extraMinusOne = run.extra - 1;
+					NETuint32_t(&extraMinusOne);
+				}
+			}
+		}
+		else
+		{
+			uint32_t prevDroidId = 0;
+			for (unsigned n = 0; n < num; ++n)
+			{
+				uint32_t droidId = (eqBegin + n)->droidId;
 
-			// Encode deltas between droid IDs, since the deltas are smaller than the actual droid IDs, and will encode to less bytes on average.
-			uint32_t deltaDroidId = droidId - prevDroidId;
-			NETuint32_t(&deltaDroidId);
+				// Encode deltas between droid IDs, since the deltas are smaller than the actual droid IDs, and will encode to less bytes on average.
+				uint32_t deltaDroidId = droidId - prevDroidId;
+				NETuint32_t(&deltaDroidId);
 
-			prevDroidId = droidId;
+				prevDroidId = droidId;
+			}
 		}
-		NETend();
+
+		size_t groupSize = headerSize + encodedlength_uint32_t(num) + plainSize;
+		unbatchedSize += 1 + encodedlength_uint32_t(groupSize) + groupSize;
 	}
 
+	size_t size = NETencodedSize();
+	NETend();
+
+	size_t messageSize = 1 + encodedlength_uint32_t(size) + size;
+	++droidInfoStats.messages;
+	droidInfoStats.bytes += messageSize;
+	droidInfoStats.bytesSaved += unbatchedSize > messageSize ? unbatchedSize - messageSize : 0;
+
 	// Sent the orders. Don't send them again.
 	queuedOrders.clear();
 }
 
+DroidInfoStatistics const &getDroidInfoStatistics()
+{
+	return droidInfoStats;
+}
+
 DROID_ORDER_DATA infoToOrderData(QueuedDroidInfo const &info, STRUCTURE_STATS const *psStats)
 {
 	DROID_ORDER_DATA sOrder;
@@ -613,102 +723,149 @@ void sendDroidInfo(DROID *psDroid, DroidOrder const &order, bool add)
 
 // ////////////////////////////////////////////////////////////////////////////
 // receive droid information form other players.
-bool recvDroidInfo(NETQUEUE queue)
+static void recvDroidInfoGroup(NETQUEUE queue)
 {
-	NETbeginDecode(queue, GAME_DROIDINFO);
+	QueuedDroidInfo info;
+	NETQueuedDroidInfo(&info);
+
+	STRUCTURE_STATS *psStats = nullptr;
+	if (info.subType == LocOrder && (info.order == DORDER_BUILD || info.order == DORDER_LINEBUILD))
 	{
-		QueuedDroidInfo info;
-		NETQueuedDroidInfo(&info);
+		// Find structure target
+		for (unsigned typeIndex = 0; typeIndex < numStructureStats; typeIndex++)
+		{
+			if (asStructureStats[typeIndex].ref == info.structRef)
+			{
+				psStats = asStructureStats + typeIndex;
+				break;
+			}
+		}
+	}
+
+	switch (info.subType)
+	{
+	case ObjOrder:       syncDebug("Order=%s,%d(%d)", getDroidOrderName(info.order), info.destId, info.destType); break;
+	case LocOrder:       syncDebug("Order=%s,(%d,%d)", getDroidOrderName(info.order), info.pos.x, info.pos.y); break;
+	case SecondaryOrder: syncDebug("SecondaryOrder=%d,%08X", (int)info.secOrder, (int)info.secState); break;
+	}
+
+	DROID_ORDER_DATA sOrder = infoToOrderData(info, psStats);
+
+	uint32_t numAndFormat = 0;
+	NETuint32_t(&numAndFormat);
+	uint32_t num = numAndFormat >> 1;
+	bool useRuns = (numAndFormat & 1) != 0;
+
+	// A run of consecutive IDs can't be longer than the number of droids the player has. The IDs in a run cost no bytes to read, so without this a bad message could loop for billions of IDs.
+	uint32_t maxRun = info.player < MAX_PLAYERS ? getNumDroids(info.player) + getNumMissionDroids(info.player) + getNumTransporterDroids(info.player) : 0;
+
+	uint32_t runLeft = 0;  // Number of IDs left in the current run of consecutive IDs.
+	for (unsigned n = 0; n < num; ++n)
+	{
+		if (runLeft == 0 && NETdecodeBytesLeft() == 0)
+		{
+			debug(LOG_WARNING, "Droid order group from %d ended after %u of %u droids.", queue.index, n, num);
+			break;  // The message ended early, so the rest of the IDs would all read as 0.
+		}
 
-		STRUCTURE_STATS *psStats = nullptr;
-		if (info.subType == LocOrder && (info.order == DORDER_BUILD || info.order == DORDER_LINEBUILD))
+		// Get the next droid ID which is being given this order.
+		if (runLeft > 0)
+		{
+			--runLeft;
+			++info.droidId;
+		}
+		else if (useRuns)
 		{
-			// Find structure target
-			for (unsigned typeIndex = 0; typeIndex < numStructureStats; typeIndex++)
+			uint32_t deltaAndHasExtra = 0;
+			NETuint32_t(&deltaAndHasExtra);
+			info.droidId += deltaAndHasExtra >> 1;
+			if ((deltaAndHasExtra & 1) != 0)
 			{
-				if (asStructureStats[typeIndex].ref == info.structRef)
+				NETuint32_t(&runLeft);
+				if (runLeft > maxRun)
 				{
-					psStats = asStructureStats + typeIndex;
-					break;
+					debug(LOG_WARNING, "Droid order from %d has a run of %u more IDs, but player %d has only %u droids.", queue.index, runLeft, info.player, maxRun);
+					runLeft = maxRun;
 				}
+				++runLeft;
 			}
 		}
+		else
+		{
+			uint32_t deltaDroidId = 0;
+			NETuint32_t(&deltaDroidId);
+			info.droidId += deltaDroidId;
+		}
 
-		switch (info.subType)
+		DROID *psDroid = IdToDroid(info.droidId, info.player);
+		if (!psDroid)
+		{
+			debug(LOG_NEVER, "Packet from %d refers to non-existent droid %u, [%s : p%d]",
+			      queue.index, info.droidId, isHumanPlayer(info.player) ? "Human" : "AI", info.player);
+			syncDebug("Droid %d missing", info.droidId);
+			continue;  // Can't find the droid, so skip this droid.
+		}
+		if (!canGiveOrdersFor(queue.index, psDroid->player))
 		{
-		case ObjOrder:       syncDebug("Order=%s,%d(%d)", getDroidOrderName(info.order), info.destId, info.destType); break;
-		case LocOrder:       syncDebug("Order=%s,(%d,%d)", getDroidOrderName(info.order), info.pos.x, info.pos.y); break;
-		case SecondaryOrder: syncDebug("SecondaryOrder=%d,%08X", (int)info.secOrder, (int)info.secState); break;
+			debug(LOG_WARNING, "Droid order (by %d) for wrong player (%d).", queue.index, psDroid->player);
+			syncDebug("Wrong player.");
+			continue;
 		}
 
-		DROID_ORDER_DATA sOrder = infoToOrderData(info, psStats);
+		CHECK_DROID(psDroid);
 
-		uint32_t num = 0;
-		NETuint32_t(&num);
+		syncDebugDroid(psDroid, '<');
 
-		for (unsigned n = 0; n < num; ++n)
+		switch (info.subType)
 		{
-			// Get the next droid ID which is being given this order.
-			uint32_t deltaDroidId = 0;
-			NETuint32_t(&deltaDroidId);
-			info.droidId += deltaDroidId;
-
-			DROID *psDroid = IdToDroid(info.droidId, info.player);
-			if (!psDroid)
-			{
-				debug(LOG_NEVER, "Packet from %d refers to non-existent droid %u, [%s : p%d]",
-				      queue.index, info.droidId, isHumanPlayer(info.player) ? "Human" : "AI", info.player);
-				syncDebug("Droid %d missing", info.droidId);
-				continue;  // Can't find the droid, so skip this droid.
-			}
-			if (!canGiveOrdersFor(queue.index, psDroid->player))
+		case ObjOrder:
+		case LocOrder:
+			/*
+			* If the current order not is a command order and we are not a
+			* commander yet are in the commander group remove us from it.
+			*/
+			if (hasCommander(psDroid))
 			{
-				debug(LOG_WARNING, "Droid order (by %d) for wrong player (%d).", queue.index, psDroid->player);
-				syncDebug("Wrong player.");
-				continue;
+				psDroid->psGroup->remove(psDroid);
 			}
 
-			CHECK_DROID(psDroid);
-
-			syncDebugDroid(psDroid, '<');
-
-			switch (info.subType)
+			if (sOrder.psObj != TargetMissing)  // Only do order if the target didn't die.
 			{
-			case ObjOrder:
-			case LocOrder:
-				/*
-				* If the current order not is a command order and we are not a
-				* commander yet are in the commander group remove us from it.
-				*/
-				if (hasCommander(psDroid))
+				if (!info.add)
 				{
-					psDroid->psGroup->remove(psDroid);
+					orderDroidListEraseRange(psDroid, 0, psDroid->listSize + 1);  // Clear all non-pending orders, plus the first pending order (which is probably the order we just received).
+					orderDroidBase(psDroid, &sOrder);  // Execute the order immediately (even if in the middle of another order.
 				}
-
-				if (sOrder.psObj != TargetMissing)  // Only do order if the target didn't die.
+				else
 				{
-					if (!info.add)
-					{
-						orderDroidListEraseRange(psDroid, 0, psDroid->listSize + 1);  // Clear all non-pending orders, plus the first pending order (which is probably the order we just received).
-						orderDroidBase(psDroid, &sOrder);  // Execute the order immediately (even if in the middle of another order.
-					}
-					else
-					{
-						orderDroidAdd(psDroid, &sOrder);   // Add the order to the (non-pending) list. Will probably overwrite the corresponding pending order, assuming all pending orders were written to the list.
-					}
+					orderDroidAdd(psDroid, &sOrder);   // Add the order to the (non-pending) list. Will probably overwrite the corresponding pending order, assuming all pending orders were written to the list.
 				}
-				break;
-			case SecondaryOrder:
-				// Set the droids secondary order
-				turnOffMultiMsg(true);
-				secondarySetState(psDroid, info.secOrder, info.secState);
-				turnOffMultiMsg(false);
-				break;
 			}
+			break;
+		case SecondaryOrder:
+			// Set the droids secondary order
+			turnOffMultiMsg(true);
+			secondarySetState(psDroid, info.secOrder, info.secState);
+			turnOffMultiMsg(false);
+			break;
+		}
 
-			syncDebugDroid(psDroid, '>');
+		syncDebugDroid(psDroid, '>');
 
-			CHECK_DROID(psDroid);
+		CHECK_DROID(psDroid);
+	}
+}
+
+bool recvDroidInfo(NETQUEUE queue)
+{
+	NETbeginDecode(queue, GAME_DROIDINFO);
+	{
+		uint32_t numGroups = 0;
+		NETuint32_t(&numGroups);
+		// Every group takes at least a few bytes, so stop at the end of the message rather than trusting numGroups.
+		for (unsigned group = 0; group < numGroups && NETdecodeBytesLeft() > 0; ++group)
+		{
+			recvDroidInfoGroup(queue);
 		}
 	}
 	NETend();
@@ -62,6 +62,7 @@
 
 #include "lib/gamelib/gtime.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netreplay.h"
 #include "lib/widget/editbox.h"
 #include "lib/widget/button.h"
 #include "lib/widget/scrollablelist.h"
@@ -101,6 +102,7 @@
 #include "notifications.h"
 #include "wztime.h"
 
+#include "benchmark.h"
 #include "multiplay.h"
 #include "multiint.h"
 #include "multijoin.h"
@@ -446,9 +448,9 @@ void loadMultiScripts()
 	uint32_t oldHash1 = DataHash[DATA_SCRIPT];
 	uint32_t oldHash2 = DataHash[DATA_SCRIPTVAL];
 
-	// Load AI players for skirmish games
+	// Load AI players for skirmish games. When playing back a replay, the AI orders are in the replay.
 	resForceBaseDir("multiplay/skirmish/");
-	if (bMultiPlayer && game.type == LEVEL_TYPE::SKIRMISH)
+	if (bMultiPlayer && game.type == LEVEL_TYPE::SKIRMISH && !NETisReplay())
 	{
 		for (unsigned i = 0; i < game.maxPlayers; i++)
 		{
@@ -478,7 +480,7 @@ void loadMultiScripts()
 	}
 
 	// Load scavengers
-	if (game.scavengers && myResponsibility(scavengerPlayer()))
+	if (game.scavengers && myResponsibility(scavengerPlayer()) && !NETisReplay())
 	{
 		debug(LOG_SAVE, "Loading scavenger AI for player %d", scavengerPlayer());
 		loadPlayerScript("multiplay/script/scavfact.js", scavengerPlayer(), AIDifficulty::EASY);
@@ -2495,6 +2497,10 @@ void WzMultiplayerOptionsTitleUI::addPlayerBox(bool players)
 static void SendFireUp()
 {
 	uint32_t randomSeed = rand();  // Pick a random random seed for the synchronised random number generator.
+	if (benchmarkEnabled())
+	{
+		randomSeed = benchmarkRandomSeed();  // Every benchmark run must simulate the same game.
+	}
 
 	NETbeginEncode(NETbroadcastQueue(), NET_FIREUP);
 	NETuint32_t(&randomSeed);
@@ -3805,6 +3811,47 @@ void startMultiplayerGame()
 	}
 }
 
+/// Starts the game recorded in a replay, with the settings from the replay instead of the ones chosen in the lobby.
+/// The game runs as a host without comms, so any messages it generates itself are dropped in favour of the recorded ones.
+bool startReplayGame(std::string const &filename)
+{
+	std::string settings;
+	if (!NETreplayLoadStart(filename, settings))
+	{
+		return false;
+	}
+
+	SPinit(LEVEL_TYPE::SKIRMISH);
+	if (!hostCampaign(game.name, sPlayer, true) || !applyReplaySettings(settings))
+	{
+		NETreplayLoadStop();
+		return false;
+	}
+	if (levFindDataSet(game.map, &game.hash) == nullptr)
+	{
+		debug(LOG_ERROR, "Don't have the map %s of the replay", game.map);
+		NETreplayLoadStop();
+		return false;
+	}
+
+	for (unsigned i = 0; i < MAX_PLAYERS; ++i)
+	{
+		ingame.JoiningInProgress[i] = i == selectedPlayer;
+	}
+
+	decideWRF();
+	bMultiPlayer = true;
+	bMultiMessages = true;
+	ingame.side = InGameSide::HOST_OR_SINGLEPLAYER;
+	NETsetPlayerConnectionStatus(CONNECTIONSTATUS_NORMAL, NET_ALL_PLAYERS);
+	resetDataHash();
+	initLoadingScreen(true);
+
+	debug(LOG_NET, "title mode STARTGAME is set--Starting replay!");
+	changeTitleMode(STARTGAME);
+	return true;
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 // Net message handling
 
@@ -3832,6 +3879,10 @@ void WzMultiplayerOptionsTitleUI::frontendMultiMessages(bool running)
 				break;
 			}
 
+		case NET_FILE_ACKNOWLEDGED:
+			NETrecvFileAcknowledged(queue);
+			break;
+
 		case NET_FILE_CANCELLED:
 			{
 				ASSERT_HOST_ONLY(break);
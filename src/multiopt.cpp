@@ -42,6 +42,7 @@
 #include "lib/widget/widget.h"
 #include "lib/gamelib/gtime.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netreplay.h"
 #include "hci.h"
 #include "configuration.h"			// lobby cfg.
 #include "clparse.h"
@@ -63,6 +64,12 @@
 #include "multirecv.h"
 #include "template.h"
 #include "activity.h"
+#include "random.h"
+#include "version.h"
+#include "warzoneconfig.h"
+#include "benchmark.h"
+
+#include <time.h>
 
 // send complete game info set!
 void sendOptions()
@@ -426,6 +433,190 @@ void playerResponding()
 	NETend();
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+// Settings recorded at the start of a replay. The same as sent in NET_OPTIONS, NET_PLAYER_INFO and NET_FIREUP.
+std::string replaySettings()
+{
+	nlohmann::json settings = nlohmann::json::object();
+
+	settings["version"] = version_getVersionString();
+	settings["randomSeed"] = gameRandSeed();
+	settings["selectedPlayer"] = selectedPlayer;
+
+	nlohmann::json gameJson = nlohmann::json::object();
+	gameJson["type"] = static_cast<uint8_t>(game.type);
+	gameJson["map"] = game.map;
+	gameJson["hash"] = game.hash.toString();
+	gameJson["maxPlayers"] = game.maxPlayers;
+	gameJson["name"] = game.name;
+	gameJson["power"] = game.power;
+	gameJson["base"] = game.base;
+	gameJson["alliance"] = game.alliance;
+	gameJson["scavengers"] = game.scavengers;
+	gameJson["isMapMod"] = game.isMapMod;
+	gameJson["techLevel"] = game.techLevel;
+	nlohmann::json mods = nlohmann::json::array();
+	for (Sha256 const &hash : game.modHashes)
+	{
+		mods.push_back(hash.toString());
+	}
+	gameJson["modHashes"] = mods;
+	settings["game"] = gameJson;
+
+	nlohmann::json players = nlohmann::json::array();
+	for (unsigned i = 0; i < MAX_PLAYERS; ++i)
+	{
+		PLAYER const &player = NetPlay.players[i];
+		nlohmann::json playerJson = nlohmann::json::object();
+		playerJson["name"] = player.name;
+		playerJson["position"] = player.position;
+		playerJson["colour"] = player.colour;
+		playerJson["allocated"] = player.allocated;
+		playerJson["team"] = player.team;
+		playerJson["ai"] = player.ai;
+		playerJson["difficulty"] = static_cast<int8_t>(player.difficulty);
+		players.push_back(playerJson);
+	}
+	settings["players"] = players;
+
+	nlohmann::json allianceJson = nlohmann::json::array();
+	for (unsigned i = 0; i < MAX_PLAYERS; ++i)
+	{
+		allianceJson.push_back(std::vector<uint8_t>(alliances[i], alliances[i] + MAX_PLAYERS));
+	}
+	settings["alliances"] = allianceJson;
+
+	nlohmann::json limits = nlohmann::json::array();
+	for (MULTISTRUCTLIMITS const &limit : ingame.structureLimits)
+	{
+		limits.push_back({limit.id, limit.limit});
+	}
+	settings["structureLimits"] = limits;
+	settings["flags"] = ingame.flags;
+
+	// Player and game names come from the network and may not be valid UTF-8.
+	return settings.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+bool applyReplaySettings(std::string const &settingsString)
+{
+	try
+	{
+		nlohmann::json settings = nlohmann::json::parse(settingsString);
+
+		if (settings["version"].get<std::string>() != version_getVersionString())
+		{
+			debug(LOG_WARNING, "Replay was recorded with version %s, this is %s. It will probably desynch.", settings["version"].get<std::string>().c_str(), version_getVersionString());
+		}
+
+		nlohmann::json const &gameJson = settings["game"];
+		game.type = static_cast<LEVEL_TYPE>(gameJson["type"].get<uint8_t>());
+		sstrcpy(game.map, gameJson["map"].get<std::string>().c_str());
+		game.hash.fromString(gameJson["hash"].get<std::string>());
+		game.maxPlayers = std::min<unsigned>(gameJson["maxPlayers"].get<unsigned>(), MAX_PLAYERS);
+		sstrcpy(game.name, gameJson["name"].get<std::string>().c_str());
+		game.power = gameJson["power"].get<uint32_t>();
+		game.base = gameJson["base"].get<uint8_t>();
+		game.alliance = gameJson["alliance"].get<uint8_t>();
+		game.scavengers = gameJson["scavengers"].get<bool>();
+		game.isMapMod = gameJson["isMapMod"].get<bool>();
+		game.techLevel = gameJson["techLevel"].get<uint32_t>();
+		game.modHashes.clear();
+		for (nlohmann::json const &hash : gameJson["modHashes"])
+		{
+			game.modHashes.emplace_back();
+			game.modHashes.back().fromString(hash.get<std::string>());
+		}
+		if (game.modHashes != getModHashList())
+		{
+			debug(LOG_WARNING, "Replay was recorded with different mods loaded. It will probably desynch.");
+		}
+
+		nlohmann::json const &players = settings["players"];
+		for (unsigned i = 0; i < MAX_PLAYERS && i < players.size(); ++i)
+		{
+			PLAYER &player = NetPlay.players[i];
+			nlohmann::json const &playerJson = players[i];
+			sstrcpy(player.name, playerJson["name"].get<std::string>().c_str());
+			player.position = playerJson["position"].get<int32_t>();
+			player.colour = playerJson["colour"].get<int32_t>();
+			setPlayerColour(i, player.colour);
+			player.allocated = playerJson["allocated"].get<bool>();
+			player.team = playerJson["team"].get<int32_t>();
+			player.ai = playerJson["ai"].get<int8_t>();
+			player.difficulty = static_cast<AIDifficulty>(playerJson["difficulty"].get<int8_t>());
+		}
+
+		nlohmann::json const &allianceJson = settings["alliances"];
+		for (unsigned i = 0; i < MAX_PLAYERS && i < allianceJson.size(); ++i)
+		{
+			for (unsigned j = 0; j < MAX_PLAYERS && j < allianceJson[i].size(); ++j)
+			{
+				alliances[i][j] = allianceJson[i][j].get<uint8_t>();
+			}
+		}
+
+		ingame.structureLimits.clear();
+		for (nlohmann::json const &limit : settings["structureLimits"])
+		{
+			ingame.structureLimits.push_back(MULTISTRUCTLIMITS {limit[0].get<uint32_t>(), limit[1].get<uint32_t>()});
+		}
+		ingame.flags = settings["flags"].get<uint8_t>();
+
+		selectedPlayer = realSelectedPlayer = std::min<unsigned>(settings["selectedPlayer"].get<unsigned>(), MAX_PLAYERS - 1);
+		gameSRand(settings["randomSeed"].get<uint32_t>());
+	}
+	catch (const std::exception &e)
+	{
+		debug(LOG_ERROR, "Bad replay settings: %s", e.what());
+		return false;
+	}
+	return true;
+}
+
+/// Returns the map name with anything that is not safe in a file name replaced.
+static std::string replayFileMapName(char const *map)
+{
+	std::string name;
+	for (char const *c = map; *c != '\0' && name.size() < 64; ++c)
+	{
+		bool safe = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '-' || *c == '_';
+		name += safe ? *c : '_';
+	}
+	return name;
+}
+
+/// Deletes the oldest recorded replays, so that there is room for one more without going over maxReplays.
+static void deleteOldReplays(int maxReplays)
+{
+	if (maxReplays <= 0)
+	{
+		return;
+	}
+	std::vector<std::string> replays;
+	char **files = PHYSFS_enumerateFiles("replay/multiplay");
+	for (char **i = files; *i != nullptr; ++i)
+	{
+		size_t len = strlen(*i);
+		if (len > 5 && strcmp(*i + len - 5, ".wzrp") == 0)
+		{
+			replays.push_back(*i);
+		}
+	}
+	PHYSFS_freeList(files);
+
+	// The names start with the date and time of the recording, so sorting them puts the oldest first.
+	std::sort(replays.begin(), replays.end());
+	for (size_t i = 0; i + maxReplays <= replays.size(); ++i)
+	{
+		std::string filename = "replay/multiplay/" + replays[i];
+		if (!PHYSFS_delete(filename.c_str()))
+		{
+			debug(LOG_WARNING, "Could not delete old replay %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		}
+	}
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 //called when the game finally gets fired up.
 bool multiGameInit()
@@ -437,6 +628,18 @@ bool multiGameInit()
 		openchannels[player] = true;								//open comms to this player.
 	}
 
+	if (war_GetRecordReplays() && getLevelLoadType() == GTYPE_SCENARIO_START && !NETisReplay() && !benchmarkEnabled() && !wzIsHeadless())
+	{
+		// Record the game messages from the start, so that the game can be replayed.
+		deleteOldReplays(war_GetMaxReplays());
+		time_t aclock;
+		time(&aclock);
+		struct tm *newtime = localtime(&aclock);
+		char filename[256];
+		snprintf(filename, sizeof(filename), "replay/multiplay/%04d%02d%02d_%02d%02d%02d_%s.wzrp", newtime->tm_year + 1900, newtime->tm_mon + 1, newtime->tm_mday, newtime->tm_hour, newtime->tm_min, newtime->tm_sec, replayFileMapName(game.map).c_str());
+		NETreplaySaveStart(filename, replaySettings());
+	}
+
 	gameInit();
 
 	return true;
@@ -463,6 +666,9 @@ bool multiGameShutdown()
 	{
 		wzYieldCurrentThread();  // TODO Make a wzDelay() function?
 	}
+	NETreplaySaveStop();
+	NETreplayLoadStop();
+
 	// close game
 	NETclose();
 	NETremRedirects();
@@ -1383,10 +1383,16 @@ bool recvMapFileRequested(NETQUEUE queue)
 	}
 
 	// Checking to see if file is available...
-	PHYSFS_file *pFileHandle = PHYSFS_openRead(filename.c_str());
-	if (pFileHandle == nullptr)
+	bool openFailed = false;
+	std::shared_ptr<std::vector<uint8_t> const> data = NETloadFileToSend(filename, hash, &openFailed);
+	if (data == nullptr && !openFailed)
+	{
+		// Too big to send, or a read error. Refuse this request, but there is no reason to end the game.
+		debug(LOG_ERROR, "Can't send %s to player %u.", filename.c_str(), player);
+		return false;
+	}
+	if (data == nullptr)
 	{
-		debug(LOG_ERROR, "Failed to open %s for reading: %s", filename.c_str(), WZ_PHYSFS_getLastError());
 		debug(LOG_FATAL, "You have a map (%s) that can't be located.\n\nMake sure it is in the correct directory and or format! (No map packs!)", filename.c_str());
 		// NOTE: if we get here, then the game is basically over, The host can't send the file for whatever reason...
 		// Which also means, that we can't continue.
@@ -1396,15 +1402,9 @@ bool recvMapFileRequested(NETQUEUE queue)
 		abort();
 	}
 
-	PHYSFS_sint64 fileSize_64 = PHYSFS_fileLength(pFileHandle);
-	ASSERT_OR_RETURN(false, fileSize_64 <= 0xFFFFFFFF, "File is too big!");
-	ASSERT_OR_RETURN(false, fileSize_64 >= 0, "Filesize < 0; can't be determined");
-	uint32_t fileSize_u32 = (uint32_t)fileSize_64;
-	ASSERT_OR_RETURN(false, fileSize_u32 <= MAX_NET_TRANSFERRABLE_FILE_SIZE, "Filesize is too large; (size: %" PRIu32")", fileSize_u32);
-
 	// Schedule file to be sent.
 	debug(LOG_INFO, "File is valid, sending [directory: %s] %s to client %u", WZ_PHYSFS_getRealDir_String(filename.c_str()).c_str(), filename.c_str(), player);
-	files.emplace_back(pFileHandle, filename, hash, fileSize_u32);
+	files.emplace_back(data, filename, hash);
 
 	return true;
 }
@@ -1433,22 +1433,24 @@ void sendMap()
 		auto &files = NetPlay.players[i].wzFiles;
 		for (auto &file : files)
 		{
-			int done = 0;
+			// Send until the window of unacknowledged data is full, or out of time.
 			file_startTime = std::chrono::high_resolution_clock::now();
-			do
+			while (NETsendFile(file, i))
 			{
-				done = NETsendFile(file, i);
 				file_currentDuration = std::chrono::duration_cast<microDuration>(std::chrono::high_resolution_clock::now() - file_startTime);
+				if (file_currentDuration.count() >= maxMicroSecondsPerFile)
+				{
+					break;
+				}
 			}
-			while (done < 100 && (file_currentDuration.count() < maxMicroSecondsPerFile));
-			if (done == 100)
+			if (file.data == nullptr && file.acknowledged == file.size)
 			{
 				netPlayersUpdated = true;  // Remove download icon from player.
 				addConsoleMessage(_("FILE SENT!"), DEFAULT_JUSTIFY, SYSTEM_MESSAGE);
 				debug(LOG_INFO, "=== File has been sent to player %d ===", i);
 			}
 		}
-		files.erase(std::remove_if(files.begin(), files.end(), [](WZFile const &file) { return file.handle == nullptr; }), files.end());
+		files.erase(std::remove_if(files.begin(), files.end(), [](WZFile const &file) { return file.data == nullptr && file.acknowledged == file.size; }), files.end());
 	}
 }
 
@@ -224,6 +224,17 @@ void sendStructureInfo(STRUCTURE *psStruct, STRUCTURE_INFO structureInfo, DROID_
 bool SendDroid(DROID_TEMPLATE *pTemplate, uint32_t x, uint32_t y, uint8_t player, uint32_t id, const INITIAL_DROID_ORDERS *initialOrders);
 bool SendDestroyDroid(const DROID *psDroid);
 void sendQueuedDroidInfo();  ///< Actually sends the droid orders which were queued by SendDroidInfo.
+
+/// Counters for the droid orders sent by sendQueuedDroidInfo.
+struct DroidInfoStatistics
+{
+	size_t orders = 0;          ///< Droid orders queued.
+	size_t duplicates = 0;      ///< Repeated orders to the same droid, which were dropped.
+	size_t messages = 0;        ///< GAME_DROIDINFO messages sent.
+	size_t bytes = 0;           ///< Size of the messages.
+	size_t bytesSaved = 0;      ///< Bytes saved compared to a message per group of identical orders, with the droid IDs as plain deltas.
+};
+DroidInfoStatistics const &getDroidInfoStatistics();
 void sendDroidInfo(DROID *psDroid, DroidOrder const &order, bool add);
 bool SendCmdGroup(DROID_GROUP *psGroup, UWORD x, UWORD y, BASE_OBJECT *psObj);
 
@@ -259,6 +270,8 @@ JoinGameResult joinGame(const std::vector<JoinConnectionDescription>& connection
 void playerResponding();
 bool multiGameInit();
 bool multiGameShutdown();
+std::string replaySettings();                               ///< Returns the game, player and alliance settings and the random seed, as recorded at the start of a replay.
+bool applyReplaySettings(std::string const &settings);      ///< Sets up the game as recorded by replaySettings, returns false if the settings are invalid.
 
 // syncing.
 bool sendScoreCheck();							//score check only(frontend)
@@ -274,6 +287,7 @@ bool sendBeacon(int32_t locX, int32_t locY, int32_t forPlayer, int32_t sender, c
 
 bool multiplayPlayersReady(bool bNotifyStatus);
 void startMultiplayerGame();
+bool startReplayGame(std::string const &filename);  ///< Starts playing back a replay, returns false if it can't be loaded.
 void resetReadyStatus(bool bSendOptions, bool ignoreReadyReset = false);
 
 STRUCTURE *findResearchingFacilityByResearchIndex(unsigned player, unsigned index);
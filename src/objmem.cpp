@@ -41,6 +41,9 @@
 #include "combat.h"
 #include "visibility.h"
 #include "qtscript.h"
+#include "objpool.h"
+
+#include <unordered_map>
 
 // the initial value for the object ID
 #define OBJ_ID_INIT 20000
@@ -65,6 +68,11 @@ FLAG_POSITION	*apsFlagPosLists[MAX_PLAYERS];
 /* The list of destroyed objects */
 BASE_OBJECT		*psDestroyedObj = nullptr;
 
+/* Objects by id. Objects are indexed when added to a list (including the mission and limbo lists), stay indexed while
+ * carried in a transporter, and are removed from the index when destroyed. Ids can be changed after an object is added,
+ * so the object's current id must always be checked, see getBaseObjFromId. */
+static std::unordered_map<uint32_t, BASE_OBJECT *> objIdIndex;
+
 /* Forward function declarations */
 #ifdef DEBUG
 static void objListIntegCheck();
@@ -84,6 +92,7 @@ bool objmemInitialise()
 /* Release the object heaps */
 void objmemShutdown()
 {
+	objPoolShutdown();
 }
 
 // Check that psVictim is not referred to by any other object in the game. We can dump out some extra data in debug builds that help track down sources of dangling pointer errors.
@@ -171,6 +180,9 @@ void objmemUpdate()
 	objListIntegCheck();
 #endif
 
+	// Memory of objects freed before this tick may be reused from now on.
+	objPoolUpdate();
+
 	/* Go through the destroyed objects list looking for objects that
 	   were destroyed before this turn */
 
@@ -217,6 +229,35 @@ uint32_t generateSynchronisedObjectId()
 	return ret;
 }
 
+void objmemUnindexObject(BASE_OBJECT *psObj)
+{
+	if (psObj->indexedId != 0)
+	{
+		auto it = objIdIndex.find(psObj->indexedId);
+		if (it != objIdIndex.end() && it->second == psObj)
+		{
+			objIdIndex.erase(it);
+		}
+		psObj->indexedId = 0;
+	}
+}
+
+/* Add the object to the object id index, under its current id */
+static void objmemIndexObject(BASE_OBJECT *psObj)
+{
+	objmemUnindexObject(psObj);
+	if (psObj->id != 0)
+	{
+		BASE_OBJECT *&psIndexed = objIdIndex[psObj->id];
+		if (psIndexed != nullptr)
+		{
+			psIndexed->indexedId = 0;  // Duplicate id, the newest object wins.
+		}
+		psIndexed = psObj;
+		psObj->indexedId = psObj->id;
+	}
+}
+
 /* Add the object to its list
  * \param list is a pointer to the object list
  */
@@ -228,6 +269,7 @@ static inline void addObjectToList(OBJECT *list[], OBJECT *object, int player)
 	// Prepend the object to the top of the list
 	object->psNext = list[player];
 	list[player] = object;
+	objmemIndexObject(object);
 }
 
 /* Add the object to its list
@@ -254,6 +296,8 @@ static inline void destroyObject(OBJECT *list[], OBJECT *object)
 	ASSERT_OR_RETURN(, object != nullptr, "Invalid pointer");
 	ASSERT(gameTime - deltaGameTime <= gameTime || gameTime == 2, "Expected %u <= %u, bad time", gameTime - deltaGameTime, gameTime);
 
+	objmemUnindexObject(object);
+
 	// If the message to remove is the first one in the list then mark the next one as the first
 	if (list[object->player] == object)
 	{
@@ -492,6 +536,7 @@ void freeAllLimboDroids()
 void addStructure(STRUCTURE *psStructToAdd)
 {
 	addObjectToList(apsStructLists, psStructToAdd, psStructToAdd->player);
+	gridStaticObjectsChanged();
 	if (psStructToAdd->pStructureType->pSensor
 	    && psStructToAdd->pStructureType->pSensor->location == LOC_TURRET)
 	{
@@ -561,12 +606,14 @@ void killStruct(STRUCTURE *psBuilding)
 	}
 
 	destroyObject(apsStructLists, psBuilding);
+	gridStaticObjectsChanged();
 }
 
 /* Remove heapall structures */
 void freeAllStructs()
 {
 	releaseAllObjectsInList(apsStructLists);
+	gridStaticObjectsChanged();
 }
 
 /*Remove a single Structure from a list*/
@@ -577,6 +624,7 @@ void removeStructureFromList(STRUCTURE *psStructToRemove, STRUCTURE *pList[MAX_P
 	ASSERT(psStructToRemove->player < MAX_PLAYERS,
 	       "removeStructureFromList: invalid player for structure");
 	removeObjectFromList(pList, psStructToRemove, psStructToRemove->player);
+	gridStaticObjectsChanged();
 	if (psStructToRemove->pStructureType->pSensor
 	    && psStructToRemove->pStructureType->pSensor->location == LOC_TURRET)
 	{
@@ -594,6 +642,7 @@ void removeStructureFromList(STRUCTURE *psStructToRemove, STRUCTURE *pList[MAX_P
 void addFeature(FEATURE *psFeatureToAdd)
 {
 	addObjectToList(apsFeatureLists, psFeatureToAdd, 0);
+	gridStaticObjectsChanged();
 	if (psFeatureToAdd->psStats->subType == FEAT_OIL_RESOURCE)
 	{
 		addObjectToFuncList(apsOilList, psFeatureToAdd, 0);
@@ -609,6 +658,7 @@ void killFeature(FEATURE *psDel)
 	       "killFeature: pointer is not a feature");
 	psDel->player = 0;
 	destroyObject(apsFeatureLists, psDel);
+	gridStaticObjectsChanged();
 
 	if (psDel->psStats->subType == FEAT_OIL_RESOURCE)
 	{
@@ -620,6 +670,7 @@ void killFeature(FEATURE *psDel)
 void freeAllFeatures()
 {
 	releaseAllObjectsInList(apsFeatureLists);
+	gridStaticObjectsChanged();
 }
 
 /**************************  FLAG_POSITION ********************************/
@@ -740,8 +791,8 @@ void checkFactoryFlags()
 
 /**************************  OBJECT ACCESS FUNCTIONALITY ********************************/
 
-// Find a base object from it's id
-BASE_OBJECT *getBaseObjFromData(unsigned id, unsigned player, OBJECT_TYPE type)
+// Find a base object from it's id, by searching the lists
+static BASE_OBJECT *findBaseObjFromData(unsigned id, unsigned player, OBJECT_TYPE type)
 {
 	BASE_OBJECT		*psObj;
 	DROID			*psTrans;
@@ -797,13 +848,12 @@ BASE_OBJECT *getBaseObjFromData(unsigned id, unsigned player, OBJECT_TYPE type)
 			psObj = psObj->psNext;
 		}
 	}
-	ASSERT(false, "failed to find id %d for player %d", id, player);
 
 	return nullptr;
 }
 
-// Find a base object from it's id
-BASE_OBJECT *getBaseObjFromId(UDWORD id)
+// Find a base object from it's id, by searching the lists
+static BASE_OBJECT *findBaseObjFromId(UDWORD id)
 {
 	unsigned int i;
 	UDWORD			player;
@@ -884,11 +934,46 @@ BASE_OBJECT *getBaseObjFromId(UDWORD id)
 			}
 		}
 	}
-	ASSERT(!"couldn't find a BASE_OBJ with ID", "getBaseObjFromId() failed for id %d", id);
 
 	return nullptr;
 }
 
+// Find a base object from it's id
+BASE_OBJECT *getBaseObjFromData(unsigned id, unsigned player, OBJECT_TYPE type)
+{
+	auto it = objIdIndex.find(id);
+	if (it != objIdIndex.end())
+	{
+		BASE_OBJECT *psObj = it->second;
+		if (psObj->id == id && psObj->type == type && (type == OBJ_FEATURE || psObj->player == player))
+		{
+			return psObj;
+		}
+	}
+
+	// Not indexed under this id, possibly because the id was changed after the object was added to its list.
+	BASE_OBJECT *psObj = findBaseObjFromData(id, player, type);
+	ASSERT_OR_RETURN(nullptr, psObj != nullptr, "failed to find id %d for player %d", id, player);
+	objmemIndexObject(psObj);
+	return psObj;
+}
+
+// Find a base object from it's id
+BASE_OBJECT *getBaseObjFromId(UDWORD id)
+{
+	auto it = objIdIndex.find(id);
+	if (it != objIdIndex.end() && it->second->id == id)
+	{
+		return it->second;
+	}
+
+	// Not indexed under this id, possibly because the id was changed after the object was added to its list.
+	BASE_OBJECT *psObj = findBaseObjFromId(id);
+	ASSERT_OR_RETURN(nullptr, psObj != nullptr, "getBaseObjFromId() failed for id %d", id);
+	objmemIndexObject(psObj);
+	return psObj;
+}
+
 UDWORD getRepairIdFromFlag(FLAG_POSITION *psFlag)
 {
 	unsigned int i;
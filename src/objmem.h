@@ -106,6 +106,9 @@ BASE_OBJECT *getBaseObjFromData(unsigned id, unsigned player, OBJECT_TYPE type);
 BASE_OBJECT *getBaseObjFromId(UDWORD id);
 bool checkValidId(UDWORD id);
 
+/// Removes the object from the object id index, called when it is freed.
+void objmemUnindexObject(BASE_OBJECT *psObj);
+
 UDWORD getRepairIdFromFlag(FLAG_POSITION *psFlag);
 
 void objCount(int *droids, int *structures, int *features);
@@ -0,0 +1,209 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file objpool.cpp
+ * Pools of memory for the game objects which are created and destroyed in large numbers.
+ */
+
+#include "lib/framework/frame.h"
+
+#include "objpool.h"
+#include "droiddef.h"
+#include "structuredef.h"
+#include "featuredef.h"
+#include "projectiledef.h"
+
+#include <cstddef>
+#include <new>
+
+/// Size of the slabs blocks are taken from, unless that is less than MIN_BLOCKS_PER_SLAB blocks.
+#define SLAB_SIZE (64 * 1024)
+#define MIN_BLOCKS_PER_SLAB 16
+/// Blocks are aligned like memory from the heap.
+#define BLOCK_ALIGNMENT alignof(std::max_align_t)
+
+static ObjectPool droidPool("droid", sizeof(DROID));
+static ObjectPool structurePool("structure", sizeof(STRUCTURE));
+static ObjectPool featurePool("feature", sizeof(FEATURE));
+static ObjectPool projectilePool("projectile", sizeof(PROJECTILE));
+
+static ObjectPool *const objPools[] = {&droidPool, &structurePool, &featurePool, &projectilePool};
+
+ObjectPool::ObjectPool(char const *name_, size_t objectSize_)
+	: name(name_)
+	, objectSize(objectSize_)
+	, blockSize((std::max(objectSize_, sizeof(Block)) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT)
+	, blocksPerSlab(std::max<size_t>(SLAB_SIZE / blockSize, MIN_BLOCKS_PER_SLAB))
+{}
+
+void ObjectPool::addSlab()
+{
+	char *slab = static_cast<char *>(::operator new(blockSize * blocksPerSlab));
+	slabs.push_back(slab);
+
+	// Link the blocks in address order, so that objects allocated one after another are next to each other.
+	for (size_t n = blocksPerSlab; n-- > 0;)
+	{
+		Block *block = reinterpret_cast<Block *>(slab + n * blockSize);
+		block->next = available;
+		available = block;
+	}
+}
+
+void *ObjectPool::allocate(size_t size)
+{
+	if (size != objectSize)
+	{
+		++heapAllocations;
+		return ::operator new(size);
+	}
+
+	if (available == nullptr)
+	{
+		addSlab();
+	}
+	Block *block = available;
+	available = block->next;
+
+	++allocations;
+	peakLive = std::max(peakLive, ++live);
+	return block;
+}
+
+void ObjectPool::deallocate(void *ptr, size_t size)
+{
+	if (ptr == nullptr)
+	{
+		return;
+	}
+	if (size != objectSize)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	ASSERT(live > 0, "Freeing more %s objects than were allocated", name);
+	--live;
+
+	Block *block = static_cast<Block *>(ptr);
+	block->next = nullptr;
+	if (pendingTail != nullptr)
+	{
+		pendingTail->next = block;
+	}
+	else
+	{
+		pending = block;
+	}
+	pendingTail = block;
+}
+
+void ObjectPool::update()
+{
+	if (pending == nullptr)
+	{
+		return;
+	}
+
+	// Older blocks first, so recently freed memory is reused last.
+	pendingTail->next = available;
+	available = pending;
+	pending = nullptr;
+	pendingTail = nullptr;
+}
+
+void ObjectPool::logStatistics() const
+{
+	debug(LOG_MEMORY, "Object pool %s: %" PRIu64 " allocations (%" PRIu64 " passed on to the heap), %zu live, %zu at most, %zu slabs of %zu %zu-byte blocks",
+	      name, allocations, heapAllocations, live, peakLive, slabs.size(), blocksPerSlab, blockSize);
+}
+
+void ObjectPool::release()
+{
+	if (live != 0)
+	{
+		return;
+	}
+
+	for (void *slab : slabs)
+	{
+		::operator delete(slab);
+	}
+	slabs.clear();
+	available = nullptr;
+	pending = nullptr;
+	pendingTail = nullptr;
+}
+
+void objPoolUpdate()
+{
+	for (ObjectPool *pool : objPools)
+	{
+		pool->update();
+	}
+}
+
+void objPoolShutdown()
+{
+	for (ObjectPool *pool : objPools)
+	{
+		pool->logStatistics();
+		pool->release();
+	}
+}
+
+void *DROID::operator new(size_t size)
+{
+	return droidPool.allocate(size);
+}
+
+void DROID::operator delete(void *ptr, size_t size)
+{
+	droidPool.deallocate(ptr, size);
+}
+
+void *STRUCTURE::operator new(size_t size)
+{
+	return structurePool.allocate(size);
+}
+
+void STRUCTURE::operator delete(void *ptr, size_t size)
+{
+	structurePool.deallocate(ptr, size);
+}
+
+void *FEATURE::operator new(size_t size)
+{
+	return featurePool.allocate(size);
+}
+
+void FEATURE::operator delete(void *ptr, size_t size)
+{
+	featurePool.deallocate(ptr, size);
+}
+
+void *PROJECTILE::operator new(size_t size)
+{
+	return projectilePool.allocate(size);
+}
+
+void PROJECTILE::operator delete(void *ptr, size_t size)
+{
+	projectilePool.deallocate(ptr, size);
+}
@@ -0,0 +1,84 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Pools of memory for the game objects which are created and destroyed in large numbers.
+ *
+ *  DROID, STRUCTURE, FEATURE and PROJECTILE have class specific operator new and delete, which take
+ *  fixed size blocks from large slabs instead of the heap, so that objects of a type are kept close
+ *  together and creating a projectile per shot doesn't need a heap allocation.
+ */
+
+#ifndef __INCLUDED_SRC_OBJPOOL_H__
+#define __INCLUDED_SRC_OBJPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Fixed size blocks for objects of one type.
+ *
+ *  A freed block isn't reused until the next call to update, so that, like with the delay between an
+ *  object dying and objmemUpdate freeing it, a stale pointer never points to a different object within
+ *  the same tick.
+ */
+class ObjectPool
+{
+public:
+	ObjectPool(char const *name, size_t objectSize);
+	ObjectPool(ObjectPool const &) = delete;
+	ObjectPool &operator =(ObjectPool const &) = delete;
+
+	void *allocate(size_t size);
+	void deallocate(void *ptr, size_t size);
+	/// Makes the blocks freed since the last call available for reuse.
+	void update();
+	void logStatistics() const;
+	/// Releases the slabs, if there are no objects left.
+	void release();
+
+private:
+	struct Block
+	{
+		Block *next;
+	};
+
+	void addSlab();
+
+	char const *name;
+	size_t objectSize;
+	size_t blockSize;
+	size_t blocksPerSlab;
+	std::vector<void *> slabs;
+	Block *available = nullptr;     ///< Blocks which may be handed out.
+	Block *pending = nullptr;       ///< Blocks freed since the last update.
+	Block *pendingTail = nullptr;
+
+	uint64_t allocations = 0;
+	uint64_t heapAllocations = 0;   ///< Allocations of a different size than objectSize, which are passed on to the heap.
+	size_t live = 0;
+	size_t peakLive = 0;
+};
+
+/// Call once per game tick, from objmemUpdate. Makes freed blocks of all the pools available for reuse.
+void objPoolUpdate();
+
+/// Logs the statistics of all the pools, and releases the memory of the pools which have no objects left.
+void objPoolShutdown();
+
+#endif // __INCLUDED_SRC_OBJPOOL_H__
@@ -0,0 +1,550 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Hierarchical (HPA*) path finding layer over the tile A*.
+ *  See "Near Optimal Hierarchical Path-Finding", Botea, Müller and Schaeffer, for more information.
+ *  How this works:
+ *  * Each pair of neighbouring clusters is scanned along their common border for runs of
+ *    tiles which are passable on both sides. Each run becomes one entrance in the middle,
+ *    or two entrances at the ends if the run is long.
+ *  * Within each cluster,  the distances between all of its entrances  are found with a
+ *    Dijkstra search which does not leave the cluster, using the same moves and costs as
+ *    the tile A*.
+ *  * To plan a route, the start and destination tiles are connected to the entrances of
+ *    their clusters, and A* is run on the graph of entrances.
+ *  Since it is  a pure function of the  blocking map,  the graph is  the same on all the
+ *  clients.  It is calculated by the  first path thread which  needs it,  and clusters are
+ *  only recalculated when their tiles or entrances changed since the previous graph.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+
+#include "pathcluster.h"
+#include "astar.h"
+#include "map.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <functional>
+
+#define PATH_CLUSTER_TILES (PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE)
+#define PATH_CLUSTER_WORDS (PATH_CLUSTER_TILES / 64)
+
+/// Runs of passable border tiles at least this long get an entrance at each end, instead of one in the middle.
+#define PATH_CLUSTER_LONG_ENTRANCE 6
+
+/// Maximum number of kinds of blocking maps to keep cluster graphs for.
+#define PATH_CLUSTER_MAX_CACHES 32
+
+typedef std::array<uint64_t, PATH_CLUSTER_WORDS> PathClusterBlocking;
+
+/// The entrances of a cluster, and the distances between them.
+struct PathCluster
+{
+	bool isBlocked(int x, int y) const  ///< Coordinates are relative to the top left of the cluster.
+	{
+		unsigned i = x + y * PATH_CLUSTER_SIZE;
+		return (blocking[i / 64] >> (i % 64)) & 1;
+	}
+
+	PathClusterBlocking blocking;       ///< Bit x + y*PATH_CLUSTER_SIZE is set if the tile is blocking. Tiles off the map are blocking.
+	std::vector<PathCoord> entrances;   ///< Entrance tiles, sorted by y, then x.
+	std::vector<unsigned> distances;    ///< Distance from entrance i to entrance j is distances[i + j*entrances.size()], UINT_MAX if unreachable within the cluster.
+};
+
+struct PathClusterEdge
+{
+	unsigned node;
+	unsigned cost;
+};
+
+/// Graph of the entrances of all clusters. Immutable once created.
+struct PathClusterData : public std::enable_shared_from_this<PathClusterData>
+{
+	int width = 0;                      ///< Number of clusters in a row of the map.
+	int height = 0;                     ///< Number of clusters in a column of the map.
+	std::vector<std::shared_ptr<const PathCluster>> clusters;  ///< Shared with older graphs, if unchanged.
+	std::vector<unsigned> firstNode;    ///< The nodes of cluster c are firstNode[c] to firstNode[c + 1] - 1, in the same order as its entrances.
+	std::vector<PathCoord> nodeTiles;
+	std::vector<unsigned> nodeCluster;
+	std::vector<unsigned> firstEdge;    ///< The edges of node n are firstEdge[n] to firstEdge[n + 1] - 1.
+	std::vector<PathClusterEdge> edges;
+};
+
+/// Handle to the graph for one blocking map. The graph is calculated by the first path thread which needs it.
+struct PathClusterGraph
+{
+	wz::mutex mutex;                    ///< Protects everything below.
+	std::shared_ptr<PathBlockingMap> blockingMap;     ///< Map to calculate the graph from, released once calculated.
+	std::shared_ptr<PathClusterGraph> previous;       ///< Graph for an earlier blocking map of the same kind, to reuse unchanged clusters from.
+	std::shared_ptr<const PathClusterData> data;      ///< The graph, or nullptr if not calculated yet.
+};
+
+struct PathClusterCache
+{
+	PathBlockingType type;
+	PathBlockingMap const *source;      ///< Only for comparing, may be deleted.
+	int mapWidth, mapHeight;
+	std::shared_ptr<PathClusterGraph> graph;
+};
+
+/// Latest cluster graphs for the kinds of blocking maps that were used recently. Only used from the main thread.
+static std::vector<PathClusterCache> fpathClusterCaches;
+
+// Same order as aDirOffset in astar.cpp, odd directions are diagonal.
+static const int8_t clusterDirX[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+static const int8_t clusterDirY[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+static inline unsigned fpathClusterEstimate(PathCoord s, PathCoord f)
+{
+	// Same as fpathEstimate in astar.cpp.
+	unsigned xDelta = abs(s.x - f.x), yDelta = abs(s.y - f.y);
+	return std::min(xDelta, yDelta) * (198 - 140) + std::max(xDelta, yDelta) * 140;
+}
+
+static inline bool fpathClusterTileBlocked(PathBlockingMap const &blockingMap, int x, int y)
+{
+	return x < 0 || y < 0 || x >= mapWidth || y >= mapHeight || blockingMap.map.get(x, y);
+}
+
+/** Finds the distances from start to every tile of the cluster with top left tile (x0, y0), without leaving the cluster.
+ *  Uses the same moves as the tile A*, including not cutting corners unless next to dstIgnore.
+ *  dist[x + y*PATH_CLUSTER_SIZE] is UINT_MAX for unreachable tiles.
+ */
+template <typename IsBlocked>
+static void fpathClusterDistances(int x0, int y0, PathCoord start, IsBlocked const &isBlocked, PathNonblockingArea const &dstIgnore, unsigned *dist)
+{
+	auto blocked = [&](int x, int y) {
+		return x < x0 || y < y0 || x >= x0 + PATH_CLUSTER_SIZE || y >= y0 + PATH_CLUSTER_SIZE || isBlocked(x, y);
+	};
+
+	std::fill_n(dist, PATH_CLUSTER_TILES, UINT_MAX);
+	typedef std::pair<unsigned, unsigned> Open;  // Distance, then tile.
+	std::vector<Open> open;
+	unsigned startIndex = (start.x - x0) + (start.y - y0) * PATH_CLUSTER_SIZE;
+	dist[startIndex] = 0;
+	open.emplace_back(0, startIndex);
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Open>());
+		Open cur = open.back();
+		open.pop_back();
+		if (cur.first != dist[cur.second])
+		{
+			continue;  // Already found a shorter way here.
+		}
+		int px = x0 + cur.second % PATH_CLUSTER_SIZE;
+		int py = y0 + cur.second / PATH_CLUSTER_SIZE;
+		for (unsigned dir = 0; dir < 8; ++dir)
+		{
+			int x = px + clusterDirX[dir];
+			int y = py + clusterDirY[dir];
+			if (blocked(x, y))
+			{
+				continue;
+			}
+			if (dir % 2 != 0 && !dstIgnore.isNonblocking(px, py) && !dstIgnore.isNonblocking(x, y) && (blocked(x, py) || blocked(px, y)))
+			{
+				continue;  // We cannot cut corners.
+			}
+			unsigned newDist = cur.first + (dir % 2 != 0 ? 198 : 140);
+			unsigned index = (x - x0) + (y - y0) * PATH_CLUSTER_SIZE;
+			if (newDist < dist[index])
+			{
+				dist[index] = newDist;
+				open.emplace_back(newDist, index);
+				std::push_heap(open.begin(), open.end(), std::greater<Open>());
+			}
+		}
+	}
+}
+
+/// Adds entrances for the border between the tiles a and a + step (inclusive) and the tiles next to them, offset by across.
+static void fpathClusterScanBorder(PathBlockingMap const &blockingMap, PathCoord a, PathCoord step, int length, PathCoord across, std::vector<std::pair<PathCoord, PathCoord>> &transitions)
+{
+	int runStart = -1;
+	for (int i = 0; i <= length; ++i)
+	{
+		int x = a.x + step.x * i;
+		int y = a.y + step.y * i;
+		bool open = i < length && !fpathClusterTileBlocked(blockingMap, x, y) && !fpathClusterTileBlocked(blockingMap, x + across.x, y + across.y);
+		if (open && runStart < 0)
+		{
+			runStart = i;
+		}
+		else if (!open && runStart >= 0)
+		{
+			int runEnd = i - 1;
+			int ends[2] = {runStart, runEnd};
+			if (runEnd - runStart + 1 < PATH_CLUSTER_LONG_ENTRANCE)
+			{
+				ends[0] = ends[1] = (runStart + runEnd) / 2;
+			}
+			for (int n = 0; n < (ends[0] == ends[1] ? 1 : 2); ++n)
+			{
+				PathCoord tile(a.x + step.x * ends[n], a.y + step.y * ends[n]);
+				transitions.emplace_back(tile, PathCoord(tile.x + across.x, tile.y + across.y));
+			}
+			runStart = -1;
+		}
+	}
+}
+
+static inline bool fpathClusterCoordLess(PathCoord const &a, PathCoord const &b)
+{
+	return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+static unsigned fpathClusterOf(PathClusterData const &graph, PathCoord tile)
+{
+	return tile.x / PATH_CLUSTER_SIZE + tile.y / PATH_CLUSTER_SIZE * graph.width;
+}
+
+/// Returns the index of tile in the entrances of cluster.
+static unsigned fpathClusterEntranceIndex(PathCluster const &cluster, PathCoord tile)
+{
+	auto i = std::lower_bound(cluster.entrances.begin(), cluster.entrances.end(), tile, fpathClusterCoordLess);
+	ASSERT(i != cluster.entrances.end() && *i == tile, "Missing entrance (%d, %d)", tile.x, tile.y);
+	return i - cluster.entrances.begin();
+}
+
+static std::shared_ptr<const PathClusterData> fpathClusterBuildGraph(PathBlockingMap const &blockingMap, PathClusterData const *oldGraph)
+{
+	std::shared_ptr<PathClusterData> graph = std::make_shared<PathClusterData>();
+	graph->width = fpathClusterMapWidth(mapWidth);
+	graph->height = fpathClusterMapWidth(mapHeight);
+	unsigned numClusters = graph->width * graph->height;
+
+	// Find the blocking tiles of each cluster.
+	std::vector<PathClusterBlocking> blocking(numClusters);
+	for (int cy = 0; cy < graph->height; ++cy)
+		for (int cx = 0; cx < graph->width; ++cx)
+		{
+			PathClusterBlocking &bits = blocking[cx + cy * graph->width];
+			bits.fill(0);
+			int x0 = cx * PATH_CLUSTER_SIZE;
+			uint64_t const rowMask = (uint64_t(1) << PATH_CLUSTER_SIZE) - 1;
+			uint64_t offMap = rowMask & ~((uint64_t(1) << std::min(mapWidth - x0, PATH_CLUSTER_SIZE)) - 1);
+			for (int y = 0; y < PATH_CLUSTER_SIZE; ++y)
+			{
+				// Copy a whole row of the cluster at a time, PATH_CLUSTER_SIZE divides 64 so rows don't straddle words.
+				int tileY = cy * PATH_CLUSTER_SIZE + y;
+				uint64_t row = tileY < mapHeight ? blockingMap.map.bits(x0, tileY, PATH_CLUSTER_SIZE) | offMap : rowMask;
+				unsigned i = y * PATH_CLUSTER_SIZE;
+				bits[i / 64] |= row << (i % 64);
+			}
+		}
+
+	// Find the entrances between each pair of neighbouring clusters.
+	std::vector<std::pair<PathCoord, PathCoord>> transitions;
+	for (int cy = 0; cy < graph->height; ++cy)
+		for (int cx = 0; cx < graph->width; ++cx)
+		{
+			int x0 = cx * PATH_CLUSTER_SIZE, y0 = cy * PATH_CLUSTER_SIZE;
+			if (cx + 1 < graph->width)
+			{
+				fpathClusterScanBorder(blockingMap, PathCoord(x0 + PATH_CLUSTER_SIZE - 1, y0), PathCoord(0, 1), std::min(PATH_CLUSTER_SIZE, mapHeight - y0), PathCoord(1, 0), transitions);
+			}
+			if (cy + 1 < graph->height)
+			{
+				fpathClusterScanBorder(blockingMap, PathCoord(x0, y0 + PATH_CLUSTER_SIZE - 1), PathCoord(1, 0), std::min(PATH_CLUSTER_SIZE, mapWidth - x0), PathCoord(0, 1), transitions);
+			}
+		}
+	std::vector<std::vector<PathCoord>> entrances(numClusters);
+	for (auto const &transition : transitions)
+	{
+		entrances[fpathClusterOf(*graph, transition.first)].push_back(transition.first);
+		entrances[fpathClusterOf(*graph, transition.second)].push_back(transition.second);
+	}
+
+	// Reuse the clusters which didn't change, and find the distances between the entrances of the others.
+	unsigned numRecalculated = 0;
+	graph->clusters.resize(numClusters);
+	for (unsigned c = 0; c < numClusters; ++c)
+	{
+		std::vector<PathCoord> &clusterEntrances = entrances[c];
+		std::sort(clusterEntrances.begin(), clusterEntrances.end(), fpathClusterCoordLess);
+		clusterEntrances.erase(std::unique(clusterEntrances.begin(), clusterEntrances.end()), clusterEntrances.end());
+
+		if (oldGraph != nullptr && oldGraph->clusters.size() == numClusters && oldGraph->clusters[c]->blocking == blocking[c] && oldGraph->clusters[c]->entrances == clusterEntrances)
+		{
+			graph->clusters[c] = oldGraph->clusters[c];
+			continue;
+		}
+
+		std::shared_ptr<PathCluster> cluster = std::make_shared<PathCluster>();
+		cluster->blocking = blocking[c];
+		cluster->entrances = std::move(clusterEntrances);
+		size_t numEntrances = cluster->entrances.size();
+		cluster->distances.resize(numEntrances * numEntrances);
+		int x0 = c % graph->width * PATH_CLUSTER_SIZE;
+		int y0 = c / graph->width * PATH_CLUSTER_SIZE;
+		auto isBlocked = [&](int x, int y) { return cluster->isBlocked(x - x0, y - y0); };
+		unsigned dist[PATH_CLUSTER_TILES];
+		for (size_t i = 0; i < numEntrances; ++i)
+		{
+			fpathClusterDistances(x0, y0, cluster->entrances[i], isBlocked, PathNonblockingArea(), dist);
+			for (size_t j = 0; j < numEntrances; ++j)
+			{
+				PathCoord tile = cluster->entrances[j];
+				cluster->distances[i + j * numEntrances] = dist[(tile.x - x0) + (tile.y - y0) * PATH_CLUSTER_SIZE];
+			}
+		}
+		graph->clusters[c] = std::move(cluster);
+		++numRecalculated;
+	}
+	if (oldGraph != nullptr && oldGraph->clusters.size() == numClusters && numRecalculated == 0)
+	{
+		return oldGraph->shared_from_this();  // Nothing changed, keep using the old graph.
+	}
+
+	// Put together the graph of all the entrances.
+	graph->firstNode.resize(numClusters + 1);
+	for (unsigned c = 0; c < numClusters; ++c)
+	{
+		graph->firstNode[c] = graph->nodeTiles.size();
+		for (PathCoord tile : graph->clusters[c]->entrances)
+		{
+			graph->nodeTiles.push_back(tile);
+			graph->nodeCluster.push_back(c);
+		}
+	}
+	graph->firstNode[numClusters] = graph->nodeTiles.size();
+
+	std::vector<std::vector<PathClusterEdge>> nodeEdges(graph->nodeTiles.size());
+	for (unsigned c = 0; c < numClusters; ++c)
+	{
+		PathCluster const &cluster = *graph->clusters[c];
+		size_t numEntrances = cluster.entrances.size();
+		for (size_t i = 0; i < numEntrances; ++i)
+			for (size_t j = 0; j < numEntrances; ++j)
+			{
+				unsigned cost = cluster.distances[i + j * numEntrances];
+				if (i != j && cost != UINT_MAX)
+				{
+					nodeEdges[graph->firstNode[c] + i].push_back({unsigned(graph->firstNode[c] + j), cost});
+				}
+			}
+	}
+	for (auto const &transition : transitions)
+	{
+		unsigned ca = fpathClusterOf(*graph, transition.first);
+		unsigned cb = fpathClusterOf(*graph, transition.second);
+		unsigned a = graph->firstNode[ca] + fpathClusterEntranceIndex(*graph->clusters[ca], transition.first);
+		unsigned b = graph->firstNode[cb] + fpathClusterEntranceIndex(*graph->clusters[cb], transition.second);
+		nodeEdges[a].push_back({b, 140});
+		nodeEdges[b].push_back({a, 140});
+	}
+	for (auto const &edges : nodeEdges)
+	{
+		graph->firstEdge.push_back(graph->edges.size());
+		graph->edges.insert(graph->edges.end(), edges.begin(), edges.end());
+	}
+	graph->firstEdge.push_back(graph->edges.size());
+
+	debug(LOG_NEVER, "Cluster graph for (%d,%d,%d): %u of %u clusters recalculated, %u entrances", (int)blockingMap.type.propulsion, blockingMap.type.owner, (int)blockingMap.type.moveType, numRecalculated, numClusters, (unsigned)graph->nodeTiles.size());
+	return graph;
+}
+
+bool fpathClusterRouteIsLong(PathCoord orig, PathCoord dest)
+{
+	return std::max(abs(orig.x - dest.x), abs(orig.y - dest.y)) >= 3 * PATH_CLUSTER_SIZE;
+}
+
+std::shared_ptr<PathClusterGraph> fpathClusterGraph(std::shared_ptr<PathBlockingMap> const &blockingMap)
+{
+	PathBlockingType const &type = blockingMap->type;
+	auto cache = std::find_if(fpathClusterCaches.begin(), fpathClusterCaches.end(), [&](PathClusterCache const &c) {
+		return fpathIsEquivalentBlocking(c.type.propulsion, c.type.owner, c.type.moveType, type.propulsion, type.owner, type.moveType);
+	});
+	if (cache == fpathClusterCaches.end())
+	{
+		if (fpathClusterCaches.size() >= PATH_CLUSTER_MAX_CACHES)
+		{
+			// Throw away the graph which was used least recently.
+			cache = std::min_element(fpathClusterCaches.begin(), fpathClusterCaches.end(), [](PathClusterCache const &a, PathClusterCache const &b) {
+				return a.type.gameTime < b.type.gameTime;
+			});
+			cache->graph = nullptr;
+		}
+		else
+		{
+			cache = fpathClusterCaches.insert(fpathClusterCaches.end(), PathClusterCache());
+		}
+	}
+	else if (cache->source == blockingMap.get() && cache->type.gameTime == type.gameTime)
+	{
+		return cache->graph;  // Already have a graph for this blocking map.
+	}
+
+	std::shared_ptr<PathClusterGraph> graph = std::make_shared<PathClusterGraph>();
+	graph->blockingMap = blockingMap;
+	if (cache->graph != nullptr && cache->mapWidth == mapWidth && cache->mapHeight == mapHeight)
+	{
+		// If the last graph was never built, reuse the one it would have reused, so that at most one old graph is kept.
+		std::lock_guard<wz::mutex> lock(cache->graph->mutex);
+		graph->previous = cache->graph->data != nullptr ? cache->graph : cache->graph->previous;
+	}
+	cache->type = type;
+	cache->source = blockingMap.get();
+	cache->mapWidth = mapWidth;
+	cache->mapHeight = mapHeight;
+	cache->graph = graph;
+	return graph;
+}
+
+/// Returns the graph, calculating it if this is the first time it is needed.
+static std::shared_ptr<const PathClusterData> fpathClusterData(PathClusterGraph &graph)
+{
+	std::lock_guard<wz::mutex> lock(graph.mutex);
+	if (graph.data == nullptr)
+	{
+		// The result doesn't depend on the previous graph, it only saves recalculating the clusters which didn't change.
+		std::shared_ptr<const PathClusterData> previousData;
+		if (graph.previous != nullptr)
+		{
+			std::lock_guard<wz::mutex> previousLock(graph.previous->mutex);
+			previousData = graph.previous->data;
+		}
+		graph.data = fpathClusterBuildGraph(*graph.blockingMap, previousData.get());
+		graph.blockingMap = nullptr;
+		graph.previous = nullptr;
+	}
+	return graph.data;
+}
+
+bool fpathClusterCorridor(PathClusterGraph &clusterGraph, PathBlockingMap const &blockingMap, PathCoord orig, PathCoord dest, PathNonblockingArea const &dstIgnore, std::vector<bool> &corridor)
+{
+	std::shared_ptr<const PathClusterData> data = fpathClusterData(clusterGraph);
+	PathClusterData const &graph = *data;
+	ASSERT_OR_RETURN(false, graph.width == fpathClusterMapWidth(mapWidth) && graph.height == fpathClusterMapWidth(mapHeight), "Cluster graph is for a different map");
+	if (orig.x < 0 || orig.y < 0 || orig.x >= mapWidth || orig.y >= mapHeight || dest.x < 0 || dest.y < 0 || dest.x >= mapWidth || dest.y >= mapHeight)
+	{
+		return false;
+	}
+
+	unsigned origCluster = fpathClusterOf(graph, orig);
+	unsigned destCluster = fpathClusterOf(graph, dest);
+	auto isBlocked = [&](int x, int y) {
+		return !dstIgnore.isNonblocking(x, y) && fpathClusterTileBlocked(blockingMap, x, y);
+	};
+	unsigned origDist[PATH_CLUSTER_TILES], destDist[PATH_CLUSTER_TILES];
+	int origX0 = orig.x / PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE, origY0 = orig.y / PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE;
+	int destX0 = dest.x / PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE, destY0 = dest.y / PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE;
+	fpathClusterDistances(origX0, origY0, orig, isBlocked, dstIgnore, origDist);
+	fpathClusterDistances(destX0, destY0, dest, isBlocked, dstIgnore, destDist);
+
+	// A* on the entrances, with two extra nodes for orig and dest.
+	unsigned numNodes = graph.nodeTiles.size();
+	unsigned origNode = numNodes;
+	unsigned destNode = numNodes + 1;
+	std::vector<unsigned> dist(numNodes + 2, UINT_MAX);
+	std::vector<unsigned> prev(numNodes + 2, UINT_MAX);
+	struct Open
+	{
+		bool operator <(Open const &z) const
+		{
+			// Same ordering as PathNode, so the best node is at the front of the heap.
+			if (est != z.est)
+			{
+				return est > z.est;
+			}
+			if (dist != z.dist)
+			{
+				return dist < z.dist;
+			}
+			return node > z.node;
+		}
+		unsigned est, dist, node;
+	};
+	std::vector<Open> open;
+	auto nodeTile = [&](unsigned node) { return node == origNode ? orig : node == destNode ? dest : graph.nodeTiles[node]; };
+	auto relax = [&](unsigned from, unsigned to, unsigned cost) {
+		if (cost == UINT_MAX || dist[from] + cost >= dist[to])
+		{
+			return;
+		}
+		dist[to] = dist[from] + cost;
+		prev[to] = from;
+		open.push_back({dist[to] + fpathClusterEstimate(nodeTile(to), dest), dist[to], to});
+		std::push_heap(open.begin(), open.end());
+	};
+
+	dist[origNode] = 0;
+	open.push_back({fpathClusterEstimate(orig, dest), 0, origNode});
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end());
+		Open cur = open.back();
+		open.pop_back();
+		if (cur.dist != dist[cur.node])
+		{
+			continue;  // Already found a shorter way here.
+		}
+		if (cur.node == destNode)
+		{
+			break;
+		}
+		unsigned nodeCluster = cur.node == origNode ? origCluster : graph.nodeCluster[cur.node];
+		if (cur.node == origNode)
+		{
+			for (unsigned n = graph.firstNode[origCluster]; n < graph.firstNode[origCluster + 1]; ++n)
+			{
+				relax(origNode, n, origDist[(graph.nodeTiles[n].x - origX0) + (graph.nodeTiles[n].y - origY0) * PATH_CLUSTER_SIZE]);
+			}
+		}
+		else
+		{
+			for (unsigned e = graph.firstEdge[cur.node]; e < graph.firstEdge[cur.node + 1]; ++e)
+			{
+				relax(cur.node, graph.edges[e].node, graph.edges[e].cost);
+			}
+		}
+		if (nodeCluster == destCluster)
+		{
+			PathCoord tile = nodeTile(cur.node);
+			relax(cur.node, destNode, destDist[(tile.x - destX0) + (tile.y - destY0) * PATH_CLUSTER_SIZE]);
+		}
+	}
+	if (dist[destNode] == UINT_MAX)
+	{
+		return false;  // Unreachable, or only reachable through dstIgnore outside its cluster. Let the tile A* find the nearest tile.
+	}
+
+	// Allow the tile A* to use the clusters along the route, and their neighbours.
+	corridor.assign(graph.width * graph.height, false);
+	for (unsigned node = destNode; node != UINT_MAX; node = prev[node])
+	{
+		PathCoord tile = nodeTile(node);
+		int cx = tile.x / PATH_CLUSTER_SIZE, cy = tile.y / PATH_CLUSTER_SIZE;
+		for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, graph.height - 1); ++y)
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, graph.width - 1); ++x)
+			{
+				corridor[x + y * graph.width] = true;
+			}
+	}
+	return true;
+}
+
+void fpathClusterReset()
+{
+	fpathClusterCaches.clear();
+}
@@ -0,0 +1,69 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Hierarchical (HPA*) path finding layer over the tile A*.
+ *
+ *  The map is split into square clusters of tiles. Where two neighbouring clusters have
+ *  passable tiles next to each other on their common border, there is an entrance, and
+ *  the distances between the entrances of each cluster are precalculated. Long routes are
+ *  first planned on this graph of entrances, and the tile A* is then restricted to the
+ *  corridor of clusters the abstract route passes through.
+ */
+
+#ifndef __INCLUDED_SRC_PATHCLUSTER_H__
+#define __INCLUDED_SRC_PATHCLUSTER_H__
+
+#include <memory>
+#include <vector>
+
+/// Width and height of a cluster, in tiles.
+#define PATH_CLUSTER_SIZE 16
+
+struct PathCoord;
+struct PathBlockingMap;
+struct PathNonblockingArea;
+struct PathClusterGraph;
+
+/// Returns true if a route from orig to dest is long enough that planning it on the cluster graph is worthwhile.
+bool fpathClusterRouteIsLong(PathCoord orig, PathCoord dest);
+
+/** Call from main thread.
+ *  Returns the cluster graph for the given blocking map. The graph isn't calculated until it is first used
+ *  by fpathClusterCorridor, and then only the clusters whose blocking tiles or entrances changed since the
+ *  previous graph for the same kind of blocking map get recalculated.
+ */
+std::shared_ptr<PathClusterGraph> fpathClusterGraph(std::shared_ptr<PathBlockingMap> const &blockingMap);
+
+/** Plans a route from orig to dest on the cluster graph. Function is thread-safe.
+ *
+ *  @param corridor Set to one flag per cluster, true for the clusters the route passes through and their neighbours.
+ *  @return false if no route was found, in which case the whole map should be searched.
+ */
+bool fpathClusterCorridor(PathClusterGraph &graph, PathBlockingMap const &blockingMap, PathCoord orig, PathCoord dest, PathNonblockingArea const &dstIgnore, std::vector<bool> &corridor);
+
+/// Returns the number of clusters in a row of the map.
+static inline int fpathClusterMapWidth(int mapWidth)
+{
+	return (mapWidth + PATH_CLUSTER_SIZE - 1) / PATH_CLUSTER_SIZE;
+}
+
+/// Call from main thread. Throws away all cached cluster graphs.
+void fpathClusterReset();
+
+#endif // __INCLUDED_SRC_PATHCLUSTER_H__
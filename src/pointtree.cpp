@@ -77,38 +77,71 @@ static uint64_t interleave(int32_t x, int32_t y)
 	return expandX(x) | expandY(y);
 }
 
-void PointTree::insert(void *pointData, int32_t x, int32_t y)
+void PointTree::insert(void *pointData, int32_t x, int32_t y, uint32_t order)
 {
-	points.push_back(Point(interleave(x, y), pointData));
+	inserted.push_back({interleave(x, y), order, pointData});
+}
+
+void PointTree::erase(void *pointData, int32_t x, int32_t y, uint32_t order)
+{
+	erased.push_back({interleave(x, y), order, pointData});
 }
 
 void PointTree::clear()
 {
 	points.clear();
+	inserted.clear();
+	erased.clear();
 }
 
-static bool pointTreeSortFunction(std::pair<uint64_t, void *> const &a, std::pair<uint64_t, void *> const &b)
+static bool pointTreeSortFunction(PointTree::Point const &a, PointTree::Point const &b)
 {
-	return a.first < b.first;  // Sort only by position, not by pointer address, even if two units are in the same place.
+	return a.key < b.key;  // Sort only by position, not by pointer address, even if two units are in the same place.
 }
 
-void PointTree::sort()
+static bool pointTreeEraseFunction(PointTree::Point const &a, PointTree::Point const &b)
 {
-	std::stable_sort(points.begin(), points.end(), pointTreeSortFunction);  // Stable sort to avoid unspecified behaviour when two objects are in exactly the same place.
+	return PointTree::isBefore(a, b) || (!PointTree::isBefore(b, a) && a.data < b.data);  // Pointers only compared to find the point to erase, never affects the order of points.
 }
 
-//#define DUMP_IMAGE  // All x and y coordinates must be in range -500 to 499, if dumping an image.
-#ifdef DUMP_IMAGE
-#include <math.h>
-uint8_t ppm[1000][1000][3];
-int doDump = false;
-#endif //DUMP_IMAGE
+void PointTree::sort()
+{
+	if (inserted.empty() && erased.empty())
+	{
+		return;  // Nothing changed.
+	}
+
+	// Stable sort to avoid unspecified behaviour when two objects are in exactly the same place with the same order.
+	std::stable_sort(inserted.begin(), inserted.end(), isBefore);
+	std::sort(erased.begin(), erased.end(), pointTreeEraseFunction);
+	if (!erased.empty())
+	{
+		points.erase(std::remove_if(points.begin(), points.end(), [this](Point const &point) {
+			return std::binary_search(erased.begin(), erased.end(), point, pointTreeEraseFunction);
+		}), points.end());
+	}
+	if (!inserted.empty())
+	{
+		scratch.resize(points.size() + inserted.size());
+		std::merge(points.begin(), points.end(), inserted.begin(), inserted.end(), scratch.begin(), isBefore);
+		std::swap(points, scratch);
+	}
+	inserted.clear();
+	erased.clear();
+}
 
 struct PointTreeRange
 {
 	uint64_t a, z;
 };
 
+static inline bool pointTreeInSquare(uint64_t key, uint64_t minX, uint64_t maxX, uint64_t minY, uint64_t maxY)
+{
+	uint64_t px = key & 0xAAAAAAAAAAAAAAAAULL;
+	uint64_t py = key & 0x5555555555555555ULL;
+	return px >= minX && px <= maxX && py >= minY && py <= maxY;
+}
+
 // If !IsFiltered, function is trivially optimised to "return i;".
 template<bool IsFiltered>
 static unsigned current(std::vector<unsigned> &filterData, unsigned i)
@@ -128,8 +161,8 @@ static unsigned current(std::vector<unsigned> &filterData, unsigned i)
 	return ret;
 }
 
-template<bool IsFiltered>
-PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo)
+/// Finds up to 4 ranges of Morton numbers, which together cover the square, plus some extra points. Returns the number of ranges.
+static int pointTreeFindRanges(int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo, PointTreeRange ranges[4])
 {
 	uint64_t minX = expandX(minXo);
 	uint64_t maxX = expandX(maxXo);
@@ -144,62 +177,12 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 	uint64_t splitY1 = expandY(splitYo - 1);
 	uint64_t splitY2 = expandY(splitYo);
 
-	PointTreeRange ranges[4] = {{minX    | minY,    splitX1 | splitY1},
-		{splitX2 | minY,    maxX    | splitY1},
-		{minX    | splitY2, splitX1 | maxY},
-		{splitX2 | splitY2, maxX    | maxY}
-	};
+	ranges[0] = {minX    | minY,    splitX1 | splitY1};
+	ranges[1] = {splitX2 | minY,    maxX    | splitY1};
+	ranges[2] = {minX    | splitY2, splitX1 | maxY};
+	ranges[3] = {splitX2 | splitY2, maxX    | maxY};
 	int numRanges = 4;
 
-#ifdef DUMP_IMAGE
-	FILE *f;
-	if (doDump)
-	{
-		f = fopen("pointtree.ppm", "wb");
-		fprintf(f, "P6\n1000 1000\n255\n");
-		for (int py = 0; py != 1000; ++py) for (int px = 0; px != 1000; ++px)
-			{
-				int ax = px - 500, ay = py - 500;
-				double dx = ax - x, dy = ay - y;
-				double dist = sqrt(dx * dx + dy * dy);
-				ppm[py][px][0] = 255;
-				ppm[py][px][1] = 255;
-				ppm[py][px][2] = 255;
-				if (dist <= radius)
-				{
-					ppm[py][px][0] = 128;
-					ppm[py][px][1] = 128;
-					ppm[py][px][2] = 128;
-				}
-				if (ax == minXo || ax == splitXo || ax == maxXo || ay == minYo || ay == splitYo || ay == maxYo)
-				{
-					ppm[py][px][0] /= 2;
-					ppm[py][px][1] /= 2;
-					ppm[py][px][2] /= 2;
-				}
-				uint64_t nn = expandX(ax) | expandY(ay);
-				if (ranges[0].a <= nn && nn <= ranges[0].z)
-				{
-					ppm[py][px][0] /= 2;
-				}
-				if (ranges[1].a <= nn && nn <= ranges[1].z)
-				{
-					ppm[py][px][1] /= 2;
-				}
-				if (ranges[2].a <= nn && nn <= ranges[2].z)
-				{
-					ppm[py][px][2] /= 2;
-				}
-				if (ranges[3].a <= nn && nn <= ranges[3].z && ((ax ^ ay) & 2))
-				{
-					ppm[py][px][0] /= 2;
-					ppm[py][px][1] /= 2;
-					ppm[py][px][2] /= 2;
-				}
-			}
-	}
-#endif //DUMP_IMAGE
-
 	// Sort ranges ready to be merged.
 	if (ranges[1].a > ranges[2].a)
 	{
@@ -225,6 +208,20 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 		--numRanges;
 	}
 
+	return numRanges;
+}
+
+template<bool IsFiltered>
+PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo)
+{
+	uint64_t minX = expandX(minXo);
+	uint64_t maxX = expandX(maxXo);
+	uint64_t minY = expandY(minYo);
+	uint64_t maxY = expandY(maxYo);
+
+	PointTreeRange ranges[4];
+	int numRanges = pointTreeFindRanges(minXo, minYo, maxXo, maxYo, ranges);
+
 	lastQueryResults.clear();
 	if (IsFiltered)
 	{
@@ -233,57 +230,82 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 	for (int r = 0; r != numRanges; ++r)
 	{
 		// Find range of points which may be close enough. Range is [i1 ... i2 - 1]. The pointers are ignored when searching.
-		unsigned i1 = std::lower_bound(points.begin(),      points.end(), Point(ranges[r].a, (void *)nullptr), pointTreeSortFunction) - points.begin();
-		unsigned i2 = std::upper_bound(points.begin() + i1, points.end(), Point(ranges[r].z, (void *)nullptr), pointTreeSortFunction) - points.begin();
+		unsigned i1 = std::lower_bound(points.begin(),      points.end(), Point{ranges[r].a, 0, nullptr}, pointTreeSortFunction) - points.begin();
+		unsigned i2 = std::upper_bound(points.begin() + i1, points.end(), Point{ranges[r].z, 0, nullptr}, pointTreeSortFunction) - points.begin();
 
 		for (unsigned i = current<IsFiltered>(filter.data, i1); i < i2; i = current<IsFiltered>(filter.data, i + 1))
 		{
-			uint64_t px = points[i].first & 0xAAAAAAAAAAAAAAAAULL;
-			uint64_t py = points[i].first & 0x5555555555555555ULL;
-			if (px >= minX && px <= maxX && py >= minY && py <= maxY)  // Only add point if it's at least in the desired square.
+			if (pointTreeInSquare(points[i].key, minX, maxX, minY, maxY))  // Only add point if it's at least in the desired square.
 			{
-				lastQueryResults.push_back(points[i].second);
+				lastQueryResults.push_back(points[i]);
 				if (IsFiltered)
 				{
 					lastFilteredQueryIndices.push_back(i);
 				}
-#ifdef DUMP_IMAGE
-				if (doDump)
-				{
-					ppm[((int32_t *)points[i].second)[1] + 500][((int32_t *)points[i].second)[0] + 500][0] = 192;
-					ppm[((int32_t *)points[i].second)[1] + 500][((int32_t *)points[i].second)[0] + 500][1] = 128;
-					ppm[((int32_t *)points[i].second)[1] + 500][((int32_t *)points[i].second)[0] + 500][2] = 0;
-				}
-#endif //DUMP_IMAGE
 			}
 		}
 	}
 
-#ifdef DUMP_IMAGE
-	if (doDump)
+
+	return lastQueryResults;
+}
+
+PointTree::Cursor::Cursor(PointTree const &pointTree, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo)
+	: points(pointTree.points.data())
+	, minX(expandX(minXo))
+	, maxX(expandX(maxXo))
+	, minY(expandY(minYo))
+	, maxY(expandY(maxYo))
+	, range(0)
+{
+	PointTreeRange ranges[4];
+	numRanges = pointTreeFindRanges(minXo, minYo, maxXo, maxYo, ranges);
+	for (int r = 0; r != numRanges; ++r)
 	{
-		fwrite(ppm[0][0], 3000000, 1, f);
-		fclose(f);
+		// Range is [begin[r] ... end[r] - 1]. The pointers are ignored when searching.
+		Vector const &v = pointTree.points;
+		begin[r] = std::lower_bound(v.begin(),            v.end(), Point{ranges[r].a, 0, nullptr}, pointTreeSortFunction) - v.begin();
+		end[r]   = std::upper_bound(v.begin() + begin[r], v.end(), Point{ranges[r].z, 0, nullptr}, pointTreeSortFunction) - v.begin();
 	}
-#endif //DUMP_IMAGE
+	index = numRanges != 0 ? begin[0] : 0;
+	skip();
+}
 
-	return lastQueryResults;
+void PointTree::Cursor::skip()
+{
+	for (; range != numRanges; ++range)
+	{
+		if (index < begin[range])
+		{
+			index = begin[range];
+		}
+		for (; index < end[range]; ++index)
+		{
+			if (pointTreeInSquare(points[index].key, minX, maxX, minY, maxY))
+			{
+				return;
+			}
+		}
+	}
 }
 
-PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
+PointTree::Cursor PointTree::cursor(int32_t x, int32_t y, uint32_t radius) const
 {
-	Filter unused;
-	return queryMaybeFilter<false>(unused, x, y, x2, y2);
+	return Cursor(*this, x - radius, y - radius, x + radius, y + radius);
 }
 
-PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t radius)
+PointTree::Cursor PointTree::cursor(int32_t x, int32_t y, int32_t x2, int32_t y2) const
 {
-	Filter unused;
-	int32_t minXo = x - radius;
-	int32_t maxXo = x + radius;
-	int32_t minYo = y - radius;
-	int32_t maxYo = y + radius;
-	return queryMaybeFilter<false>(unused, minXo, minYo, maxXo, maxYo);
+	return Cursor(*this, x, y, x2, y2);
+}
+
+void PointTree::query(ResultVector &results, int32_t x, int32_t y, uint32_t radius) const
+{
+	results.clear();
+	for (Cursor i = cursor(x, y, radius); i.valid(); i.next())
+	{
+		results.push_back(*i);
+	}
 }
 
 PointTree::ResultVector &PointTree::query(Filter &filter, int32_t x, int32_t y, uint32_t radius)
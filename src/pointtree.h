@@ -28,7 +28,13 @@
 class PointTree
 {
 public:
-	typedef std::vector<void *> ResultVector;
+	struct Point
+	{
+		uint64_t key;    ///< Morton number of the position.
+		uint32_t order;  ///< Points at the same position are sorted by order.
+		void *data;
+	};
+	typedef std::vector<Point> ResultVector;
 	typedef std::vector<unsigned> IndexVector;
 	class Filter  ///< Filters are invalidated when modifying the PointTree.
 	{
@@ -52,31 +58,78 @@ public:
 		Data data;
 	};
 
-	void insert(void *pointData, int32_t x, int32_t y);                       ///< Inserts a point into the point tree.
+	/// Inserts a point into the point tree. Points with the same position are sorted by order, which should be unique.
+	void insert(void *pointData, int32_t x, int32_t y, uint32_t order);
+	/// Removes a point, which was inserted with the same parameters before the last sort().
+	void erase(void *pointData, int32_t x, int32_t y, uint32_t order);
 	void clear();                                                             ///< Clears the PointTree.
-	void sort();                                                              ///< Must be done between inserting and querying, to get meaningful results.
-	/// Returns all points less than or equal to radius from (x, y), possibly plus some extra nearby points.
+	/// Must be done between inserting or erasing and querying, to get meaningful results.
+	/// Only the inserted points need sorting, so this is cheap if few points changed since the last sort.
+	void sort();
+	/// Iterates over the points in a square, in sorted order (by position (Morton number), then by order), without
+	/// modifying anything. Thread safe, as long as the PointTree isn't modified while any cursor is in use.
+	class Cursor
+	{
+	public:
+		Cursor(PointTree const &pointTree, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo);
+		bool valid() const
+		{
+			return range != numRanges;
+		}
+		Point const &operator *() const
+		{
+			return points[index];
+		}
+		void next()
+		{
+			++index;
+			skip();
+		}
+
+	private:
+		void skip();  ///< Moves to the next point inside the square, unless already there.
+
+		Point const *points;
+		uint64_t minX, maxX, minY, maxY;
+		unsigned begin[4], end[4];  ///< Ranges of points which may be in the square.
+		int numRanges, range;
+		unsigned index;
+	};
+
+	/// Returns a cursor over all points less than or equal to radius from (x, y), possibly plus some extra nearby points.
+	/// (More specifically, all points in a square with edge length 2*radius.)
+	Cursor cursor(int32_t x, int32_t y, uint32_t radius) const;
+	/// Returns a cursor over all points within the given rectangle.
+	Cursor cursor(int32_t x, int32_t y, int32_t x2, int32_t y2) const;
+	/// Returns all points less than or equal to radius from (x, y), possibly plus some extra nearby points, into the caller's buffer.
 	/// (More specifically, returns all objects in a square with edge length 2*radius.)
-	/// Note: Not thread safe, because it modifies lastQueryResults.
-	ResultVector &query(int32_t x, int32_t y, uint32_t radius);
+	/// Results are sorted by position (Morton number), then by order. Thread safe, if each thread has its own buffer.
+	void query(ResultVector &results, int32_t x, int32_t y, uint32_t radius) const;
 	/// Returns all points which have not been filtered away, less than or equal to radius from (x, y), possibly plus some extra nearby points.
 	/// (More specifically, returns objects in a square with edge length 2*radius.)
 	/// Note: Not thread safe, because it modifies lastQueryResults, lastFilteredQueryIndices and the internal filter representation for faster lookups.
+	/// If the filter is only an optimisation, use a cursor and test the condition directly instead.
 	ResultVector &query(Filter &filter, int32_t x, int32_t y, uint32_t radius);
-	/// Returns all points which have not been filtered away within given rectangle. See function above on thread safety.
-	ResultVector &query(int32_t x, int32_t y, uint32_t x2, uint32_t y2);
+
+	/// Returns true if a is sorted before b.
+	static bool isBefore(Point const &a, Point const &b)
+	{
+		return a.key < b.key || (a.key == b.key && a.order < b.order);
+	}
 
 	ResultVector lastQueryResults;
 	IndexVector lastFilteredQueryIndices;
 
 private:
-	typedef std::pair<uint64_t, void *> Point;
 	typedef std::vector<Point> Vector;
 
 	template<bool IsFiltered>
 	ResultVector &queryMaybeFilter(Filter &filter, int32_t minXo, int32_t maxXo, int32_t minYo, int32_t maxYo);
 
-	Vector points;
+	Vector points;    ///< Sorted points.
+	Vector inserted;  ///< Points to insert on the next sort().
+	Vector erased;    ///< Points to remove on the next sort().
+	Vector scratch;   ///< Reused by sort(), to avoid reallocating.
 };
 
 #endif //_point_tree_h
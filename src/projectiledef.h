@@ -42,6 +42,10 @@ struct PROJECTILE : public SIMPLE_OBJECT
 {
 	PROJECTILE(uint32_t id, unsigned player) : SIMPLE_OBJECT(OBJ_PROJECTILE, id, player) {}
 
+	// Memory comes from a pool, see objpool.h.
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	void            update();
 	bool            deleteIfDead()
 	{
@@ -64,6 +64,7 @@
 #include "qtscript.h"
 
 #include "lib/framework/file.h"
+#include "lib/framework/math_ext.h"
 #include "lib/gamelib/gtime.h"
 #include "lib/netplay/netplay.h"
 #include "multiplay.h"
@@ -78,6 +79,8 @@
 #include "game.h"
 #include "warzoneconfig.h"
 
+#include <algorithm>
+#include <ctime>
 #include <set>
 #include <memory>
 #include <utility>
@@ -181,6 +184,303 @@ scripting_engine::area_by_values_or_area_label_lookup::area_by_values_or_area_la
 #define MAX_US 20000
 #define HALF_MAX_US 10000
 
+static bool scriptTimerStagger = false;
+
+void scriptSetTimerStagger(bool stagger)
+{
+	scriptTimerStagger = stagger;
+}
+
+bool scriptGetTimerStagger()
+{
+	return scriptTimerStagger;
+}
+
+/// An AI script running its timers in parallel, see scriptSetParallelAI().
+struct ScriptWorker
+{
+	enum State
+	{
+		IDLE,     ///< Has no timers to run this tick.
+		RUNNING,  ///< Running script code.
+		WAITING,  ///< Waiting for its turn to call into the game, or for the main thread to make the call if it is scriptTurn.
+		DONE,     ///< Finished running its timers for this tick.
+	};
+
+	wzapi::scripting_instance *instance = nullptr;
+	WZ_THREAD *thread = nullptr;
+	WZ_SEMAPHORE *start = nullptr;  ///< Posted by the main thread when there are timers to run, or when quitting.
+	WZ_SEMAPHORE *wake = nullptr;   ///< Posted when given the turn, or when the instance waited for by scriptWaitForInstance() has stopped.
+	WZ_SEMAPHORE *called = nullptr; ///< Posted by the main thread when done making the call into the game for the worker.
+	bool quit = false;
+	State state = IDLE;
+	unsigned calls = 0;             ///< Calls into the game made this tick, decides whose turn it is.
+	unsigned depth = 0;             ///< Number of nested calls into the game being made for the worker.
+	std::function<void ()> const *call = nullptr;  ///< Call into the game for the main thread to make.
+	std::vector<std::shared_ptr<scripting_engine::timerNode>> runlist;
+};
+
+static bool scriptParallelAI = false;
+static bool scriptProfiling = false;
+static std::unordered_map<wzapi::scripting_instance *, ScriptWorker *> scriptWorkers;  ///< Only changed by the main thread, while no workers are running.
+static std::vector<ScriptWorker *> scriptActiveWorkers;  ///< Workers running this tick, by player.
+static WZ_SEMAPHORE *scriptMainWake = nullptr;           ///< Posted by each worker, once done, and when it has a call for the main thread.
+static wz::mutex scriptTurnMutex;                        ///< Protects the states of the workers, and the variables below.
+static ScriptWorker *scriptCaller = nullptr;             ///< Worker waiting for the main thread to make its call into the game.
+static ScriptWorker *scriptTurn = nullptr;               ///< Worker whose call into the game is being made.
+static ScriptWorker *scriptStopWaiter = nullptr;         ///< Worker waiting in scriptWaitForInstance(), if any.
+static ScriptWorker *scriptStopTarget = nullptr;         ///< Worker scriptStopWaiter is waiting for.
+static thread_local ScriptWorker *currentScriptWorker = nullptr;
+
+void scriptSetParallelAI(bool parallel)
+{
+	scriptParallelAI = parallel;
+}
+
+bool scriptGetParallelAI()
+{
+	return scriptParallelAI;
+}
+
+void scriptSetProfiling(bool profiling)
+{
+	scriptProfiling = profiling;
+}
+
+bool scriptGetProfiling()
+{
+	return scriptProfiling;
+}
+
+// Gives the turn to the worker with the fewest calls so far, if it is waiting for it. Call with scriptTurnMutex locked.
+static ScriptWorker *scriptNextTurn()
+{
+	if (scriptTurn != nullptr)
+	{
+		return nullptr;
+	}
+	ScriptWorker *next = nullptr;
+	for (ScriptWorker *worker : scriptActiveWorkers)
+	{
+		if (worker->state != ScriptWorker::DONE && (next == nullptr || worker->calls < next->calls))
+		{
+			next = worker;
+		}
+	}
+	if (next == nullptr || next->state != ScriptWorker::WAITING)
+	{
+		return nullptr;  // Have to wait for the next worker to get to its next call, even if others are waiting already.
+	}
+	scriptTurn = next;
+	return next;
+}
+
+// Call with scriptTurnMutex locked, when the worker stops running script code.
+static void scriptWorkerStopped(ScriptWorker *worker)
+{
+	if (scriptStopTarget == worker)
+	{
+		wzSemaphorePost(scriptStopWaiter->wake);
+		scriptStopWaiter = nullptr;
+		scriptStopTarget = nullptr;
+	}
+}
+
+void scriptCallIntoGame(std::function<void ()> const &call)
+{
+	ScriptWorker *worker = currentScriptWorker;
+	if (worker == nullptr || worker->depth != 0)
+	{
+		call();  // Not running in parallel, or already on the main thread, making a call for the worker.
+		return;
+	}
+	ScriptWorker *next;
+	{
+		std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+		worker->state = ScriptWorker::WAITING;
+		scriptWorkerStopped(worker);
+		next = scriptNextTurn();
+	}
+	if (next != worker)
+	{
+		ASSERT(next == nullptr, "Gave the turn to the wrong worker");
+		wzSemaphoreWait(worker->wake);
+	}
+	{
+		std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+		worker->call = &call;
+		scriptCaller = worker;
+	}
+	wzSemaphorePost(scriptMainWake);
+	wzSemaphoreWait(worker->called);
+	{
+		std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+		++worker->calls;
+		worker->state = ScriptWorker::RUNNING;
+		scriptTurn = nullptr;
+		next = scriptNextTurn();
+	}
+	if (next != nullptr)
+	{
+		wzSemaphorePost(next->wake);
+	}
+}
+
+void scriptWaitForInstance(wzapi::scripting_instance *instance)
+{
+	ScriptWorker *worker = currentScriptWorker;
+	if (worker == nullptr || worker->instance == instance)
+	{
+		return;
+	}
+	ASSERT(worker->depth != 0, "Running another script without having the turn");
+	auto it = scriptWorkers.find(instance);
+	if (it == scriptWorkers.end())
+	{
+		return;
+	}
+	{
+		std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+		if (it->second->state != ScriptWorker::RUNNING)
+		{
+			return;
+		}
+		scriptStopWaiter = worker;
+		scriptStopTarget = it->second;
+	}
+	wzSemaphoreWait(worker->wake);
+}
+
+static int scriptWorkerThreadFunc(void *data)
+{
+	ScriptWorker *worker = static_cast<ScriptWorker *>(data);
+	currentScriptWorker = worker;
+	while (true)
+	{
+		wzSemaphoreWait(worker->start);
+		if (worker->quit)
+		{
+			break;
+		}
+		for (auto &node : worker->runlist)
+		{
+			scripting_engine::instance().runTimer(*node);
+		}
+		ScriptWorker *next;
+		{
+			std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+			worker->state = ScriptWorker::DONE;
+			scriptWorkerStopped(worker);
+			next = scriptNextTurn();
+		}
+		if (next != nullptr)
+		{
+			wzSemaphorePost(next->wake);
+		}
+		wzSemaphorePost(scriptMainWake);
+	}
+	return 0;
+}
+
+static ScriptWorker *getScriptWorker(wzapi::scripting_instance *instance)
+{
+	ScriptWorker *&worker = scriptWorkers[instance];
+	if (worker == nullptr)
+	{
+		if (scriptMainWake == nullptr)
+		{
+			scriptMainWake = wzSemaphoreCreate(0);
+		}
+		worker = new ScriptWorker;
+		worker->instance = instance;
+		worker->start = wzSemaphoreCreate(0);
+		worker->wake = wzSemaphoreCreate(0);
+		worker->called = wzSemaphoreCreate(0);
+		worker->thread = wzThreadCreate(scriptWorkerThreadFunc, worker);
+		wzThreadStart(worker->thread);
+	}
+	return worker;
+}
+
+// Makes the call into the game of the worker which has the turn, on the main thread. While making it, the main thread acts
+// as the worker, so that scripts run by the call wait for the AIs they belong to as the worker would.
+static void runScriptWorkerCall(ScriptWorker *worker)
+{
+	ScriptWorker *mainWorker = currentScriptWorker;
+	currentScriptWorker = worker;
+	++worker->depth;
+	(*worker->call)();
+	--worker->depth;
+	worker->call = nullptr;
+	currentScriptWorker = mainWorker;
+	wzSemaphorePost(worker->called);
+}
+
+// Runs the timers of each worker on its own thread, and makes their calls into the game until all are done.
+static void runScriptWorkers()
+{
+	std::sort(scriptActiveWorkers.begin(), scriptActiveWorkers.end(), [](ScriptWorker const *a, ScriptWorker const *b) {
+		return a->instance->player() < b->instance->player();
+	});
+	{
+		std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+		for (ScriptWorker *worker : scriptActiveWorkers)
+		{
+			worker->state = ScriptWorker::RUNNING;
+			worker->calls = 0;
+		}
+	}
+	for (ScriptWorker *worker : scriptActiveWorkers)
+	{
+		wzSemaphorePost(worker->start);
+	}
+	size_t done = 0;
+	while (done < scriptActiveWorkers.size())
+	{
+		wzSemaphoreWait(scriptMainWake);
+		ScriptWorker *caller;
+		{
+			std::lock_guard<wz::mutex> lock(scriptTurnMutex);
+			caller = scriptCaller;
+			scriptCaller = nullptr;
+		}
+		if (caller != nullptr)
+		{
+			runScriptWorkerCall(caller);
+		}
+		else
+		{
+			++done;  // Each post is either a call or a worker being done, and there is at most one call at a time.
+		}
+	}
+	for (ScriptWorker *worker : scriptActiveWorkers)
+	{
+		worker->state = ScriptWorker::IDLE;
+		worker->runlist.clear();
+	}
+	scriptActiveWorkers.clear();
+}
+
+static void shutdownScriptWorkers()
+{
+	for (auto &it : scriptWorkers)
+	{
+		ScriptWorker *worker = it.second;
+		worker->quit = true;
+		wzSemaphorePost(worker->start);
+		wzThreadJoin(worker->thread);
+		wzSemaphoreDestroy(worker->start);
+		wzSemaphoreDestroy(worker->wake);
+		wzSemaphoreDestroy(worker->called);
+		delete worker;
+	}
+	scriptWorkers.clear();
+	if (scriptMainWake != nullptr)
+	{
+		wzSemaphoreDestroy(scriptMainWake);
+		scriptMainWake = nullptr;
+	}
+}
 
 uniqueTimerID scripting_engine::getNextAvailableTimerID()
 {
@@ -201,6 +501,12 @@ uniqueTimerID scripting_engine::setTimer(wzapi::scripting_instance *caller, cons
 	}
 	node->type = type;
 	node->timerID = newTimerID;
+	int periodTicks = milliseconds / GAME_TICKS_PER_UPDATE;
+	if (scriptTimerStagger && type == TIMER_REPEAT && periodTicks > 1 && aiInstances.count(caller) != 0)
+	{
+		node->frameTime += (player % periodTicks) * GAME_TICKS_PER_UPDATE;
+	}
+	scheduleTimer(node);
 	auto inserted_iter = timers.emplace(timers.end(), std::move(node));
 	timerIDMap[newTimerID] = inserted_iter;
 	return newTimerID;
@@ -210,10 +516,55 @@ uniqueTimerID scripting_engine::setTimer(wzapi::scripting_instance *caller, cons
 void scripting_engine::addTimerNode(std::shared_ptr<scripting_engine::timerNode>&& node)
 {
 	ASSERT(timerIDMap.count(node->timerID) == 0, "Duplicate timerID found: %s", WzString::number(node->timerID).toUtf8().c_str());
+	if (node->type == TIMER_ONESHOT_DONE)
+	{
+		return;  // Already ran, and would have been removed.
+	}
+	scheduleTimer(node);
 	auto inserted_iter = timers.emplace(timers.end(), std::move(node));
 	timerIDMap[(*inserted_iter)->timerID] = inserted_iter;
 }
 
+void scripting_engine::scheduleTimer(const std::shared_ptr<timerNode>& node)
+{
+	timerQueue.push_back(timerQueueEntry{node->frameTime, node->timerID, node});
+	std::push_heap(timerQueue.begin(), timerQueue.end());
+}
+
+void scripting_engine::runTimer(timerNode &node)
+{
+	bool removed = false;
+	BASE_OBJECT *psObj = nullptr;
+	scriptCallIntoGame([&node, &removed, &psObj] {
+		// IMPORTANT: A queued function can delete a timer that is in the runlist!
+		// So we must verify that the node is not one of the deleted ones.
+		removed = node.type == TIMER_REMOVED;
+		if (!removed)
+		{
+			psObj = IdToObject(node.baseobjtype, node.baseobj, node.player);
+		}
+	});
+	if (removed)
+	{
+		return; // skip
+	}
+	node.function(node.timerID, psObj, node.additionalTimerFuncParam.get());
+}
+
+// Throws away the stale entries of timerQueue, which pile up if timers are removed long before they are due.
+void scripting_engine::rebuildTimerQueue()
+{
+	timerQueue.clear();
+	for (const auto &node : timers)
+	{
+		if (node->type != TIMER_ONESHOT_DONE)
+		{
+			timerQueue.push_back(timerQueueEntry{node->frameTime, node->timerID, node});
+		}
+	}
+	std::make_heap(timerQueue.begin(), timerQueue.end());
+}
+
 /// Scripting engine (what others call the scripting context, but QtScript's nomenclature is different).
 static std::vector<wzapi::scripting_instance *> scripts;
 
@@ -377,6 +728,37 @@ bool shutdownScripts()
 	return scripting_engine::instance().shutdownScripts();
 }
 
+// Writes the profiles of the scripts to logs/scriptprofile-<date>.json.
+static void writeScriptProfiles()
+{
+	nlohmann::json profiles = nlohmann::json::array();
+	for (auto *instance : scripts)
+	{
+		nlohmann::json profile = instance->debugGetProfile();
+		if (!profile.is_null())
+		{
+			profile["script"] = instance->scriptName();
+			profile["player"] = instance->player();
+			profiles.push_back(std::move(profile));
+		}
+	}
+	if (profiles.empty())
+	{
+		return;
+	}
+
+	time_t aclock;
+	time(&aclock);
+	struct tm *newtime = localtime(&aclock);
+	char filename[256];
+	snprintf(filename, sizeof(filename), "logs/scriptprofile-%04d%02d%02d_%02d%02d%02d.json", newtime->tm_year + 1900, newtime->tm_mon + 1, newtime->tm_mday, newtime->tm_hour, newtime->tm_min, newtime->tm_sec);
+	std::string data = nlohmann::json({{"gameTime", gameTime}, {"scripts", std::move(profiles)}}).dump(4);
+	if (saveFile(filename, data.c_str(), static_cast<UDWORD>(data.size())))
+	{
+		debug(LOG_INFO, "Wrote script profiles to %s", filename);
+	}
+}
+
 bool scripting_engine::shutdownScripts()
 {
 	scriptsReady = false;
@@ -384,6 +766,10 @@ bool scripting_engine::shutdownScripts()
 	globalDialog = false;
 	models.clear();
 	triggerModel = nullptr;
+	if (scriptProfiling)
+	{
+		writeScriptProfiles();
+	}
 	for (auto *instance : scripts)
 	{
 		MONITOR *monitor = monitors.at(instance);
@@ -411,6 +797,9 @@ bool scripting_engine::shutdownScripts()
 	timers.clear();
 	lastTimerID = 0;
 	timerIDMap.clear();
+	timerQueue.clear();
+	aiInstances.clear();
+	shutdownScriptWorkers();
 	monitors.clear();
 	for (auto& script : scripts)
 	{
@@ -442,37 +831,85 @@ bool scripting_engine::updateScripts()
 	{
 		instance->updateGameTime(gameTime);
 	}
-	// Weed out dead timers
-	removeTimersIf([](const timerNode& node)
+	if (timerQueue.size() > 2 * timers.size() + 64)
 	{
-		return (node.type == TIMER_ONESHOT_DONE);
-	});
-	// Check for timers, and run them if applicable.
-	// TODO - load balancing
+		rebuildTimerQueue();
+	}
+	// Take the timers which are due off the queue, earliest first.
 	std::vector<std::shared_ptr<timerNode>> runlist; // make a new list here, since we might trample all over the timer list during execution
-	for (auto &node : timers)
+	while (!timerQueue.empty() && timerQueue.front().frameTime <= gameTime)
+	{
+		std::pop_heap(timerQueue.begin(), timerQueue.end());
+		std::shared_ptr<timerNode> node = timerQueue.back().node.lock();
+		int frameTime = timerQueue.back().frameTime;
+		timerQueue.pop_back();
+		if (node == nullptr || node->type == TIMER_REMOVED || node->frameTime != frameTime)
+		{
+			continue;  // Stale entry.
+		}
+		node->frameTime = node->ms + gameTime;	// update for next invokation
+		if (node->type == TIMER_ONESHOT_READY)
+		{
+			node->type = TIMER_ONESHOT_DONE; // unless there is none
+		}
+		node->calls++;
+		runlist.push_back(node);
+	}
+	// Requeue the repeating timers only now, since a timer with a period of 0 is due again immediately.
+	for (auto &node : runlist)
 	{
-		if (node->frameTime <= gameTime)
+		if (node->type == TIMER_REPEAT)
 		{
-			node->frameTime = node->ms + gameTime;	// update for next invokation
-			if (node->type == TIMER_ONESHOT_READY)
+			scheduleTimer(node);
+		}
+	}
+
+	// The AIs run their timers after the other scripts, each AI on its own thread if running in parallel.
+	bool parallel = scriptParallelAI && war_getJSBackend() == JS_BACKEND::quickjs;
+	std::vector<std::shared_ptr<timerNode>> aiRunlist;
+	for (auto &node : runlist)
+	{
+		if (parallel && aiInstances.count(node->instance) != 0)
+		{
+			aiRunlist.push_back(node);
+		}
+		else
+		{
+			runTimer(*node);
+		}
+	}
+	if (!aiRunlist.empty())
+	{
+		for (auto &node : aiRunlist)
+		{
+			ScriptWorker *worker = getScriptWorker(node->instance);
+			if (worker->runlist.empty())
+			{
+				scriptActiveWorkers.push_back(worker);
+			}
+			worker->runlist.push_back(node);
+		}
+		if (scriptActiveWorkers.size() > 1)
+		{
+			runScriptWorkers();
+		}
+		else
+		{
+			for (auto &node : aiRunlist)
 			{
-				node->type = TIMER_ONESHOT_DONE; // unless there is none
+				runTimer(*node);
 			}
-			node->calls++;
-			runlist.push_back(node);
+			scriptActiveWorkers[0]->runlist.clear();
+			scriptActiveWorkers.clear();
 		}
 	}
-
+	// Weed out dead timers
 	for (auto &node : runlist)
 	{
-		// IMPORTANT: A queued function can delete a timer that is in the runlist!
-		// So we must verify that the node is not one of the deleted ones.
-		if (node->type == TIMER_REMOVED)
+		if (node->type == TIMER_ONESHOT_DONE)
 		{
-			continue; // skip
+			removeTimer(node->timerID);
 		}
-		node->function(node->timerID, IdToObject(node->baseobjtype, node->baseobj, node->player), node->additionalTimerFuncParam.get());
 	}
 
 	if (globalDialog && doUpdateModels)
@@ -676,9 +1113,16 @@ wzapi::scripting_instance* scripting_engine::loadPlayerScript(const WzString& pa
 	// Clear previous log file
 	PHYSFS_delete((std::string("logs/") + pNewInstance->scriptName() + ".log").c_str());
 
+	// AIs only run on the host, so their timers can be staggered or run in parallel without the peers getting out of synch.
+	if (difficulty != AIDifficulty::DISABLED)
+	{
+		aiInstances.insert(pNewInstance);
+	}
+
 	// Attempt to ready instance for execution
 	if (!pNewInstance->readyInstanceForExecution())
 	{
+		aiInstances.erase(pNewInstance);
 		delete pNewInstance;
 		debug(LOG_ERROR, "Unable to ready instance for execution: %s", path.toUtf8().c_str());
 		return nullptr;
@@ -966,6 +1410,11 @@ void jsHandleDebugClosed()
 
 void jsShowDebug()
 {
+	if (wzIsHeadless())
+	{
+		debug(LOG_INFO, "There is no script debugger when running headless");
+		return;
+	}
 	// Add globals
 	for (auto *instance : scripts)
 	{
@@ -1447,21 +1896,24 @@ bool triggerEventSeen(BASE_OBJECT *psViewer, BASE_OBJECT *psSeen)
 bool scripting_engine::triggerEventSeen(BASE_OBJECT *psViewer, BASE_OBJECT *psSeen)
 {
 	ASSERT(scriptsReady, "Scripts not initialized yet");
-	if (!psSeen || !psViewer) { return true; }
+	if (!psSeen || !psViewer) { return false; }
+	bool handled = false;
 	for (auto *instance : scripts)
 	{
 		std::pair<bool, int> callbacks = scripting_engine::instance().seenLabelCheck(instance, psSeen, psViewer);
 		if (callbacks.first)
 		{
 			instance->handle_eventObjectSeen(psViewer, psSeen);
+			handled = true;
 		}
 		if (callbacks.second)
 		{
 			int groupId = callbacks.second;
 			instance->handle_eventGroupSeen(psViewer, groupId);
+			handled = true;
 		}
 	}
-	return true;
+	return handled;
 }
 
 //__ ## eventObjectTransfer(object, from)
@@ -1889,6 +2341,122 @@ void scripting_engine::showLabel(const std::string &key, bool clear_old, bool ju
 	}
 }
 
+/// Size of the buckets of the area label index, as a shift of world coordinates. 8 tiles.
+#define LABEL_BUCKET_SHIFT (TILE_SHIFT + 3)
+
+void scripting_engine::labelsChanged()
+{
+	labelIndex.dirty = true;
+}
+
+void scripting_engine::rebuildLabelIndex()
+{
+	labelIndex.dirty = false;
+	labelIndex.bucketsWidth = std::max((mapWidth * TILE_UNITS + (1 << LABEL_BUCKET_SHIFT) - 1) >> LABEL_BUCKET_SHIFT, 1);
+	labelIndex.bucketsHeight = std::max((mapHeight * TILE_UNITS + (1 << LABEL_BUCKET_SHIFT) - 1) >> LABEL_BUCKET_SHIFT, 1);
+	labelIndex.areaBuckets.assign(labelIndex.bucketsWidth * labelIndex.bucketsHeight, std::vector<LABELMAP::value_type *>());
+	labelIndex.objectLabels.clear();
+	labelIndex.groupLabels.clear();
+
+	for (auto &it : labels)
+	{
+		labelIndexInsert(it);
+	}
+}
+
+/// Gets the buckets of the area index which an area or radius label overlaps. Returns false for other labels.
+bool scripting_engine::labelBuckets(LABEL const &l, int &x1, int &y1, int &x2, int &y2) const
+{
+	Vector2i lo, hi;
+	if (l.type == SCRIPT_AREA)
+	{
+		lo = l.p1;
+		hi = l.p2;
+	}
+	else if (l.type == SCRIPT_RADIUS)
+	{
+		lo = l.p1 - Vector2i(l.p2.x, l.p2.x);
+		hi = l.p1 + Vector2i(l.p2.x, l.p2.x);
+	}
+	else
+	{
+		return false;
+	}
+	x1 = clip(lo.x >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsWidth - 1);
+	y1 = clip(lo.y >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsHeight - 1);
+	x2 = clip(hi.x >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsWidth - 1);
+	y2 = clip(hi.y >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsHeight - 1);
+	return true;
+}
+
+/// Adds a label to the index, if it is untriggered. The label must not be in the index already.
+void scripting_engine::labelIndexInsert(LABELMAP::value_type &it)
+{
+	LABEL &l = it.second;
+	if (labelIndex.dirty || l.triggered != 0)
+	{
+		return;  // Either rebuildLabelIndex will add it, or it can't trigger until resetLabel adds it.
+	}
+	if (l.type == SCRIPT_GROUP)
+	{
+		labelIndex.groupLabels[l.id].push_back(&l);
+		return;
+	}
+	labelIndex.objectLabels[l.id].push_back(&l);
+
+	int x1, y1, x2, y2;
+	if (!labelBuckets(l, x1, y1, x2, y2))
+	{
+		return;
+	}
+	for (int y = y1; y <= y2; ++y)
+	{
+		for (int x = x1; x <= x2; ++x)
+		{
+			// Keep the buckets in label order, so the area events fire in the same order as after a rebuild.
+			std::vector<LABELMAP::value_type *> &bucket = labelIndex.areaBuckets[x + y * labelIndex.bucketsWidth];
+			auto pos = std::lower_bound(bucket.begin(), bucket.end(), &it, [](LABELMAP::value_type const *a, LABELMAP::value_type const *b) {
+				return a->first < b->first;
+			});
+			bucket.insert(pos, &it);
+		}
+	}
+}
+
+/// Removes a label from the index, if it is there. Call before changing the label's type, id or position.
+void scripting_engine::labelIndexErase(LABELMAP::value_type &it)
+{
+	LABEL &l = it.second;
+	if (labelIndex.dirty)
+	{
+		return;
+	}
+	auto &byId = l.type == SCRIPT_GROUP ? labelIndex.groupLabels : labelIndex.objectLabels;
+	auto found = byId.find(l.id);
+	if (found != byId.end())
+	{
+		found->second.erase(std::remove(found->second.begin(), found->second.end(), &l), found->second.end());
+		if (found->second.empty())
+		{
+			byId.erase(found);
+		}
+	}
+
+	int x1, y1, x2, y2;
+	if (!labelBuckets(l, x1, y1, x2, y2))
+	{
+		return;
+	}
+	for (int y = y1; y <= y2; ++y)
+	{
+		for (int x = x1; x <= x2; ++x)
+		{
+			std::vector<LABELMAP::value_type *> &bucket = labelIndex.areaBuckets[x + y * labelIndex.bucketsWidth];
+			bucket.erase(std::remove(bucket.begin(), bucket.end(), &it), bucket.end());
+		}
+	}
+}
+
 // The bool return value is true when an object callback needs to be called.
 // The int return value holds group id when a group callback needs to be called, 0 otherwise.
 std::pair<bool, int> scripting_engine::seenLabelCheck(wzapi::scripting_instance *instance, const BASE_OBJECT *seen, const BASE_OBJECT *viewer)
@@ -1897,28 +2465,31 @@ std::pair<bool, int> scripting_engine::seenLabelCheck(wzapi::scripting_instance
 	ASSERT_OR_RETURN(std::make_pair(false, 0), psMap != nullptr, "Non-existent groupmap for engine");
 	auto seenObjIt = psMap->map().find(seen);
 	int groupId = (seenObjIt != psMap->map().end()) ? seenObjIt->second : 0;
-	bool foundObj = false, foundGroup = false;
-	for (auto &it : labels)
+	if (labelIndex.dirty)
 	{
-		LABEL &l = it.second;
-		if (l.triggered != 0 || !(l.subscriber == ALL_PLAYERS || l.subscriber == viewer->player))
-		{
-			continue;
-		}
+		rebuildLabelIndex();
+	}
 
-		// Don't let a seen game object ID which matches a group label ID to prematurely
-		// trigger a group label.
-		if (l.type != SCRIPT_GROUP && l.id == seen->id)
+	// Don't let a seen game object ID which matches a group label ID to prematurely
+	// trigger a group label, so look them up separately.
+	auto trigger = [viewer](std::unordered_map<int, std::vector<LABEL *>> const &index, int id) {
+		bool found = false;
+		auto it = index.find(id);
+		if (it != index.end())
 		{
-			l.triggered = viewer->id; // record who made the discovery
-			foundObj = true;
-		}
-		else if (l.type == SCRIPT_GROUP && l.id == groupId)
-		{
-			l.triggered = viewer->id; // record who made the discovery
-			foundGroup = true;
+			for (LABEL *l : it->second)
+			{
+				if (l->triggered == 0 && (l->subscriber == ALL_PLAYERS || l->subscriber == viewer->player))
+				{
+					l->triggered = viewer->id; // record who made the discovery
+					found = true;
+				}
+			}
 		}
-	}
+		return found;
+	};
+	bool foundObj = trigger(labelIndex.objectLabels, seen->id);
+	bool foundGroup = trigger(labelIndex.groupLabels, groupId);
 	if (foundObj || foundGroup)
 	{
 		updateLabelModel();
@@ -1930,8 +2501,16 @@ bool scripting_engine::areaLabelCheck(DROID *psDroid)
 {
 	int x = psDroid->pos.x;
 	int y = psDroid->pos.y;
-	bool activated = false;
-	for (LABELMAP::iterator i = labels.begin(); i != labels.end(); i++)
+	if (labelIndex.dirty)
+	{
+		rebuildLabelIndex();
+	}
+
+	// Only the labels overlapping the bucket the droid is in need checking.
+	int bucketX = clip(x >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsWidth - 1);
+	int bucketY = clip(y >> LABEL_BUCKET_SHIFT, 0, labelIndex.bucketsHeight - 1);
+	std::vector<std::string> activatedLabels;
+	for (LABELMAP::value_type *i : labelIndex.areaBuckets[bucketX + bucketY * labelIndex.bucketsWidth])
 	{
 		LABEL &l = i->second;
 		if (l.triggered == 0 && (l.subscriber == ALL_PLAYERS || l.subscriber == psDroid->player)
@@ -1939,11 +2518,16 @@ bool scripting_engine::areaLabelCheck(DROID *psDroid)
 		        || (l.type == SCRIPT_RADIUS && iHypot(l.p1 - psDroid->pos.xy()) < l.p2.x)))
 		{
 			// We're inside an untriggered area
-			activated = true;
 			l.triggered = psDroid->id;
-			triggerEventArea(i->first, psDroid);
+			activatedLabels.push_back(i->first);
 		}
 	}
+	// Trigger the events after the loop, since they may change the labels, and so the index.
+	for (std::string const &label : activatedLabels)
+	{
+		triggerEventArea(label, psDroid);
+	}
+	bool activated = !activatedLabels.empty();
 	if (activated)
 	{
 		updateLabelModel();
@@ -2036,6 +2620,7 @@ bool scripting_engine::loadLabels(const char *filename)
 	}
 	WzConfig ini(filename, WzConfig::ReadOnly);
 	labels.clear();
+	labelsChanged();
 	std::vector<WzString> list = ini.childGroups();
 	debug(LOG_SAVE, "Loading %zu labels...", list.size());
 	for (int i = 0; i < list.size(); ++i)
@@ -2225,14 +2810,17 @@ bool scripting_engine::writeLabels(const char *filename)
 //--
 wzapi::no_return_value scripting_engine::resetLabel(WZAPI_PARAMS(std::string labelName, optional<int> filter))
 {
-	LABELMAP& labels = scripting_engine::instance().labels;
-	SCRIPT_ASSERT({}, context, labels.count(labelName) > 0, "Label %s not found", labelName.c_str());
-	LABEL &l = labels[labelName];
+	scripting_engine &engine = scripting_engine::instance();
+	auto it = engine.labels.find(labelName);
+	SCRIPT_ASSERT({}, context, it != engine.labels.end(), "Label %s not found", labelName.c_str());
+	LABEL &l = it->second;
+	engine.labelIndexErase(*it);  // In case it is untriggered already.
 	l.triggered = 0; // make active again
 	if (filter.has_value())
 	{
 		l.subscriber = filter.value();
 	}
+	engine.labelIndexInsert(*it);
 	return {};
 }
 
@@ -2409,8 +2997,19 @@ wzapi::no_return_value scripting_engine::addLabel(WZAPI_PARAMS(generic_script_ob
 		value.triggered = _triggered.value();
 	}
 
-	labels[label] = value;
-	scripting_engine::instance().updateLabelModel();
+	scripting_engine &engine = scripting_engine::instance();
+	auto it = labels.find(label);
+	if (it != labels.end())
+	{
+		engine.labelIndexErase(*it);
+		it->second = value;
+	}
+	else
+	{
+		it = labels.emplace(label, value).first;
+	}
+	engine.labelIndexInsert(*it);
+	engine.updateLabelModel();
 	return {};
 }
 
@@ -2421,10 +3020,16 @@ wzapi::no_return_value scripting_engine::addLabel(WZAPI_PARAMS(generic_script_ob
 //--
 int scripting_engine::removeLabel(WZAPI_PARAMS(std::string label))
 {
-	LABELMAP& labels = scripting_engine::instance().labels;
-	int result = labels.erase(label);
-	scripting_engine::instance().updateLabelModel();
-	return result;
+	scripting_engine &engine = scripting_engine::instance();
+	auto it = engine.labels.find(label);
+	if (it == engine.labels.end())
+	{
+		return 0;
+	}
+	engine.labelIndexErase(*it);
+	engine.labels.erase(it);
+	engine.updateLabelModel();
+	return 1;
 }
 
 //-- ## getLabel(object)
@@ -2733,6 +3338,7 @@ bool scripting_engine::unregisterFunctions(wzapi::scripting_instance *instance)
 	}
 	ASSERT(num == 1, "Number of engines removed from group map is %d!", num);
 	labels.clear();
+	labelsChanged();
 	labelModel = nullptr;
 	return true;
 }
@@ -25,7 +25,11 @@
 #include "random.h"
 #include "wzapi.h"
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
 
 class QString;
 class QStandardItemModel;
@@ -101,6 +105,44 @@ bool prepareScripts(bool loadGame);
 /// Run this each logical frame to update frame-dependent script states
 bool updateScripts();
 
+/// If set, the first call of each repeating timer of an AI script is delayed by a number of game ticks depending on the
+/// player, so that timers with the same period set by different AIs don't all run on the same tick. Only AIs are
+/// staggered, since they run on the host only, while the other scripts must run their timers identically on every peer.
+void scriptSetTimerStagger(bool stagger);
+bool scriptGetTimerStagger();
+
+/// If set, the timers of AI scripts which are due on the same tick run in parallel, each AI on a worker thread of its own,
+/// while the game waits. The calls from the scripts into the game are still made one at a time, and on the main thread, see
+/// scriptCallIntoGame(). Only AIs run in parallel, since they run on the host only, and only with the QuickJS backend.
+void scriptSetParallelAI(bool parallel);
+bool scriptGetParallelAI();
+
+/// If set, the QuickJS script instances created from then on record the time taken, the number of calls and the JS heap
+/// allocated by each of their functions and each kind of call into the game. The profiles are written to logs/ as JSON
+/// when the scripts are shut down at the end of the game.
+void scriptSetProfiling(bool profiling);
+bool scriptGetProfiling();
+
+/// Used by the script backends for each call from a script into the game. Just makes the call, unless called from an AI
+/// running in parallel, in which case it waits for the turn of the AI, then has the main thread make the call while the AI
+/// waits, since the game, and the console, audio and widgets it updates, may only be used from the main thread. The AIs take
+/// turns in order of the number of calls each made so far, then by player, so the game sees the calls in the same order no
+/// matter how long the scripts take to run in between.
+void scriptCallIntoGame(std::function<void ()> const &call);
+
+template<typename Call>
+auto scriptCallIntoGame(Call &&call) -> typename std::enable_if<!std::is_void<decltype(call())>::value, decltype(call())>::type
+{
+	decltype(call()) result;
+	scriptCallIntoGame(std::function<void ()>([&call, &result] { result = call(); }));
+	return result;
+}
+
+/// Call from the script backends before running script code of the given instance. If called during a call into the game
+/// made for an AI running in parallel, while the instance is also running in parallel, waits until the instance is stopped
+/// waiting for its turn to call into the game, or has finished.
+void scriptWaitForInstance(wzapi::scripting_instance *instance);
+
 // Load and evaluate the given script, kept in memory
 bool loadGlobalScript(WzString path);
 wzapi::scripting_instance* loadPlayerScript(const WzString& path, int player, AIDifficulty difficulty);
@@ -137,6 +179,7 @@ bool triggerEventStructDemolish(STRUCTURE *psStruct, DROID *psDroid);
 bool triggerEventDroidIdle(DROID *psDroid);
 bool triggerEventDestroyed(BASE_OBJECT *psVictim);
 bool triggerEventStructureReady(STRUCTURE *psStruct);
+/// Returns true if any script event handler was run, which may have changed the game state.
 bool triggerEventSeen(BASE_OBJECT *psViewer, BASE_OBJECT *psSeen);
 bool triggerEventObjectTransfer(BASE_OBJECT *psObj, int from);
 bool triggerEventChat(int from, int to, const char *message);
@@ -317,15 +360,49 @@ private:
 	typedef std::map<std::string, LABEL> LABELMAP;
 	LABELMAP labels;
 
+	/// Untriggered labels, indexed for the label checks done on every droid move and every sighting. Labels which get
+	/// triggered stay in the index until they are reset or removed. Pointers into labels, so single labels are updated
+	/// with labelIndexInsert() and labelIndexErase(), and the whole index is rebuilt after labelsChanged().
+	struct LABEL_INDEX
+	{
+		bool dirty = true;
+		int bucketsWidth = 0;
+		int bucketsHeight = 0;
+		std::vector<std::vector<LABELMAP::value_type *>> areaBuckets;  ///< SCRIPT_AREA and SCRIPT_RADIUS labels overlapping each bucket of tiles, in label order.
+		std::unordered_map<int, std::vector<LABEL *>> objectLabels;   ///< All labels except SCRIPT_GROUP, by id.
+		std::unordered_map<int, std::vector<LABEL *>> groupLabels;    ///< SCRIPT_GROUP labels, by group id.
+	};
+	LABEL_INDEX labelIndex;
+
 	typedef std::map<wzapi::scripting_instance *, GROUPMAP *> ENGINEMAP;
 	ENGINEMAP groups;
 
-	/// List of timer events for scripts. Before running them, we sort the list then run as many as we have time for.
-	/// In this way, we implement load balancing of events and keep frame rates tidy for users. Since scripts run on the
-	/// host, we do not need to worry about each peer simulating the world differently.
+	/// List of timer events for scripts, in the order they were added. The timers due are found using timerQueue.
 	std::list<std::shared_ptr<timerNode>> timers;
 	uniqueTimerID lastTimerID = 0;
 	std::unordered_map<uniqueTimerID, std::list<std::shared_ptr<timerNode>>::iterator> timerIDMap; // a map from uniqueTimerID -> entry in the timers list
+
+	/// Entry of timerQueue. It is stale if the timer has since been removed or rescheduled, and then just gets skipped.
+	struct timerQueueEntry
+	{
+		bool operator <(timerQueueEntry const &z) const
+		{
+			// Inverted, so that the heap has the earliest timer at the front. Equal times run in timer id order.
+			if (frameTime != z.frameTime)
+			{
+				return frameTime > z.frameTime;
+			}
+			return timerID > z.timerID;
+		}
+
+		int frameTime;
+		uniqueTimerID timerID;
+		std::weak_ptr<timerNode> node;
+	};
+	/// Heap of the timers by the game time they are next due, so that a tick only has to look at the timers it runs.
+	std::vector<timerQueueEntry> timerQueue;
+	/// AI script instances, whose repeating timers may be staggered and run in parallel, see scriptSetTimerStagger() and scriptSetParallelAI().
+	std::unordered_set<wzapi::scripting_instance *> aiInstances;
 private:
 	scripting_engine() { }
 public:
@@ -388,6 +465,8 @@ public:
 	}
 	
 	bool removeTimer(uniqueTimerID timerID);
+	/// Runs a timer taken off timerQueue, unless it has been removed since.
+	void runTimer(timerNode &node);
 public:
 	// Monitoring performance of function calls
 	template<typename Func>
@@ -405,6 +484,8 @@ private:
 	uniqueTimerID getNextAvailableTimerID();
 	// internal-only function that adds a Timer node (used for restoring saved games)
 	void addTimerNode(std::shared_ptr<timerNode>&& node);
+	void scheduleTimer(const std::shared_ptr<timerNode>& node);
+	void rebuildTimerQueue();
 
 // MARK: triggering events (from wz game code)
 public:
@@ -488,6 +569,11 @@ protected:
 	void groupRemoveObject(const BASE_OBJECT *psObj);
 
 private:
+	void labelsChanged();
+	void rebuildLabelIndex();
+	bool labelBuckets(LABEL const &l, int &x1, int &y1, int &x2, int &y2) const;
+	void labelIndexInsert(LABELMAP::value_type &it);
+	void labelIndexErase(LABELMAP::value_type &it);
 	std::pair<bool, int> seenLabelCheck(wzapi::scripting_instance *instance, const BASE_OBJECT *seen, const BASE_OBJECT *viewer);
 	void removeFromGroup(wzapi::scripting_instance *instance, GROUPMAP *psMap, const BASE_OBJECT *psObj);
 	bool groupAddObject(const BASE_OBJECT *psObj, int groupId, wzapi::scripting_instance *instance);
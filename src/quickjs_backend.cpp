@@ -88,6 +88,8 @@
 #include <unordered_set>
 #include "lib/framework/file.h"
 #include <unordered_map>
+#include <array>
+#include <initializer_list>
 
 #if !defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8
 #pragma GCC diagnostic push
@@ -142,18 +144,33 @@ void to_json(nlohmann::json& j, const JSContextValue& value); // forward-declare
 
 bool QuickJS_EnumerateObjectProperties(JSContext *ctx, JSValue obj, const std::function<void (const char *key, JSAtom& atom)>& func, bool enumerableOnly = true); // forward-declare
 
+static void QuickJS_RegisterGameObjectClass(JSContext *ctx); // forward-declare
+static void QuickJS_UnregisterGameObjectClass(JSContext *ctx); // forward-declare
+
 class quickjs_scripting_instance;
 static std::map<JSContext*, quickjs_scripting_instance *> engineToInstanceMap;
 
+/// Time, calls and JS heap allocations of a script function or of a call into the game, see scriptSetProfiling().
+struct QuickJSProfileEntry
+{
+	uint64_t calls = 0;
+	uint64_t microseconds = 0;
+	uint64_t worstMicroseconds = 0;
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+};
+
 class quickjs_scripting_instance : public wzapi::scripting_instance
 {
 public:
 	quickjs_scripting_instance(int player, const std::string& scriptName)
 	: scripting_instance(player, scriptName)
 	{
-		rt = JS_NewRuntime();
+		profiling = scriptGetProfiling();
+		rt = profiling ? JS_NewCountingRuntime(&allocationCounts) : JS_NewRuntime();
 		ctx = JS_NewContext(rt);
 		global_obj = JS_GetGlobalObject(ctx);
+		QuickJS_RegisterGameObjectClass(ctx);
 
 		engineToInstanceMap.insert(std::pair<JSContext*, quickjs_scripting_instance*>(ctx, this));
 	}
@@ -162,6 +179,7 @@ public:
 		engineToInstanceMap.erase(ctx);
 
 		JS_FreeValue(ctx, global_obj);
+		QuickJS_UnregisterGameObjectClass(ctx);
 		JS_FreeContext(ctx);
 		ctx = nullptr;
 		JS_FreeRuntime(rt);
@@ -189,6 +207,8 @@ public:
 
 	bool debugEvaluateCommand(const std::string &text) override;
 
+	nlohmann::json debugGetProfile() override;
+
 public:
 
 	void updateGameTime(uint32_t gameTime) override;
@@ -230,6 +250,12 @@ public: // temporary
 	std::vector<std::string> eventNamespaces;
 	JSValue Get_Global_Obj() const { return global_obj; }
 
+	/// Only recorded if profiling, see QuickJSProfileScope.
+	bool profiling = false;
+	JSAllocationCounts allocationCounts = {0, 0};
+	std::map<std::string, QuickJSProfileEntry> functionProfile;  ///< By script function.
+	std::map<std::string, QuickJSProfileEntry> apiProfile;       ///< By call into the game.
+
 public:
 	// MARK: General events
 
@@ -743,6 +769,437 @@ JSValue convResearch(const RESEARCH *psResearch, JSContext *ctx, int player)
 	return value;
 }
 
+// Droids, structures and features are converted to objects of the game object class. Converting one only records the
+// values of its properties, and the JS values of the properties are only created when read. The properties behave
+// exactly like the read-only, non-enumerable own properties of the plain objects that game objects used to be
+// converted to, so they still show up in Object.getOwnPropertyNames() and get saved with the script globals.
+
+enum GameObjectProperty
+{
+	GOP_ID, GOP_X, GOP_Y, GOP_Z, GOP_PLAYER, GOP_ARMOUR, GOP_THERMAL, GOP_TYPE, GOP_SELECTED, GOP_NAME, GOP_BORN, GOP_GROUP,
+	GOP_ACTION, GOP_RANGE, GOP_ORDER, GOP_COST, GOP_HAS_INDIRECT, GOP_BODY_SIZE, GOP_CARGO_CAPACITY, GOP_CARGO_LEFT, GOP_CARGO_COUNT,
+	GOP_IS_RADAR_DETECTOR, GOP_IS_CB, GOP_IS_SENSOR, GOP_CAN_HIT_AIR, GOP_CAN_HIT_GROUND, GOP_IS_VTOL, GOP_DROID_TYPE,
+	GOP_EXPERIENCE, GOP_HEALTH, GOP_BODY, GOP_PROPULSION, GOP_ARMED, GOP_WEAPONS, GOP_CARGO_SIZE,
+	GOP_STATUS, GOP_STATTYPE, GOP_MODULES, GOP_DAMAGEABLE,
+	GOP_COUNT
+};
+
+static const char *const gameObjectPropertyNames[GOP_COUNT] =
+{
+	"id", "x", "y", "z", "player", "armour", "thermal", "type", "selected", "name", "born", "group",
+	"action", "range", "order", "cost", "hasIndirect", "bodySize", "cargoCapacity", "cargoLeft", "cargoCount",
+	"isRadarDetector", "isCB", "isSensor", "canHitAir", "canHitGround", "isVTOL", "droidType",
+	"experience", "health", "body", "propulsion", "armed", "weapons", "cargoSize",
+	"status", "stattype", "modules", "damageable",
+};
+
+/// The properties of a kind of game object, in the order they are listed by Object.getOwnPropertyNames().
+struct GameObjectPropertyList
+{
+	GameObjectPropertyList(std::initializer_list<GameObjectProperty> properties_) : properties(properties_)
+	{
+		for (GameObjectProperty property : properties)
+		{
+			mask |= uint64_t(1) << property;
+		}
+	}
+
+	std::vector<GameObjectProperty> properties;
+	uint64_t mask = 0;
+};
+
+#define GOP_BASE_OBJECT GOP_ID, GOP_X, GOP_Y, GOP_Z, GOP_PLAYER, GOP_ARMOUR, GOP_THERMAL, GOP_TYPE, GOP_SELECTED, GOP_NAME, GOP_BORN, GOP_GROUP
+
+static const GameObjectPropertyList baseObjectProperties = {GOP_BASE_OBJECT};
+static const GameObjectPropertyList structureProperties = {GOP_BASE_OBJECT, GOP_IS_CB, GOP_IS_SENSOR, GOP_CAN_HIT_AIR, GOP_CAN_HIT_GROUND,
+	GOP_HAS_INDIRECT, GOP_IS_RADAR_DETECTOR, GOP_RANGE, GOP_STATUS, GOP_HEALTH, GOP_COST, GOP_STATTYPE, GOP_MODULES, GOP_WEAPONS};
+static const GameObjectPropertyList featureProperties = {GOP_BASE_OBJECT, GOP_HEALTH, GOP_DAMAGEABLE, GOP_STATTYPE};
+static const GameObjectPropertyList droidProperties = {GOP_BASE_OBJECT, GOP_ACTION, GOP_RANGE, GOP_ORDER, GOP_COST, GOP_HAS_INDIRECT,
+	GOP_BODY_SIZE, GOP_IS_RADAR_DETECTOR, GOP_IS_CB, GOP_IS_SENSOR, GOP_CAN_HIT_AIR, GOP_CAN_HIT_GROUND, GOP_IS_VTOL, GOP_DROID_TYPE,
+	GOP_EXPERIENCE, GOP_HEALTH, GOP_BODY, GOP_PROPULSION, GOP_ARMED, GOP_WEAPONS, GOP_CARGO_SIZE};
+static const GameObjectPropertyList transporterProperties = {GOP_BASE_OBJECT, GOP_ACTION, GOP_RANGE, GOP_ORDER, GOP_COST, GOP_HAS_INDIRECT,
+	GOP_BODY_SIZE, GOP_CARGO_CAPACITY, GOP_CARGO_LEFT, GOP_CARGO_COUNT, GOP_IS_RADAR_DETECTOR, GOP_IS_CB, GOP_IS_SENSOR, GOP_CAN_HIT_AIR,
+	GOP_CAN_HIT_GROUND, GOP_IS_VTOL, GOP_DROID_TYPE, GOP_EXPERIENCE, GOP_HEALTH, GOP_BODY, GOP_PROPULSION, GOP_ARMED, GOP_WEAPONS, GOP_CARGO_SIZE};
+
+/// The values of the properties of a game object at the time it was converted.
+struct GameObjectSnapshot
+{
+	struct Weapon
+	{
+		uint32_t nStat;
+		uint32_t lastFired;
+		int armed;
+	};
+
+	GameObjectSnapshot(const GameObjectPropertyList &properties_) : properties(properties_) {}
+
+	const GameObjectPropertyList &properties;
+
+	OBJECT_TYPE type = OBJ_NUM_TYPES;
+	uint32_t id = 0;
+	Vector3i pos;
+	uint32_t player = 0;
+	int armour = 0;
+	int thermal = 0;
+	uint32_t selected = 0;
+	std::string name;
+	uint32_t born = 0;
+	bool hasGroup = false;
+	int group = 0;
+
+	int range = -1;
+	uint32_t cost = 0;
+	bool hasIndirect = false;
+	bool isRadarDetector = false;
+	bool isCB = false;
+	bool isSensor = false;
+	bool canHitAir = false;
+	bool canHitGround = false;
+	double health = 0.0;
+	int stattype = 0;
+	int numWeaps = 0;
+	std::array<Weapon, MAX_WEAPONS> weapons;
+	JSValue weaponList = JS_UNINITIALIZED;  ///< Created when first read, and then kept, so that it is the same array each time.
+
+	int action = 0;
+	int order = 0;
+	int bodySize = 0;
+	int cargoLeft = 0;
+	uint32_t cargoCount = 0;
+	bool isVTOL = false;
+	int droidType = 0;
+	double experience = 0.0;
+	uint32_t bodyStat = 0;
+	uint32_t propulsionStat = 0;
+	int cargoSize = 0;
+
+	int status = 0;
+	bool hasModules = false;
+	uint32_t modules = 0;
+
+	bool damageable = false;
+};
+
+/// Data of the game object class, for each runtime, since atoms belong to a runtime.
+struct QuickJSGameObjectClass
+{
+	std::array<JSAtom, GOP_COUNT> propertyAtoms;
+	std::unordered_map<JSAtom, GameObjectProperty> propertyByAtom;
+	JSAtom fullnameAtom = JS_ATOM_NULL;
+	JSAtom lastFiredAtom = JS_ATOM_NULL;
+	/// Interned ids and names of stats, indexed by stat, created when first used.
+	std::vector<JSAtom> weaponIds;
+	std::vector<JSAtom> weaponNames;
+	std::vector<JSAtom> bodyIds;
+	std::vector<JSAtom> propulsionIds;
+};
+
+static JSClassID gameObjectClassId = 0;
+
+static QuickJSGameObjectClass &gameObjectClass(JSContext *ctx)
+{
+	return *static_cast<QuickJSGameObjectClass *>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+}
+
+static JSValue statString(JSContext *ctx, std::vector<JSAtom> &atoms, size_t index, const WzString &str)
+{
+	if (index >= atoms.size())
+	{
+		atoms.resize(index + 1, JS_ATOM_NULL);
+	}
+	if (atoms[index] == JS_ATOM_NULL)
+	{
+		atoms[index] = JS_NewAtom(ctx, str.toUtf8().c_str());
+	}
+	return JS_AtomToString(ctx, atoms[index]);
+}
+
+static JSValue gameObjectWeaponList(JSContext *ctx, const GameObjectSnapshot &snapshot)
+{
+	QuickJSGameObjectClass &cls = gameObjectClass(ctx);
+	JSValue weaponlist = JS_NewArray(ctx);
+	for (int j = 0; j < snapshot.numWeaps; j++)
+	{
+		JSValue weapon = JS_NewObject(ctx);
+		uint32_t nStat = snapshot.weapons[j].nStat;
+		const WEAPON_STATS *psStats = asWeaponStats + nStat;
+		JS_DefinePropertyValue(ctx, weapon, cls.fullnameAtom, statString(ctx, cls.weaponNames, nStat, psStats->name), 0);
+		JS_DefinePropertyValue(ctx, weapon, cls.propertyAtoms[GOP_NAME], statString(ctx, cls.weaponIds, nStat, psStats->id), 0); // will be changed to contain full name
+		JS_DefinePropertyValue(ctx, weapon, cls.propertyAtoms[GOP_ID], statString(ctx, cls.weaponIds, nStat, psStats->id), 0);
+		JS_DefinePropertyValue(ctx, weapon, cls.lastFiredAtom, JS_NewUint32(ctx, snapshot.weapons[j].lastFired), 0);
+		if (snapshot.type == OBJ_DROID)
+		{
+			JS_DefinePropertyValue(ctx, weapon, cls.propertyAtoms[GOP_ARMED], JS_NewInt32(ctx, snapshot.weapons[j].armed), 0);
+		}
+		JS_DefinePropertyValueUint32(ctx, weaponlist, j, weapon, 0);
+	}
+	return weaponlist;
+}
+
+static JSValue gameObjectPropertyValue(JSContext *ctx, GameObjectSnapshot &snapshot, GameObjectProperty property)
+{
+	bool isDroid = snapshot.type == OBJ_DROID;
+	switch (property)
+	{
+	case GOP_ID: return JS_NewUint32(ctx, snapshot.id);
+	case GOP_X: return JS_NewInt32(ctx, map_coord(snapshot.pos.x));
+	case GOP_Y: return JS_NewInt32(ctx, map_coord(snapshot.pos.y));
+	case GOP_Z: return JS_NewInt32(ctx, map_coord(snapshot.pos.z));
+	case GOP_PLAYER: return JS_NewUint32(ctx, snapshot.player);
+	case GOP_ARMOUR: return JS_NewInt32(ctx, snapshot.armour);
+	case GOP_THERMAL: return JS_NewInt32(ctx, snapshot.thermal);
+	case GOP_TYPE: return JS_NewInt32(ctx, snapshot.type);
+	case GOP_SELECTED: return JS_NewUint32(ctx, snapshot.selected);
+	case GOP_NAME: return JS_NewString(ctx, snapshot.name.c_str());
+	case GOP_BORN: return JS_NewUint32(ctx, snapshot.born);
+	case GOP_GROUP: return snapshot.hasGroup ? JS_NewInt32(ctx, snapshot.group) : JS_NULL;
+	case GOP_ACTION: return JS_NewInt32(ctx, snapshot.action);
+	case GOP_RANGE: return isDroid && snapshot.range < 0 ? JS_NULL : JS_NewInt32(ctx, snapshot.range);
+	case GOP_ORDER: return JS_NewInt32(ctx, snapshot.order);
+	case GOP_COST: return isDroid ? JS_NewUint32(ctx, snapshot.cost) : JS_NewInt32(ctx, snapshot.cost);
+	case GOP_HAS_INDIRECT: return JS_NewBool(ctx, snapshot.hasIndirect);
+	case GOP_BODY_SIZE: return JS_NewInt32(ctx, snapshot.bodySize);
+	case GOP_CARGO_CAPACITY: return JS_NewInt32(ctx, TRANSPORTER_CAPACITY);
+	case GOP_CARGO_LEFT: return JS_NewInt32(ctx, snapshot.cargoLeft);
+	case GOP_CARGO_COUNT: return JS_NewUint32(ctx, snapshot.cargoCount);
+	case GOP_IS_RADAR_DETECTOR: return JS_NewBool(ctx, snapshot.isRadarDetector);
+	case GOP_IS_CB: return JS_NewBool(ctx, snapshot.isCB);
+	case GOP_IS_SENSOR: return JS_NewBool(ctx, snapshot.isSensor);
+	case GOP_CAN_HIT_AIR: return JS_NewBool(ctx, snapshot.canHitAir);
+	case GOP_CAN_HIT_GROUND: return JS_NewBool(ctx, snapshot.canHitGround);
+	case GOP_IS_VTOL: return JS_NewBool(ctx, snapshot.isVTOL);
+	case GOP_DROID_TYPE: return JS_NewInt32(ctx, snapshot.droidType);
+	case GOP_EXPERIENCE: return JS_NewFloat64(ctx, snapshot.experience);
+	case GOP_HEALTH:
+		switch (snapshot.type)
+		{
+		case OBJ_DROID: return JS_NewFloat64(ctx, snapshot.health);
+		case OBJ_STRUCTURE: return JS_NewInt32(ctx, (int)snapshot.health);
+		default: return JS_NewUint32(ctx, (uint32_t)snapshot.health);
+		}
+	case GOP_BODY: return statString(ctx, gameObjectClass(ctx).bodyIds, snapshot.bodyStat, asBodyStats[snapshot.bodyStat].id);
+	case GOP_PROPULSION: return statString(ctx, gameObjectClass(ctx).propulsionIds, snapshot.propulsionStat, asPropulsionStats[snapshot.propulsionStat].id);
+	case GOP_ARMED: return JS_NewFloat64(ctx, 0.0); // deprecated!
+	case GOP_WEAPONS:
+		if (JS_VALUE_GET_TAG(snapshot.weaponList) == JS_TAG_UNINITIALIZED)
+		{
+			snapshot.weaponList = gameObjectWeaponList(ctx, snapshot);
+		}
+		return JS_DupValue(ctx, snapshot.weaponList);
+	case GOP_CARGO_SIZE: return JS_NewInt32(ctx, snapshot.cargoSize);
+	case GOP_STATUS: return JS_NewInt32(ctx, snapshot.status);
+	case GOP_STATTYPE: return JS_NewInt32(ctx, snapshot.stattype);
+	case GOP_MODULES: return snapshot.hasModules ? JS_NewUint32(ctx, snapshot.modules) : JS_NULL;
+	case GOP_DAMAGEABLE: return JS_NewBool(ctx, snapshot.damageable);
+	case GOP_COUNT: break;
+	}
+	return JS_UNDEFINED;
+}
+
+/// Returns the snapshot of obj, if prop is one of its properties.
+static GameObjectSnapshot *gameObjectLookup(JSContext *ctx, JSValueConst obj, JSAtom prop, GameObjectProperty &property)
+{
+	QuickJSGameObjectClass &cls = gameObjectClass(ctx);
+	auto it = cls.propertyByAtom.find(prop);
+	if (it == cls.propertyByAtom.end())
+	{
+		return nullptr;
+	}
+	GameObjectSnapshot *snapshot = static_cast<GameObjectSnapshot *>(JS_GetOpaque(obj, gameObjectClassId));
+	if (snapshot == nullptr || (snapshot->properties.mask & uint64_t(1) << it->second) == 0)
+	{
+		return nullptr;
+	}
+	property = it->second;
+	return snapshot;
+}
+
+static int gameObjectGetOwnProperty(JSContext *ctx, JSPropertyDescriptor *desc, JSValueConst obj, JSAtom prop)
+{
+	GameObjectProperty property;
+	GameObjectSnapshot *snapshot = gameObjectLookup(ctx, obj, prop, property);
+	if (snapshot == nullptr)
+	{
+		return false;
+	}
+	if (desc != nullptr)
+	{
+		desc->flags = 0;  // Read-only, non-enumerable and non-configurable.
+		desc->value = gameObjectPropertyValue(ctx, *snapshot, property);
+		desc->getter = JS_UNDEFINED;
+		desc->setter = JS_UNDEFINED;
+	}
+	return true;
+}
+
+static int gameObjectGetOwnPropertyNames(JSContext *ctx, JSPropertyEnum **ptab, uint32_t *plen, JSValueConst obj)
+{
+	GameObjectSnapshot *snapshot = static_cast<GameObjectSnapshot *>(JS_GetOpaque(obj, gameObjectClassId));
+	const std::vector<GameObjectProperty> &properties = snapshot != nullptr ? snapshot->properties.properties : baseObjectProperties.properties;
+	uint32_t len = snapshot != nullptr ? static_cast<uint32_t>(properties.size()) : 0;
+	JSPropertyEnum *tab = static_cast<JSPropertyEnum *>(js_malloc(ctx, sizeof(JSPropertyEnum) * std::max<uint32_t>(len, 1)));
+	if (tab == nullptr)
+	{
+		return -1;
+	}
+	QuickJSGameObjectClass &cls = gameObjectClass(ctx);
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		tab[i].is_enumerable = false;
+		tab[i].atom = JS_DupAtom(ctx, cls.propertyAtoms[properties[i]]);
+	}
+	*ptab = tab;
+	*plen = len;
+	return 0;
+}
+
+static int gameObjectDeleteProperty(JSContext *ctx, JSValueConst obj, JSAtom prop)
+{
+	GameObjectProperty property;
+	return gameObjectLookup(ctx, obj, prop, property) != nullptr ? false : true;  // The properties are non-configurable.
+}
+
+static int gameObjectDefineOwnProperty(JSContext *ctx, JSValueConst this_obj, JSAtom prop, JSValueConst val, JSValueConst getter, JSValueConst setter, int flags)
+{
+	GameObjectProperty property;
+	if (gameObjectLookup(ctx, this_obj, prop, property) == nullptr)
+	{
+		// Properties added by the script are ordinary properties.
+		return JS_DefineProperty(ctx, this_obj, prop, val, getter, setter, flags | JS_PROP_NO_EXOTIC);
+	}
+	// Read-only and non-configurable, so can only be redefined as it is.
+	if ((flags & (JS_PROP_HAS_GET | JS_PROP_HAS_SET | JS_PROP_HAS_VALUE)) != 0
+	    || ((flags & JS_PROP_HAS_CONFIGURABLE) != 0 && (flags & JS_PROP_CONFIGURABLE) != 0)
+	    || ((flags & JS_PROP_HAS_WRITABLE) != 0 && (flags & JS_PROP_WRITABLE) != 0)
+	    || ((flags & JS_PROP_HAS_ENUMERABLE) != 0 && (flags & JS_PROP_ENUMERABLE) != 0))
+	{
+		if ((flags & (JS_PROP_THROW | JS_PROP_THROW_STRICT)) != 0)
+		{
+			JS_ThrowTypeError(ctx, "property is not configurable");
+			return -1;
+		}
+		return false;
+	}
+	return true;
+}
+
+static void gameObjectMark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
+{
+	GameObjectSnapshot *snapshot = static_cast<GameObjectSnapshot *>(JS_GetOpaque(val, gameObjectClassId));
+	if (snapshot != nullptr)
+	{
+		JS_MarkValue(rt, snapshot->weaponList, mark_func);
+	}
+}
+
+static void gameObjectFinalizer(JSRuntime *rt, JSValue val)
+{
+	GameObjectSnapshot *snapshot = static_cast<GameObjectSnapshot *>(JS_GetOpaque(val, gameObjectClassId));
+	if (snapshot != nullptr)
+	{
+		JS_FreeValueRT(rt, snapshot->weaponList);
+		delete snapshot;
+	}
+}
+
+static JSClassExoticMethods gameObjectExoticMethods = [] {
+	JSClassExoticMethods methods = {};
+	methods.get_own_property = gameObjectGetOwnProperty;
+	methods.get_own_property_names = gameObjectGetOwnPropertyNames;
+	methods.delete_property = gameObjectDeleteProperty;
+	methods.define_own_property = gameObjectDefineOwnProperty;
+	return methods;
+}();
+
+/// Registers the game object class with the runtime of ctx. Call once, before converting any game objects.
+static void QuickJS_RegisterGameObjectClass(JSContext *ctx)
+{
+	JSRuntime *rt = JS_GetRuntime(ctx);
+	if (gameObjectClassId == 0)
+	{
+		JS_NewClassID(&gameObjectClassId);
+	}
+	JSClassDef classDef = {};
+	classDef.class_name = "GameObject";
+	classDef.finalizer = gameObjectFinalizer;
+	classDef.gc_mark = gameObjectMark;
+	classDef.exotic = &gameObjectExoticMethods;
+	JS_NewClass(rt, gameObjectClassId, &classDef);
+
+	// Same prototype as plain objects.
+	JSValue obj = JS_NewObject(ctx);
+	JS_SetClassProto(ctx, gameObjectClassId, JS_GetPrototype(ctx, obj));
+	JS_FreeValue(ctx, obj);
+
+	QuickJSGameObjectClass *cls = new QuickJSGameObjectClass;
+	for (int i = 0; i < GOP_COUNT; ++i)
+	{
+		cls->propertyAtoms[i] = JS_NewAtom(ctx, gameObjectPropertyNames[i]);
+		cls->propertyByAtom[cls->propertyAtoms[i]] = static_cast<GameObjectProperty>(i);
+	}
+	cls->fullnameAtom = JS_NewAtom(ctx, "fullname");
+	cls->lastFiredAtom = JS_NewAtom(ctx, "lastFired");
+	JS_SetRuntimeOpaque(rt, cls);
+}
+
+static void QuickJS_UnregisterGameObjectClass(JSContext *ctx)
+{
+	QuickJSGameObjectClass *cls = &gameObjectClass(ctx);
+	for (JSAtom atom : cls->propertyAtoms)
+	{
+		JS_FreeAtom(ctx, atom);
+	}
+	JS_FreeAtom(ctx, cls->fullnameAtom);
+	JS_FreeAtom(ctx, cls->lastFiredAtom);
+	for (const std::vector<JSAtom> *atoms : {&cls->weaponIds, &cls->weaponNames, &cls->bodyIds, &cls->propulsionIds})
+	{
+		for (JSAtom atom : *atoms)
+		{
+			if (atom != JS_ATOM_NULL)
+			{
+				JS_FreeAtom(ctx, atom);
+			}
+		}
+	}
+	JS_SetRuntimeOpaque(JS_GetRuntime(ctx), nullptr);
+	delete cls;
+}
+
+static JSValue newGameObject(JSContext *ctx, GameObjectSnapshot *snapshot)
+{
+	JSValue value = JS_NewObjectClass(ctx, gameObjectClassId);
+	if (JS_IsException(value))
+	{
+		delete snapshot;
+		return value;
+	}
+	JS_SetOpaque(value, snapshot);
+	return value;
+}
+
+static void snapshotObj(GameObjectSnapshot &snapshot, const BASE_OBJECT *psObj, JSContext *ctx)
+{
+	snapshot.type = psObj->type;
+	snapshot.id = psObj->id;
+	snapshot.pos = psObj->pos;
+	snapshot.player = psObj->player;
+	snapshot.armour = objArmour(psObj, WC_KINETIC);
+	snapshot.thermal = objArmour(psObj, WC_HEAT);
+	snapshot.selected = psObj->selected;
+	snapshot.name = objInfo(psObj);
+	snapshot.born = psObj->born;
+	scripting_engine::GROUPMAP *psMap = scripting_engine::instance().getGroupMap(engineToInstanceMap.at(ctx));
+	if (psMap != nullptr)
+	{
+		auto it = psMap->map().find(psObj);
+		if (it != psMap->map().end())
+		{
+			snapshot.hasGroup = true;
+			snapshot.group = it->second;
+		}
+	}
+}
+
 //;; ## Structure
 //;;
 //;; Describes a structure (building). It inherits all the properties of the base object (see below).
@@ -766,73 +1223,54 @@ JSValue convResearch(const RESEARCH *psResearch, JSContext *ctx, int player)
 //;;
 JSValue convStructure(const STRUCTURE *psStruct, JSContext *ctx)
 {
-	bool aa = false;
-	bool ga = false;
-	bool indirect = false;
-	int range = -1;
+	GameObjectSnapshot *snapshot = new GameObjectSnapshot(structureProperties);
+	snapshotObj(*snapshot, psStruct, ctx);
 	for (int i = 0; i < psStruct->numWeaps; i++)
 	{
 		if (psStruct->asWeaps[i].nStat)
 		{
 			WEAPON_STATS *psWeap = &asWeaponStats[psStruct->asWeaps[i].nStat];
-			aa = aa || psWeap->surfaceToAir & SHOOT_IN_AIR;
-			ga = ga || psWeap->surfaceToAir & SHOOT_ON_GROUND;
-			indirect = indirect || psWeap->movementModel == MM_INDIRECT || psWeap->movementModel == MM_HOMINGINDIRECT;
-			range = MAX(proj_GetLongRange(psWeap, psStruct->player), range);
-		}
-	}
-	JSValue value = convObj(psStruct, ctx);
-	QuickJS_DefinePropertyValue(ctx, value, "isCB", JS_NewBool(ctx, structCBSensor(psStruct)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "isSensor", JS_NewBool(ctx, structStandardSensor(psStruct)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "canHitAir", JS_NewBool(ctx, aa), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "canHitGround", JS_NewBool(ctx, ga), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "hasIndirect", JS_NewBool(ctx, indirect), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "isRadarDetector", JS_NewBool(ctx, objRadarDetector(psStruct)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "range", JS_NewInt32(ctx, range), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "status", JS_NewInt32(ctx, (int)psStruct->status), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "health", JS_NewInt32(ctx, 100 * psStruct->body / MAX(1, structureBody(psStruct))), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "cost", JS_NewInt32(ctx, psStruct->pStructureType->powerToBuild), 0);
-	int stattype = 0;
+			snapshot->canHitAir = snapshot->canHitAir || psWeap->surfaceToAir & SHOOT_IN_AIR;
+			snapshot->canHitGround = snapshot->canHitGround || psWeap->surfaceToAir & SHOOT_ON_GROUND;
+			snapshot->hasIndirect = snapshot->hasIndirect || psWeap->movementModel == MM_INDIRECT || psWeap->movementModel == MM_HOMINGINDIRECT;
+			snapshot->range = MAX(proj_GetLongRange(psWeap, psStruct->player), snapshot->range);
+		}
+	}
+	snapshot->isCB = structCBSensor(psStruct);
+	snapshot->isSensor = structStandardSensor(psStruct);
+	snapshot->isRadarDetector = objRadarDetector(psStruct);
+	snapshot->status = (int)psStruct->status;
+	snapshot->health = 100 * psStruct->body / MAX(1, structureBody(psStruct));
+	snapshot->cost = psStruct->pStructureType->powerToBuild;
 	switch (psStruct->pStructureType->type) // don't bleed our source insanities into the scripting world
 	{
 	case REF_WALL:
 	case REF_WALLCORNER:
 	case REF_GATE:
-		stattype = (int)REF_WALL;
+		snapshot->stattype = (int)REF_WALL;
 		break;
 	case REF_GENERIC:
 	case REF_DEFENSE:
-		stattype = (int)REF_DEFENSE;
+		snapshot->stattype = (int)REF_DEFENSE;
 		break;
 	default:
-		stattype = (int)psStruct->pStructureType->type;
+		snapshot->stattype = (int)psStruct->pStructureType->type;
 		break;
 	}
-	QuickJS_DefinePropertyValue(ctx, value, "stattype", JS_NewInt32(ctx, stattype), 0);
 	if (psStruct->pStructureType->type == REF_FACTORY || psStruct->pStructureType->type == REF_CYBORG_FACTORY
 	    || psStruct->pStructureType->type == REF_VTOL_FACTORY
 	    || psStruct->pStructureType->type == REF_RESEARCH
 	    || psStruct->pStructureType->type == REF_POWER_GEN)
 	{
-		QuickJS_DefinePropertyValue(ctx, value, "modules", JS_NewUint32(ctx, psStruct->capacity), 0);
-	}
-	else
-	{
-		QuickJS_DefinePropertyValue(ctx, value, "modules", JS_NULL, 0);
+		snapshot->hasModules = true;
+		snapshot->modules = psStruct->capacity;
 	}
-	JSValue weaponlist = JS_NewArray(ctx);
+	snapshot->numWeaps = psStruct->numWeaps;
 	for (int j = 0; j < psStruct->numWeaps; j++)
 	{
-		JSValue weapon = JS_NewObject(ctx);
-		const WEAPON_STATS *psStats = asWeaponStats + psStruct->asWeaps[j].nStat;
-		QuickJS_DefinePropertyValue(ctx, weapon, "fullname", JS_NewString(ctx, psStats->name.toUtf8().c_str()), 0);
-		QuickJS_DefinePropertyValue(ctx, weapon, "name", JS_NewString(ctx, psStats->id.toUtf8().c_str()), 0); // will be changed to contain full name
-		QuickJS_DefinePropertyValue(ctx, weapon, "id", JS_NewString(ctx, psStats->id.toUtf8().c_str()), 0);
-		QuickJS_DefinePropertyValue(ctx, weapon, "lastFired", JS_NewUint32(ctx, psStruct->asWeaps[j].lastFired), 0);
-		JS_DefinePropertyValueUint32(ctx, weaponlist, j, weapon, 0);
+		snapshot->weapons[j] = {psStruct->asWeaps[j].nStat, psStruct->asWeaps[j].lastFired, 0};
 	}
-	QuickJS_DefinePropertyValue(ctx, value, "weapons", weaponlist, 0);
-	return value;
+	return newGameObject(ctx, snapshot);
 }
 
 //;; ## Feature
@@ -845,12 +1283,13 @@ JSValue convStructure(const STRUCTURE *psStruct, JSContext *ctx)
 //;;
 JSValue convFeature(const FEATURE *psFeature, JSContext *ctx)
 {
-	JSValue value = convObj(psFeature, ctx);
+	GameObjectSnapshot *snapshot = new GameObjectSnapshot(featureProperties);
+	snapshotObj(*snapshot, psFeature, ctx);
 	const FEATURE_STATS *psStats = psFeature->psStats;
-	QuickJS_DefinePropertyValue(ctx, value, "health", JS_NewUint32(ctx, 100 * psStats->body / MAX(1, psFeature->body)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "damageable", JS_NewBool(ctx, psStats->damageable), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "stattype", JS_NewInt32(ctx, psStats->subType), 0);
-	return value;
+	snapshot->health = 100 * psStats->body / MAX(1, psFeature->body);
+	snapshot->damageable = psStats->damageable;
+	snapshot->stattype = psStats->subType;
+	return newGameObject(ctx, snapshot);
 }
 
 //;; ## Droid
@@ -917,10 +1356,8 @@ JSValue convFeature(const FEATURE *psFeature, JSContext *ctx)
 //;;
 JSValue convDroid(const DROID *psDroid, JSContext *ctx)
 {
-	bool aa = false;
-	bool ga = false;
-	bool indirect = false;
-	int range = -1;
+	GameObjectSnapshot *snapshot = new GameObjectSnapshot(isTransporter(psDroid) ? transporterProperties : droidProperties);
+	snapshotObj(*snapshot, psDroid, ctx);
 	const BODY_STATS *psBodyStats = &asBodyStats[psDroid->asBits[COMP_BODY]];
 
 	for (int i = 0; i < psDroid->numWeaps; i++)
@@ -928,26 +1365,13 @@ JSValue convDroid(const DROID *psDroid, JSContext *ctx)
 		if (psDroid->asWeaps[i].nStat)
 		{
 			WEAPON_STATS *psWeap = &asWeaponStats[psDroid->asWeaps[i].nStat];
-			aa = aa || psWeap->surfaceToAir & SHOOT_IN_AIR;
-			ga = ga || psWeap->surfaceToAir & SHOOT_ON_GROUND;
-			indirect = indirect || psWeap->movementModel == MM_INDIRECT || psWeap->movementModel == MM_HOMINGINDIRECT;
-			range = MAX(proj_GetLongRange(psWeap, psDroid->player), range);
+			snapshot->canHitAir = snapshot->canHitAir || psWeap->surfaceToAir & SHOOT_IN_AIR;
+			snapshot->canHitGround = snapshot->canHitGround || psWeap->surfaceToAir & SHOOT_ON_GROUND;
+			snapshot->hasIndirect = snapshot->hasIndirect || psWeap->movementModel == MM_INDIRECT || psWeap->movementModel == MM_HOMINGINDIRECT;
+			snapshot->range = MAX(proj_GetLongRange(psWeap, psDroid->player), snapshot->range);
 		}
 	}
 	DROID_TYPE type = psDroid->droidType;
-	JSValue value = convObj(psDroid, ctx);
-	QuickJS_DefinePropertyValue(ctx, value, "action", JS_NewInt32(ctx, (int)psDroid->action), 0);
-	if (range >= 0)
-	{
-		QuickJS_DefinePropertyValue(ctx, value, "range", JS_NewInt32(ctx, range), 0);
-	}
-	else
-	{
-		QuickJS_DefinePropertyValue(ctx, value, "range", JS_NULL, 0);
-	}
-	QuickJS_DefinePropertyValue(ctx, value, "order", JS_NewInt32(ctx, (int)psDroid->order.type), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "cost", JS_NewUint32(ctx, calcDroidPower(psDroid)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "hasIndirect", JS_NewBool(ctx, indirect), 0);
 	switch (psDroid->droidType) // hide some engine craziness
 	{
 	case DROID_CYBORG_CONSTRUCT:
@@ -961,43 +1385,31 @@ JSValue convDroid(const DROID *psDroid, JSContext *ctx)
 	default:
 		break;
 	}
-	QuickJS_DefinePropertyValue(ctx, value, "bodySize", JS_NewInt32(ctx, psBodyStats->size), 0);
+	snapshot->action = (int)psDroid->action;
+	snapshot->order = (int)psDroid->order.type;
+	snapshot->cost = calcDroidPower(psDroid);
+	snapshot->bodySize = psBodyStats->size;
 	if (isTransporter(psDroid))
 	{
-		QuickJS_DefinePropertyValue(ctx, value, "cargoCapacity", JS_NewInt32(ctx, TRANSPORTER_CAPACITY), 0);
-		QuickJS_DefinePropertyValue(ctx, value, "cargoLeft", JS_NewInt32(ctx, calcRemainingCapacity(psDroid)), 0);
-		QuickJS_DefinePropertyValue(ctx, value, "cargoCount", JS_NewUint32(ctx, psDroid->psGroup != nullptr? psDroid->psGroup->getNumMembers() : 0), 0);
+		snapshot->cargoLeft = calcRemainingCapacity(psDroid);
+		snapshot->cargoCount = psDroid->psGroup != nullptr? psDroid->psGroup->getNumMembers() : 0;
 	}
-	QuickJS_DefinePropertyValue(ctx, value, "isRadarDetector", JS_NewBool(ctx, objRadarDetector(psDroid)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "isCB", JS_NewBool(ctx, cbSensorDroid(psDroid)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "isSensor", JS_NewBool(ctx, standardSensorDroid(psDroid)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "canHitAir", JS_NewBool(ctx, aa), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "canHitGround", JS_NewBool(ctx, ga), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "isVTOL", JS_NewBool(ctx, isVtolDroid(psDroid)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "droidType", JS_NewInt32(ctx, (int)type), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "experience", JS_NewFloat64(ctx, (double)psDroid->experience / 65536.0), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "health", JS_NewFloat64(ctx, 100.0 / (double)psDroid->originalBody * (double)psDroid->body), 0);
-
-	QuickJS_DefinePropertyValue(ctx, value, "body", JS_NewString(ctx, asBodyStats[psDroid->asBits[COMP_BODY]].id.toUtf8().c_str()), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "propulsion", JS_NewString(ctx, asPropulsionStats[psDroid->asBits[COMP_PROPULSION]].id.toUtf8().c_str()), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "armed", JS_NewFloat64(ctx, 0.0), 0); // deprecated!
-
-	JSValue weaponlist = JS_NewArray(ctx);
+	snapshot->isRadarDetector = objRadarDetector(psDroid);
+	snapshot->isCB = cbSensorDroid(psDroid);
+	snapshot->isSensor = standardSensorDroid(psDroid);
+	snapshot->isVTOL = isVtolDroid(psDroid);
+	snapshot->droidType = (int)type;
+	snapshot->experience = (double)psDroid->experience / 65536.0;
+	snapshot->health = 100.0 / (double)psDroid->originalBody * (double)psDroid->body;
+	snapshot->bodyStat = psDroid->asBits[COMP_BODY];
+	snapshot->propulsionStat = psDroid->asBits[COMP_PROPULSION];
+	snapshot->numWeaps = psDroid->numWeaps;
 	for (int j = 0; j < psDroid->numWeaps; j++)
 	{
-		int armed = droidReloadBar(psDroid, &psDroid->asWeaps[j], j);
-		JSValue weapon = JS_NewObject(ctx);
-		const WEAPON_STATS *psStats = asWeaponStats + psDroid->asWeaps[j].nStat;
-		QuickJS_DefinePropertyValue(ctx, weapon, "fullname", JS_NewString(ctx, psStats->name.toUtf8().c_str()), 0);
-		QuickJS_DefinePropertyValue(ctx, weapon, "name", JS_NewString(ctx, psStats->id.toUtf8().c_str()), 0); // will be changed to contain full name
-		QuickJS_DefinePropertyValue(ctx, weapon, "id", JS_NewString(ctx, psStats->id.toUtf8().c_str()), 0);
-		QuickJS_DefinePropertyValue(ctx, weapon, "lastFired", JS_NewUint32(ctx, psDroid->asWeaps[j].lastFired), 0);
-		QuickJS_DefinePropertyValue(ctx, weapon, "armed", JS_NewInt32(ctx, armed), 0);
-		JS_DefinePropertyValueUint32(ctx, weaponlist, j, weapon, 0);
+		snapshot->weapons[j] = {psDroid->asWeaps[j].nStat, psDroid->asWeaps[j].lastFired, droidReloadBar(psDroid, &psDroid->asWeaps[j], j)};
 	}
-	QuickJS_DefinePropertyValue(ctx, value, "weapons", weaponlist, 0);
-	QuickJS_DefinePropertyValue(ctx, value, "cargoSize", JS_NewInt32(ctx, transporterSpaceRequired(psDroid)), 0);
-	return value;
+	snapshot->cargoSize = transporterSpaceRequired(psDroid);
+	return newGameObject(ctx, snapshot);
 }
 
 //;; ## Base Object
@@ -1022,30 +1434,10 @@ JSValue convDroid(const DROID *psDroid, JSContext *ctx)
 //;;
 JSValue convObj(const BASE_OBJECT *psObj, JSContext *ctx)
 {
-	JSValue value = JS_NewObject(ctx);
-	ASSERT_OR_RETURN(value, psObj, "No object for conversion");
-	QuickJS_DefinePropertyValue(ctx, value, "id", JS_NewUint32(ctx, psObj->id), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "x", JS_NewInt32(ctx, map_coord(psObj->pos.x)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "y", JS_NewInt32(ctx, map_coord(psObj->pos.y)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "z", JS_NewInt32(ctx, map_coord(psObj->pos.z)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "player", JS_NewUint32(ctx, psObj->player), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "armour", JS_NewInt32(ctx, objArmour(psObj, WC_KINETIC)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "thermal", JS_NewInt32(ctx, objArmour(psObj, WC_HEAT)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "type", JS_NewInt32(ctx, psObj->type), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "selected", JS_NewUint32(ctx, psObj->selected), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "name", JS_NewString(ctx, objInfo(psObj)), 0);
-	QuickJS_DefinePropertyValue(ctx, value, "born", JS_NewUint32(ctx, psObj->born), 0);
-	scripting_engine::GROUPMAP *psMap = scripting_engine::instance().getGroupMap(engineToInstanceMap.at(ctx));
-	if (psMap != nullptr && psMap->map().count(psObj) > 0) // FIXME:
-	{
-		int group = psMap->map().at(psObj); // FIXME:
-		QuickJS_DefinePropertyValue(ctx, value, "group", JS_NewInt32(ctx, group), 0);
-	}
-	else
-	{
-		QuickJS_DefinePropertyValue(ctx, value, "group", JS_NULL, 0);
-	}
-	return value;
+	ASSERT_OR_RETURN(JS_NewObject(ctx), psObj, "No object for conversion");
+	GameObjectSnapshot *snapshot = new GameObjectSnapshot(baseObjectProperties);
+	snapshotObj(*snapshot, psObj, ctx);
+	return newGameObject(ctx, snapshot);
 }
 
 //;; ## Template
@@ -1106,10 +1498,71 @@ JSValue convMax(const BASE_OBJECT *psObj, JSContext *ctx)
 	}
 }
 
+/// Adds the time taken and the JS heap allocated until it goes out of scope to the profile of the script, if profiling.
+/// Nested scopes are included in the numbers of the outer scopes.
+class QuickJSProfileScope
+{
+public:
+	QuickJSProfileScope(JSContext *ctx, const char *name, bool api)
+	{
+		if (!scriptGetProfiling())
+		{
+			return;
+		}
+		instance = engineToInstanceMap.at(ctx);
+		if (!instance->profiling)
+		{
+			instance = nullptr;
+			return;
+		}
+		entry = &(api ? instance->apiProfile : instance->functionProfile)[name];
+		startAllocations = instance->allocationCounts;
+		startTime = std::chrono::steady_clock::now();
+	}
+	~QuickJSProfileScope()
+	{
+		if (instance == nullptr)
+		{
+			return;
+		}
+		uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+		entry->calls++;
+		entry->microseconds += microseconds;
+		entry->worstMicroseconds = std::max(entry->worstMicroseconds, microseconds);
+		entry->allocations += instance->allocationCounts.count - startAllocations.count;
+		entry->allocatedBytes += instance->allocationCounts.size - startAllocations.size;
+	}
+
+	QuickJSProfileScope(QuickJSProfileScope const &) = delete;
+	QuickJSProfileScope &operator =(QuickJSProfileScope const &) = delete;
+
+private:
+	quickjs_scripting_instance *instance = nullptr;
+	QuickJSProfileEntry *entry = nullptr;
+	JSAllocationCounts startAllocations;
+	std::chrono::steady_clock::time_point startTime;
+};
+
+// Makes a call from the script of the given context into the game, see scriptCallIntoGame(). If AIs run in parallel, the
+// call is made on the main thread, rather than on the thread running the script.
+template<typename Call>
+static auto callIntoGame(JSContext *ctx, Call &&call) -> decltype(call())
+{
+	return scriptCallIntoGame([ctx, &call] {
+		const void *stack_top = JS_UpdateStackTop(JS_GetRuntime(ctx));
+		auto restore_stack_top = gsl::finally([ctx, stack_top] { JS_RestoreStackTop(JS_GetRuntime(ctx), stack_top); });
+		return call();
+	});
+}
+
 // Call a function by name
 static JSValue callFunction(JSContext *ctx, const std::string &function, std::vector<JSValue> &args, bool event = true)
 {
 	const auto instance = engineToInstanceMap.at(ctx);
+	scriptWaitForInstance(instance);
+	// The instance may be running on another thread than last time, if AIs run in parallel.
+	const void *stack_top = JS_UpdateStackTop(JS_GetRuntime(ctx));
+	auto restore_stack_top = gsl::finally([ctx, stack_top] { JS_RestoreStackTop(JS_GetRuntime(ctx), stack_top); });
 	JSValue global_obj = instance->Get_Global_Obj();
 	if (event)
 	{
@@ -1137,6 +1590,7 @@ static JSValue callFunction(JSContext *ctx, const std::string &function, std::ve
 	}
 
 	JSValue result;
+	QuickJSProfileScope profile(ctx, function.c_str(), false);
 	scripting_engine::instance().executeWithPerformanceMonitoring(instance, function, [ctx, &result, value, &args](){
 		result = JS_Call(ctx, value, JS_UNDEFINED, (int)args.size(), args.data());
 	});
@@ -1204,6 +1658,7 @@ static JSValue callFunction(JSContext *ctx, const std::string &function, std::ve
 		{
 			JSContext *pCtx = ctx;
 			return [pCtx, func](const int player) {
+				scriptWaitForInstance(engineToInstanceMap.at(pCtx));  // Before allocating the arguments in its runtime.
 				std::vector<JSValue> args;
 				args.push_back(JS_NewInt32(pCtx, player));
 				callFunction(pCtx, func.toUtf8(), args);
@@ -2116,15 +2571,21 @@ static JSValue callFunction(JSContext *ctx, const std::string &function, std::ve
 		#define IMPL_JS_FUNC(func_name, wrapped_func) \
 			static JSValue JS_FUNC_IMPL_NAME(func_name)(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) \
 			{ \
-				return wrap_(wrapped_func, ctx, argc, argv); \
+				return callIntoGame(ctx, [ctx, argc, argv] { \
+					QuickJSProfileScope profile(ctx, #func_name, true); \
+					return wrap_(wrapped_func, ctx, argc, argv); \
+				}); \
 			}
 
 		#define IMPL_JS_FUNC_DEBUGMSGUPDATE(func_name, wrapped_func) \
 			static JSValue JS_FUNC_IMPL_NAME(func_name)(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) \
 			{ \
-				JSValue retVal = wrap_(wrapped_func, ctx, argc, argv); \
-				jsDebugMessageUpdate(); \
-				return retVal; \
+				return callIntoGame(ctx, [ctx, argc, argv] { \
+					QuickJSProfileScope profile(ctx, #func_name, true); \
+					JSValue retVal = wrap_(wrapped_func, ctx, argc, argv); \
+					jsDebugMessageUpdate(); \
+					return retVal; \
+				}); \
 			}
 
 		template <typename T>
@@ -2133,6 +2594,8 @@ static JSValue callFunction(JSContext *ctx, const std::string &function, std::ve
 		template <typename... Args>
 		bool wrap_event_handler__(const std::string &functionName, JSContext *context, Args&&... args)
 		{
+			// Building the arguments allocates in the instance's runtime, which must not be running on its own worker meanwhile.
+			scriptWaitForInstance(engineToInstanceMap.at(context));
 			std::vector<JSValue> args_list;
 			using expander = int[];
 //			WZ_DECL_UNUSED int dummy[] = { 0, ((void) append_value_list(args_list, std::forward<Args>(args), engine),0)... };
@@ -2253,56 +2716,58 @@ static std::string QuickJS_DumpError(JSContext *ctx)
 //--
 static JSValue js_include(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	SCRIPT_ASSERT(ctx, argc == 1, "Must specify a file to include");
-	JSValue global_obj = JS_GetGlobalObject(ctx);
-	auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
-	std::string basePath = QuickJS_GetStdString(ctx, global_obj, "scriptPath");
-	std::string basenameStr = JSValueToStdString(ctx, argv[0]);
-	QFileInfo basename(basenameStr.c_str());
-	std::string path = basePath + "/" + basename.fileName().toStdString();
-	// allow users to use subdirectories too
-	if (PHYSFS_exists(basename.filePath().toUtf8().constData()))
-	{
-		path = basename.filePath().toStdString(); // use this path instead (from read-only dir)
-	}
-	else if (PHYSFS_exists(QString("scripts/" + basename.filePath()).toUtf8().constData()))
-	{
-		path = "scripts/" + basename.filePath().toStdString(); // use this path instead (in user write dir)
-	}
-	UDWORD size;
-	char *bytes = nullptr;
-	if (!loadFile(path.c_str(), &bytes, &size))
-	{
-		debug(LOG_ERROR, "Failed to read include file \"%s\" (path=%s, name=%s)",
-		      path.c_str(), basePath.c_str(), basename.filePath().toUtf8().constData());
-		JS_ThrowReferenceError(ctx, "Failed to read include file \"%s\" (path=%s, name=%s)", path.c_str(), basePath.c_str(), basename.filePath().toUtf8().constData());
-		return JS_FALSE;
-	}
-	JSValue compiledFuncObj = JS_Eval(ctx, bytes, size, path.c_str(), JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
-	free(bytes);
-	if (JS_IsException(compiledFuncObj))
-	{
-		// compilation error / syntax error
-		std::string errorAsString = QuickJS_DumpError(ctx);
-		debug(LOG_ERROR, "Syntax error in include file %s: %s",
-			  path.c_str(), errorAsString.c_str());
-		JS_FreeValue(ctx, compiledFuncObj);
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		SCRIPT_ASSERT(ctx, argc == 1, "Must specify a file to include");
+		JSValue global_obj = JS_GetGlobalObject(ctx);
+		auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
+		std::string basePath = QuickJS_GetStdString(ctx, global_obj, "scriptPath");
+		std::string basenameStr = JSValueToStdString(ctx, argv[0]);
+		QFileInfo basename(basenameStr.c_str());
+		std::string path = basePath + "/" + basename.fileName().toStdString();
+		// allow users to use subdirectories too
+		if (PHYSFS_exists(basename.filePath().toUtf8().constData()))
+		{
+			path = basename.filePath().toStdString(); // use this path instead (from read-only dir)
+		}
+		else if (PHYSFS_exists(QString("scripts/" + basename.filePath()).toUtf8().constData()))
+		{
+			path = "scripts/" + basename.filePath().toStdString(); // use this path instead (in user write dir)
+		}
+		UDWORD size;
+		char *bytes = nullptr;
+		if (!loadFile(path.c_str(), &bytes, &size))
+		{
+			debug(LOG_ERROR, "Failed to read include file \"%s\" (path=%s, name=%s)",
+			      path.c_str(), basePath.c_str(), basename.filePath().toUtf8().constData());
+			JS_ThrowReferenceError(ctx, "Failed to read include file \"%s\" (path=%s, name=%s)", path.c_str(), basePath.c_str(), basename.filePath().toUtf8().constData());
+			return JS_FALSE;
+		}
+		JSValue compiledFuncObj = JS_Eval(ctx, bytes, size, path.c_str(), JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+		free(bytes);
+		if (JS_IsException(compiledFuncObj))
+		{
+			// compilation error / syntax error
+			std::string errorAsString = QuickJS_DumpError(ctx);
+			debug(LOG_ERROR, "Syntax error in include file %s: %s",
+				  path.c_str(), errorAsString.c_str());
+			JS_FreeValue(ctx, compiledFuncObj);
+			compiledFuncObj = JS_UNINITIALIZED;
+			return JS_FALSE;
+		}
+		JSValue result = JS_EvalFunction(ctx, compiledFuncObj);
 		compiledFuncObj = JS_UNINITIALIZED;
-		return JS_FALSE;
-	}
-	JSValue result = JS_EvalFunction(ctx, compiledFuncObj);
-	compiledFuncObj = JS_UNINITIALIZED;
-	if (JS_IsException(result))
-	{
-		std::string errorAsString = QuickJS_DumpError(ctx);
-		debug(LOG_ERROR, "Uncaught exception in include file %s: %s",
-		      path.c_str(), errorAsString.c_str());
-		JS_FreeValue(ctx, result);
-		return JS_FALSE;
-    }
-    JS_FreeValue(ctx, result);
-	debug(LOG_SCRIPT, "Included new script file %s", path.c_str());
-	return JS_TRUE;
+		if (JS_IsException(result))
+		{
+			std::string errorAsString = QuickJS_DumpError(ctx);
+			debug(LOG_ERROR, "Uncaught exception in include file %s: %s",
+			      path.c_str(), errorAsString.c_str());
+			JS_FreeValue(ctx, result);
+			return JS_FALSE;
+	    }
+	    JS_FreeValue(ctx, result);
+		debug(LOG_SCRIPT, "Included new script file %s", path.c_str());
+		return JS_TRUE;
+	});
 }
 
 class quickjs_timer_additionaldata : public timerAdditionalData
@@ -2323,7 +2788,7 @@ static uniqueTimerID SetQuickJSTimer(JSContext *ctx, int player, const std::stri
 		std::vector<JSValue> args;
 		if (baseObject != nullptr)
 		{
-			args.push_back(convMax(baseObject, ctx));
+			args.push_back(callIntoGame(ctx, [ctx, baseObject] { return convMax(baseObject, ctx); }));
 		}
 		else if (pData && !(pData->stringArg.empty()))
 		{
@@ -2357,39 +2822,41 @@ static uniqueTimerID SetQuickJSTimer(JSContext *ctx, int player, const std::stri
 //--
 static JSValue js_setTimer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	SCRIPT_ASSERT(ctx, argc >= 2, "Must have at least two parameters");
-	SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Timer functions must be quoted");
-	std::string funcName = JSValueToStdString(ctx, argv[0]);
-	int32_t ms = JSValueToInt32(ctx, argv[1]);
-
-	JSValue global_obj = JS_GetGlobalObject(ctx);
-	auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
-	int player = QuickJS_GetInt32(ctx, global_obj, "me");
-
-	JSValue funcObj = JS_GetPropertyStr(ctx, global_obj, funcName.c_str()); // check existence
-	SCRIPT_ASSERT(ctx, JS_IsFunction(ctx, funcObj), "No such function: %s", funcName.c_str());
-	JS_FreeValue(ctx, funcObj);
-
-	std::string stringArg;
-	BASE_OBJECT *psObj = nullptr;
-	if (argc == 3)
-	{
-		JSValue obj = argv[2];
-		if (JS_IsString(obj))
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		SCRIPT_ASSERT(ctx, argc >= 2, "Must have at least two parameters");
+		SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Timer functions must be quoted");
+		std::string funcName = JSValueToStdString(ctx, argv[0]);
+		int32_t ms = JSValueToInt32(ctx, argv[1]);
+
+		JSValue global_obj = JS_GetGlobalObject(ctx);
+		auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
+		int player = QuickJS_GetInt32(ctx, global_obj, "me");
+
+		JSValue funcObj = JS_GetPropertyStr(ctx, global_obj, funcName.c_str()); // check existence
+		SCRIPT_ASSERT(ctx, JS_IsFunction(ctx, funcObj), "No such function: %s", funcName.c_str());
+		JS_FreeValue(ctx, funcObj);
+
+		std::string stringArg;
+		BASE_OBJECT *psObj = nullptr;
+		if (argc == 3)
 		{
-			stringArg = JSValueToStdString(ctx, obj);
-		}
-		else // is game object
-		{
-			int baseobj = QuickJS_GetInt32(ctx, obj, "id");
-			OBJECT_TYPE baseobjtype = (OBJECT_TYPE)QuickJS_GetInt32(ctx, obj, "type");
-			psObj = IdToObject(baseobjtype, baseobj, player);
+			JSValue obj = argv[2];
+			if (JS_IsString(obj))
+			{
+				stringArg = JSValueToStdString(ctx, obj);
+			}
+			else // is game object
+			{
+				int baseobj = QuickJS_GetInt32(ctx, obj, "id");
+				OBJECT_TYPE baseobjtype = (OBJECT_TYPE)QuickJS_GetInt32(ctx, obj, "type");
+				psObj = IdToObject(baseobjtype, baseobj, player);
+			}
 		}
-	}
 
-	SetQuickJSTimer(ctx, player, funcName, ms, stringArg, psObj, TIMER_REPEAT);
+		SetQuickJSTimer(ctx, player, funcName, ms, stringArg, psObj, TIMER_REPEAT);
 
-	return JS_TRUE;
+		return JS_TRUE;
+	});
 }
 
 //-- ## removeTimer(function)
@@ -2399,28 +2866,30 @@ static JSValue js_setTimer(JSContext *ctx, JSValueConst this_val, int argc, JSVa
 //--
 static JSValue js_removeTimer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	SCRIPT_ASSERT(ctx, argc == 1, "Must have one parameter");
-	SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Timer functions must be quoted");
-	std::string function = JSValueToStdString(ctx, argv[0]);
-
-	JSValue global_obj = JS_GetGlobalObject(ctx);
-	auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
-	int player = QuickJS_GetInt32(ctx, global_obj, "me");
-
-	wzapi::scripting_instance* instance = engineToInstanceMap.at(ctx);
-	std::vector<uniqueTimerID> removedTimerIDs = scripting_engine::instance().removeTimersIf(
-		[instance, function, player](const scripting_engine::timerNode& node)
-	{
-		return (node.instance == instance) && (node.timerName == function) && (node.player == player);
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		SCRIPT_ASSERT(ctx, argc == 1, "Must have one parameter");
+		SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Timer functions must be quoted");
+		std::string function = JSValueToStdString(ctx, argv[0]);
+
+		JSValue global_obj = JS_GetGlobalObject(ctx);
+		auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
+		int player = QuickJS_GetInt32(ctx, global_obj, "me");
+
+		wzapi::scripting_instance* instance = engineToInstanceMap.at(ctx);
+		std::vector<uniqueTimerID> removedTimerIDs = scripting_engine::instance().removeTimersIf(
+			[instance, function, player](const scripting_engine::timerNode& node)
+		{
+			return (node.instance == instance) && (node.timerName == function) && (node.player == player);
+		});
+		if (removedTimerIDs.empty())
+		{
+			// Friendly warning
+			std::string warnName = function;
+			debug(LOG_ERROR, "Did not find timer %s to remove", warnName.c_str());
+			return JS_FALSE;
+		}
+		return JS_TRUE;
 	});
-	if (removedTimerIDs.empty())
-	{
-		// Friendly warning
-		std::string warnName = function;
-		debug(LOG_ERROR, "Did not find timer %s to remove", warnName.c_str());
-		return JS_FALSE;
-	}
-	return JS_TRUE;
 }
 
 //-- ## queue(function[, milliseconds[, object]])
@@ -2438,44 +2907,46 @@ static JSValue js_removeTimer(JSContext *ctx, JSValueConst this_val, int argc, J
 // do not add anything.
 static JSValue js_queue(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	SCRIPT_ASSERT(ctx, argc >= 1, "Must have at least one parameter");
-	SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Queued functions must be quoted");
-	std::string funcName = JSValueToStdString(ctx, argv[0]);
-
-	JSValue global_obj = JS_GetGlobalObject(ctx);
-	auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		SCRIPT_ASSERT(ctx, argc >= 1, "Must have at least one parameter");
+		SCRIPT_ASSERT(ctx, JS_IsString(argv[0]), "Queued functions must be quoted");
+		std::string funcName = JSValueToStdString(ctx, argv[0]);
 
-	JSValue funcObj = JS_GetPropertyStr(ctx, global_obj, funcName.c_str()); // check existence
-	SCRIPT_ASSERT(ctx, JS_IsFunction(ctx, funcObj), "No such function: %s", funcName.c_str());
-	JS_FreeValue(ctx, funcObj);
+		JSValue global_obj = JS_GetGlobalObject(ctx);
+		auto free_global_obj = gsl::finally([ctx, global_obj] { JS_FreeValue(ctx, global_obj); });  // establish exit action
 
-	int32_t ms = 0;
-	if (argc > 1)
-	{
-		ms = JSValueToInt32(ctx, argv[1]);
-	}
-	int player = QuickJS_GetInt32(ctx, global_obj, "me");
+		JSValue funcObj = JS_GetPropertyStr(ctx, global_obj, funcName.c_str()); // check existence
+		SCRIPT_ASSERT(ctx, JS_IsFunction(ctx, funcObj), "No such function: %s", funcName.c_str());
+		JS_FreeValue(ctx, funcObj);
 
-	std::string stringArg;
-	BASE_OBJECT *psObj = nullptr;
-	if (argc == 3)
-	{
-		JSValue obj = argv[2];
-		if (JS_IsString(obj))
+		int32_t ms = 0;
+		if (argc > 1)
 		{
-			stringArg = JSValueToStdString(ctx, obj);
+			ms = JSValueToInt32(ctx, argv[1]);
 		}
-		else // is game object
+		int player = QuickJS_GetInt32(ctx, global_obj, "me");
+
+		std::string stringArg;
+		BASE_OBJECT *psObj = nullptr;
+		if (argc == 3)
 		{
-			int baseobj = QuickJS_GetInt32(ctx, obj, "id");
-			OBJECT_TYPE baseobjtype = (OBJECT_TYPE)QuickJS_GetInt32(ctx, obj, "type");
-			psObj = IdToObject(baseobjtype, baseobj, player);
+			JSValue obj = argv[2];
+			if (JS_IsString(obj))
+			{
+				stringArg = JSValueToStdString(ctx, obj);
+			}
+			else // is game object
+			{
+				int baseobj = QuickJS_GetInt32(ctx, obj, "id");
+				OBJECT_TYPE baseobjtype = (OBJECT_TYPE)QuickJS_GetInt32(ctx, obj, "type");
+				psObj = IdToObject(baseobjtype, baseobj, player);
+			}
 		}
-	}
 
-	SetQuickJSTimer(ctx, player, funcName, ms, stringArg, psObj, TIMER_ONESHOT_READY);
+		SetQuickJSTimer(ctx, player, funcName, ms, stringArg, psObj, TIMER_ONESHOT_READY);
 
-	return JS_TRUE;
+		return JS_TRUE;
+	});
 }
 
 //-- ## namespace(prefix)
@@ -3054,6 +3525,32 @@ bool quickjs_scripting_instance::debugEvaluateCommand(const std::string &text)
 	return true;
 }
 
+nlohmann::json quickjs_scripting_instance::debugGetProfile()
+{
+	if (!profiling)
+	{
+		return nlohmann::json();
+	}
+	auto profileToJson = [](const std::map<std::string, QuickJSProfileEntry> &profile) {
+		nlohmann::json result = nlohmann::json::object();
+		for (const auto &it : profile)
+		{
+			const QuickJSProfileEntry &entry = it.second;
+			result[it.first] = {
+				{"calls", entry.calls}, {"microseconds", entry.microseconds}, {"worstMicroseconds", entry.worstMicroseconds},
+				{"allocations", entry.allocations}, {"allocatedBytes", entry.allocatedBytes},
+			};
+		}
+		return result;
+	};
+	return {
+		{"functions", profileToJson(functionProfile)},
+		{"api", profileToJson(apiProfile)},
+		{"allocations", allocationCounts.count},
+		{"allocatedBytes", allocationCounts.size},
+	};
+}
+
 void quickjs_scripting_instance::updateGameTime(uint32_t gameTime)
 {
 	int ret = JS_DefinePropertyValueStr(ctx, global_obj, "gameTime", JS_NewUint32(ctx, gameTime), JS_PROP_WRITABLE | JS_PROP_ENUMERABLE);
@@ -3161,6 +3658,7 @@ IMPL_EVENT_HANDLER(eventBeaconRemoved, int, int)
 IMPL_EVENT_HANDLER(eventGroupLoss, const BASE_OBJECT *, int, int)
 bool quickjs_scripting_instance::handle_eventArea(const std::string& label, const DROID *psDroid)
 {
+	scriptWaitForInstance(this);  // Before allocating the arguments in our runtime.
 	std::vector<JSValue> args;
 	args.push_back(convDroid(psDroid, ctx));
 	std::string funcname = std::string("eventArea") + label;
@@ -3201,18 +3699,21 @@ IMPL_JS_FUNC(enumGateways, wzapi::enumGateways)
 //--
 static JSValue js_enumTemplates(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	SCRIPT_ASSERT(ctx, argc == 1, "Must have one parameter");
-	SCRIPT_ASSERT(ctx, JS_IsNumber(argv[0]), "Supplied parameter must be a player number");
-	int player = JSValueToInt32(ctx, argv[0]);
-
-	JSValue result = JS_NewArray(ctx); //engine->newArray(droidTemplates[player].size());
-	uint32_t count = 0;
-	for (auto &keyvaluepair : droidTemplates[player])
-	{
-		JS_DefinePropertyValueUint32(ctx, result, count, convTemplate(keyvaluepair.second, ctx), 0); // TODO: Check return value?
-		count++;
-	}
-	return result;
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		QuickJSProfileScope profile(ctx, "enumTemplates", true);
+		SCRIPT_ASSERT(ctx, argc == 1, "Must have one parameter");
+		SCRIPT_ASSERT(ctx, JS_IsNumber(argv[0]), "Supplied parameter must be a player number");
+		int player = JSValueToInt32(ctx, argv[0]);
+
+		JSValue result = JS_NewArray(ctx); //engine->newArray(droidTemplates[player].size());
+		uint32_t count = 0;
+		for (auto &keyvaluepair : droidTemplates[player])
+		{
+			JS_DefinePropertyValueUint32(ctx, result, count, convTemplate(keyvaluepair.second, ctx), 0); // TODO: Check return value?
+			count++;
+		}
+		return result;
+	});
 }
 
 IMPL_JS_FUNC(enumGroup, scripting_engine::enumGroup)
@@ -3331,12 +3832,15 @@ IMPL_JS_FUNC(addBeacon, wzapi::addBeacon)
 //--
 static JSValue js_removeBeacon(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
 {
-	JSValue retVal = wrap_(wzapi::removeBeacon, ctx, argc, argv);
-	if (JS_IsBool(retVal) && JS_ToBool(ctx, retVal))
-	{
-		jsDebugMessageUpdate();
-	}
-	return retVal;
+	return callIntoGame(ctx, [ctx, argc, argv] {
+		QuickJSProfileScope profile(ctx, "removeBeacon", true);
+		JSValue retVal = wrap_(wzapi::removeBeacon, ctx, argc, argv);
+		if (JS_IsBool(retVal) && JS_ToBool(ctx, retVal))
+		{
+			jsDebugMessageUpdate();
+		}
+		return retVal;
+	});
 }
 
 IMPL_JS_FUNC(chat, wzapi::chat)
@@ -3382,28 +3886,32 @@ IMPL_JS_FUNC(setRevealStatus, wzapi::setRevealStatus)
 
 static JSValue js_stats_get(JSContext *ctx, JSValueConst this_val)
 {
-	JSValue currentFuncObj = js_debugger_get_current_funcObject(ctx);
-	int type = QuickJS_GetInt32(ctx, currentFuncObj, "type");
-	int player = QuickJS_GetInt32(ctx, currentFuncObj, "player");
-	unsigned index = QuickJS_GetUint32(ctx, currentFuncObj, "index");
-	std::string name = QuickJS_GetStdString(ctx, currentFuncObj, "name");
-	JS_FreeValue(ctx, currentFuncObj);
-	quickjs_execution_context execution_context(ctx);
-	return mapJsonToQuickJSValue(ctx, wzapi::getUpgradeStats(execution_context, player, name, type, index), JS_PROP_C_W_E);
+	return callIntoGame(ctx, [ctx] {
+		JSValue currentFuncObj = js_debugger_get_current_funcObject(ctx);
+		int type = QuickJS_GetInt32(ctx, currentFuncObj, "type");
+		int player = QuickJS_GetInt32(ctx, currentFuncObj, "player");
+		unsigned index = QuickJS_GetUint32(ctx, currentFuncObj, "index");
+		std::string name = QuickJS_GetStdString(ctx, currentFuncObj, "name");
+		JS_FreeValue(ctx, currentFuncObj);
+		quickjs_execution_context execution_context(ctx);
+		return mapJsonToQuickJSValue(ctx, wzapi::getUpgradeStats(execution_context, player, name, type, index), JS_PROP_C_W_E);
+	});
 }
 
 static JSValue js_stats_set(JSContext *ctx, JSValueConst this_val, JSValueConst val)
 {
-	JSValue currentFuncObj = js_debugger_get_current_funcObject(ctx);
-	int type = QuickJS_GetInt32(ctx, currentFuncObj, "type");
-	int player = QuickJS_GetInt32(ctx, currentFuncObj, "player");
-	unsigned index = QuickJS_GetUint32(ctx, currentFuncObj, "index");
-	std::string name = QuickJS_GetStdString(ctx, currentFuncObj, "name");
-	JS_FreeValue(ctx, currentFuncObj);
-	quickjs_execution_context execution_context(ctx);
-	wzapi::setUpgradeStats(execution_context, player, name, type, index, JSContextValue{ctx, val});
-	// Now read value and return it
-	return mapJsonToQuickJSValue(ctx, wzapi::getUpgradeStats(execution_context, player, name, type, index), JS_PROP_C_W_E);
+	return callIntoGame(ctx, [ctx, val] {
+		JSValue currentFuncObj = js_debugger_get_current_funcObject(ctx);
+		int type = QuickJS_GetInt32(ctx, currentFuncObj, "type");
+		int player = QuickJS_GetInt32(ctx, currentFuncObj, "player");
+		unsigned index = QuickJS_GetUint32(ctx, currentFuncObj, "index");
+		std::string name = QuickJS_GetStdString(ctx, currentFuncObj, "name");
+		JS_FreeValue(ctx, currentFuncObj);
+		quickjs_execution_context execution_context(ctx);
+		wzapi::setUpgradeStats(execution_context, player, name, type, index, JSContextValue{ctx, val});
+		// Now read value and return it
+		return mapJsonToQuickJSValue(ctx, wzapi::getUpgradeStats(execution_context, player, name, type, index), JS_PROP_C_W_E);
+	});
 }
 
 
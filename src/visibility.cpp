@@ -24,6 +24,7 @@
  */
 #include "lib/framework/frame.h"
 #include "lib/framework/fixedpoint.h"
+#include "lib/framework/wzapp.h"
 
 #include "lib/gamelib/gtime.h"
 #include "lib/sound/audio.h"
@@ -47,6 +48,10 @@
 #include "qtscript.h"
 #include "wavecast.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 // accuracy for the height gradient
 #define GRAD_MUL 10000
 
@@ -95,18 +100,89 @@ struct VisibleObjectHelp_t
 static int *gNumWalls = nullptr;
 static Vector2i *gWall = nullptr;
 
+/// Viewers are split into chunks of this many, which the vision threads take one at a time.
+#define VIS_VIEWERS_PER_CHUNK 64
+/// Maximum number of threads helping the main thread with processVisibilityVision.
+#define VIS_MAX_THREADS 7
+
+/// An object within range of a viewer, and how well the viewer sees it, see computeVisibilityVision.
+struct VisionCandidate
+{
+	BASE_OBJECT *psObj;
+	int val;
+};
+
+/// Candidates of a chunk of viewers, one viewer after another. viewerEnd[n] is where the candidates of the n:th viewer of the chunk end.
+struct VisionChunk
+{
+	std::vector<VisionCandidate> candidates;
+	std::vector<size_t> viewerEnd;
+};
+
+static std::vector<BASE_OBJECT *> visViewers;       ///< Droids and structures, in the order processVisibility handles them.
+static std::vector<VisionChunk> visChunks;          ///< Only the first visNumChunks are in use, the rest are kept for their memory.
+static size_t visNumChunks = 0;
+static std::atomic<size_t> visNextChunk(0);         ///< Next chunk to be taken by a thread.
+static std::vector<WZ_THREAD *> visThreads;
+static WZ_SEMAPHORE *visStartSemaphore = nullptr;   ///< Posted once per thread needed for the current tick.
+static WZ_SEMAPHORE *visDoneSemaphore = nullptr;    ///< Posted by each thread when there are no more chunks to take.
+static bool visQuit = false;
+
 // forward declarations
 static void setSeenBy(BASE_OBJECT *psObj, unsigned viewer, int val);
 
+static int visThreadFunc(void *);
+
 // initialise the visibility stuff
 bool visInitialise()
 {
 	visLevelInc = 1;
 	visLevelDec = 0;
 
+	if (visThreads.empty())
+	{
+		visQuit = false;
+		visStartSemaphore = wzSemaphoreCreate(0);
+		visDoneSemaphore = wzSemaphoreCreate(0);
+
+		// Leave a core for the main thread, which takes chunks too.
+		unsigned numThreads = std::min<unsigned>(wzGetLogicalCPUCount() - 1, VIS_MAX_THREADS);
+		for (unsigned n = 0; n < numThreads; ++n)
+		{
+			WZ_THREAD *thread = wzThreadCreate(visThreadFunc, nullptr);
+			wzThreadStart(thread);
+			visThreads.push_back(thread);
+		}
+	}
+
 	return true;
 }
 
+void visShutdown()
+{
+	visQuit = true;
+	for (size_t n = 0; n < visThreads.size(); ++n)
+	{
+		wzSemaphorePost(visStartSemaphore);  // Wake up threads.
+	}
+	for (WZ_THREAD *thread : visThreads)
+	{
+		wzThreadJoin(thread);
+	}
+	visThreads.clear();
+
+	if (visStartSemaphore != nullptr)
+	{
+		wzSemaphoreDestroy(visStartSemaphore);
+		visStartSemaphore = nullptr;
+		wzSemaphoreDestroy(visDoneSemaphore);
+		visDoneSemaphore = nullptr;
+	}
+	visViewers.clear();
+	visChunks.clear();
+	visNumChunks = 0;
+}
+
 // update the visibility change levels
 void visUpdateLevel()
 {
@@ -186,7 +262,6 @@ void removeSpotters()
 
 static void updateSpotters()
 {
-	static GridList gridList;  // static to avoid allocations.
 	for (unsigned i = 0; i < apsInvisibleViewers.size(); i++)
 	{
 		SPOTTER *psSpot = apsInvisibleViewers.at(i);
@@ -197,14 +272,11 @@ static void updateSpotters()
 			continue;
 		}
 		// else, ie if not expired, show objects around it
-		gridList = gridStartIterateUnseen(world_coord(psSpot->pos.x), world_coord(psSpot->pos.y), psSpot->sensorRadius, psSpot->player);
-		for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
+		gridVisitUnseen(world_coord(psSpot->pos.x), world_coord(psSpot->pos.y), psSpot->sensorRadius, psSpot->player, [psSpot](BASE_OBJECT *psObj)
 		{
-			BASE_OBJECT *psObj = *gi;
-
 			// Tell system that this side can see this object
 			setSeenBy(psObj, psSpot->player, UBYTE_MAX);
-		}
+		});
 	}
 }
 
@@ -643,6 +715,8 @@ bool hasSharedVision(unsigned viewer, unsigned ally)
 
 static void setSeenBy(BASE_OBJECT *psObj, unsigned viewer, int val /*= UBYTE_MAX*/)
 {
+	gridMarkSeen(psObj);
+
 	//forward out vision to our allies
 	for (int ally = 0; ally < MAX_PLAYERS; ++ally)
 	{
@@ -655,6 +729,8 @@ static void setSeenBy(BASE_OBJECT *psObj, unsigned viewer, int val /*= UBYTE_MAX
 
 static void setSeenByInstantly(BASE_OBJECT *psObj, unsigned viewer, int val /*= UBYTE_MAX*/)
 {
+	gridMarkSeen(psObj);
+
 	//forward out vision to our allies
 	for (int ally = 0; ally < MAX_PLAYERS; ++ally)
 	{
@@ -715,12 +791,8 @@ static void processVisibilityVision(BASE_OBJECT *psViewer)
 
 	// get all the objects from the grid the droid is in
 	// Will give inconsistent results if hasSharedVision is not an equivalence relation.
-	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterateUnseen(psViewer->pos.x, psViewer->pos.y, objSensorRange(psViewer), psViewer->player);
-	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
+	gridVisitUnseen(psViewer->pos.x, psViewer->pos.y, objSensorRange(psViewer), psViewer->player, [psViewer](BASE_OBJECT *psObj)
 	{
-		BASE_OBJECT *psObj = *gi;
-
 		int val = visibleObject(psViewer, psObj, false);
 
 		// If we've got ranged line of sight...
@@ -732,6 +804,178 @@ static void processVisibilityVision(BASE_OBJECT *psViewer)
 			// Check if scripting system wants to trigger an event for this
 			triggerEventSeen(psViewer, psObj);
 		}
+	});
+}
+
+// Find the objects psViewer might see, and how well it sees them, like processVisibilityVision but without changing anything.
+// Function is thread-safe, as long as the main thread waits for it.
+static void computeVisibilityVision(BASE_OBJECT *psViewer, std::vector<VisionCandidate> &candidates)
+{
+	// The unseen filter may let through objects which an earlier viewer sees fully by the time they are applied, applyVisibilityVision skips those.
+	gridVisitUnseen(psViewer->pos.x, psViewer->pos.y, objSensorRange(psViewer), psViewer->player, [psViewer, &candidates](BASE_OBJECT *psObj)
+	{
+		VisionCandidate candidate = {psObj, visibleObject(psViewer, psObj, false)};
+		candidates.push_back(candidate);
+	});
+}
+
+// Takes chunks of visViewers until there are none left. Called by the main thread and the vision threads.
+static void computeVisionChunks()
+{
+	for (size_t n = visNextChunk++; n < visNumChunks; n = visNextChunk++)
+	{
+		VisionChunk &chunk = visChunks[n];
+		chunk.candidates.clear();
+		chunk.viewerEnd.clear();
+		size_t end = std::min(n * VIS_VIEWERS_PER_CHUNK + VIS_VIEWERS_PER_CHUNK, visViewers.size());
+		for (size_t viewer = n * VIS_VIEWERS_PER_CHUNK; viewer < end; ++viewer)
+		{
+			computeVisibilityVision(visViewers[viewer], chunk.candidates);
+			chunk.viewerEnd.push_back(chunk.candidates.size());
+		}
+	}
+}
+
+static int visThreadFunc(void *)
+{
+	for (;;)
+	{
+		wzSemaphoreWait(visStartSemaphore);  // Go to sleep until needed.
+		if (visQuit)
+		{
+			return 0;
+		}
+		computeVisionChunks();
+		wzSemaphorePost(visDoneSemaphore);
+	}
+}
+
+// Applies the candidates computed for visViewers[viewer], in the same order processVisibilityVision would have visited them.
+// Returns true if a script was run, in which case the values computed for later viewers can no longer be trusted.
+static bool applyVisibilityVision(BASE_OBJECT *psViewer, size_t viewer)
+{
+	VisionChunk const &chunk = visChunks[viewer / VIS_VIEWERS_PER_CHUNK];
+	size_t index = viewer % VIS_VIEWERS_PER_CHUNK;
+	size_t begin = index == 0 ? 0 : chunk.viewerEnd[index - 1];
+	bool scriptsRan = false;
+	for (size_t n = begin; n < chunk.viewerEnd[index]; ++n)
+	{
+		BASE_OBJECT *psObj = chunk.candidates[n].psObj;
+		if (psObj->seenThisTick[psViewer->player] == UINT8_MAX)
+		{
+			continue;  // Seen by an earlier viewer, so processVisibilityVision wouldn't have visited it.
+		}
+		int val = scriptsRan ? visibleObject(psViewer, psObj, false) : chunk.candidates[n].val;
+		if (val > 0)
+		{
+			setSeenBy(psObj, psViewer->player, val);
+			scriptsRan = triggerEventSeen(psViewer, psObj) || scriptsRan;
+		}
+	}
+	return scriptsRan;
+}
+
+// Does the same as calling processVisibilityVision on all droids and structures, but the line of sight checks are done in parallel first.
+static void processVisibilityVisionAll()
+{
+	visViewers.clear();
+	for (int player = 0; player < MAX_PLAYERS; ++player)
+	{
+		BASE_OBJECT *lists[] = {apsDroidLists[player], apsStructLists[player]};
+		for (BASE_OBJECT *list : lists)
+		{
+			for (BASE_OBJECT *psObj = list; psObj != nullptr; psObj = psObj->psNext)
+			{
+				visViewers.push_back(psObj);
+			}
+		}
+	}
+
+	visNumChunks = (visViewers.size() + VIS_VIEWERS_PER_CHUNK - 1) / VIS_VIEWERS_PER_CHUNK;
+	if (visChunks.size() < visNumChunks)
+	{
+		visChunks.resize(visNumChunks);
+	}
+	visNextChunk = 0;
+	size_t numHelpers = std::min(visThreads.size(), visNumChunks > 0 ? visNumChunks - 1 : 0);
+	for (size_t n = 0; n < numHelpers; ++n)
+	{
+		wzSemaphorePost(visStartSemaphore);
+	}
+	computeVisionChunks();
+	for (size_t n = 0; n < numHelpers; ++n)
+	{
+		wzSemaphoreWait(visDoneSemaphore);
+	}
+
+	// Merge the results in a fixed order, so that the outcome doesn't depend on the number of threads. If a script
+	// runs, it might change anything, so do everything after that the slow way, exactly as if nothing was computed.
+	bool stale = false;
+	size_t viewer = 0;
+	for (int player = 0; player < MAX_PLAYERS; ++player)
+	{
+		BASE_OBJECT *lists[] = {apsDroidLists[player], apsStructLists[player]};
+		for (BASE_OBJECT *list : lists)
+		{
+			for (BASE_OBJECT *psObj = list; psObj != nullptr; psObj = psObj->psNext)
+			{
+				stale = stale || viewer >= visViewers.size() || visViewers[viewer] != psObj;
+				if (stale)
+				{
+					processVisibilityVision(psObj);
+				}
+				else
+				{
+					stale = applyVisibilityVision(psObj, viewer++);
+				}
+			}
+		}
+	}
+}
+
+// Show active radars to the radar detectors in range of them as radar blips.
+static void processVisibilityRadarDetectors()
+{
+	static std::vector<BASE_OBJECT *> radars;  // Active radars, sorted by x coordinate.
+
+	radars.clear();
+	for (BASE_OBJECT *psObj = apsSensorList[0]; psObj != nullptr; psObj = psObj->psNextFunc)
+	{
+		if (objActiveRadar(psObj))
+		{
+			radars.push_back(psObj);
+		}
+	}
+	if (radars.empty())
+	{
+		return;
+	}
+	std::sort(radars.begin(), radars.end(), [](BASE_OBJECT const *a, BASE_OBJECT const *b)
+	{
+		return a->pos.x < b->pos.x;
+	});
+
+	// A target only ever gets raised to UBYTE_MAX / 2, so the order the detectors and targets are checked in doesn't matter.
+	for (BASE_OBJECT *psObj = apsSensorList[0]; psObj != nullptr; psObj = psObj->psNextFunc)
+	{
+		if (objRadarDetector(psObj))
+		{
+			// Only targets with |dx| < range can have iHypot(dx, dy) < range.
+			const int range = objSensorRange(psObj) * 10;
+			auto first = std::upper_bound(radars.begin(), radars.end(), psObj->pos.x - range, [](int x, BASE_OBJECT const *psTarget)
+			{
+				return x < psTarget->pos.x;
+			});
+			for (auto it = first; it != radars.end() && (*it)->pos.x < psObj->pos.x + range; ++it)
+			{
+				BASE_OBJECT *psTarget = *it;
+				if (psObj != psTarget && psTarget->visible[psObj->player] < UBYTE_MAX / 2
+				    && iHypot((psTarget->pos - psObj->pos).xy()) < range)
+				{
+					psTarget->visible[psObj->player] = UBYTE_MAX / 2;
+				}
+			}
+		}
 	}
 }
 
@@ -828,33 +1072,8 @@ void processVisibility()
 			}
 		}
 	}
-	for (int player = 0; player < MAX_PLAYERS; ++player)
-	{
-		BASE_OBJECT *lists[] = {apsDroidLists[player], apsStructLists[player]};
-		unsigned list;
-		for (list = 0; list < sizeof(lists) / sizeof(*lists); ++list)
-		{
-			for (BASE_OBJECT *psObj = lists[list]; psObj != nullptr; psObj = psObj->psNext)
-			{
-				processVisibilityVision(psObj);
-			}
-		}
-	}
-	for (BASE_OBJECT *psObj = apsSensorList[0]; psObj != nullptr; psObj = psObj->psNextFunc)
-	{
-		if (objRadarDetector(psObj))
-		{
-			for (BASE_OBJECT *psTarget = apsSensorList[0]; psTarget != nullptr; psTarget = psTarget->psNextFunc)
-			{
-				if (psObj != psTarget && psTarget->visible[psObj->player] < UBYTE_MAX / 2
-				    && objActiveRadar(psTarget)
-				    && iHypot((psTarget->pos - psObj->pos).xy()) < objSensorRange(psObj) * 10)
-				{
-					psTarget->visible[psObj->player] = UBYTE_MAX / 2;
-				}
-			}
-		}
-	}
+	processVisibilityVisionAll();
+	processVisibilityRadarDetectors();
 	for (int player = 0; player < MAX_PLAYERS; ++player)
 	{
 		BASE_OBJECT *lists[] = {apsDroidLists[player], apsStructLists[player], apsFeatureLists[player]};
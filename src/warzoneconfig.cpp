@@ -64,6 +64,8 @@ struct WARZONE_GLOBALS
 	bool radarJump = false;
 	video_backend gfxBackend = video_backend::opengl; // the actual default value is determined in loadConfig()
 	JS_BACKEND jsBackend = (JS_BACKEND)0;
+	bool recordReplays = false;
+	int maxReplays = 20; // replays kept in replay/multiplay, 0 to keep them all
 };
 
 static WARZONE_GLOBALS warGlobs;
@@ -402,3 +404,23 @@ void war_setJSBackend(JS_BACKEND backend)
 {
 	warGlobs.jsBackend = backend;
 }
+
+bool war_GetRecordReplays()
+{
+	return warGlobs.recordReplays;
+}
+
+void war_SetRecordReplays(bool enabled)
+{
+	warGlobs.recordReplays = enabled;
+}
+
+int war_GetMaxReplays()
+{
+	return warGlobs.maxReplays;
+}
+
+void war_SetMaxReplays(int maxReplays)
+{
+	warGlobs.maxReplays = std::max(maxReplays, 0);
+}
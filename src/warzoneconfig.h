@@ -115,6 +115,10 @@ video_backend war_getGfxBackend();
 void war_setGfxBackend(video_backend backend);
 JS_BACKEND war_getJSBackend();
 void war_setJSBackend(JS_BACKEND backend);
+bool war_GetRecordReplays();
+void war_SetRecordReplays(bool enabled);
+int war_GetMaxReplays();
+void war_SetMaxReplays(int maxReplays);
 
 /**
  * Enable or disable sound initialization
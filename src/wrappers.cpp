@@ -34,12 +34,14 @@
 #include "lib/sound/audio.h"
 #include "lib/framework/wzapp.h"
 
+#include "clparse.h"
 #include "frontend.h"
 #include "keyedit.h"
 #include "keymap.h"
 #include "mission.h"
 #include "multiint.h"
 #include "multilimit.h"
+#include "multiplay.h"
 #include "multistat.h"
 #include "warzoneconfig.h"
 #include "wrappers.h"
@@ -128,9 +130,13 @@ TITLECODE titleLoop()
 	if (firstcall)
 	{
 		firstcall = false;
-		// First check to see if --host was given as a command line option, if not,
-		// then check --join and if neither, run the normal game menu.
-		if (hostlaunch != HostLaunch::Normal)
+		// First check to see if --replay was given as a command line option, then
+		// --host, then --join, and if none of them, run the normal game menu.
+		if (!wz_replay_file().empty() && startReplayGame(wz_replay_file()))
+		{
+			// Started the game from the replay settings, skipping the menus.
+		}
+		else if (hostlaunch != HostLaunch::Normal)
 		{
 			if (hostlaunch == HostLaunch::Skirmish)
 			{
@@ -558,6 +558,9 @@ namespace wzapi
 
 		virtual bool debugEvaluateCommand(const std::string &text) = 0;
 
+		// time and memory taken by the functions of the script, if profiled (see scriptSetProfiling)
+		virtual nlohmann::json debugGetProfile() { return nlohmann::json(); }
+
 	public:
 		// output to debug log file
 		void dumpScriptLog(const std::string &info);